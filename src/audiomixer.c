@@ -17,6 +17,7 @@
 #include "mixer.h"
 #include "parallel_output.h"
 #include "parallel_output_gui.h"
+#include "rbjeq.h"
 #include "version.h"
 
 static struct mixer *g_mixer = NULL;
@@ -26,6 +27,8 @@ static int g_last_frame = -1;
 static int16_t *g_warming_buffer = NULL;
 static size_t g_warming_buffer_samples = 0;
 
+static struct wstr g_ir_dir = {0}; // impulse responses for the convolution reverb are read from here
+
 static HFONT g_font = NULL;
 static HWND g_id_combo = NULL;
 static HWND g_params_label = NULL;
@@ -114,6 +117,7 @@ static BOOL filter_proc_channel_strip(FILTER *fp, FILTER_PROC_INFO *fpip) {
     return TRUE;
   }
   bool updated = false;
+  static float const div100 = 1.f / 100.f;
   static float const div1000 = 1.f / 1000.f;
   static float const div10000 = 1.f / 10000.f;
   error err = mixer_update_channel(g_mixer,
@@ -125,10 +129,26 @@ static BOOL filter_proc_channel_strip(FILTER *fp, FILTER_PROC_INFO *fpip) {
                                        .low_shelf_gain = slider_to_db(fp->track[4]),
                                        .high_shelf_frequency = (float)fp->track[5],
                                        .high_shelf_gain = slider_to_db(fp->track[6]),
+                                       .eq_backend = fp->check[2] ? channel_eq_backend_svf : channel_eq_backend_biquad,
+                                       // the mid band only goes into the cascade while it changes the sound
+                                       .eq_band_count = fp->track[16] != 0 ? 1 : 0,
+                                       .eq_bands =
+                                           {
+                                               {
+                                                   .type = rbjeq_type_peaking,
+                                                   .frequency = (float)fp->track[15],
+                                                   .q = (float)(fp->track[17]) * div100,
+                                                   .gain = slider_to_db(fp->track[16]),
+                                               },
+                                           },
                                        .dynamics_threshold = (float)(fp->track[7]) * div10000,
                                        .dynamics_ratio = (float)(fp->track[8]) * div10000 * 0.4f + 0.2f,
                                        .dynamics_attack = (float)(fp->track[9]) * div10000,
                                        .dynamics_release = (float)(fp->track[10]) * div10000 * 0.82f,
+                                       .dynamics_detector =
+                                           fp->check[0] ? dynamics_detector_rms : dynamics_detector_peak,
+                                       .dynamics_rms_window = 0.05f,
+                                       .dynamics_control_interval = fp->check[1] ? 8 : 1,
                                        .aux_send_id = fp->track[11],
                                        .aux_send = slider_to_db(fp->track[12]),
                                        .post_gain = slider_to_db(fp->track[13]),
@@ -216,6 +236,11 @@ static BOOL filter_proc_aux1(FILTER *fp, FILTER_PROC_INFO *fpip) {
     return TRUE;
   }
 
+  wchar_t ir_path[MAX_PATH] = {0};
+  if (fp->check[2] && g_ir_dir.len + 16 < MAX_PATH) {
+    wsprintfW(ir_path, L"%ls%d.wav", g_ir_dir.ptr, id);
+  }
+
   bool updated = false;
   static float const div10000 = 1.f / 10000.f;
   error err = mixer_update_aux_channel(g_mixer,
@@ -230,6 +255,12 @@ static BOOL filter_proc_aux1(FILTER *fp, FILTER_PROC_INFO *fpip) {
                                                    .damping = (float)(fp->track[5]) * div10000,
                                                    .excursion = (float)(fp->track[6]) * div10000,
                                                    .wet = slider_to_db(fp->track[7]),
+                                                   .quality = fp->check[0] ? aux_channel_reverb_quality_half
+                                                                           : aux_channel_reverb_quality_full,
+                                                   .type = fp->check[2]   ? aux_channel_reverb_type_convolution
+                                                           : fp->check[1] ? aux_channel_reverb_type_fdn
+                                                                          : aux_channel_reverb_type_dattorro,
+                                                   .ir_path = ir_path,
                                                },
                                        },
                                        &updated);
@@ -268,6 +299,24 @@ static BOOL filter_init(FILTER *fp) {
     err = ethru(err);
     goto cleanup;
   }
+  err = get_module_file_name(get_hinstance(), &g_ir_dir);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  size_t fnpos = 0;
+  err = extract_file_name(&g_ir_dir, &fnpos);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  g_ir_dir.ptr[fnpos] = L'\0';
+  g_ir_dir.len = fnpos;
+  err = scat(&g_ir_dir, L"AudioMixerIR\\");
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
   FILTER *afp = aviutl_get_exedit_audio_filter();
   if (afp) {
     g_exedit_audio_filter_proc = (BOOL(*)(FILTER * fp, FILTER_PROC_INFO * fpip))(void *)afp->func_proc;
@@ -284,6 +333,7 @@ cleanup:
 static BOOL filter_exit(FILTER *fp) {
   aviutl_set_pointers(fp, NULL);
   ereport(mixer_destroy(&g_mixer));
+  ereport(sfree(&g_ir_dir));
   if (g_warming_buffer) {
     ereport(mem_aligned_free(&g_warming_buffer));
   }
@@ -452,7 +502,10 @@ static void update_params_view(void) {
               NSTR(" μs\r\n"),
               NSTR("  Release   "),
               params.dynamics_release,
-              NSTR(" ms\r\n\r\n"),
+              NSTR(" ms\r\n"),
+              NSTR("  Detector  "),
+              params.dynamics_detector,
+              NSTR("\r\n\r\n"),
               NSTR("[Aux1 Send]\r\n"),
               NSTR("  Gain      "),
               params.aux_send,
@@ -940,21 +993,47 @@ FILTER_DLL __declspec(dllexport) * *__stdcall GetFilterTableList(void) {
                                                "Aux ID",
                                                "Aux Send",
                                                NULL,
-                                               NULL};
-  static int channel_strip_track_default[] = {-1, 0, 0, 200, 0, 3000, 0, 6000, 0, 1800, 5500, -1, -10000, 0, 0};
-  static int channel_strip_track_s[] = {-1, -10000, 0, 1, -10000, 1, -10000, 0, 0, 0, 0, -1, -10000, -10000, -10000};
-  static int channel_strip_track_e[] = {
-      100, 10000, 500, 24000, 10000, 24000, 10000, 10000, 10000, 10000, 10000, 100, 10000, 10000, 10000};
+                                               NULL,
+                                               "EQ MidFreq",
+                                               "EQ MidGain",
+                                               "EQ MidQ"};
+  static int channel_strip_track_default[] = {
+      -1, 0, 0, 200, 0, 3000, 0, 6000, 0, 1800, 5500, -1, -10000, 0, 0, 1000, 0, 100};
+  static int channel_strip_track_s[] = {
+      -1, -10000, 0, 1, -10000, 1, -10000, 0, 0, 0, 0, -1, -10000, -10000, -10000, 1, -10000, 10};
+  static int channel_strip_track_e[] = {100,
+                                        10000,
+                                        500,
+                                        24000,
+                                        10000,
+                                        24000,
+                                        10000,
+                                        10000,
+                                        10000,
+                                        10000,
+                                        10000,
+                                        100,
+                                        10000,
+                                        10000,
+                                        10000,
+                                        24000,
+                                        10000,
+                                        1000};
+  static TCHAR *channel_strip_check_names[] = {"C RMS", "C LowCPU", "EQ SVF"};
+  static int channel_strip_check_default[] = {0, 0, 0};
   static FILTER_DLL channel_strip_filter_dll = {
       .flag = FILTER_FLAG_PRIORITY_LOWEST | FILTER_FLAG_ALWAYS_ACTIVE | FILTER_FLAG_AUDIO_FILTER |
               FILTER_FLAG_WINDOW_SIZE | FILTER_FLAG_EX_INFORMATION,
       .x = 240 | FILTER_WINDOW_SIZE_CLIENT,
-      .y = 540 | FILTER_WINDOW_SIZE_CLIENT,
-      .track_n = 15,
+      .y = 648 | FILTER_WINDOW_SIZE_CLIENT,
+      .track_n = 18,
       .track_name = channel_strip_track_names,
       .track_default = channel_strip_track_default,
       .track_s = channel_strip_track_s,
       .track_e = channel_strip_track_e,
+      .check_n = 3,
+      .check_name = channel_strip_check_names,
+      .check_default = channel_strip_check_default,
       .func_proc = filter_proc_channel_strip,
       .func_init = filter_init,
       .func_exit = filter_exit,
@@ -965,6 +1044,8 @@ FILTER_DLL __declspec(dllexport) * *__stdcall GetFilterTableList(void) {
   static int aux1_channel_strip_track_default[] = {-1, 0, 10000, 10000, 5000, 50, 5000, 0};
   static int aux1_channel_strip_track_s[] = {-1, 0, 0, 0, 0, 0, 0, -10000};
   static int aux1_channel_strip_track_e[] = {100, 10000, 10000, 10000, 10000, 10000, 10000, 0};
+  static TCHAR *aux1_channel_strip_check_names[] = {"R HalfRate", "R FDN", "R Conv"};
+  static int aux1_channel_strip_check_default[] = {0, 0, 0};
   static FILTER_DLL aux1_channel_strip_filter_dll = {
       .flag =
           FILTER_FLAG_PRIORITY_HIGHEST | FILTER_FLAG_ALWAYS_ACTIVE | FILTER_FLAG_AUDIO_FILTER | FILTER_FLAG_NO_CONFIG,
@@ -973,6 +1054,9 @@ FILTER_DLL __declspec(dllexport) * *__stdcall GetFilterTableList(void) {
       .track_default = aux1_channel_strip_track_default,
       .track_s = aux1_channel_strip_track_s,
       .track_e = aux1_channel_strip_track_e,
+      .check_n = 3,
+      .check_name = aux1_channel_strip_check_names,
+      .check_default = aux1_channel_strip_check_default,
       .func_proc = filter_proc_aux1,
   };
   static FILTER_DLL parallel_output_filter_dll = {
@@ -3,55 +3,227 @@
 #include <math.h>
 #include <stdatomic.h>
 
+#include "ovthreads.h"
+
 #include "array2d.h"
+#include "convreverb.h"
+#include "fdnreverb.h"
+#include "halfband.h"
 #include "inlines.h"
+#include "simd.h"
 #include "uxfdreverb.h"
 
+struct aux_channel_format {
+  float sample_rate;
+  size_t channels;
+  size_t buffer_size;
+  size_t serial; // incremented on every change
+};
+
+enum {
+  retry_min_frames = 16, // frames before a failed construction is queued again
+  retry_max_frames = 4096,
+};
+
+enum aux_channel_state {
+  aux_channel_state_queued, // waiting for or under construction by the builder thread
+  aux_channel_state_ready,
+  aux_channel_state_failed, // construction failed, build_error holds the reason
+};
+
 struct aux_channel {
   size_t used_at;
   size_t parameter_updated_at;
   struct uxfdreverb *reverb;
+  struct fdnreverb *fdn;   // only created for the FDN type
+  struct convreverb *conv; // only created for the convolution type
+  NATIVE_CHAR *ir_path;    // file the impulse response of conv was requested from
+  float ir_sample_rate;    // rate the impulse response of conv was requested at
+  struct halfband *halfband;
   struct array2d buf;
+  struct array2d half_in;
+  struct array2d half_out;
+  struct aux_channel_format format; // format the buffers and the reverbs are prepared for
+  int quality;
+  int type;
   int id;
 
+  // background construction, see builder_main
+  // Until the state becomes ready, the members above except id and used_at belong to the builder thread.
+  atomic_int state; // enum aux_channel_state
+  error build_error;
+  struct aux_channel_effect_params pending; // applied on construction, protected by the list's mtx
+  NATIVE_CHAR *pending_ir_path;             // owned copy of pending.reverb.ir_path
+  bool has_pending;
+  bool prewarmed; // kept by gc until it is used for the first time
+  struct aux_channel *job_next;
+  struct aux_channel *replacement; // reverb being rebuilt by the builder thread, see rebuild
+  size_t build_serial;             // serial of the format the last construction was started with
+  size_t retry_at;                 // counter before which a failed construction is not queued again
+  size_t retry_interval;           // frames to the next retry, 0 unless the last construction failed
+
+  // auto-sleep, see aux_channel_sleep
+  float tail_peak;       // largest send peak since the reverb last went to sleep
+  size_t silent_samples; // samples since the last non-silent send
+  bool sleeping;
+
   struct aux_channel *next;
 };
 
-static float g_sample_rate = 0;
-static size_t g_channels = 0;
-static size_t g_buffer_size = 0;
-
 static void clear_buffer(struct aux_channel *const c) {
   clear((float *restrict const *)c->buf.ptr, c->buf.channels, c->buf.buffer_size);
 }
 
+static float reverb_sample_rate(struct aux_channel const *const c, float const sample_rate) {
+  return c->quality == aux_channel_reverb_quality_half ? sample_rate * 0.5f : sample_rate;
+}
+
+static size_t reverb_max_samples(struct aux_channel const *const c, size_t const buffer_size) {
+  return c->quality == aux_channel_reverb_quality_half ? buffer_size / 2 + 1 : buffer_size;
+}
+
 NODISCARD static error aux_channel_set_format(struct aux_channel *const c,
-                                              float const sample_rate,
-                                              size_t const channels,
-                                              size_t const buffer_size) {
+                                              struct aux_channel_format const *const format) {
+  size_t const channels = format->channels;
+  size_t const buffer_size = format->buffer_size;
   struct array2d buf = {0};
+  struct array2d half_in = {0};
+  struct array2d half_out = {0};
   error err = array2d_allocate(&buf, channels, buffer_size);
   if (efailed(err)) {
     err = ethru(err);
     goto cleanup;
   }
+  err = array2d_allocate(&half_in, channels, buffer_size / 2 + 1);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  err = array2d_allocate(&half_out, channels, buffer_size / 2 + 1);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  err = halfband_set_format(c->halfband, channels);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
   array2d_release(&c->buf);
+  array2d_release(&c->half_in);
+  array2d_release(&c->half_out);
   c->buf = buf;
+  c->half_in = half_in;
+  c->half_out = half_out;
+  buf = (struct array2d){0};
+  half_in = (struct array2d){0};
+  half_out = (struct array2d){0};
+  c->format = *format;
   clear_buffer(c);
-  uxfdreverb_set_format(c->reverb, sample_rate, channels);
+  halfband_clear(c->halfband);
+  uxfdreverb_set_format(c->reverb, reverb_sample_rate(c, format->sample_rate), channels);
+  if (c->fdn) {
+    fdnreverb_set_format(c->fdn, reverb_sample_rate(c, format->sample_rate), channels);
+  }
+  if (c->conv) {
+    convreverb_set_format(c->conv, channels, reverb_max_samples(c, buffer_size));
+  }
 cleanup:
+  array2d_release(&buf);
+  array2d_release(&half_in);
+  array2d_release(&half_out);
   return err;
 }
 
 static void aux_channel_reset(struct aux_channel *const c) {
   c->used_at = 0;
   c->parameter_updated_at = 0;
+  c->tail_peak = 0.f;
+  c->silent_samples = 0;
+  c->sleeping = false;
   clear_buffer(c);
+  halfband_clear(c->halfband);
   uxfdreverb_clear(c->reverb);
+  if (c->fdn) {
+    fdnreverb_clear(c->fdn);
+  }
+  if (c->conv) {
+    convreverb_clear(c->conv);
+  }
+}
+
+// Creates the reverb of the type on construction, a ready channel changes its type through a replacement.
+NODISCARD static error aux_channel_set_type(struct aux_channel *const c, int const type) {
+  if (type == aux_channel_reverb_type_fdn && !c->fdn) {
+    error err = fdnreverb_create(&c->fdn);
+    if (efailed(err)) {
+      err = ethru(err);
+      return err;
+    }
+    fdnreverb_set_dry(c->fdn, 0.f);
+    fdnreverb_set_format(c->fdn, reverb_sample_rate(c, c->format.sample_rate), c->format.channels);
+  }
+  if (type == aux_channel_reverb_type_convolution && !c->conv) {
+    error err = convreverb_create(&c->conv);
+    if (efailed(err)) {
+      err = ethru(err);
+      return err;
+    }
+    convreverb_set_format(c->conv, c->format.channels, reverb_max_samples(c, c->format.buffer_size));
+  }
+  c->type = type;
+  return eok();
+}
+
+static bool same_ir(struct aux_channel const *const c, NATIVE_CHAR const *const path, float const sample_rate) {
+  bool const same_path = (!path || !path[0]) ? !c->ir_path : (c->ir_path && wcscmp(c->ir_path, path) == 0);
+  return same_path && fcmp(c->ir_sample_rate, ==, sample_rate, 1e-3f);
+}
+
+// Loads the impulse response when the file or the rate it is needed at has changed.
+// A file that cannot be loaded is reported once and leaves the reverb silent until the path changes.
+NODISCARD static error aux_channel_set_ir(struct aux_channel *const c, NATIVE_CHAR const *const path) {
+  float const sample_rate = reverb_sample_rate(c, c->format.sample_rate);
+  if (same_ir(c, path, sample_rate)) {
+    return eok();
+  }
+  struct convreverb_ir *ir = NULL;
+  error err = eok();
+  if (c->ir_path) {
+    ereport(mem_free(&c->ir_path));
+  }
+  c->ir_sample_rate = sample_rate;
+  if (path && path[0]) {
+    size_t const len = wcslen(path);
+    err = mem(&c->ir_path, len + 1, sizeof(NATIVE_CHAR));
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
+    memcpy(c->ir_path, path, (len + 1) * sizeof(NATIVE_CHAR));
+    ereport(convreverb_ir_load(&ir, path, sample_rate));
+  }
+  convreverb_set_ir(c->conv, &ir);
+cleanup:
+  return err;
 }
 
 static void aux_channel_set_effects(struct aux_channel *const c, struct aux_channel_effect_params const *e) {
   struct aux_channel_effect_reverb_params const *const rev = &e->reverb;
+  if (c->type == aux_channel_reverb_type_convolution) {
+    convreverb_set_wet(c->conv, db_to_amp(rev->wet));
+    return;
+  }
+  if (c->type == aux_channel_reverb_type_fdn) {
+    fdnreverb_set_band_width(c->fdn, rev->band_width);
+    fdnreverb_set_pre_delay(c->fdn, rev->pre_delay);
+    fdnreverb_set_diffuse(c->fdn, rev->diffuse);
+    fdnreverb_set_decay(c->fdn, rev->decay);
+    fdnreverb_set_damping(c->fdn, rev->damping);
+    fdnreverb_set_excursion(c->fdn, rev->excursion);
+    fdnreverb_set_wet(c->fdn, db_to_amp(rev->wet));
+    return;
+  }
   uxfdreverb_set_band_width(c->reverb, rev->band_width);
   uxfdreverb_set_pre_delay(c->reverb, rev->pre_delay);
   uxfdreverb_set_diffuse(c->reverb, rev->diffuse);
@@ -62,7 +234,36 @@ static void aux_channel_set_effects(struct aux_channel *const c, struct aux_chan
 }
 
 NODISCARD static error aux_channel_update_internal_parameter(struct aux_channel *const c, bool *const updated) {
-  error err = uxfdreverb_update_internal_parameter(c->reverb, updated);
+  error err = eok();
+  if (c->conv) {
+    bool b = false;
+    err = convreverb_update_internal_parameter(c->conv, &b);
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
+    if (c->type == aux_channel_reverb_type_convolution) {
+      if (updated) {
+        *updated = b;
+      }
+      goto cleanup;
+    }
+  }
+  if (c->fdn) {
+    bool b = false;
+    err = fdnreverb_update_internal_parameter(c->fdn, &b);
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
+    if (c->type == aux_channel_reverb_type_fdn) {
+      if (updated) {
+        *updated = b;
+      }
+      goto cleanup;
+    }
+  }
+  err = uxfdreverb_update_internal_parameter(c->reverb, updated);
   if (efailed(err)) {
     err = ethru(err);
     goto cleanup;
@@ -71,37 +272,186 @@ cleanup:
   return err;
 }
 
+NODISCARD static error aux_channel_configure(struct aux_channel *const c,
+                                            struct aux_channel_effect_params const *const e,
+                                            bool *const updated) {
+  error err = eok();
+  // while a replacement is being built the running reverb only takes the parameters it can apply in place
+  if (!c->replacement) {
+    err = aux_channel_set_type(c, e->reverb.type);
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
+  }
+  aux_channel_set_effects(c, e);
+  if (c->type == aux_channel_reverb_type_convolution && !c->replacement) {
+    err = aux_channel_set_ir(c, e->reverb.ir_path);
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
+  }
+  err = aux_channel_update_internal_parameter(c, updated);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+cleanup:
+  return err;
+}
+
+static void aux_channel_process_reverb(struct aux_channel *const c,
+                                       float const *restrict const *const inputs,
+                                       float *restrict const *const outputs,
+                                       size_t const samples) {
+  switch (c->type) {
+  case aux_channel_reverb_type_fdn:
+    fdnreverb_process(c->fdn, inputs, outputs, samples);
+    break;
+  case aux_channel_reverb_type_convolution:
+    convreverb_process(c->conv, inputs, outputs, samples);
+    break;
+  default:
+    uxfdreverb_process(c->reverb, inputs, outputs, samples);
+    break;
+  }
+}
+
+// Whether the tail can still be above -144dB after the send has been silent for the given seconds.
+// The estimate for the algorithmic reverbs is the largest send peak with some headroom for build-up in the tank,
+// decaying at the reverb's upper bound once the pre-delay and diffusers have passed.
+// The convolution reverb has a known end.
+static bool aux_channel_tail_audible(struct aux_channel const *const c, float const seconds) {
+  static float const threshold = 0.000000063095734f; // -144db
+  static float const headroom = 16.f;
+  static float const onset = 0.3f; // longest pre-delay plus input diffusion in seconds
+  if (c->type == aux_channel_reverb_type_convolution) {
+    return seconds < convreverb_get_tail_duration(c->conv);
+  }
+  float const decay = c->type == aux_channel_reverb_type_fdn ? fdnreverb_get_decay_per_second(c->fdn)
+                                                             : uxfdreverb_get_decay_per_second(c->reverb);
+  float const t = seconds - onset;
+  return t < 0.f || c->tail_peak * headroom * powf(decay, t) >= threshold;
+}
+
+// Skips the reverb while nothing is sent and its tail has died out.
+// Returns true if the reverb was skipped and the output of this round is silence.
+static bool aux_channel_sleep(struct aux_channel *const c, float const peak, size_t const samples) {
+  if (peak > 0.f) {
+    c->tail_peak = fmaxf(c->tail_peak, peak);
+    c->silent_samples = 0;
+    c->sleeping = false;
+    return false;
+  }
+  if (!c->sleeping) {
+    float const seconds = (float)(c->silent_samples) / c->format.sample_rate;
+    c->silent_samples += samples;
+    if (c->tail_peak > 0.f && aux_channel_tail_audible(c, seconds)) {
+      return false;
+    }
+    c->sleeping = true;
+    c->tail_peak = 0.f;
+    halfband_clear(c->halfband);
+  }
+  size_t const reverb_samples = c->quality == aux_channel_reverb_quality_half ? samples / 2 : samples;
+  switch (c->type) {
+  case aux_channel_reverb_type_fdn:
+    fdnreverb_silence(c->fdn, reverb_samples);
+    break;
+  case aux_channel_reverb_type_convolution:
+    convreverb_silence(c->conv, reverb_samples);
+    break;
+  default:
+    uxfdreverb_silence(c->reverb, reverb_samples);
+    break;
+  }
+  return true;
+}
+
+// Frees everything but the channel itself, so that a failed construction can be retried.
+static void aux_channel_release(struct aux_channel *const c) {
+  array2d_release(&c->buf);
+  array2d_release(&c->half_in);
+  array2d_release(&c->half_out);
+  if (c->halfband) {
+    ereport(halfband_destroy(&c->halfband));
+  }
+  if (c->fdn) {
+    ereport(fdnreverb_destroy(&c->fdn));
+  }
+  if (c->conv) {
+    ereport(convreverb_destroy(&c->conv));
+  }
+  if (c->ir_path) {
+    ereport(mem_free(&c->ir_path));
+  }
+  if (c->reverb) {
+    ereport(uxfdreverb_destroy(&c->reverb));
+  }
+  c->ir_sample_rate = 0.f;
+  c->quality = aux_channel_reverb_quality_full;
+  c->type = aux_channel_reverb_type_dattorro;
+}
+
 NODISCARD static error aux_channel_destroy(struct aux_channel **cp) {
   if (!cp || !*cp) {
     return errg(err_invalid_arugment);
   }
   struct aux_channel *c = *cp;
-  array2d_release(&c->buf);
-  if (c->reverb) {
-    ereport(uxfdreverb_destroy(&c->reverb));
+  aux_channel_release(c);
+  if (c->pending_ir_path) {
+    ereport(mem_free(&c->pending_ir_path));
+  }
+  if (c->build_error) {
+    efree(&c->build_error);
+  }
+  if (c->replacement) {
+    ereport(aux_channel_destroy(&c->replacement));
   }
   ereport(mem_free(cp));
   return eok();
 }
 
-NODISCARD static error aux_channel_create(struct aux_channel **const cp) {
+// Only allocates the channel itself, the rest is done by aux_channel_build on the builder thread.
+NODISCARD static error aux_channel_create(struct aux_channel **const cp, int const id) {
   if (!cp || *cp) {
     return errg(err_invalid_arugment);
   }
   error err = mem(cp, 1, sizeof(struct aux_channel));
   if (efailed(err)) {
     err = ethru(err);
-    goto cleanup;
+    return err;
   }
   struct aux_channel *const c = *cp;
-  *c = (struct aux_channel){0};
-  err = uxfdreverb_create(&c->reverb);
+  *c = (struct aux_channel){
+      .id = id,
+  };
+  atomic_init(&c->state, aux_channel_state_queued);
+  return eok();
+}
+
+// Allocates the buffers and the reverbs and applies e if it is not NULL.
+// Whatever an earlier construction of c allocated is freed first.
+NODISCARD static error aux_channel_build(struct aux_channel *const c,
+                                         struct aux_channel_format const *const format,
+                                         struct aux_channel_effect_params const *const e) {
+  aux_channel_release(c);
+  error err = uxfdreverb_create(&c->reverb);
   if (efailed(err)) {
     err = ethru(err);
     goto cleanup;
   }
   uxfdreverb_set_dry(c->reverb, 0.f);
-  err = aux_channel_set_format(c, g_sample_rate, g_channels, g_buffer_size);
+  err = halfband_create(&c->halfband);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  if (e) {
+    c->quality = e->reverb.quality;
+  }
+  err = aux_channel_set_format(c, format);
   if (efailed(err)) {
     err = ethru(err);
     goto cleanup;
@@ -111,12 +461,17 @@ NODISCARD static error aux_channel_create(struct aux_channel **const cp) {
     err = ethru(err);
     goto cleanup;
   }
+  if (e) {
+    err = aux_channel_configure(c, e, NULL);
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
+  }
 
 cleanup:
   if (efailed(err)) {
-    if (*cp) {
-      ereport(aux_channel_destroy(cp));
-    }
+    aux_channel_release(c);
   }
   return err;
 }
@@ -125,6 +480,22 @@ struct aux_channel_list {
   struct aux_channel *head;
   aux_channel_notify_func notify_func;
   void *userdata;
+  struct aux_channel_format format;
+  size_t len;
+  struct channel_send_route *routes; // room for len entries, see aux_channel_list_get_send_routes
+  size_t routes_cap;
+
+  // New channels are constructed on this thread so that the audio thread does not allocate and clear
+  // megabytes of delay lines in the middle of a frame. queue, building, trash, quit, the format and
+  // the pending parameters of the queued channels are protected by mtx.
+  thrd_t builder;
+  mtx_t mtx;
+  cnd_t cnd;
+  struct aux_channel *queue;
+  struct aux_channel *building;
+  struct aux_channel *trash; // replaced reverbs freed by the builder thread, linked by job_next
+  bool quit;
+  bool started;
 };
 
 static struct aux_channel *get_head(struct aux_channel_list const *const acl) { return acl->head; }
@@ -137,10 +508,127 @@ void aux_channel_list_set_notify_callback(struct aux_channel_list *const acl, au
   acl->notify_func = f;
 }
 
+static bool is_ready(struct aux_channel *const c) {
+  return atomic_load_explicit(&c->state, memory_order_acquire) == aux_channel_state_ready;
+}
+
+// Must be called with mtx held.
+static void queue_push(struct aux_channel_list *const acl, struct aux_channel *const c) {
+  struct aux_channel **p = &acl->queue;
+  while (*p) {
+    p = &(*p)->job_next;
+  }
+  *p = c;
+  cnd_broadcast(&acl->cnd);
+}
+
+// Stores the parameters the builder applies on construction, must be called with mtx held if c is queued.
+NODISCARD static error set_pending(struct aux_channel *const c, struct aux_channel_effect_params const *const e) {
+  NATIVE_CHAR const *const path = e->reverb.ir_path;
+  if (!path || !path[0]) {
+    if (c->pending_ir_path) {
+      ereport(mem_free(&c->pending_ir_path));
+    }
+  } else if (!c->pending_ir_path || wcscmp(c->pending_ir_path, path) != 0) {
+    if (c->pending_ir_path) {
+      ereport(mem_free(&c->pending_ir_path));
+    }
+    size_t const len = wcslen(path);
+    error err = mem(&c->pending_ir_path, len + 1, sizeof(NATIVE_CHAR));
+    if (efailed(err)) {
+      err = ethru(err);
+      return err;
+    }
+    memcpy(c->pending_ir_path, path, (len + 1) * sizeof(NATIVE_CHAR));
+  }
+  c->pending = *e;
+  c->pending.reverb.ir_path = c->pending_ir_path;
+  c->has_pending = true;
+  return eok();
+}
+
+static void free_jobs(struct aux_channel *c) {
+  while (c) {
+    struct aux_channel *next = c->job_next;
+    ereport(aux_channel_destroy(&c));
+    c = next;
+  }
+}
+
+static int builder_main(void *userdata) {
+  struct aux_channel_list *const acl = userdata;
+  mtx_lock(&acl->mtx);
+  for (;;) {
+    while (!acl->quit && !acl->queue && !acl->trash) {
+      cnd_wait(&acl->cnd, &acl->mtx);
+    }
+    if (acl->quit) {
+      break;
+    }
+    if (acl->trash) {
+      struct aux_channel *const trash = acl->trash;
+      acl->trash = NULL;
+      mtx_unlock(&acl->mtx);
+      free_jobs(trash);
+      mtx_lock(&acl->mtx);
+      continue;
+    }
+    struct aux_channel *const c = acl->queue;
+    acl->queue = c->job_next;
+    c->job_next = NULL;
+    acl->building = c;
+    struct aux_channel_format const format = acl->format;
+    c->build_serial = format.serial;
+    bool const has_pending = c->has_pending;
+    struct aux_channel_effect_params const pending = c->pending;
+    NATIVE_CHAR *ir_path = c->pending_ir_path; // pending.reverb.ir_path, owned by this thread until the build ends
+    c->pending_ir_path = NULL;
+    c->has_pending = false;
+    mtx_unlock(&acl->mtx);
+
+    error err = aux_channel_build(c, &format, has_pending ? &pending : NULL);
+    if (ir_path) {
+      ereport(mem_free(&ir_path));
+    }
+
+    mtx_lock(&acl->mtx);
+    c->build_error = err;
+    if (!efailed(err)) {
+      c->retry_interval = 0;
+    }
+    atomic_store_explicit(
+        &c->state, efailed(err) ? aux_channel_state_failed : aux_channel_state_ready, memory_order_release);
+    acl->building = NULL;
+    cnd_broadcast(&acl->cnd);
+  }
+  mtx_unlock(&acl->mtx);
+  return 0;
+}
+
+// After this returns the builder thread no longer touches c.
+static void builder_cancel(struct aux_channel_list *const acl, struct aux_channel *const c) {
+  if (atomic_load_explicit(&c->state, memory_order_acquire) != aux_channel_state_queued) {
+    return;
+  }
+  mtx_lock(&acl->mtx);
+  for (struct aux_channel **p = &acl->queue; *p; p = &(*p)->job_next) {
+    if (*p == c) {
+      *p = c->job_next;
+      c->job_next = NULL;
+      break;
+    }
+  }
+  while (acl->building == c) {
+    cnd_wait(&acl->cnd, &acl->mtx);
+  }
+  mtx_unlock(&acl->mtx);
+}
+
 static void free_all(struct aux_channel_list *const acl) {
   struct aux_channel *next = NULL;
   struct aux_channel *ac = get_head(acl);
   set_head(acl, NULL);
+  acl->len = 0;
   while (ac) {
     next = ac->next;
     ereport(aux_channel_destroy(&ac));
@@ -153,7 +641,22 @@ NODISCARD error aux_channel_list_destroy(struct aux_channel_list **const aclp) {
     return errg(err_invalid_arugment);
   }
   struct aux_channel_list *acl = *aclp;
+  if (acl->started) {
+    mtx_lock(&acl->mtx);
+    acl->quit = true;
+    cnd_broadcast(&acl->cnd);
+    mtx_unlock(&acl->mtx);
+    thrd_join(acl->builder, NULL);
+    cnd_destroy(&acl->cnd);
+    mtx_destroy(&acl->mtx);
+  }
+  free_jobs(acl->trash);
+  acl->trash = NULL;
   free_all(acl);
+  if (acl->routes) {
+    ereport(mem_free(&acl->routes));
+  }
+  convreverb_ir_cache_trim();
   ereport(mem_free(aclp));
   return eok();
 }
@@ -169,6 +672,22 @@ NODISCARD error aux_channel_list_create(struct aux_channel_list **const aclp) {
   }
   struct aux_channel_list *acl = *aclp;
   *acl = (struct aux_channel_list){0};
+  if (mtx_init(&acl->mtx, mtx_plain) != thrd_success) {
+    err = errg(err_fail);
+    goto cleanup;
+  }
+  if (cnd_init(&acl->cnd) != thrd_success) {
+    mtx_destroy(&acl->mtx);
+    err = errg(err_fail);
+    goto cleanup;
+  }
+  if (thrd_create(&acl->builder, builder_main, acl) != thrd_success) {
+    cnd_destroy(&acl->cnd);
+    mtx_destroy(&acl->mtx);
+    err = errg(err_fail);
+    goto cleanup;
+  }
+  acl->started = true;
 cleanup:
   if (efailed(err)) {
     if (*aclp) {
@@ -178,42 +697,55 @@ cleanup:
   return err;
 }
 
-NODISCARD static error
-find(struct aux_channel_list *const acl, int const id, size_t const counter, struct aux_channel **const r) {
-  struct aux_channel *c = NULL;
-  struct aux_channel *prev = NULL;
-  for (c = get_head(acl); c; c = c->next) {
+// Returns the channel with the id or NULL, *prev receives the channel after which the id belongs.
+static struct aux_channel *lookup(struct aux_channel_list *const acl, int const id, struct aux_channel **const prev) {
+  *prev = NULL;
+  for (struct aux_channel *c = get_head(acl); c; c = c->next) {
     if (c->id == id) {
-      if (c->used_at != counter) {
-        if (c->used_at + 1 != counter) {
-          // reuse of an used channel
-          aux_channel_reset(c);
-        } else {
-          // first call in current round
-          clear_buffer(c);
-        }
-        c->used_at = counter;
-      }
-      *r = c;
-      return eok();
+      return c;
     }
     if (c->id > id) {
-      goto not_found;
-    }
-    if (!c->next || c->next->id > id) {
-      prev = c;
-      goto not_found;
+      break;
     }
+    *prev = c;
   }
+  return NULL;
+}
 
-not_found:
-  c = NULL;
-  error err = aux_channel_create(&c);
+// Inserts a new channel and queues its construction.
+NODISCARD static error add_channel(struct aux_channel_list *const acl,
+                                   struct aux_channel *const prev,
+                                   int const id,
+                                   struct aux_channel_effect_params const *const e,
+                                   struct aux_channel **const r) {
+  struct aux_channel *c = NULL;
+  struct channel_send_route *routes = NULL;
+  error err = eok();
+  if (acl->len + 1 > acl->routes_cap) {
+    size_t const cap = acl->routes_cap ? acl->routes_cap * 2 : 8;
+    err = mem(&routes, cap, sizeof(struct channel_send_route));
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
+    if (acl->routes) {
+      ereport(mem_free(&acl->routes));
+    }
+    acl->routes = routes;
+    acl->routes_cap = cap;
+  }
+  err = aux_channel_create(&c, id);
   if (efailed(err)) {
     err = ethru(err);
-    return err;
+    goto cleanup;
+  }
+  if (e) {
+    err = set_pending(c, e);
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
   }
-  c->id = id;
   if (prev) {
     c->next = prev->next;
     prev->next = c;
@@ -221,23 +753,266 @@ not_found:
     c->next = get_head(acl);
     set_head(acl, c);
   }
+  ++acl->len;
+  mtx_lock(&acl->mtx);
+  queue_push(acl, c);
+  mtx_unlock(&acl->mtx);
   *r = c;
+  c = NULL;
+
+cleanup:
+  if (c) {
+    ereport(aux_channel_destroy(&c));
+  }
+  return err;
+}
+
+// Takes the error of a failed construction and schedules the next attempt.
+// Only the first of consecutive failures is returned, the interval to the next attempt doubles with each of them.
+NODISCARD static error build_failed(struct aux_channel *const c, size_t const counter, error err) {
+  bool const first = c->retry_interval == 0;
+  c->retry_interval = first ? retry_min_frames
+                            : (c->retry_interval * 2 < retry_max_frames ? c->retry_interval * 2 : retry_max_frames);
+  c->retry_at = counter + c->retry_interval;
+  if (!first) {
+    efree(&err);
+    return eok();
+  }
+  return err;
+}
+
+// Queues the construction of c again with e, the builder frees what the last one allocated.
+NODISCARD static error requeue(struct aux_channel_list *const acl,
+                               struct aux_channel *const c,
+                               struct aux_channel_effect_params const *const e) {
+  mtx_lock(&acl->mtx);
+  error err = set_pending(c, e);
+  if (efailed(err)) {
+    mtx_unlock(&acl->mtx);
+    err = ethru(err);
+    return err;
+  }
+  atomic_store_explicit(&c->state, aux_channel_state_queued, memory_order_relaxed);
+  queue_push(acl, c);
+  mtx_unlock(&acl->mtx);
   return eok();
 }
 
+// Picks up the result of the construction.
+// A failed construction is queued again after a while or as soon as the format changes,
+// a format change made during a successful one queues it again so that the audio thread does not allocate.
+NODISCARD static error check_ready(struct aux_channel_list *const acl,
+                                   struct aux_channel *const c,
+                                   size_t const counter,
+                                   struct aux_channel_effect_params const *const e,
+                                   bool *const ready) {
+  *ready = false;
+  int const state = atomic_load_explicit(&c->state, memory_order_acquire);
+  if (state == aux_channel_state_queued) {
+    return eok();
+  }
+  error err = eok();
+  if (state == aux_channel_state_failed) {
+    if (c->build_error) {
+      err = build_failed(c, counter, c->build_error);
+      c->build_error = NULL;
+      if (efailed(err)) {
+        err = ethru(err);
+        goto cleanup;
+      }
+    }
+    if (counter < c->retry_at && c->build_serial == acl->format.serial) {
+      goto cleanup;
+    }
+    err = requeue(acl, c, e);
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
+    goto cleanup;
+  }
+  if (c->format.serial != acl->format.serial) {
+    err = requeue(acl, c, e);
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
+    goto cleanup;
+  }
+  *ready = true;
+cleanup:
+  return err;
+}
+
+NODISCARD static error find(struct aux_channel_list *const acl,
+                            int const id,
+                            size_t const counter,
+                            struct aux_channel_effect_params const *const e,
+                            struct aux_channel **const r,
+                            bool *const ready) {
+  struct aux_channel *prev = NULL;
+  struct aux_channel *c = lookup(acl, id, &prev);
+  error err = eok();
+  if (!c) {
+    // the parameters are set before the job is queued, the builder could otherwise pick it up without them
+    err = add_channel(acl, prev, id, e, &c);
+    if (efailed(err)) {
+      err = ethru(err);
+      return err;
+    }
+  }
+  err = check_ready(acl, c, counter, e, ready);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  if (c->used_at != counter) {
+    if (*ready) {
+      if (c->used_at + 1 != counter) {
+        // reuse of an used channel
+        aux_channel_reset(c);
+      } else {
+        // first call in current round
+        clear_buffer(c);
+      }
+    }
+    c->used_at = counter;
+    c->prewarmed = false;
+  }
+  *r = c;
+  return eok();
+}
+
+// Whether e asks for a reverb that c cannot switch to without allocating.
+static bool needs_rebuild(struct aux_channel const *const c, struct aux_channel_effect_params const *const e) {
+  struct aux_channel_effect_reverb_params const *const rev = &e->reverb;
+  if (c->type != rev->type || c->quality != rev->quality) {
+    return true;
+  }
+  return c->type == aux_channel_reverb_type_convolution &&
+         !same_ir(c, rev->ir_path, reverb_sample_rate(c, c->format.sample_rate));
+}
+
+static void swap_reverb(struct aux_channel *const c, struct aux_channel *const r) {
+  struct aux_channel const t = *c;
+  c->reverb = r->reverb;
+  c->fdn = r->fdn;
+  c->conv = r->conv;
+  c->ir_path = r->ir_path;
+  c->ir_sample_rate = r->ir_sample_rate;
+  c->halfband = r->halfband;
+  c->quality = r->quality;
+  c->type = r->type;
+  r->reverb = t.reverb;
+  r->fdn = t.fdn;
+  r->conv = t.conv;
+  r->ir_path = t.ir_path;
+  r->ir_sample_rate = t.ir_sample_rate;
+  r->halfband = t.halfband;
+  r->quality = t.quality;
+  r->type = t.type;
+}
+
+// Type, quality and impulse response changes are built on the builder thread into a replacement channel,
+// the reverb that is running keeps processing until the replacement is ready and is then freed on that thread.
+NODISCARD static error rebuild(struct aux_channel_list *const acl,
+                               struct aux_channel *const c,
+                               size_t const counter,
+                               struct aux_channel_effect_params const *const e) {
+  error err = eok();
+  struct aux_channel *r = NULL;
+  int const state = c->replacement ? atomic_load_explicit(&c->replacement->state, memory_order_acquire)
+                                   : aux_channel_state_queued;
+  if (state != aux_channel_state_queued) {
+    // a replacement built for parameters that have changed again is dropped
+    struct aux_channel *const done = c->replacement;
+    c->replacement = NULL;
+    if (state == aux_channel_state_failed) {
+      err = build_failed(c, counter, done->build_error);
+      done->build_error = NULL;
+    } else if (done->format.serial == c->format.serial && needs_rebuild(c, e) && !needs_rebuild(done, e)) {
+      swap_reverb(c, done);
+      c->retry_interval = 0;
+    }
+    mtx_lock(&acl->mtx);
+    done->job_next = acl->trash;
+    acl->trash = done;
+    cnd_broadcast(&acl->cnd);
+    mtx_unlock(&acl->mtx);
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
+  }
+  if (!needs_rebuild(c, e) || counter < c->retry_at) {
+    goto cleanup;
+  }
+  if (c->replacement) {
+    // only picked up if the construction has not started yet, otherwise the next one catches up
+    mtx_lock(&acl->mtx);
+    err = set_pending(c->replacement, e);
+    mtx_unlock(&acl->mtx);
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
+    goto cleanup;
+  }
+  err = aux_channel_create(&r, c->id);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  err = set_pending(r, e);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  mtx_lock(&acl->mtx);
+  queue_push(acl, r);
+  mtx_unlock(&acl->mtx);
+  c->replacement = r;
+  r = NULL;
+
+cleanup:
+  if (r) {
+    ereport(aux_channel_destroy(&r));
+  }
+  return err;
+}
+
 NODISCARD error aux_channel_list_channel_update(struct aux_channel_list *const acl,
                                                 int const id,
                                                 size_t const counter,
                                                 struct aux_channel_effect_params const *e,
                                                 bool *const updated) {
   struct aux_channel *c = NULL;
-  error err = find(acl, id, counter, &c);
+  bool ready = false;
+  error err = find(acl, id, counter, e, &c, &ready);
   if (efailed(err)) {
     err = ethru(err);
     goto cleanup;
   }
-  aux_channel_set_effects(c, e);
-  err = aux_channel_update_internal_parameter(c, updated);
+  if (!ready) {
+    // the builder applies the latest parameters, the channel stays silent until it is ready
+    mtx_lock(&acl->mtx);
+    err = set_pending(c, e);
+    mtx_unlock(&acl->mtx);
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
+    if (updated) {
+      *updated = false;
+    }
+    goto cleanup;
+  }
+  err = rebuild(acl, c, counter, e);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  err = aux_channel_configure(c, e, updated);
   if (efailed(err)) {
     err = ethru(err);
     goto cleanup;
@@ -248,25 +1023,59 @@ cleanup:
   return err;
 }
 
-NODISCARD error aux_channel_list_add(struct aux_channel_list *const acl,
-                                     int const id,
-                                     size_t const counter,
-                                     float const *restrict const *const src,
-                                     size_t const samples,
-                                     float const gain_db) {
-  struct aux_channel *c = NULL;
-  error err = find(acl, id, counter, &c);
+size_t aux_channel_list_get_send_routes(struct aux_channel_list *const acl,
+                                        size_t const counter,
+                                        struct channel_send_route const **const routes) {
+  size_t n = 0;
+  for (struct aux_channel *c = get_head(acl); c; c = c->next) {
+    if (c->parameter_updated_at == counter) {
+      acl->routes[n++] = (struct channel_send_route){
+          .id = c->id,
+          .buf = c->buf.ptr,
+      };
+    }
+  }
+  *routes = acl->routes;
+  return n;
+}
+
+NODISCARD error aux_channel_list_prewarm(struct aux_channel_list *const acl,
+                                         int const id,
+                                         struct aux_channel_effect_params const *e) {
+  struct aux_channel *prev = NULL;
+  struct aux_channel *c = lookup(acl, id, &prev);
+  error err = eok();
+  if (c) {
+    if (atomic_load_explicit(&c->state, memory_order_acquire) == aux_channel_state_queued) {
+      mtx_lock(&acl->mtx);
+      err = set_pending(c, e);
+      mtx_unlock(&acl->mtx);
+      if (efailed(err)) {
+        err = ethru(err);
+        goto cleanup;
+      }
+    }
+    goto cleanup;
+  }
+  err = add_channel(acl, prev, id, e, &c);
   if (efailed(err)) {
     err = ethru(err);
     goto cleanup;
   }
-  float *restrict const *const mixbuf = c->buf.ptr;
-  mix_with_gain(mixbuf, src, gain_db, c->buf.channels, samples);
+  c->prewarmed = true;
 
 cleanup:
   return err;
 }
 
+void aux_channel_list_wait(struct aux_channel_list *const acl) {
+  mtx_lock(&acl->mtx);
+  while (acl->queue || acl->building) {
+    cnd_wait(&acl->cnd, &acl->mtx);
+  }
+  mtx_unlock(&acl->mtx);
+}
+
 void aux_channel_list_mix(struct aux_channel_list const *const acl,
                           size_t const counter,
                           size_t const samples,
@@ -274,19 +1083,42 @@ void aux_channel_list_mix(struct aux_channel_list const *const acl,
                           float *restrict const *const subbuf) {
   float *restrict const *buf;
   float *restrict const *tmp = subbuf;
+  struct simd_kernels const *const k = simd();
   for (struct aux_channel *c = get_head(acl); c; c = c->next) {
     if (c->parameter_updated_at != counter) {
       continue;
     }
     buf = c->buf.ptr;
     size_t const channels = c->buf.channels;
-    uxfdreverb_process(c->reverb, (float const *restrict const *)buf, tmp, samples);
+    if (aux_channel_sleep(c, find_peak((float const *restrict const *)buf, channels, samples), samples)) {
+      if (acl->notify_func) {
+        acl->notify_func(acl->userdata, c->id, (float const *restrict const *)buf, channels, samples);
+      }
+      continue;
+    }
+    if (c->quality == aux_channel_reverb_quality_half) {
+      size_t const half_samples =
+          halfband_decimate(c->halfband, (float const *restrict const *)buf, c->half_in.ptr, samples);
+      aux_channel_process_reverb(c, (float const *restrict const *)c->half_in.ptr, c->half_out.ptr, half_samples);
+      halfband_interpolate(c->halfband, (float const *restrict const *)c->half_out.ptr, half_samples, tmp, samples);
+    } else {
+      aux_channel_process_reverb(c, (float const *restrict const *)buf, tmp, samples);
+    }
     swap(&buf, &tmp);
     if (acl->notify_func) {
       acl->notify_func(acl->userdata, c->id, (float const *restrict const *)buf, channels, samples);
     }
-    mix(mixbuf, (float const *restrict const *)buf, channels, samples);
+    k->mix(mixbuf, (float const *restrict const *)buf, channels, samples);
+  }
+}
+
+bool aux_channel_list_is_active(struct aux_channel_list const *const acl, size_t const counter) {
+  for (struct aux_channel *c = get_head(acl); c; c = c->next) {
+    if (c->parameter_updated_at == counter) {
+      return true;
+    }
   }
+  return false;
 }
 
 void aux_channel_list_gc(struct aux_channel_list *const acl, size_t const counter) {
@@ -294,7 +1126,7 @@ void aux_channel_list_gc(struct aux_channel_list *const acl, size_t const counte
   struct aux_channel *next = NULL;
   struct aux_channel *c = get_head(acl);
   while (c) {
-    if (c->used_at == counter) {
+    if (c->used_at == counter || c->prewarmed) {
       prev = c;
       c = c->next;
       continue;
@@ -305,23 +1137,37 @@ void aux_channel_list_gc(struct aux_channel_list *const acl, size_t const counte
     } else {
       set_head(acl, next);
     }
+    builder_cancel(acl, c);
+    if (c->replacement) {
+      builder_cancel(acl, c->replacement);
+    }
     ereport(aux_channel_destroy(&c));
+    --acl->len;
     c = next;
   }
 }
 
-NODISCARD error aux_channel_list_set_format(struct aux_channel_list const *const acl,
+NODISCARD error aux_channel_list_set_format(struct aux_channel_list *const acl,
                                             float const sample_rate,
                                             size_t const channels,
                                             size_t const buffer_size,
                                             bool *const updated) {
-  g_sample_rate = sample_rate;
-  g_channels = channels;
-  g_buffer_size = buffer_size;
+  mtx_lock(&acl->mtx);
+  acl->format = (struct aux_channel_format){
+      .sample_rate = sample_rate,
+      .channels = channels,
+      .buffer_size = buffer_size,
+      .serial = acl->format.serial + 1,
+  };
+  mtx_unlock(&acl->mtx);
   bool upd = false;
   error err = eok();
   for (struct aux_channel *c = get_head(acl); c; c = c->next) {
-    err = aux_channel_set_format(c, sample_rate, channels, buffer_size);
+    if (!is_ready(c)) {
+      // check_ready queues the construction again for the new format once it has finished
+      continue;
+    }
+    err = aux_channel_set_format(c, &acl->format);
     if (efailed(err)) {
       err = ethru(err);
       goto cleanup;
@@ -343,6 +1189,8 @@ cleanup:
 
 void aux_channel_list_reset(struct aux_channel_list const *const acl) {
   for (struct aux_channel *c = get_head(acl); c; c = c->next) {
-    aux_channel_reset(c);
+    if (is_ready(c)) {
+      aux_channel_reset(c);
+    }
   }
 }
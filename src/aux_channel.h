@@ -2,6 +2,19 @@
 
 #include "ovbase.h"
 
+#include "channel.h"
+
+enum aux_channel_reverb_quality {
+  aux_channel_reverb_quality_full,
+  aux_channel_reverb_quality_half, // runs the reverb at half the sample rate through a half-band resampler
+};
+
+enum aux_channel_reverb_type {
+  aux_channel_reverb_type_dattorro,    // uxfdreverb
+  aux_channel_reverb_type_fdn,         // fdnreverb
+  aux_channel_reverb_type_convolution, // convreverb, only uses wet and quality
+};
+
 struct aux_channel_effect_reverb_params {
   float band_width;
   float pre_delay;
@@ -10,6 +23,9 @@ struct aux_channel_effect_reverb_params {
   float damping;
   float excursion;
   float wet;
+  int quality;                // enum aux_channel_reverb_quality
+  int type;                   // enum aux_channel_reverb_type
+  NATIVE_CHAR const *ir_path; // impulse response of the convolution type, can be NULL
 };
 
 struct aux_channel_effect_params {
@@ -30,7 +46,7 @@ NODISCARD error aux_channel_list_destroy(struct aux_channel_list **const aclp);
 void aux_channel_list_set_userdata(struct aux_channel_list *const acl, void *const userdata);
 void aux_channel_list_set_notify_callback(struct aux_channel_list *const acl, aux_channel_notify_func f);
 
-NODISCARD error aux_channel_list_set_format(struct aux_channel_list const *const acl,
+NODISCARD error aux_channel_list_set_format(struct aux_channel_list *const acl,
                                             float const sample_rate,
                                             size_t const channels,
                                             size_t const buffer_size,
@@ -42,12 +58,20 @@ NODISCARD error aux_channel_list_channel_update(struct aux_channel_list *const a
                                                 struct aux_channel_effect_params const *e,
                                                 bool *const updated);
 
-NODISCARD error aux_channel_list_add(struct aux_channel_list *const acl,
-                                     int const id,
-                                     size_t const counter,
-                                     float const *restrict const *const src,
-                                     size_t const samples,
-                                     float const gain_db);
+// Returns the accumulation buffers of the channels that are mixed in this round, sorted by id.
+// The table stays valid until the list is modified.
+size_t aux_channel_list_get_send_routes(struct aux_channel_list *const acl,
+                                        size_t const counter,
+                                        struct channel_send_route const **const routes);
+
+// Queues the construction of the channel with the given parameters ahead of its first use.
+// Channels are constructed on a background thread and stay silent until they are ready,
+// a pre-warmed channel is kept until it is used for the first time.
+NODISCARD error aux_channel_list_prewarm(struct aux_channel_list *const acl,
+                                         int const id,
+                                         struct aux_channel_effect_params const *e);
+// Blocks until all queued constructions have finished.
+void aux_channel_list_wait(struct aux_channel_list *const acl);
 
 void aux_channel_list_mix(struct aux_channel_list const *const acl,
                           size_t const counter,
@@ -55,5 +79,8 @@ void aux_channel_list_mix(struct aux_channel_list const *const acl,
                           float *restrict const *const mixbuf,
                           float *restrict const *const tmpbuf);
 
+// Tells whether aux_channel_list_mix has anything to mix in this round.
+bool aux_channel_list_is_active(struct aux_channel_list const *const acl, size_t const counter);
+
 void aux_channel_list_gc(struct aux_channel_list *const acl, size_t const counter);
 void aux_channel_list_reset(struct aux_channel_list const *const acl);
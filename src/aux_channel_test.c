@@ -0,0 +1,310 @@
+#include "aux_channel.c"
+
+#include "ovtest.h"
+
+enum {
+  test_channels = 2,
+  test_samples = 480,
+};
+
+static float g_src[test_channels][test_samples];
+static float g_mix[test_channels][test_samples];
+static float g_sub[test_channels][test_samples];
+
+static struct aux_channel_effect_params params(int const type, int const quality) {
+  return (struct aux_channel_effect_params){
+      .reverb =
+          {
+              .band_width = 0.5f,
+              .pre_delay = 0.f,
+              .diffuse = 0.5f,
+              .decay = 0.5f,
+              .damping = 0.5f,
+              .excursion = 0.5f,
+              .wet = 0.f,
+              .quality = quality,
+              .type = type,
+          },
+  };
+}
+
+static struct aux_channel *get(struct aux_channel_list *const acl, int const id) {
+  struct aux_channel *prev = NULL;
+  return lookup(acl, id, &prev);
+}
+
+// Sends an impulse to id and returns the peak of the mixed output.
+static float run_frame(struct aux_channel_list *const acl,
+                       int const id,
+                       size_t const counter,
+                       struct aux_channel_effect_params const *const e) {
+  float const *src[test_channels] = {g_src[0], g_src[1]};
+  float *mixbuf[test_channels] = {g_mix[0], g_mix[1]};
+  float *subbuf[test_channels] = {g_sub[0], g_sub[1]};
+  memset(g_src, 0, sizeof(g_src));
+  memset(g_mix, 0, sizeof(g_mix));
+  g_src[0][0] = 1.f;
+  g_src[1][0] = 1.f;
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, id, counter, e, NULL));
+  struct channel_send_route const *routes = NULL;
+  size_t const n = aux_channel_list_get_send_routes(acl, counter, &routes);
+  for (size_t i = 0; i < n; ++i) {
+    if (routes[i].id == id) {
+      mix_with_amp(routes[i].buf, src, 1.f, test_channels, test_samples);
+    }
+  }
+  aux_channel_list_mix(acl, counter, test_samples, (float *restrict const *)mixbuf, (float *restrict const *)subbuf);
+  float const *o[test_channels] = {g_mix[0], g_mix[1]};
+  return find_peak(o, test_channels, test_samples);
+}
+
+static void test_background_construction(void) {
+  struct aux_channel_list *acl = NULL;
+  TEST_SUCCEEDED_F(aux_channel_list_create(&acl));
+  TEST_SUCCEEDED_F(aux_channel_list_set_format(acl, 48000.f, test_channels, test_samples, NULL));
+  struct aux_channel_effect_params const e = params(aux_channel_reverb_type_dattorro, aux_channel_reverb_quality_half);
+
+  // the first frame only queues the construction, whether or not it finished in time nothing is mixed
+  TEST_CHECK(run_frame(acl, 1, 1, &e) <= 0.f);
+  aux_channel_list_wait(acl);
+  struct aux_channel *const c = get(acl, 1);
+  TEST_CHECK(c != NULL && is_ready(c));
+  TEST_CHECK(c->quality == aux_channel_reverb_quality_half); // parameters were applied by the builder
+  TEST_CHECK(c->buf.channels == test_channels && c->buf.buffer_size == test_samples);
+
+  float peak = 0.f;
+  for (size_t counter = 2; counter < 40; ++counter) {
+    peak = fmaxf(peak, run_frame(acl, 1, counter, &e));
+  }
+  TEST_CHECK(peak > 0.f);
+  TEST_SUCCEEDED_F(aux_channel_list_destroy(&acl));
+}
+
+static void test_prewarm(void) {
+  struct aux_channel_list *acl = NULL;
+  TEST_SUCCEEDED_F(aux_channel_list_create(&acl));
+  TEST_SUCCEEDED_F(aux_channel_list_set_format(acl, 48000.f, test_channels, test_samples, NULL));
+  struct aux_channel_effect_params const e = params(aux_channel_reverb_type_fdn, aux_channel_reverb_quality_full);
+  TEST_SUCCEEDED_F(aux_channel_list_prewarm(acl, 2, &e));
+  aux_channel_list_wait(acl);
+  struct aux_channel *const c = get(acl, 2);
+  TEST_CHECK(c != NULL && is_ready(c) && c->fdn != NULL && c->type == aux_channel_reverb_type_fdn);
+
+  // pre-warmed channels survive until they are used
+  aux_channel_list_gc(acl, 5);
+  TEST_CHECK(get(acl, 2) == c);
+
+  // and are mixed from the first frame
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 2, 6, &e, NULL));
+  TEST_CHECK(c->parameter_updated_at == 6);
+  float peak = 0.f;
+  for (size_t counter = 6; counter < 40; ++counter) {
+    peak = fmaxf(peak, run_frame(acl, 2, counter, &e));
+  }
+  TEST_CHECK(peak > 0.f);
+  aux_channel_list_gc(acl, 39);
+  TEST_CHECK(get(acl, 2) == c);
+  aux_channel_list_gc(acl, 41);
+  TEST_CHECK(get(acl, 2) == NULL);
+  TEST_SUCCEEDED_F(aux_channel_list_destroy(&acl));
+}
+
+// Channels can be dropped and the format can be changed while they are under construction.
+static void test_interrupt(void) {
+  struct aux_channel_list *acl = NULL;
+  TEST_SUCCEEDED_F(aux_channel_list_create(&acl));
+  TEST_SUCCEEDED_F(aux_channel_list_set_format(acl, 48000.f, test_channels, test_samples, NULL));
+  struct aux_channel_effect_params const e = params(aux_channel_reverb_type_dattorro, aux_channel_reverb_quality_full);
+  for (int id = 0; id < 16; ++id) {
+    TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, id, 1, &e, NULL));
+  }
+  aux_channel_list_gc(acl, 2);
+  TEST_CHECK(get_head(acl) == NULL);
+
+  for (int id = 0; id < 4; ++id) {
+    TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, id, 3, &e, NULL));
+  }
+  TEST_SUCCEEDED_F(aux_channel_list_set_format(acl, 44100.f, 1, test_samples / 2, NULL));
+  aux_channel_list_wait(acl);
+  // a construction that finished with the old format is queued again
+  for (int id = 0; id < 4; ++id) {
+    TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, id, 4, &e, NULL));
+  }
+  aux_channel_list_wait(acl);
+  for (int id = 0; id < 4; ++id) {
+    TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, id, 5, &e, NULL));
+    struct aux_channel *const c = get(acl, id);
+    TEST_CHECK(is_ready(c));
+    TEST_CHECK(c->buf.channels == 1 && c->buf.buffer_size == test_samples / 2);
+    TEST_CHECK(fcmp(c->format.sample_rate, ==, 44100.f, 1e-3f));
+  }
+  TEST_SUCCEEDED_F(aux_channel_list_destroy(&acl));
+}
+
+// Only the channels that are updated in the round and are ready receive sends.
+static void test_send_routes(void) {
+  struct aux_channel_list *acl = NULL;
+  TEST_SUCCEEDED_F(aux_channel_list_create(&acl));
+  TEST_SUCCEEDED_F(aux_channel_list_set_format(acl, 48000.f, test_channels, test_samples, NULL));
+  struct aux_channel_effect_params const e = params(aux_channel_reverb_type_dattorro, aux_channel_reverb_quality_full);
+  static int const ids[] = {7, 3, 12, 5};
+  for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]); ++i) {
+    TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, ids[i], 1, &e, NULL));
+  }
+  struct channel_send_route const *routes = NULL;
+  TEST_CHECK(aux_channel_list_get_send_routes(acl, 1, &routes) == 0);
+  aux_channel_list_wait(acl);
+  for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]) - 1; ++i) {
+    TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, ids[i], 2, &e, NULL));
+  }
+  size_t const n = aux_channel_list_get_send_routes(acl, 2, &routes);
+  TEST_CHECK(n == 3);
+  TEST_CHECK(n == 3 && routes[0].id == 3 && routes[1].id == 7 && routes[2].id == 12);
+  TEST_CHECK(n == 3 && routes[0].buf == get(acl, 3)->buf.ptr);
+  TEST_SUCCEEDED_F(aux_channel_list_destroy(&acl));
+}
+
+// A new impulse response is loaded by the builder thread while the old one keeps playing.
+static void test_rebuild_ir(void) {
+  struct aux_channel_list *acl = NULL;
+  TEST_SUCCEEDED_F(aux_channel_list_create(&acl));
+  TEST_SUCCEEDED_F(aux_channel_list_set_format(acl, 48000.f, test_channels, test_samples, NULL));
+  struct aux_channel_effect_params e = params(aux_channel_reverb_type_convolution, aux_channel_reverb_quality_full);
+  e.reverb.ir_path = NSTR("missing_a.wav"); // a file that cannot be loaded leaves the reverb silent
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, 1, &e, NULL));
+  aux_channel_list_wait(acl);
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, 2, &e, NULL));
+  struct aux_channel *const c = get(acl, 1);
+  struct convreverb *const conv = c->conv;
+  TEST_CHECK(conv != NULL && c->replacement == NULL && wcscmp(c->ir_path, NSTR("missing_a.wav")) == 0);
+
+  e.reverb.ir_path = NSTR("missing_b.wav");
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, 3, &e, NULL));
+  TEST_CHECK(c->replacement != NULL);
+  TEST_CHECK(c->conv == conv && wcscmp(c->ir_path, NSTR("missing_a.wav")) == 0);
+  aux_channel_list_wait(acl);
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, 4, &e, NULL));
+  TEST_CHECK(c->replacement == NULL);
+  TEST_CHECK(c->conv != conv && wcscmp(c->ir_path, NSTR("missing_b.wav")) == 0);
+
+  // a replacement that is no longer needed when it is ready is dropped
+  e.reverb.ir_path = NSTR("missing_c.wav");
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, 5, &e, NULL));
+  TEST_CHECK(c->replacement != NULL);
+  aux_channel_list_wait(acl);
+  e.reverb.ir_path = NSTR("missing_b.wav");
+  struct convreverb *const conv_b = c->conv;
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, 6, &e, NULL));
+  TEST_CHECK(c->replacement == NULL && c->conv == conv_b);
+  TEST_SUCCEEDED_F(aux_channel_list_destroy(&acl));
+}
+
+// Type and quality changes are built on the builder thread while the old reverb keeps playing.
+static void test_rebuild_type(void) {
+  struct aux_channel_list *acl = NULL;
+  TEST_SUCCEEDED_F(aux_channel_list_create(&acl));
+  TEST_SUCCEEDED_F(aux_channel_list_set_format(acl, 48000.f, test_channels, test_samples, NULL));
+  struct aux_channel_effect_params e = params(aux_channel_reverb_type_dattorro, aux_channel_reverb_quality_full);
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, 1, &e, NULL));
+  aux_channel_list_wait(acl);
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, 2, &e, NULL));
+  struct aux_channel *const c = get(acl, 1);
+  struct uxfdreverb *const reverb = c->reverb;
+
+  e = params(aux_channel_reverb_type_fdn, aux_channel_reverb_quality_full);
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, 3, &e, NULL));
+  TEST_CHECK(c->replacement != NULL && c->type == aux_channel_reverb_type_dattorro && c->fdn == NULL);
+  aux_channel_list_wait(acl);
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, 4, &e, NULL));
+  TEST_CHECK(c->replacement == NULL && c->type == aux_channel_reverb_type_fdn && c->fdn != NULL);
+  TEST_CHECK(c->reverb != reverb);
+
+  e.reverb.quality = aux_channel_reverb_quality_half;
+  struct fdnreverb *const fdn = c->fdn;
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, 5, &e, NULL));
+  TEST_CHECK(c->replacement != NULL && c->quality == aux_channel_reverb_quality_full && c->fdn == fdn);
+  aux_channel_list_wait(acl);
+  float peak = 0.f;
+  for (size_t counter = 6; counter < 40; ++counter) {
+    peak = fmaxf(peak, run_frame(acl, 1, counter, &e));
+  }
+  TEST_CHECK(peak > 0.f);
+  TEST_CHECK(c->replacement == NULL && c->quality == aux_channel_reverb_quality_half && c->fdn != fdn);
+
+  // channels under reconstruction can be dropped
+  e = params(aux_channel_reverb_type_dattorro, aux_channel_reverb_quality_half);
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, 40, &e, NULL));
+  aux_channel_list_gc(acl, 41);
+  TEST_CHECK(get_head(acl) == NULL);
+  TEST_SUCCEEDED_F(aux_channel_list_destroy(&acl));
+}
+
+// A construction that finished with an outdated format is rebuilt by the builder thread, not in the mix.
+static void test_format_during_build(void) {
+  struct aux_channel_list *acl = NULL;
+  TEST_SUCCEEDED_F(aux_channel_list_create(&acl));
+  TEST_SUCCEEDED_F(aux_channel_list_set_format(acl, 48000.f, test_channels, test_samples, NULL));
+  struct aux_channel_effect_params const e = params(aux_channel_reverb_type_fdn, aux_channel_reverb_quality_half);
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, 1, &e, NULL));
+  aux_channel_list_wait(acl);
+  struct aux_channel *const c = get(acl, 1);
+  TEST_CHECK(is_ready(c));
+
+  // what aux_channel_list_set_format leaves behind for a channel that is still under construction
+  acl->format = (struct aux_channel_format){
+      .sample_rate = 44100.f,
+      .channels = 1,
+      .buffer_size = test_samples / 2,
+      .serial = acl->format.serial + 1,
+  };
+  bool updated = true;
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, 2, &e, &updated));
+  TEST_CHECK(!updated && c->parameter_updated_at != 2);
+  aux_channel_list_wait(acl);
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, 3, &e, NULL));
+  TEST_CHECK(is_ready(c) && c->parameter_updated_at == 3);
+  TEST_CHECK(c->buf.channels == 1 && c->buf.buffer_size == test_samples / 2);
+  TEST_CHECK(c->type == aux_channel_reverb_type_fdn && c->quality == aux_channel_reverb_quality_half);
+  TEST_SUCCEEDED_F(aux_channel_list_destroy(&acl));
+}
+
+// A failed construction is reported once and retried with a growing interval.
+static void test_build_failure(void) {
+  struct aux_channel_list *acl = NULL;
+  TEST_SUCCEEDED_F(aux_channel_list_create(&acl));
+  TEST_SUCCEEDED_F(aux_channel_list_set_format(acl, 48000.f, test_channels, test_samples, NULL));
+  struct aux_channel_effect_params const e = params(aux_channel_reverb_type_dattorro, aux_channel_reverb_quality_full);
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, 1, &e, NULL));
+  aux_channel_list_wait(acl);
+  struct aux_channel *const c = get(acl, 1);
+
+  c->build_error = errg(err_fail);
+  atomic_store(&c->state, aux_channel_state_failed);
+  TEST_FAILED_F(aux_channel_list_channel_update(acl, 1, 2, &e, NULL));
+  TEST_CHECK(c->retry_interval == retry_min_frames && c->retry_at == 2 + retry_min_frames);
+  c->build_error = errg(err_fail);
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, 3, &e, NULL));
+  TEST_CHECK(c->retry_interval == retry_min_frames * 2 && c->retry_at == 3 + retry_min_frames * 2);
+  for (size_t counter = 4; counter < 3 + retry_min_frames * 2; ++counter) {
+    TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, counter, &e, NULL));
+  }
+  TEST_CHECK(atomic_load(&c->state) == aux_channel_state_failed);
+
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, 3 + retry_min_frames * 2, &e, NULL));
+  aux_channel_list_wait(acl);
+  TEST_SUCCEEDED_F(aux_channel_list_channel_update(acl, 1, 4 + retry_min_frames * 2, &e, NULL));
+  TEST_CHECK(is_ready(c) && c->retry_interval == 0);
+  TEST_SUCCEEDED_F(aux_channel_list_destroy(&acl));
+}
+
+TEST_LIST = {
+    {"test_background_construction", test_background_construction},
+    {"test_prewarm", test_prewarm},
+    {"test_interrupt", test_interrupt},
+    {"test_send_routes", test_send_routes},
+    {"test_rebuild_ir", test_rebuild_ir},
+    {"test_rebuild_type", test_rebuild_type},
+    {"test_format_during_build", test_format_during_build},
+    {"test_build_failure", test_build_failure},
+    {NULL, NULL},
+};
@@ -0,0 +1,397 @@
+#pragma once
+
+#include "ovbase.h"
+
+#include <immintrin.h>
+
+#include "chspec.h"
+#include "simd.h"
+
+// Transposed Direct Form II biquads with the channels in SIMD lanes, the kernels behind rbjeq_kernel_simd.
+// Only included by simd_kernels.h, so the 8-lane path is built into the tables of the levels that have AVX2.
+
+struct biquad_coef4 {
+  __m128 b0, b1, b2, a1, a2;
+};
+
+static inline struct biquad_coef4 biquad_coef4(struct simd_biquad const *const b) {
+  return (struct biquad_coef4){
+      .b0 = _mm_set1_ps(b->b0),
+      .b1 = _mm_set1_ps(b->b1),
+      .b2 = _mm_set1_ps(b->b2),
+      .a1 = _mm_set1_ps(b->a1),
+      .a2 = _mm_set1_ps(b->a2),
+  };
+}
+
+// Every sample waits for y and the new s1, so the terms that do not depend on y are added first
+// to keep the recurrence at one add and one multiply-subtract, fused where FMA is available.
+static inline __m128 biquad_tdf2_4(__m128 const x,
+                                   struct biquad_coef4 const *const c,
+                                   __m128 *const s1,
+                                   __m128 *const s2) {
+#ifdef __FMA__
+  __m128 const y = _mm_fmadd_ps(c->b0, x, *s1);
+  *s1 = _mm_fnmadd_ps(c->a1, y, _mm_fmadd_ps(c->b1, x, *s2));
+  *s2 = _mm_fnmadd_ps(c->a2, y, _mm_mul_ps(c->b2, x));
+#else
+  __m128 const y = _mm_add_ps(_mm_mul_ps(c->b0, x), *s1);
+  *s1 = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(c->b1, x), *s2), _mm_mul_ps(c->a1, y));
+  *s2 = _mm_sub_ps(_mm_mul_ps(c->b2, x), _mm_mul_ps(c->a2, y));
+#endif
+  return y;
+}
+
+// TDF-II has no input history that could keep the state alive,
+// so denormals are flushed once per call instead of adding a bias on every sample.
+static inline __m128 biquad_flush_denormal4(__m128 const v) {
+  __m128 const abs = _mm_andnot_ps(_mm_set1_ps(-0.f), v);
+  return _mm_and_ps(v, _mm_cmpge_ps(abs, _mm_set1_ps(1e-15f)));
+}
+
+static inline __m128 biquad_select4(__m128 const mask, __m128 const a, __m128 const b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// Processes the channels [ch, ch + active) in the lanes of one SSE vector, 4 samples at a time with 4x4 transposes.
+// second is not referenced when cascade is false.
+static inline __attribute__((always_inline)) void biquad_group4(struct simd_biquad const *const first,
+                                                                struct simd_biquad const *const second,
+                                                                float const *restrict const *const inputs,
+                                                                float *restrict const *const outputs,
+                                                                size_t const ch,
+                                                                size_t const active,
+                                                                size_t const samples,
+                                                                bool const cascade) {
+  struct biquad_coef4 const c1 = biquad_coef4(first);
+  struct biquad_coef4 const c2 = cascade ? biquad_coef4(second) : c1;
+  size_t const samples4 = samples & ~(size_t)3;
+  __m128 const zero = _mm_setzero_ps();
+  float const *in[4] = {NULL};
+  float *out[4] = {NULL};
+  for (size_t l = 0; l < active; ++l) {
+    in[l] = inputs[ch + l];
+    out[l] = outputs[ch + l];
+  }
+  __m128 s1 = _mm_loadu_ps(first->s1 + ch), s2 = _mm_loadu_ps(first->s2 + ch);
+  __m128 t1 = cascade ? _mm_loadu_ps(second->s1 + ch) : zero, t2 = cascade ? _mm_loadu_ps(second->s2 + ch) : zero;
+  for (size_t i = 0; i < samples4; i += 4) {
+    __m128 x0 = _mm_loadu_ps(in[0] + i);
+    __m128 x1 = active > 1 ? _mm_loadu_ps(in[1] + i) : zero;
+    __m128 x2 = active > 2 ? _mm_loadu_ps(in[2] + i) : zero;
+    __m128 x3 = active > 3 ? _mm_loadu_ps(in[3] + i) : zero;
+    _MM_TRANSPOSE4_PS(x0, x1, x2, x3);
+    x0 = biquad_tdf2_4(x0, &c1, &s1, &s2);
+    x1 = biquad_tdf2_4(x1, &c1, &s1, &s2);
+    x2 = biquad_tdf2_4(x2, &c1, &s1, &s2);
+    x3 = biquad_tdf2_4(x3, &c1, &s1, &s2);
+    if (cascade) {
+      x0 = biquad_tdf2_4(x0, &c2, &t1, &t2);
+      x1 = biquad_tdf2_4(x1, &c2, &t1, &t2);
+      x2 = biquad_tdf2_4(x2, &c2, &t1, &t2);
+      x3 = biquad_tdf2_4(x3, &c2, &t1, &t2);
+    }
+    _MM_TRANSPOSE4_PS(x0, x1, x2, x3);
+    _mm_storeu_ps(out[0] + i, x0);
+    if (active > 1) {
+      _mm_storeu_ps(out[1] + i, x1);
+    }
+    if (active > 2) {
+      _mm_storeu_ps(out[2] + i, x2);
+    }
+    if (active > 3) {
+      _mm_storeu_ps(out[3] + i, x3);
+    }
+  }
+  for (size_t i = samples4; i < samples; ++i) {
+    float v[4] = {0};
+    for (size_t l = 0; l < active; ++l) {
+      v[l] = in[l][i];
+    }
+    __m128 x = biquad_tdf2_4(_mm_loadu_ps(v), &c1, &s1, &s2);
+    if (cascade) {
+      x = biquad_tdf2_4(x, &c2, &t1, &t2);
+    }
+    _mm_storeu_ps(v, x);
+    for (size_t l = 0; l < active; ++l) {
+      out[l][i] = v[l];
+    }
+  }
+  _mm_storeu_ps(first->s1 + ch, biquad_flush_denormal4(s1));
+  _mm_storeu_ps(first->s2 + ch, biquad_flush_denormal4(s2));
+  if (cascade) {
+    _mm_storeu_ps(second->s1 + ch, biquad_flush_denormal4(t1));
+    _mm_storeu_ps(second->s2 + ch, biquad_flush_denormal4(t2));
+  }
+}
+
+// Runs both sections of a mono or stereo cascade in one SSE vector: lanes 0 and 1 hold the channels of the first
+// section, lanes 2 and 3 those of the second. Every step hands the output of the first section to the second one,
+// which therefore runs one sample behind. The first step only advances the first section and one extra step at the
+// end only advances the second, so nothing is carried over to the next call.
+static inline __attribute__((always_inline)) void biquad_cascade_pipeline(struct simd_biquad const *const first,
+                                                                          struct simd_biquad const *const second,
+                                                                          float const *restrict const *const inputs,
+                                                                          float *restrict const *const outputs,
+                                                                          size_t const channels,
+                                                                          size_t const samples) {
+  if (!samples) {
+    return;
+  }
+  struct biquad_coef4 const c = {
+      .b0 = _mm_set_ps(second->b0, second->b0, first->b0, first->b0),
+      .b1 = _mm_set_ps(second->b1, second->b1, first->b1, first->b1),
+      .b2 = _mm_set_ps(second->b2, second->b2, first->b2, first->b2),
+      .a1 = _mm_set_ps(second->a1, second->a1, first->a1, first->a1),
+      .a2 = _mm_set_ps(second->a2, second->a2, first->a2, first->a2),
+  };
+  __m128 const first_lanes = _mm_castsi128_ps(_mm_set_epi32(0, 0, -1, -1));
+  float const *const in0 = inputs[0];
+  float const *const in1 = channels > 1 ? inputs[1] : inputs[0]; // a mono lane 1 is computed but never stored
+  float *const out0 = outputs[0];
+  float *const out1 = channels > 1 ? outputs[1] : NULL;
+  __m128 s1 = _mm_set_ps(second->s1[1], second->s1[0], first->s1[1], first->s1[0]);
+  __m128 s2 = _mm_set_ps(second->s2[1], second->s2[0], first->s2[1], first->s2[0]);
+  __m128 y;
+
+  // fill: the second section has no input yet
+  {
+    __m128 const old1 = s1, old2 = s2;
+    y = biquad_tdf2_4(_mm_set_ps(0.f, 0.f, in1[0], in0[0]), &c, &s1, &s2);
+    s1 = biquad_select4(first_lanes, s1, old1);
+    s2 = biquad_select4(first_lanes, s2, old2);
+  }
+  size_t i = 1;
+  for (; i + 4 <= samples; i += 4) {
+    __m128 const a = _mm_loadu_ps(in0 + i);
+    __m128 const b = _mm_loadu_ps(in1 + i);
+    __m128 const lo = _mm_unpacklo_ps(a, b); // a0 b0 a1 b1
+    __m128 const hi = _mm_unpackhi_ps(a, b); // a2 b2 a3 b3
+    __m128 const p0 = y = biquad_tdf2_4(_mm_movelh_ps(lo, y), &c, &s1, &s2);
+    __m128 const p1 = y = biquad_tdf2_4(_mm_shuffle_ps(lo, y, _MM_SHUFFLE(1, 0, 3, 2)), &c, &s1, &s2);
+    __m128 const p2 = y = biquad_tdf2_4(_mm_movelh_ps(hi, y), &c, &s1, &s2);
+    __m128 const p3 = y = biquad_tdf2_4(_mm_shuffle_ps(hi, y, _MM_SHUFFLE(1, 0, 3, 2)), &c, &s1, &s2);
+    // lanes 2 and 3 of each step are samples i - 1 to i + 2 of the second section
+    __m128 const q0 = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(3, 2, 3, 2));
+    __m128 const q1 = _mm_shuffle_ps(p2, p3, _MM_SHUFFLE(3, 2, 3, 2));
+    _mm_storeu_ps(out0 + i - 1, _mm_shuffle_ps(q0, q1, _MM_SHUFFLE(2, 0, 2, 0)));
+    if (out1) {
+      _mm_storeu_ps(out1 + i - 1, _mm_shuffle_ps(q0, q1, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+  }
+  float v[4];
+  for (; i < samples; ++i) {
+    y = biquad_tdf2_4(_mm_movelh_ps(_mm_set_ps(0.f, 0.f, in1[i], in0[i]), y), &c, &s1, &s2);
+    _mm_storeu_ps(v, y);
+    out0[i - 1] = v[2];
+    if (out1) {
+      out1[i - 1] = v[3];
+    }
+  }
+
+  // drain: the first section has no input left
+  {
+    __m128 const old1 = s1, old2 = s2;
+    y = biquad_tdf2_4(_mm_movelh_ps(_mm_setzero_ps(), y), &c, &s1, &s2);
+    s1 = biquad_select4(first_lanes, old1, s1);
+    s2 = biquad_select4(first_lanes, old2, s2);
+  }
+  _mm_storeu_ps(v, y);
+  out0[samples - 1] = v[2];
+  if (out1) {
+    out1[samples - 1] = v[3];
+  }
+
+  float t1[4], t2[4];
+  _mm_storeu_ps(t1, biquad_flush_denormal4(s1));
+  _mm_storeu_ps(t2, biquad_flush_denormal4(s2));
+  for (size_t ch = 0; ch < channels; ++ch) {
+    first->s1[ch] = t1[ch];
+    first->s2[ch] = t2[ch];
+    second->s1[ch] = t1[2 + ch];
+    second->s2[ch] = t2[2 + ch];
+  }
+}
+
+#ifdef __AVX2__
+struct biquad_coef8 {
+  __m256 b0, b1, b2, a1, a2;
+};
+
+static inline struct biquad_coef8 biquad_coef8(struct simd_biquad const *const b) {
+  return (struct biquad_coef8){
+      .b0 = _mm256_set1_ps(b->b0),
+      .b1 = _mm256_set1_ps(b->b1),
+      .b2 = _mm256_set1_ps(b->b2),
+      .a1 = _mm256_set1_ps(b->a1),
+      .a2 = _mm256_set1_ps(b->a2),
+  };
+}
+
+static inline __m256 biquad_tdf2_8(__m256 const x,
+                                   struct biquad_coef8 const *const c,
+                                   __m256 *const s1,
+                                   __m256 *const s2) {
+  __m256 const y = _mm256_fmadd_ps(c->b0, x, *s1);
+  *s1 = _mm256_fnmadd_ps(c->a1, y, _mm256_fmadd_ps(c->b1, x, *s2));
+  *s2 = _mm256_fnmadd_ps(c->a2, y, _mm256_mul_ps(c->b2, x));
+  return y;
+}
+
+static inline __m256 biquad_flush_denormal8(__m256 const v) {
+  __m256 const abs = _mm256_andnot_ps(_mm256_set1_ps(-0.f), v);
+  return _mm256_and_ps(v, _mm256_cmp_ps(abs, _mm256_set1_ps(1e-15f), _CMP_GE_OQ));
+}
+
+// Same as biquad_group4 for the channels [ch, ch + active) in the lanes of one AVX vector,
+// the two 4x4 transposes give 4 vectors of 8 channels each.
+static inline __attribute__((always_inline)) void biquad_group8(struct simd_biquad const *const first,
+                                                                struct simd_biquad const *const second,
+                                                                float const *restrict const *const inputs,
+                                                                float *restrict const *const outputs,
+                                                                size_t const ch,
+                                                                size_t const active,
+                                                                size_t const samples,
+                                                                bool const cascade) {
+  struct biquad_coef8 const c1 = biquad_coef8(first);
+  struct biquad_coef8 const c2 = cascade ? biquad_coef8(second) : c1;
+  size_t const samples4 = samples & ~(size_t)3;
+  __m128 const zero = _mm_setzero_ps();
+  float const *in[8] = {NULL};
+  float *out[8] = {NULL};
+  for (size_t l = 0; l < active; ++l) {
+    in[l] = inputs[ch + l];
+    out[l] = outputs[ch + l];
+  }
+  __m256 s1 = _mm256_loadu_ps(first->s1 + ch), s2 = _mm256_loadu_ps(first->s2 + ch);
+  __m256 t1 = cascade ? _mm256_loadu_ps(second->s1 + ch) : _mm256_setzero_ps();
+  __m256 t2 = cascade ? _mm256_loadu_ps(second->s2 + ch) : _mm256_setzero_ps();
+  for (size_t i = 0; i < samples4; i += 4) {
+    __m128 x0 = _mm_loadu_ps(in[0] + i);
+    __m128 x1 = active > 1 ? _mm_loadu_ps(in[1] + i) : zero;
+    __m128 x2 = active > 2 ? _mm_loadu_ps(in[2] + i) : zero;
+    __m128 x3 = active > 3 ? _mm_loadu_ps(in[3] + i) : zero;
+    __m128 x4 = active > 4 ? _mm_loadu_ps(in[4] + i) : zero;
+    __m128 x5 = active > 5 ? _mm_loadu_ps(in[5] + i) : zero;
+    __m128 x6 = active > 6 ? _mm_loadu_ps(in[6] + i) : zero;
+    __m128 x7 = active > 7 ? _mm_loadu_ps(in[7] + i) : zero;
+    _MM_TRANSPOSE4_PS(x0, x1, x2, x3);
+    _MM_TRANSPOSE4_PS(x4, x5, x6, x7);
+    __m256 y0 = biquad_tdf2_8(_mm256_set_m128(x4, x0), &c1, &s1, &s2);
+    __m256 y1 = biquad_tdf2_8(_mm256_set_m128(x5, x1), &c1, &s1, &s2);
+    __m256 y2 = biquad_tdf2_8(_mm256_set_m128(x6, x2), &c1, &s1, &s2);
+    __m256 y3 = biquad_tdf2_8(_mm256_set_m128(x7, x3), &c1, &s1, &s2);
+    if (cascade) {
+      y0 = biquad_tdf2_8(y0, &c2, &t1, &t2);
+      y1 = biquad_tdf2_8(y1, &c2, &t1, &t2);
+      y2 = biquad_tdf2_8(y2, &c2, &t1, &t2);
+      y3 = biquad_tdf2_8(y3, &c2, &t1, &t2);
+    }
+    x0 = _mm256_castps256_ps128(y0);
+    x1 = _mm256_castps256_ps128(y1);
+    x2 = _mm256_castps256_ps128(y2);
+    x3 = _mm256_castps256_ps128(y3);
+    x4 = _mm256_extractf128_ps(y0, 1);
+    x5 = _mm256_extractf128_ps(y1, 1);
+    x6 = _mm256_extractf128_ps(y2, 1);
+    x7 = _mm256_extractf128_ps(y3, 1);
+    _MM_TRANSPOSE4_PS(x0, x1, x2, x3);
+    _MM_TRANSPOSE4_PS(x4, x5, x6, x7);
+    _mm_storeu_ps(out[0] + i, x0);
+    if (active > 1) {
+      _mm_storeu_ps(out[1] + i, x1);
+    }
+    if (active > 2) {
+      _mm_storeu_ps(out[2] + i, x2);
+    }
+    if (active > 3) {
+      _mm_storeu_ps(out[3] + i, x3);
+    }
+    if (active > 4) {
+      _mm_storeu_ps(out[4] + i, x4);
+    }
+    if (active > 5) {
+      _mm_storeu_ps(out[5] + i, x5);
+    }
+    if (active > 6) {
+      _mm_storeu_ps(out[6] + i, x6);
+    }
+    if (active > 7) {
+      _mm_storeu_ps(out[7] + i, x7);
+    }
+  }
+  for (size_t i = samples4; i < samples; ++i) {
+    float v[8] = {0};
+    for (size_t l = 0; l < active; ++l) {
+      v[l] = in[l][i];
+    }
+    __m256 x = biquad_tdf2_8(_mm256_loadu_ps(v), &c1, &s1, &s2);
+    if (cascade) {
+      x = biquad_tdf2_8(x, &c2, &t1, &t2);
+    }
+    _mm256_storeu_ps(v, x);
+    for (size_t l = 0; l < active; ++l) {
+      out[l][i] = v[l];
+    }
+  }
+  _mm256_storeu_ps(first->s1 + ch, biquad_flush_denormal8(s1));
+  _mm256_storeu_ps(first->s2 + ch, biquad_flush_denormal8(s2));
+  if (cascade) {
+    _mm256_storeu_ps(second->s1 + ch, biquad_flush_denormal8(t1));
+    _mm256_storeu_ps(second->s2 + ch, biquad_flush_denormal8(t2));
+  }
+}
+#endif
+
+// channels is a constant in the instances biquad_process creates for 1 to chspec_max_channels channels,
+// so the number of groups and the lanes in use are known.
+static inline __attribute__((always_inline)) void biquad_impl(struct simd_biquad const *const first,
+                                                              struct simd_biquad const *const second,
+                                                              float const *restrict const *const inputs,
+                                                              float *restrict const *const outputs,
+                                                              size_t const channels,
+                                                              size_t const samples,
+                                                              bool const cascade) {
+  if (cascade && channels <= 2) {
+    biquad_cascade_pipeline(first, second, inputs, outputs, channels, samples);
+    return;
+  }
+  size_t ch = 0;
+#ifdef __AVX2__
+  for (; ch + 4 < channels; ch += 8) {
+    size_t const active = channels - ch < 8 ? channels - ch : 8;
+    biquad_group8(first, second, inputs, outputs, ch, active, samples, cascade);
+  }
+#endif
+  for (; ch < channels; ch += 4) {
+    size_t const active = channels - ch < 4 ? channels - ch : 4;
+    biquad_group4(first, second, inputs, outputs, ch, active, samples, cascade);
+  }
+}
+
+static inline void biquad_process(struct simd_biquad const *const first,
+                                  struct simd_biquad const *const second,
+                                  float const *restrict const *const inputs,
+                                  float *restrict const *const outputs,
+                                  size_t const channels,
+                                  size_t const samples) {
+  switch (channels) {
+#define X(n)                                                                                                           \
+  case n:                                                                                                              \
+    if (second) {                                                                                                      \
+      biquad_impl(first, second, inputs, outputs, n, samples, true);                                                   \
+    } else {                                                                                                           \
+      biquad_impl(first, NULL, inputs, outputs, n, samples, false);                                                    \
+    }                                                                                                                  \
+    break;
+    CHSPEC_EACH(X)
+#undef X
+  default:
+    if (second) {
+      biquad_impl(first, second, inputs, outputs, channels, samples, true);
+    } else {
+      biquad_impl(first, NULL, inputs, outputs, channels, samples, false);
+    }
+    break;
+  }
+}
@@ -5,24 +5,36 @@
 #include "ovnum.h"
 #include "ovutil/str.h"
 
-#include "circbuffer_i16.h"
 #include "dynamics.h"
 #include "inlines.h"
 #include "lagger.h"
+#include "mirrorbuf_i16.h"
+#include "peq.h"
 #include "rbjeq.h"
+#include "simd.h"
+#include "svf.h"
+
+enum {
+  buffer_shrink_interval = 256, // frames between attempts to give back the buffer a burst of input grew
+};
 
 struct channel {
   size_t used_at;
-  struct circbuffer_i16 *buf;
+  struct mirrorbuf_i16 *buf;
   struct lagger *lagger;
   struct rbjeq *low_shelf;
   struct rbjeq *high_shelf;
+  struct svf *low_shelf_svf;
+  struct svf *high_shelf_svf;
+  struct peq *eq;
   struct dynamics *dyn;
   int id;
   int aux_send_id;
+  int eq_backend;
 
   float pre_gain;
   float aux_send;
+  float aux_send_amp; // aux_send as a linear gain
   float post_gain;
   float pan;
   struct channel *next;
@@ -32,7 +44,7 @@ struct channel {
 
 NODISCARD static error channel_set_format(struct channel *const c, float const sample_rate, size_t const channels) {
   error err = eok();
-  err = circbuffer_i16_set_channels(c->buf, channels);
+  err = mirrorbuf_i16_set_channels(c->buf, channels);
   if (efailed(err)) {
     err = ethru(err);
     goto cleanup;
@@ -40,7 +52,14 @@ NODISCARD static error channel_set_format(struct channel *const c, float const s
   lagger_set_format(c->lagger, sample_rate, channels);
   rbjeq_set_format(c->low_shelf, sample_rate, channels);
   rbjeq_set_format(c->high_shelf, sample_rate, channels);
-  dynamics_set_format(c->dyn, sample_rate, channels);
+  svf_set_format(c->low_shelf_svf, sample_rate, channels);
+  svf_set_format(c->high_shelf_svf, sample_rate, channels);
+  peq_set_format(c->eq, sample_rate, channels);
+  err = dynamics_set_format(c->dyn, sample_rate, channels);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
 cleanup:
   return err;
 }
@@ -51,20 +70,41 @@ static void channel_set_effects(struct channel *const c, struct channel_effect_p
     c->parameter_changed = true;
   }
   lagger_set_duration(c->lagger, e->lagger_duration);
-  rbjeq_set_frequency(c->low_shelf, e->low_shelf_frequency);
-  rbjeq_set_gain(c->low_shelf, e->low_shelf_gain);
-  rbjeq_set_frequency(c->high_shelf, e->high_shelf_frequency);
-  rbjeq_set_gain(c->high_shelf, e->high_shelf_gain);
+  if (c->eq_backend != e->eq_backend) {
+    c->eq_backend = e->eq_backend;
+    rbjeq_clear(c->low_shelf);
+    rbjeq_clear(c->high_shelf);
+    svf_clear(c->low_shelf_svf);
+    svf_clear(c->high_shelf_svf);
+    c->parameter_changed = true;
+  }
+  // only the backend in use follows the parameters, the other one catches up when it is selected
+  if (c->eq_backend == channel_eq_backend_svf) {
+    svf_set_frequency(c->low_shelf_svf, e->low_shelf_frequency);
+    svf_set_gain(c->low_shelf_svf, e->low_shelf_gain);
+    svf_set_frequency(c->high_shelf_svf, e->high_shelf_frequency);
+    svf_set_gain(c->high_shelf_svf, e->high_shelf_gain);
+  } else {
+    rbjeq_set_frequency(c->low_shelf, e->low_shelf_frequency);
+    rbjeq_set_gain(c->low_shelf, e->low_shelf_gain);
+    rbjeq_set_frequency(c->high_shelf, e->high_shelf_frequency);
+    rbjeq_set_gain(c->high_shelf, e->high_shelf_gain);
+  }
+  peq_set_bands(c->eq, e->eq_bands, e->eq_band_count);
   dynamics_set_thresh(c->dyn, e->dynamics_threshold);
   dynamics_set_ratio(c->dyn, e->dynamics_ratio);
   dynamics_set_attack(c->dyn, e->dynamics_attack);
   dynamics_set_release(c->dyn, e->dynamics_release);
+  dynamics_set_detector(c->dyn, e->dynamics_detector);
+  dynamics_set_rms_window(c->dyn, e->dynamics_rms_window);
+  dynamics_set_control_interval(c->dyn, e->dynamics_control_interval);
   if (c->aux_send_id != e->aux_send_id) {
     c->aux_send_id = e->aux_send_id;
     c->parameter_changed = true;
   }
   if (fcmp(c->aux_send, !=, e->aux_send, 1e-12f)) {
     c->aux_send = e->aux_send;
+    c->aux_send_amp = db_to_amp(e->aux_send);
     c->parameter_changed = true;
   }
   if (fcmp(c->post_gain, !=, e->post_gain, 1e-12f)) {
@@ -81,25 +121,47 @@ NODISCARD static error channel_update_internal_parameter(struct channel *const c
   bool lagger_updated = false;
   bool low_shelf_updated = false;
   bool high_shelf_updated = false;
+  bool low_shelf_svf_updated = false;
+  bool high_shelf_svf_updated = false;
+  bool eq_updated = false;
   bool dynamics_updated = false;
   error err = lagger_update_internal_parameter(c->lagger, &lagger_updated);
   if (efailed(err)) {
     err = ethru(err);
     goto cleanup;
   }
-  err = rbjeq_update_internal_parameter(c->low_shelf, &low_shelf_updated);
-  if (efailed(err)) {
-    err = ethru(err);
-    goto cleanup;
+  if (c->eq_backend == channel_eq_backend_svf) {
+    err = svf_update_internal_parameter(c->low_shelf_svf, &low_shelf_svf_updated);
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
+    err = svf_update_internal_parameter(c->high_shelf_svf, &high_shelf_svf_updated);
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
+  } else {
+    err = rbjeq_update_internal_parameter(c->low_shelf, &low_shelf_updated);
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
+    err = rbjeq_update_internal_parameter(c->high_shelf, &high_shelf_updated);
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
   }
-  err = rbjeq_update_internal_parameter(c->high_shelf, &high_shelf_updated);
+  err = peq_update_internal_parameter(c->eq, &eq_updated);
   if (efailed(err)) {
     err = ethru(err);
     goto cleanup;
   }
   dynamics_update_internal_parameter(c->dyn, &dynamics_updated);
   if (updated) {
-    *updated = c->parameter_changed || lagger_updated || low_shelf_updated || high_shelf_updated || dynamics_updated;
+    *updated = c->parameter_changed || lagger_updated || low_shelf_updated || high_shelf_updated ||
+               low_shelf_svf_updated || high_shelf_svf_updated || eq_updated || dynamics_updated;
   }
   c->parameter_changed = false;
 
@@ -113,7 +175,7 @@ NODISCARD static error channel_destroy(struct channel **cp) {
   }
   struct channel *c = *cp;
   if (c->buf) {
-    ereport(circbuffer_i16_destroy(&c->buf));
+    ereport(mirrorbuf_i16_destroy(&c->buf));
   }
   if (c->lagger) {
     ereport(lagger_destroy(&c->lagger));
@@ -124,6 +186,15 @@ NODISCARD static error channel_destroy(struct channel **cp) {
   if (c->high_shelf) {
     ereport(rbjeq_destroy(&c->high_shelf));
   }
+  if (c->low_shelf_svf) {
+    ereport(svf_destroy(&c->low_shelf_svf));
+  }
+  if (c->high_shelf_svf) {
+    ereport(svf_destroy(&c->high_shelf_svf));
+  }
+  if (c->eq) {
+    ereport(peq_destroy(&c->eq));
+  }
   if (c->dyn) {
     ereport(dynamics_destroy(&c->dyn));
   }
@@ -143,8 +214,10 @@ NODISCARD static error channel_create(struct channel **const cp) {
     goto cleanup;
   }
   struct channel *const c = *cp;
-  *c = (struct channel){0};
-  err = circbuffer_i16_create(&c->buf);
+  *c = (struct channel){
+      .aux_send_amp = 1.f,
+  };
+  err = mirrorbuf_i16_create(&c->buf);
   if (efailed(err)) {
     err = ethru(err);
     goto cleanup;
@@ -172,6 +245,28 @@ NODISCARD static error channel_create(struct channel **const cp) {
   rbjeq_set_type(c->high_shelf, rbjeq_type_high_shelf);
   rbjeq_set_q(c->high_shelf, 1.f / sqrt2);
 
+  err = svf_create(&c->low_shelf_svf);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  svf_set_type(c->low_shelf_svf, rbjeq_type_low_shelf);
+  svf_set_q(c->low_shelf_svf, 1.f / sqrt2);
+
+  err = svf_create(&c->high_shelf_svf);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  svf_set_type(c->high_shelf_svf, rbjeq_type_high_shelf);
+  svf_set_q(c->high_shelf_svf, 1.f / sqrt2);
+
+  err = peq_create(&c->eq);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+
   err = dynamics_create(&c->dyn);
   if (efailed(err)) {
     err = ethru(err);
@@ -196,6 +291,9 @@ NODISCARD static error channel_create(struct channel **const cp) {
                           .dynamics_ratio = 0.6f,
                           .dynamics_attack = 0.18f,
                           .dynamics_release = 0.55f,
+                          .dynamics_detector = dynamics_detector_peak,
+                          .dynamics_rms_window = 0.05f,
+                          .dynamics_control_interval = 1,
                           .aux_send = 0.f,
                           .post_gain = 1.f,
                           .pan = 1.f,
@@ -224,10 +322,13 @@ static float channel_get_lookahead_duration(struct channel const *const c) {
 
 static void channel_reset(struct channel *const c) {
   c->used_at = 0;
-  circbuffer_i16_clear(c->buf);
+  mirrorbuf_i16_clear(c->buf);
   lagger_clear(c->lagger);
   rbjeq_clear(c->low_shelf);
   rbjeq_clear(c->high_shelf);
+  svf_clear(c->low_shelf_svf);
+  svf_clear(c->high_shelf_svf);
+  peq_clear(c->eq);
   dynamics_clear(c->dyn);
 }
 
@@ -236,7 +337,6 @@ static void channel_reset(struct channel *const c) {
 struct channel_list {
   struct channel *head;
   channel_notify_func notify_func;
-  channel_write_to_send_func write_to_send_target_func;
   void *userdata;
 };
 
@@ -245,9 +345,6 @@ static void set_head(struct channel_list *const cl, struct channel *const new_he
 
 void channel_list_set_userdata(struct channel_list *const cl, void *const userdata) { cl->userdata = userdata; }
 void channel_list_set_notify_callback(struct channel_list *const cl, channel_notify_func f) { cl->notify_func = f; }
-void channel_list_set_write_to_send_target_callback(struct channel_list *const cl, channel_write_to_send_func f) {
-  cl->write_to_send_target_func = f;
-}
 
 static void free_all(struct channel_list *const cl) {
   struct channel *next = NULL;
@@ -358,7 +455,15 @@ NODISCARD error channel_list_channel_update(struct channel_list *const cl,
     err = ethru(err);
     goto cleanup;
   }
-  err = circbuffer_i16_write(c->buf, src, samples);
+  if (samples) {
+    // room for a late frame on top of the current one without growing the buffer
+    err = mirrorbuf_i16_reserve(c->buf, samples * 2);
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
+  }
+  err = mirrorbuf_i16_write(c->buf, src, samples);
   if (efailed(err)) {
     err = ethru(err);
     return err;
@@ -368,59 +473,167 @@ cleanup:
   return err;
 }
 
+enum channel_stage {
+  channel_stage_low_shelf_svf,
+  channel_stage_high_shelf_svf,
+  channel_stage_shelf_cascade,
+  channel_stage_low_shelf,
+  channel_stage_high_shelf,
+  channel_stage_eq,
+  channel_stage_dynamics,
+  channel_stage_max,
+  channel_stage_copy = channel_stage_max, // only used to read the lagger when no other stage is active
+};
+
+// Lists the active stages in processing order.
+static size_t channel_get_stages(struct channel const *const c, int stages[channel_stage_max]) {
+  size_t n = 0;
+  if (c->eq_backend == channel_eq_backend_svf) {
+    if (svf_is_active(c->low_shelf_svf)) {
+      stages[n++] = channel_stage_low_shelf_svf;
+    }
+    if (svf_is_active(c->high_shelf_svf)) {
+      stages[n++] = channel_stage_high_shelf_svf;
+    }
+  }
+  bool const use_low_shelf =
+      c->eq_backend == channel_eq_backend_biquad && fcmp(rbjeq_get_gain(c->low_shelf), !=, 0.f, 1e-12f);
+  bool const use_high_shelf =
+      c->eq_backend == channel_eq_backend_biquad && fcmp(rbjeq_get_gain(c->high_shelf), !=, 0.f, 1e-12f);
+  if (use_low_shelf && use_high_shelf) {
+    stages[n++] = channel_stage_shelf_cascade;
+  } else if (use_low_shelf) {
+    stages[n++] = channel_stage_low_shelf;
+  } else if (use_high_shelf) {
+    stages[n++] = channel_stage_high_shelf;
+  }
+  if (peq_get_bands(c->eq) > 0) {
+    stages[n++] = channel_stage_eq;
+  }
+  if (fcmp(dynamics_get_ratio(c->dyn), !=, 0.2f, 1e-12f)) {
+    stages[n++] = channel_stage_dynamics;
+  }
+  return n;
+}
+
+static void channel_process_stage(struct channel *const c,
+                                  int const stage,
+                                  float const *restrict const *const inputs,
+                                  float *restrict const *const outputs,
+                                  size_t const samples) {
+  switch (stage) {
+  case channel_stage_low_shelf_svf:
+    svf_process(c->low_shelf_svf, inputs, outputs, samples);
+    break;
+  case channel_stage_high_shelf_svf:
+    svf_process(c->high_shelf_svf, inputs, outputs, samples);
+    break;
+  case channel_stage_shelf_cascade:
+    rbjeq_process_cascade(c->low_shelf, c->high_shelf, inputs, outputs, samples);
+    break;
+  case channel_stage_low_shelf:
+    rbjeq_process(c->low_shelf, inputs, outputs, samples);
+    break;
+  case channel_stage_high_shelf:
+    rbjeq_process(c->high_shelf, inputs, outputs, samples);
+    break;
+  case channel_stage_eq:
+    peq_process(c->eq, inputs, outputs, samples);
+    break;
+  case channel_stage_dynamics:
+    dynamics_process(c->dyn, inputs, outputs, samples);
+    break;
+  case channel_stage_copy:
+    for (size_t ch = 0, channels = mirrorbuf_i16_get_channels(c->buf); ch < channels; ++ch) {
+      memcpy(outputs[ch], inputs[ch], samples * sizeof(float));
+    }
+    break;
+  }
+}
+
+static float *restrict const *
+find_route(struct channel_send_route const *const routes, size_t const num_routes, int const id) {
+  size_t lo = 0;
+  size_t hi = num_routes;
+  while (lo < hi) {
+    size_t const mid = (lo + hi) / 2;
+    if (routes[mid].id < id) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo < num_routes && routes[lo].id == id ? routes[lo].buf : NULL;
+}
+
 void channel_list_mix(struct channel_list const *const cl,
                       size_t const counter,
                       size_t const samples,
+                      struct channel_send_route const *const routes,
+                      size_t const num_routes,
                       float *restrict const *const mixbuf,
                       float *restrict const *const chbuf,
                       float *restrict const *const tmpbuf) {
   float *restrict const *ch = chbuf;
   float *restrict const *tmp = tmpbuf;
+  struct simd_kernels const *const k = simd();
   static float const i16_to_float = 1.f / 32768.f;
   for (struct channel *c = get_head(cl); c; c = c->next) {
-    if (c->used_at != counter && circbuffer_i16_get_remain(c->buf) == 0) {
+    if (c->used_at != counter && mirrorbuf_i16_get_remain(c->buf) == 0) {
       continue;
     }
     size_t read = 0;
-    ereport(circbuffer_i16_read_as_float(c->buf, ch, samples, i16_to_float * db_to_amp(c->pre_gain), &read));
+    ereport(mirrorbuf_i16_read_as_float(c->buf, ch, samples, i16_to_float * db_to_amp(c->pre_gain), &read));
     if (read < samples) {
-      for (size_t i = 0, channels = circbuffer_i16_get_channels(c->buf); i < channels; ++i) {
+      for (size_t i = 0, channels = mirrorbuf_i16_get_channels(c->buf); i < channels; ++i) {
         memset(ch[i] + read, 0, (samples - read) * sizeof(float));
       }
     }
-    if (lagger_get_duration(c->lagger) > 0.f) {
-      lagger_process(c->lagger, (float const *restrict const *)ch, tmp, samples);
-      swap(&ch, &tmp);
-    }
-    if (fcmp(rbjeq_get_gain(c->low_shelf), !=, 0.f, 1e-12f)) {
-      rbjeq_process(c->low_shelf, (float const *restrict const *)ch, tmp, samples);
-      swap(&ch, &tmp);
-    }
-    if (fcmp(rbjeq_get_gain(c->high_shelf), !=, 0.f, 1e-12f)) {
-      rbjeq_process(c->high_shelf, (float const *restrict const *)ch, tmp, samples);
+    int stages[channel_stage_max];
+    size_t const num_stages = channel_get_stages(c, stages);
+    size_t first = 0;
+    if (lagger_is_active(c->lagger)) {
+      // the first stage reads the delay line in place
+      struct lagger_view view = {0};
+      lagger_process(c->lagger, (float const *restrict const *)ch, tmp, samples, &view);
+      int const stage = num_stages ? stages[first++] : channel_stage_copy;
+      for (size_t i = 0; i < view.spans; ++i) {
+        channel_process_stage(c, stage, view.inputs[i], view.outputs[i], view.samples[i]);
+      }
       swap(&ch, &tmp);
     }
-    if (fcmp(dynamics_get_ratio(c->dyn), !=, 0.2f, 1e-12f)) {
-      dynamics_process(c->dyn, (float const *restrict const *)ch, tmp, samples);
+    for (size_t i = first; i < num_stages; ++i) {
+      channel_process_stage(c, stages[i], (float const *restrict const *)ch, tmp, samples);
       swap(&ch, &tmp);
     }
-    if (c->aux_send_id > -1 && fcmp(c->aux_send, >, -144.f, 1e-12f) && cl->write_to_send_target_func) {
-      ereport(cl->write_to_send_target_func(
-          cl->userdata, c->aux_send_id, counter, (float const *restrict const *)ch, samples, c->aux_send));
+    size_t const channels = mirrorbuf_i16_get_channels(c->buf);
+    if (c->aux_send_id > -1 && c->aux_send_amp > 0.f) {
+      float *restrict const *const send = find_route(routes, num_routes, c->aux_send_id);
+      if (send) {
+        k->mix_with_amp(send, (float const *restrict const *)ch, c->aux_send_amp, channels, samples);
+      }
     }
-    size_t const channels = circbuffer_i16_get_channels(c->buf);
     if (channels == 2) {
-      stereo_pan_and_gain(tmp, (float const *restrict const *)ch, c->pan, c->post_gain, samples);
+      k->stereo_pan_and_gain(tmp, (float const *restrict const *)ch, c->pan, c->post_gain, samples);
       swap(&ch, &tmp);
     } else {
-      gain(tmp, (float const *restrict const *)ch, c->post_gain, channels, samples);
+      k->gain(tmp, (float const *restrict const *)ch, c->post_gain, channels, samples);
       swap(&ch, &tmp);
     }
     if (cl->notify_func) {
       cl->notify_func(cl->userdata, c->id, (float const *restrict const *)ch, channels, samples);
     }
-    mix(mixbuf, (float const *restrict const *)ch, channels, samples);
+    k->mix(mixbuf, (float const *restrict const *)ch, channels, samples);
+  }
+}
+
+bool channel_list_is_active(struct channel_list const *const cl, size_t const counter) {
+  for (struct channel *c = get_head(cl); c; c = c->next) {
+    if (c->used_at == counter || mirrorbuf_i16_get_remain(c->buf) > 0) {
+      return true;
+    }
   }
+  return false;
 }
 
 void channel_list_gc(struct channel_list *const cl, size_t const counter) {
@@ -428,7 +641,10 @@ void channel_list_gc(struct channel_list *const cl, size_t const counter) {
   struct channel *next = NULL;
   struct channel *c = get_head(cl);
   while (c) {
-    if (c->used_at == counter || circbuffer_i16_get_remain(c->buf) > 0) {
+    if (c->used_at == counter || mirrorbuf_i16_get_remain(c->buf) > 0) {
+      if (counter % buffer_shrink_interval == 0) {
+        ereport(mirrorbuf_i16_shrink(c->buf));
+      }
       prev = c;
       c = c->next;
       continue;
@@ -500,6 +716,7 @@ static void get_effect_params_str(struct channel const *const c, struct channel_
   dynamics_get_ratio_str(c->dyn, params->dynamics_ratio);
   dynamics_get_attack_str(c->dyn, params->dynamics_attack);
   dynamics_get_release_str(c->dyn, params->dynamics_release);
+  dynamics_get_detector_str(c->dyn, params->dynamics_detector);
   write_double(params->aux_send, (double)c->aux_send, tmp);
   write_double(params->post_gain, (double)c->post_gain, tmp);
   write_double(params->pan, (double)c->pan, tmp);
@@ -2,6 +2,13 @@
 
 #include "ovbase.h"
 
+#include "peq.h"
+
+enum channel_eq_backend {
+  channel_eq_backend_biquad,
+  channel_eq_backend_svf, // ramps frequency/gain changes per sample
+};
+
 struct channel_effect_params {
   float pre_gain;
   float lagger_duration;
@@ -9,10 +16,16 @@ struct channel_effect_params {
   float low_shelf_gain;
   float high_shelf_frequency;
   float high_shelf_gain;
+  int eq_backend; // enum channel_eq_backend
+  size_t eq_band_count;
+  struct peq_band eq_bands[peq_max_bands];
   float dynamics_threshold;
   float dynamics_ratio;
   float dynamics_attack;
   float dynamics_release;
+  int dynamics_detector; // enum dynamics_detector
+  float dynamics_rms_window;
+  size_t dynamics_control_interval; // 1, 4 or 8, see dynamics_set_control_interval
   int aux_send_id;
   float aux_send;
   float post_gain;
@@ -30,6 +43,7 @@ struct channel_effect_params_str {
   NATIVE_CHAR dynamics_ratio[16];
   NATIVE_CHAR dynamics_attack[16];
   NATIVE_CHAR dynamics_release[16];
+  NATIVE_CHAR dynamics_detector[16];
   NATIVE_CHAR aux_send[16];
   NATIVE_CHAR post_gain[16];
   NATIVE_CHAR pan[16];
@@ -41,12 +55,11 @@ typedef void (*channel_notify_func)(void *const userdata,
                                     size_t const channels,
                                     size_t const samples);
 
-typedef NODISCARD error (*channel_write_to_send_func)(void *const userdata,
-                                                      int const send_id,
-                                                      size_t const counter,
-                                                      float const *restrict const *const src,
-                                                      size_t const samples,
-                                                      float const gain_db);
+// Destination of the aux sends, resolved once per frame by the owner of the aux channels.
+struct channel_send_route {
+  int id;
+  float *restrict const *buf; // the sends are accumulated here
+};
 
 struct channel_list;
 
@@ -55,7 +68,6 @@ NODISCARD error channel_list_destroy(struct channel_list **const clp);
 
 void channel_list_set_userdata(struct channel_list *const cl, void *const userdata);
 void channel_list_set_notify_callback(struct channel_list *const cl, channel_notify_func f);
-void channel_list_set_write_to_send_target_callback(struct channel_list *const cl, channel_write_to_send_func f);
 
 NODISCARD error channel_list_set_format(struct channel_list const *const cl,
                                         float const sample_rate,
@@ -77,12 +89,18 @@ NODISCARD error channel_list_channel_update(struct channel_list *const cl,
                                             size_t const samples,
                                             bool *const updated);
 
+// routes must be sorted by id, sends to an id that is not in routes are dropped.
 void channel_list_mix(struct channel_list const *const cl,
                       size_t const counter,
                       size_t const samples,
+                      struct channel_send_route const *const routes,
+                      size_t const num_routes,
                       float *restrict const *const mixbuf,
                       float *restrict const *const chbuf,
                       float *restrict const *const tmpbuf);
 
+// Tells whether channel_list_mix has anything to mix in this round.
+bool channel_list_is_active(struct channel_list const *const cl, size_t const counter);
+
 void channel_list_gc(struct channel_list *const cl, size_t const counter);
 void channel_list_reset(struct channel_list const *const cl);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "ovbase.h"
+
+// Kernels whose inner loops run over the channels are instantiated once per channel count up to
+// chspec_max_channels, so that those loops are unrolled and the per-channel state can stay in registers.
+// Other counts go through a generic instance that reads the count at run time.
+enum {
+  chspec_max_channels = 8,
+};
+
+// Expands X(n) for every specialized channel count.
+#define CHSPEC_EACH(X) X(1) X(2) CHSPEC_EACH_MULTI(X)
+// The same without mono and stereo, for code that already has its own paths for them.
+#define CHSPEC_EACH_MULTI(X) X(3) X(4) X(5) X(6) X(7) X(8)
+
+// Tables are laid out as {generic, 1 channel, ..., chspec_max_channels channels}.
+static inline size_t chspec_index(size_t const channels) { return channels <= chspec_max_channels ? channels : 0; }
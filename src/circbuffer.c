@@ -2,6 +2,10 @@
 
 #include <stdalign.h>
 
+enum {
+  growth_limit = 65536, // the largest step the buffer grows by at once in samples
+};
+
 struct circbuffer {
   float **ptr;
   size_t len;
@@ -10,8 +14,29 @@ struct circbuffer {
   size_t buffer_size;
   size_t remain;
   size_t writecur;
+  size_t reserved; // circbuffer_shrink never goes below this
+  size_t peak;     // the highest remain since the last circbuffer_shrink
 };
 
+// Grows geometrically so that uneven writes settle after a few reallocations.
+static size_t grow_size(size_t const buffer_size, size_t const needed) {
+  size_t const grown = buffer_size + (buffer_size < growth_limit ? buffer_size : growth_limit);
+  return grown > needed ? grown : needed;
+}
+
+NODISCARD static error ensure(struct circbuffer *const c, size_t const samples) {
+  size_t const needed = c->remain + samples;
+  if (needed <= c->buffer_size) {
+    return eok();
+  }
+  error err = circbuffer_set_buffer_size(c, grow_size(c->buffer_size, needed));
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  return eok();
+}
+
 NODISCARD static error allocate(struct circbuffer *const c, size_t const start_index) {
   static size_t const align = 16, block_size = 4;
 
@@ -185,6 +210,40 @@ NODISCARD error circbuffer_set_buffer_size(struct circbuffer *const c, size_t co
   return err;
 }
 
+NODISCARD error circbuffer_reserve(struct circbuffer *const c, size_t const buffer_size) {
+  if (!c || !buffer_size) {
+    return errg(err_invalid_arugment);
+  }
+  c->reserved = buffer_size;
+  if (buffer_size <= c->buffer_size) {
+    return eok();
+  }
+  error err = circbuffer_set_buffer_size(c, buffer_size);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  return eok();
+}
+
+NODISCARD error circbuffer_shrink(struct circbuffer *const c) {
+  if (!c) {
+    return errg(err_invalid_arugment);
+  }
+  size_t const peak = c->peak > c->remain ? c->peak : c->remain;
+  size_t const target = peak * 2 > c->reserved ? peak * 2 : c->reserved;
+  c->peak = c->remain;
+  if (!c->len || !target || target * 2 > c->buffer_size) {
+    return eok();
+  }
+  error err = circbuffer_set_buffer_size(c, target);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  return eok();
+}
+
 void circbuffer_clear(struct circbuffer *const c) {
   c->remain = 0;
   c->writecur = 0;
@@ -246,15 +305,16 @@ NODISCARD error circbuffer_write_offset(struct circbuffer *const c,
   if (!c->len || !samples) {
     return eok();
   }
-  if (c->remain + samples > c->buffer_size) {
-    error err = circbuffer_set_buffer_size(c, c->remain + samples);
-    if (efailed(err)) {
-      err = ethru(err);
-      return err;
-    }
+  error err = ensure(c, samples);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
   }
   c->writecur = writebuf(c, src, (float *restrict const *const)c->ptr, samples, offset);
   c->remain += samples;
+  if (c->remain > c->peak) {
+    c->peak = c->remain;
+  }
   return eok();
 }
 
@@ -276,15 +336,16 @@ NODISCARD error circbuffer_write_silence(struct circbuffer *const c, size_t cons
   if (!c->len || !samples) {
     return eok();
   }
-  if (c->remain + samples > c->buffer_size) {
-    error err = circbuffer_set_buffer_size(c, c->remain + samples);
-    if (efailed(err)) {
-      err = ethru(err);
-      return err;
-    }
+  error err = ensure(c, samples);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
   }
   c->writecur = fillbuf(c, (float *restrict const *const)c->ptr, samples);
   c->remain += samples;
+  if (c->remain > c->peak) {
+    c->peak = c->remain;
+  }
   return eok();
 }
 
@@ -8,6 +8,10 @@ NODISCARD error circbuffer_create(struct circbuffer **const cp);
 NODISCARD error circbuffer_destroy(struct circbuffer **const cp);
 
 NODISCARD error circbuffer_set_buffer_size(struct circbuffer *const c, size_t const buffer_size);
+// Makes room for at least buffer_size samples up front, writes grow the buffer geometrically beyond that.
+NODISCARD error circbuffer_reserve(struct circbuffer *const c, size_t const buffer_size);
+// Gives back the capacity the writes since the last call did not need, intended to be called while idle.
+NODISCARD error circbuffer_shrink(struct circbuffer *const c);
 
 void circbuffer_clear(struct circbuffer *const c);
 
@@ -2,6 +2,10 @@
 
 #include <stdalign.h>
 
+enum {
+  growth_limit = 65536, // the largest step the buffer grows by at once in samples
+};
+
 struct circbuffer_i16 {
   int16_t *ptr;
 
@@ -9,8 +13,30 @@ struct circbuffer_i16 {
   size_t buffer_size;
   size_t remain;
   size_t writecur;
+  size_t reserved; // circbuffer_i16_shrink never goes below this
+  size_t peak;     // the highest remain since the last circbuffer_i16_shrink
 };
 
+// Grows geometrically so that uneven writes settle after a few reallocations.
+static size_t grow_size(size_t const buffer_size, size_t const needed) {
+  size_t const grown = buffer_size + (buffer_size < growth_limit ? buffer_size : growth_limit);
+  return grown > needed ? grown : needed;
+}
+
+NODISCARD static error ensure(struct circbuffer_i16 *const c, size_t const samples) {
+  size_t const needed = c->remain + samples;
+  if (c->ptr && needed <= c->buffer_size) {
+    return eok();
+  }
+  size_t const size = c->ptr ? grow_size(c->buffer_size, needed) : needed > c->buffer_size ? needed : c->buffer_size;
+  error err = circbuffer_i16_set_buffer_size(c, size);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  return eok();
+}
+
 NODISCARD static error allocate(struct circbuffer_i16 *const c) {
   static size_t const align = 16, block_size = 4;
 
@@ -197,6 +223,41 @@ NODISCARD error circbuffer_i16_set_buffer_size(struct circbuffer_i16 *const c, s
   return err;
 }
 
+NODISCARD error circbuffer_i16_reserve(struct circbuffer_i16 *const c, size_t const buffer_size) {
+  if (!c || !buffer_size) {
+    return errg(err_invalid_arugment);
+  }
+  c->reserved = buffer_size;
+  size_t const size = buffer_size > c->buffer_size ? buffer_size : c->buffer_size;
+  if (c->ptr && size == c->buffer_size) {
+    return eok();
+  }
+  error err = circbuffer_i16_set_buffer_size(c, size);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  return eok();
+}
+
+NODISCARD error circbuffer_i16_shrink(struct circbuffer_i16 *const c) {
+  if (!c) {
+    return errg(err_invalid_arugment);
+  }
+  size_t const peak = c->peak > c->remain ? c->peak : c->remain;
+  size_t const target = peak * 2 > c->reserved ? peak * 2 : c->reserved;
+  c->peak = c->remain;
+  if (!c->ptr || !target || target * 2 > c->buffer_size) {
+    return eok();
+  }
+  error err = circbuffer_i16_set_buffer_size(c, target);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  return eok();
+}
+
 void circbuffer_i16_clear(struct circbuffer_i16 *const c) {
   c->remain = 0;
   c->writecur = 0;
@@ -247,15 +308,16 @@ NODISCARD error circbuffer_i16_write_offset(struct circbuffer_i16 *const c,
   if (!samples) {
     return eok();
   }
-  if (!c->ptr || c->remain + samples > c->buffer_size) {
-    error err = circbuffer_i16_set_buffer_size(c, c->remain + samples);
-    if (efailed(err)) {
-      err = ethru(err);
-      return err;
-    }
+  error err = ensure(c, samples);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
   }
   c->writecur = writebuf(c, src, (int16_t *restrict const)c->ptr, samples, offset);
   c->remain += samples;
+  if (c->remain > c->peak) {
+    c->peak = c->remain;
+  }
   return eok();
 }
 
@@ -280,15 +342,16 @@ NODISCARD error circbuffer_i16_write_silence(struct circbuffer_i16 *const c, siz
   if (!samples) {
     return eok();
   }
-  if (!c->ptr || c->remain + samples > c->buffer_size) {
-    error err = circbuffer_i16_set_buffer_size(c, c->remain + samples);
-    if (efailed(err)) {
-      err = ethru(err);
-      return err;
-    }
+  error err = ensure(c, samples);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
   }
   c->writecur = fillbuf(c, (int16_t *restrict const)c->ptr, samples);
   c->remain += samples;
+  if (c->remain > c->peak) {
+    c->peak = c->remain;
+  }
   return eok();
 }
 
@@ -8,6 +8,10 @@ NODISCARD error circbuffer_i16_create(struct circbuffer_i16 **const cp);
 NODISCARD error circbuffer_i16_destroy(struct circbuffer_i16 **const cp);
 
 NODISCARD error circbuffer_i16_set_buffer_size(struct circbuffer_i16 *const c, size_t const buffer_size);
+// Makes room for at least buffer_size samples up front, writes grow the buffer geometrically beyond that.
+NODISCARD error circbuffer_i16_reserve(struct circbuffer_i16 *const c, size_t const buffer_size);
+// Gives back the capacity the writes since the last call did not need, intended to be called while idle.
+NODISCARD error circbuffer_i16_shrink(struct circbuffer_i16 *const c);
 
 void circbuffer_i16_clear(struct circbuffer_i16 *const c);
 
@@ -81,26 +81,26 @@ static void test_write_read_mono(void) {
   TEST_CHECK(c->remain == 16);
   TEST_CHECK(c->writecur == 8);
   TEST_SUCCEEDED_F(circbuffer_i16_write(c, input, 8));
-  TEST_CHECK(c->buffer_size == 24);
+  TEST_CHECK(c->buffer_size == 32);
   TEST_CHECK(c->remain == 24);
-  TEST_CHECK(c->writecur == 0);
+  TEST_CHECK(c->writecur == 24);
   TEST_SUCCEEDED_F(circbuffer_i16_read(c, output, 16, &written));
   TEST_CHECK(written == 16);
   TEST_CHECK(memcmp(output, input, sizeof(int16_t) * 16) == 0);
-  TEST_CHECK(c->buffer_size == 24);
+  TEST_CHECK(c->buffer_size == 32);
   TEST_CHECK(c->remain == 8);
-  TEST_CHECK(c->writecur == 0);
+  TEST_CHECK(c->writecur == 24);
   TEST_SUCCEEDED_F(circbuffer_i16_read(c, output, 16, &written));
   TEST_CHECK(written == 8);
   TEST_CHECK(memcmp(output, input, sizeof(int16_t) * 8) == 0);
-  TEST_CHECK(c->buffer_size == 24);
+  TEST_CHECK(c->buffer_size == 32);
   TEST_CHECK(c->remain == 0);
-  TEST_CHECK(c->writecur == 0);
+  TEST_CHECK(c->writecur == 24);
 
   TEST_SUCCEEDED_F(circbuffer_i16_write(c, input, 16));
-  TEST_CHECK(c->buffer_size == 24);
+  TEST_CHECK(c->buffer_size == 32);
   TEST_CHECK(c->remain == 16);
-  TEST_CHECK(c->writecur == 16);
+  TEST_CHECK(c->writecur == 8);
   static float const testdata[16] = {
       10.f, 20.f, 30.f, 40.f, 50.f, 60.f, 70.f, 80.f, 90.f, 100.f, 110.f, 120.f, 130.f, 140.f, 150.f, 160.f};
   float const *const expected[1] = {testdata};
@@ -118,8 +118,79 @@ static void test_write_read_mono(void) {
   TEST_CHECK(c == NULL);
 }
 
+static void test_reserve_shrink(void) {
+  static int16_t const input[256 * 2] = {0};
+  int16_t output[256 * 2] = {0};
+  struct circbuffer_i16 *c = NULL;
+  TEST_SUCCEEDED_F(circbuffer_i16_create(&c));
+  TEST_SUCCEEDED_F(circbuffer_i16_set_channels(c, 2));
+  TEST_SUCCEEDED_F(circbuffer_i16_reserve(c, 64));
+  TEST_CHECK(c->ptr != NULL);
+  TEST_CHECK(c->buffer_size == 64);
+
+  TEST_SUCCEEDED_F(circbuffer_i16_write(c, input, 48));
+  TEST_SUCCEEDED_F(circbuffer_i16_write(c, input, 48));
+  TEST_CHECK(c->buffer_size == 128);
+  TEST_SUCCEEDED_F(circbuffer_i16_write(c, input, 256));
+  TEST_CHECK(c->buffer_size == 352);
+
+  size_t written = 0;
+  TEST_SUCCEEDED_F(circbuffer_i16_read(c, output, 256, &written));
+  TEST_SUCCEEDED_F(circbuffer_i16_read(c, output, 256, &written));
+  TEST_CHECK(c->remain == 0);
+  TEST_SUCCEEDED_F(circbuffer_i16_shrink(c));
+  TEST_CHECK(c->buffer_size == 352); // still in use since the last call
+  TEST_SUCCEEDED_F(circbuffer_i16_write(c, input, 16));
+  TEST_SUCCEEDED_F(circbuffer_i16_shrink(c));
+  TEST_CHECK(c->buffer_size == 64); // never below the reservation
+  TEST_CHECK(c->remain == 16);
+  TEST_SUCCEEDED_F(circbuffer_i16_destroy(&c));
+}
+
+// Frame sizes wander around the nominal size like AviUtl's do at 29.97 fps,
+// with an occasional dropped frame that delivers two frames at once.
+static void bench_jitter(void) {
+  enum {
+    channels = 2,
+    frame = 1471,
+    frames = 200000,
+  };
+  static int16_t input[frame * 3 * channels];
+  static float buf[channels][frame];
+  float *const output[channels] = {buf[0], buf[1]};
+  for (size_t i = 0; i < frame * 3 * channels; ++i) {
+    input[i] = (int16_t)(i & 0x7fff);
+  }
+  struct circbuffer_i16 *c = NULL;
+  TEST_SUCCEEDED_F(circbuffer_i16_create(&c));
+  TEST_SUCCEEDED_F(circbuffer_i16_set_channels(c, channels));
+  size_t reallocations = 0;
+  uint32_t rng = 1;
+  for (size_t i = 0; i < frames; ++i) {
+    rng = rng * 1664525u + 1013904223u;
+    size_t n = frame - 24 + (rng >> 16) % 49;
+    if ((rng >> 8) % 97 == 0) {
+      n += frame;
+    }
+    int16_t const *const ptr = c->ptr;
+    TEST_SUCCEEDED_F(circbuffer_i16_write(c, input, n));
+    reallocations += ptr != c->ptr;
+    size_t written = 0;
+    TEST_SUCCEEDED_F(circbuffer_i16_read_as_float(c, output, frame, 1.f, &written));
+    if (c->remain > frame * 2) {
+      // the host catches up after a burst
+      TEST_SUCCEEDED_F(circbuffer_i16_discard(c, c->remain - frame, NULL));
+    }
+  }
+  TEST_CHECK(reallocations < 8);
+  TEST_MSG("reallocated %zu times, buffer size %zu", reallocations, c->buffer_size);
+  TEST_SUCCEEDED_F(circbuffer_i16_destroy(&c));
+}
+
 TEST_LIST = {
     {"test_create_destroy", test_create_destroy},
     {"test_write_read_mono", test_write_read_mono},
+    {"test_reserve_shrink", test_reserve_shrink},
+    {"bench_jitter", bench_jitter},
     {NULL, NULL},
 };
@@ -83,28 +83,59 @@ static void test_write_read_mono(void) {
   TEST_CHECK(c->remain == 16);
   TEST_CHECK(c->writecur == 8);
   TEST_SUCCEEDED_F(circbuffer_write(c, input, 8));
-  TEST_CHECK(c->buffer_size == 24);
+  TEST_CHECK(c->buffer_size == 32);
   TEST_CHECK(c->remain == 24);
-  TEST_CHECK(c->writecur == 0);
+  TEST_CHECK(c->writecur == 24);
   TEST_SUCCEEDED_F(circbuffer_read(c, output, 16, &written));
   TEST_CHECK(written == 16);
   TEST_CHECK(memcmp(output[0], input[0], sizeof(float) * 16) == 0);
-  TEST_CHECK(c->buffer_size == 24);
+  TEST_CHECK(c->buffer_size == 32);
   TEST_CHECK(c->remain == 8);
-  TEST_CHECK(c->writecur == 0);
+  TEST_CHECK(c->writecur == 24);
   TEST_SUCCEEDED_F(circbuffer_read(c, output, 16, &written));
   TEST_CHECK(written == 8);
   TEST_CHECK(memcmp(output[0], input[0], sizeof(float) * 8) == 0);
-  TEST_CHECK(c->buffer_size == 24);
+  TEST_CHECK(c->buffer_size == 32);
   TEST_CHECK(c->remain == 0);
-  TEST_CHECK(c->writecur == 0);
+  TEST_CHECK(c->writecur == 24);
 
   TEST_SUCCEEDED_F(circbuffer_destroy(&c));
   TEST_CHECK(c == NULL);
 }
 
+static void test_reserve_shrink(void) {
+  static float testdata[256] = {0};
+  static float const *const input[1] = {testdata};
+  float buffer[256] = {0};
+  float *const output[1] = {buffer};
+  struct circbuffer *c = NULL;
+  TEST_SUCCEEDED_F(circbuffer_create(&c));
+  TEST_SUCCEEDED_F(circbuffer_set_channels(c, 1));
+  TEST_SUCCEEDED_F(circbuffer_reserve(c, 64));
+  TEST_CHECK(c->buffer_size == 64);
+
+  TEST_SUCCEEDED_F(circbuffer_write(c, input, 48));
+  TEST_SUCCEEDED_F(circbuffer_write(c, input, 48));
+  TEST_CHECK(c->buffer_size == 128);
+  TEST_SUCCEEDED_F(circbuffer_write(c, input, 256));
+  TEST_CHECK(c->buffer_size == 352);
+
+  size_t written = 0;
+  TEST_SUCCEEDED_F(circbuffer_read(c, output, 256, &written));
+  TEST_SUCCEEDED_F(circbuffer_read(c, output, 256, &written));
+  TEST_CHECK(c->remain == 0);
+  TEST_SUCCEEDED_F(circbuffer_shrink(c));
+  TEST_CHECK(c->buffer_size == 352); // still in use since the last call
+  TEST_SUCCEEDED_F(circbuffer_write(c, input, 16));
+  TEST_SUCCEEDED_F(circbuffer_shrink(c));
+  TEST_CHECK(c->buffer_size == 64); // never below the reservation
+  TEST_CHECK(c->remain == 16);
+  TEST_SUCCEEDED_F(circbuffer_destroy(&c));
+}
+
 TEST_LIST = {
     {"test_create_destroy", test_create_destroy},
     {"test_write_read_mono", test_write_read_mono},
+    {"test_reserve_shrink", test_reserve_shrink},
     {NULL, NULL},
 };
@@ -0,0 +1,98 @@
+#include "coefcache.h"
+
+static uint32_t hash(void const *const key, size_t const key_size) {
+  // FNV-1a
+  uint8_t const *const p = key;
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < key_size; ++i) {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  return h;
+}
+
+static void lock(struct coefcache *const cc) {
+  while (atomic_flag_test_and_set_explicit(&cc->lock, memory_order_acquire)) {
+  }
+}
+
+static void unlock(struct coefcache *const cc) { atomic_flag_clear_explicit(&cc->lock, memory_order_release); }
+
+static uint32_t next_stamp(struct coefcache *const cc) {
+  if (++cc->clock == 0) {
+    // wrapped around, restart the ages rather than confusing new entries with empty ones
+    for (size_t s = 0; s < coefcache_sets; ++s) {
+      for (size_t w = 0; w < coefcache_ways; ++w) {
+        if (cc->entries[s][w].stamp) {
+          cc->entries[s][w].stamp = 1;
+        }
+      }
+    }
+    cc->clock = 2;
+  }
+  return cc->clock;
+}
+
+bool coefcache_get(struct coefcache *const cc,
+                   void const *const key,
+                   size_t const key_size,
+                   void *const value,
+                   size_t const value_size) {
+  if (key_size > coefcache_max_key_size || value_size > coefcache_max_value_size) {
+    return false;
+  }
+  uint32_t const h = hash(key, key_size);
+  struct coefcache_entry *const set = cc->entries[h % coefcache_sets];
+  bool found = false;
+  lock(cc);
+  for (size_t w = 0; w < coefcache_ways; ++w) {
+    struct coefcache_entry *const e = set + w;
+    if (e->stamp && e->hash == h && memcmp(e->key, key, key_size) == 0) {
+      memcpy(value, e->value, value_size);
+      e->stamp = next_stamp(cc);
+      found = true;
+      break;
+    }
+  }
+  unlock(cc);
+  return found;
+}
+
+void coefcache_put(struct coefcache *const cc,
+                   void const *const key,
+                   size_t const key_size,
+                   void const *const value,
+                   size_t const value_size) {
+  if (key_size > coefcache_max_key_size || value_size > coefcache_max_value_size) {
+    return;
+  }
+  uint32_t const h = hash(key, key_size);
+  struct coefcache_entry *const set = cc->entries[h % coefcache_sets];
+  lock(cc);
+  struct coefcache_entry *victim = set;
+  for (size_t w = 0; w < coefcache_ways; ++w) {
+    struct coefcache_entry *const e = set + w;
+    if (e->stamp && e->hash == h && memcmp(e->key, key, key_size) == 0) {
+      victim = e;
+      break;
+    }
+    if (e->stamp < victim->stamp) {
+      victim = e; // least recently used, or empty
+    }
+  }
+  victim->hash = h;
+  memcpy(victim->key, key, key_size);
+  memcpy(victim->value, value, value_size);
+  victim->stamp = next_stamp(cc);
+  unlock(cc);
+}
+
+void coefcache_clear(struct coefcache *const cc) {
+  lock(cc);
+  for (size_t s = 0; s < coefcache_sets; ++s) {
+    for (size_t w = 0; w < coefcache_ways; ++w) {
+      cc->entries[s][w].stamp = 0;
+    }
+  }
+  cc->clock = 0;
+  unlock(cc);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "ovbase.h"
+
+#include <stdatomic.h>
+
+// A small process-wide cache for derived filter/dynamics parameters.
+// Keys and values are plain structs without padding; they are compared bytewise.
+// Access is guarded by a spinlock since lookups only happen on parameter changes
+// and the critical section is a few hundred bytes of memcmp/memcpy.
+
+enum {
+  coefcache_sets = 64,
+  coefcache_ways = 4,
+  coefcache_max_key_size = 48,
+  coefcache_max_value_size = 64,
+};
+
+struct coefcache_entry {
+  uint32_t hash;
+  uint32_t stamp; // 0 means empty
+  uint8_t key[coefcache_max_key_size];
+  uint8_t value[coefcache_max_value_size];
+};
+
+struct coefcache {
+  atomic_flag lock;
+  uint32_t clock;
+  struct coefcache_entry entries[coefcache_sets][coefcache_ways];
+};
+
+#define COEFCACHE_INIT {.lock = ATOMIC_FLAG_INIT}
+
+bool coefcache_get(struct coefcache *const cc,
+                   void const *const key,
+                   size_t const key_size,
+                   void *const value,
+                   size_t const value_size);
+void coefcache_put(struct coefcache *const cc,
+                   void const *const key,
+                   size_t const key_size,
+                   void const *const value,
+                   size_t const value_size);
+void coefcache_clear(struct coefcache *const cc);
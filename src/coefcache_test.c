@@ -0,0 +1,97 @@
+#include "coefcache.c"
+
+#include "ovtest.h"
+
+#include "ovthreads.h"
+
+struct test_key {
+  float frequency;
+  float gain;
+};
+
+struct test_value {
+  float a, b;
+};
+
+static void test_get_put(void) {
+  static struct coefcache cc = COEFCACHE_INIT;
+  struct test_key const key = {1000.f, 3.f};
+  struct test_value v = {0};
+  TEST_CHECK(!coefcache_get(&cc, &key, sizeof(key), &v, sizeof(v)));
+  coefcache_put(&cc, &key, sizeof(key), &(struct test_value){1.f, 2.f}, sizeof(v));
+  TEST_CHECK(coefcache_get(&cc, &key, sizeof(key), &v, sizeof(v)));
+  TEST_CHECK(v.a == 1.f && v.b == 2.f);
+
+  // overwrite the same key
+  coefcache_put(&cc, &key, sizeof(key), &(struct test_value){3.f, 4.f}, sizeof(v));
+  TEST_CHECK(coefcache_get(&cc, &key, sizeof(key), &v, sizeof(v)));
+  TEST_CHECK(v.a == 3.f && v.b == 4.f);
+
+  TEST_CHECK(!coefcache_get(&cc, &(struct test_key){1000.f, 3.5f}, sizeof(key), &v, sizeof(v)));
+
+  coefcache_clear(&cc);
+  TEST_CHECK(!coefcache_get(&cc, &key, sizeof(key), &v, sizeof(v)));
+}
+
+static void test_eviction(void) {
+  static struct coefcache cc = COEFCACHE_INIT;
+  enum { n = coefcache_sets * coefcache_ways * 4 };
+  for (int i = 0; i < n; ++i) {
+    struct test_key const key = {(float)i, 0.f};
+    coefcache_put(&cc, &key, sizeof(key), &(struct test_value){(float)i, (float)-i}, sizeof(struct test_value));
+  }
+  // the cache never holds more than its capacity, and every hit must return the matching value
+  int hits = 0;
+  for (int i = 0; i < n; ++i) {
+    struct test_key const key = {(float)i, 0.f};
+    struct test_value v = {0};
+    if (coefcache_get(&cc, &key, sizeof(key), &v, sizeof(v))) {
+      ++hits;
+      TEST_CHECK(v.a == (float)i && v.b == (float)-i);
+    }
+  }
+  TEST_CHECK(hits > 0 && hits <= coefcache_sets * coefcache_ways);
+  TEST_MSG("hits %d", hits);
+}
+
+static struct coefcache g_shared = COEFCACHE_INIT;
+
+static int worker(void *userdata) {
+  int const seed = *(int *)userdata;
+  int mismatch = 0;
+  for (int i = 0; i < 100000; ++i) {
+    int const k = (i * 7 + seed) % 512;
+    struct test_key const key = {(float)k, 1.f};
+    struct test_value v = {0};
+    if (coefcache_get(&g_shared, &key, sizeof(key), &v, sizeof(v))) {
+      if (v.a != (float)k || v.b != (float)(k * 2)) {
+        ++mismatch;
+      }
+    } else {
+      coefcache_put(&g_shared, &key, sizeof(key), &(struct test_value){(float)k, (float)(k * 2)}, sizeof(v));
+    }
+  }
+  return mismatch;
+}
+
+static void test_threads(void) {
+  enum { num_threads = 4 };
+  thrd_t th[num_threads];
+  int seeds[num_threads];
+  for (int i = 0; i < num_threads; ++i) {
+    seeds[i] = i * 13;
+    TEST_CHECK(thrd_create(th + i, worker, seeds + i) == thrd_success);
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    int mismatch = -1;
+    TEST_CHECK(thrd_join(th[i], &mismatch) == thrd_success);
+    TEST_CHECK(mismatch == 0);
+  }
+}
+
+TEST_LIST = {
+    {"test_get_put", test_get_put},
+    {"test_eviction", test_eviction},
+    {"test_threads", test_threads},
+    {NULL, NULL},
+};
@@ -0,0 +1,842 @@
+#include "convreverb.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <xmmintrin.h>
+
+#include "ovthreads.h"
+
+#include "fft.h"
+#include "inlines.h"
+#include "wavreader.h"
+
+enum {
+  block_size = convreverb_partition_size,
+  fft_size = block_size * 2,
+  bins = fft_size / 2,
+  spectrum_size = bins * 2, // re followed by im
+  max_ir_channels = 2,
+  max_ir_seconds = 20,
+  max_workers = 4,
+  worker_partitions = 256, // one more worker for each this many tail partitions
+  cache_max_unused = 4,
+  resample_phases = 512, // kernel table entries per input sample
+};
+
+struct convreverb_ir {
+  struct convreverb_ir *next; // in the cache
+  NATIVE_CHAR *path;          // NULL if not cached
+  float sample_rate;
+  size_t channels;
+  size_t length;
+  size_t partitions;
+  float *spectra; // [channel][partition][spectrum_size], scaled for fft_inverse
+  size_t refcount;
+};
+
+static struct {
+  once_flag once;
+  bool initialized; // whether mtx could be created, nothing is cached otherwise
+  mtx_t mtx;
+  struct convreverb_ir *head; // most recently loaded first
+} g_cache = {.once = ONCE_FLAG_INIT};
+
+static void cache_init(void) { g_cache.initialized = mtx_init(&g_cache.mtx, mtx_plain) == thrd_success; }
+
+static bool cache_ready(void) {
+  call_once(&g_cache.once, cache_init);
+  return g_cache.initialized;
+}
+
+static void cache_lock(void) { mtx_lock(&g_cache.mtx); }
+static void cache_unlock(void) { mtx_unlock(&g_cache.mtx); }
+
+static void ir_free(struct convreverb_ir *ir) {
+  if (ir->spectra) {
+    ereport(mem_aligned_free(&ir->spectra));
+  }
+  if (ir->path) {
+    ereport(mem_free(&ir->path));
+  }
+  ereport(mem_free(&ir));
+}
+
+// Unlinks unused entries beyond cache_max_unused, or all of them, and returns them as a list.
+static struct convreverb_ir *cache_unlink_unused(size_t const keep) {
+  struct convreverb_ir *freed = NULL;
+  struct convreverb_ir **pp = &g_cache.head;
+  size_t unused = 0;
+  while (*pp) {
+    struct convreverb_ir *const e = *pp;
+    if (e->refcount == 0 && ++unused > keep) {
+      *pp = e->next;
+      e->next = freed;
+      freed = e;
+      continue;
+    }
+    pp = &e->next;
+  }
+  return freed;
+}
+
+static void free_list(struct convreverb_ir *ir) {
+  while (ir) {
+    struct convreverb_ir *const next = ir->next;
+    ir_free(ir);
+    ir = next;
+  }
+}
+
+void convreverb_ir_cache_trim(void) {
+  if (!cache_ready()) {
+    return;
+  }
+  cache_lock();
+  struct convreverb_ir *const freed = cache_unlink_unused(0);
+  cache_unlock();
+  free_list(freed);
+}
+
+NODISCARD error convreverb_ir_release(struct convreverb_ir **const irp) {
+  if (!irp || !*irp) {
+    return errg(err_invalid_arugment);
+  }
+  struct convreverb_ir *const ir = *irp;
+  *irp = NULL;
+  if (!ir->path) {
+    ir_free(ir);
+    return eok();
+  }
+  cache_lock();
+  --ir->refcount;
+  struct convreverb_ir *const freed = cache_unlink_unused(cache_max_unused);
+  cache_unlock();
+  free_list(freed);
+  return eok();
+}
+
+static double sinc(double const x) {
+  static double const pi = 3.14159265358979323846264338327950288;
+  return fabs(x) < 1e-9 ? 1.0 : sin(pi * x) / (pi * x);
+}
+
+// Blackman-windowed sinc band-limited to the lower of the two rates, tabulated over [-half, half] input samples
+// with resample_phases entries per sample. Each entry is followed by the slope to the next one.
+struct resample_kernel {
+  float *table;
+  double ratio;
+  size_t half;
+};
+
+NODISCARD static error resample_kernel_init(struct resample_kernel *const k, double const ratio) {
+  static double const pi = 3.14159265358979323846264338327950288;
+  k->ratio = ratio;
+  if (fabs(ratio - 1.0) < 1e-9) {
+    return eok();
+  }
+  double const cutoff = ratio > 1.0 ? 1.0 / ratio : 1.0;
+  size_t const half = (size_t)ceil(16.0 / cutoff);
+  size_t const len = half * 2 * resample_phases + 2;
+  error err = mem(&k->table, len * 2, sizeof(float));
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  double prev = 0.0;
+  for (size_t i = 0; i < len; ++i) {
+    double const x = (double)i / (double)resample_phases - (double)half;
+    double v = 0.0;
+    if (fabs(x) <= (double)half) {
+      double const w = 0.42 + 0.5 * cos(pi * x / (double)half) + 0.08 * cos(2.0 * pi * x / (double)half);
+      v = cutoff * sinc(cutoff * x) * w;
+    }
+    k->table[i * 2] = (float)v;
+    if (i) {
+      k->table[i * 2 - 1] = (float)(v - prev);
+    }
+    prev = v;
+  }
+  k->table[len * 2 - 1] = 0.f;
+  k->half = half;
+  return eok();
+}
+
+static void resample_kernel_exit(struct resample_kernel *const k) {
+  if (k->table) {
+    ereport(mem_free(&k->table));
+  }
+}
+
+// The taps of one output sample are whole input samples apart,
+// so they all share the fractional table position and only the integer index moves.
+static void resample(struct resample_kernel const *const k,
+                     float const *restrict const input,
+                     size_t const input_len,
+                     float *restrict const output,
+                     size_t const output_len) {
+  if (fabs(k->ratio - 1.0) < 1e-9) {
+    memcpy(output, input, (input_len < output_len ? input_len : output_len) * sizeof(float));
+    return;
+  }
+  float const *restrict const table = k->table;
+  double const half = (double)k->half;
+  for (size_t i = 0; i < output_len; ++i) {
+    double const t = (double)i * k->ratio;
+    double const first = ceil(t - half);
+    size_t const end = (size_t)floor(t + half) + 1;
+    size_t const j0 = first < 0.0 ? 0 : (size_t)first;
+    // table position of input[j0], it goes down by resample_phases for every following tap
+    double const pos = (t - (double)j0 + half) * (double)resample_phases;
+    size_t idx = (size_t)pos;
+    float const frac = (float)(pos - (double)idx);
+    float sum = 0.f;
+    for (size_t j = j0; j < end && j < input_len; ++j, idx -= resample_phases) {
+      sum += input[j] * (table[idx * 2] + frac * table[idx * 2 + 1]);
+    }
+    output[i] = sum;
+  }
+}
+
+NODISCARD error convreverb_ir_create(struct convreverb_ir **const irp,
+                                     float const *const *const samples,
+                                     size_t const channels,
+                                     size_t const length,
+                                     float const source_rate,
+                                     float const sample_rate) {
+  if (!irp || *irp || !samples || channels == 0 || length == 0 || source_rate <= 0.f || sample_rate <= 0.f) {
+    return errg(err_invalid_arugment);
+  }
+  struct fft *f = NULL;
+  float *tmp = NULL;
+  struct resample_kernel kernel = {0};
+  double const ratio = (double)source_rate / (double)sample_rate;
+  size_t out_len = (size_t)ceil((double)length / ratio);
+  if (out_len > (size_t)(sample_rate * max_ir_seconds)) {
+    out_len = (size_t)(sample_rate * max_ir_seconds);
+  }
+  error err = mem(irp, 1, sizeof(struct convreverb_ir));
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  struct convreverb_ir *const ir = *irp;
+  *ir = (struct convreverb_ir){
+      .sample_rate = sample_rate,
+      .channels = channels < max_ir_channels ? channels : max_ir_channels,
+      .length = out_len,
+      .partitions = (out_len + block_size - 1) / block_size,
+      .refcount = 1,
+  };
+  err = mem_aligned_alloc(&ir->spectra, ir->channels * ir->partitions * spectrum_size, sizeof(float), 16);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  err = mem_aligned_alloc(&tmp, ir->partitions * block_size + fft_size, sizeof(float), 16);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  err = fft_create(&f, fft_size);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  err = resample_kernel_init(&kernel, ratio);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  float *const frame = tmp + ir->partitions * block_size;
+  float const scale = 1.f / (float)bins; // cancels the gain of fft_inverse
+  for (size_t ch = 0; ch < ir->channels; ++ch) {
+    memset(tmp, 0, ir->partitions * block_size * sizeof(float));
+    resample(&kernel, samples[ch], length, tmp, out_len);
+    for (size_t k = 0; k < ir->partitions; ++k) {
+      // overlap-save takes the second half of the circular convolution, so the partition goes to the first half
+      memcpy(frame, tmp + k * block_size, block_size * sizeof(float));
+      memset(frame + block_size, 0, block_size * sizeof(float));
+      float *const re = ir->spectra + (ch * ir->partitions + k) * spectrum_size;
+      float *const im = re + bins;
+      fft_forward(f, frame, re, im);
+      for (size_t i = 0; i < spectrum_size; ++i) {
+        re[i] *= scale;
+      }
+    }
+  }
+
+cleanup:
+  resample_kernel_exit(&kernel);
+  if (f) {
+    ereport(fft_destroy(&f));
+  }
+  if (tmp) {
+    ereport(mem_aligned_free(&tmp));
+  }
+  if (efailed(err)) {
+    if (*irp) {
+      ir_free(*irp);
+      *irp = NULL;
+    }
+  }
+  return err;
+}
+
+static struct convreverb_ir *cache_find(NATIVE_CHAR const *const path, float const sample_rate) {
+  for (struct convreverb_ir *e = g_cache.head; e; e = e->next) {
+    if (fcmp(e->sample_rate, ==, sample_rate, 1e-3f) && wcscmp(e->path, path) == 0) {
+      ++e->refcount;
+      return e;
+    }
+  }
+  return NULL;
+}
+
+NODISCARD static error load(struct convreverb_ir **const irp, NATIVE_CHAR const *const path, float const sample_rate) {
+  struct wavreader *w = NULL;
+  float *buf = NULL;
+  error err = wavreader_open(&w, path);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  size_t const channels = wavreader_get_channels(w) < max_ir_channels ? wavreader_get_channels(w) : max_ir_channels;
+  float const source_rate = wavreader_get_sample_rate(w);
+  size_t length = wavreader_get_samples(w);
+  if (length > (size_t)(source_rate * max_ir_seconds)) {
+    length = (size_t)(source_rate * max_ir_seconds);
+  }
+  if (length == 0) {
+    err = errg(err_invalid_arugment);
+    goto cleanup;
+  }
+  err = mem(&buf, length * channels, sizeof(float));
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  float const *planes[max_ir_channels] = {buf, buf + (channels - 1) * length};
+  for (size_t ch = 0; ch < channels; ++ch) {
+    wavreader_read(w, ch, 0, buf + ch * length, length);
+  }
+  err = convreverb_ir_create(irp, planes, channels, length, source_rate, sample_rate);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+
+cleanup:
+  if (buf) {
+    ereport(mem_free(&buf));
+  }
+  if (w) {
+    ereport(wavreader_close(&w));
+  }
+  return err;
+}
+
+NODISCARD error convreverb_ir_load(struct convreverb_ir **const irp,
+                                   NATIVE_CHAR const *const path,
+                                   float const sample_rate) {
+  if (!irp || *irp || !path) {
+    return errg(err_invalid_arugment);
+  }
+  if (!cache_ready()) {
+    return errg(err_fail);
+  }
+  cache_lock();
+  *irp = cache_find(path, sample_rate);
+  cache_unlock();
+  if (*irp) {
+    return eok();
+  }
+
+  struct convreverb_ir *ir = NULL;
+  size_t const len = wcslen(path);
+  error err = load(&ir, path, sample_rate);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  err = mem(&ir->path, len + 1, sizeof(NATIVE_CHAR));
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  memcpy(ir->path, path, (len + 1) * sizeof(NATIVE_CHAR));
+
+  cache_lock();
+  // another bus may have loaded the same file in the meantime
+  *irp = cache_find(path, sample_rate);
+  if (!*irp) {
+    ir->next = g_cache.head;
+    g_cache.head = ir;
+    *irp = ir;
+    ir = NULL;
+  }
+  cache_unlock();
+
+cleanup:
+  if (ir) {
+    ir_free(ir);
+  }
+  return err;
+}
+
+struct worker {
+  struct convreverb *r;
+  thrd_t thread;
+  mtx_t mtx;
+  cnd_t cnd;
+  size_t first; // tail partitions [first, last) are convolved by this worker
+  size_t last;
+  size_t target;      // tails of the blocks before this can be computed
+  atomic_size_t done; // tails of the blocks before this are ready
+  bool quit;
+  bool started;
+  float *acc;  // spectrum_size
+  float *time; // fft_size
+  float *tail; // [block % tail_slots][channel][block_size]
+};
+
+struct convreverb {
+  struct fft *fft;
+  struct convreverb_ir *ir;
+  struct convreverb_ir *next_ir;
+  bool next_ir_set;
+  float wet;
+  size_t channels;
+  size_t max_samples;
+
+  float *arena;
+  float *frames; // [channel][fft_size], previous block followed by the current one
+  float *out;    // [channel][block_size], output of the last block
+  float *fdl;    // [block & fdl_mask][channel][spectrum_size]
+  float *acc;
+  float *time;
+  size_t fdl_mask;
+  size_t head; // partitions convolved on the calling thread
+  size_t tail_slots;
+  struct worker *workers;
+  size_t num_workers;
+  size_t fill;
+  size_t block;
+
+  bool need_parameter_update : 1;
+  bool silent : 1;
+};
+
+static inline float *fdl_at(struct convreverb const *const r, size_t const block, size_t const ch) {
+  return r->fdl + ((block & r->fdl_mask) * r->channels + ch) * spectrum_size;
+}
+
+static inline float const *ir_at(struct convreverb_ir const *const ir, size_t const ch, size_t const partition) {
+  size_t const irch = ch < ir->channels ? ch : ir->channels - 1;
+  return ir->spectra + (irch * ir->partitions + partition) * spectrum_size;
+}
+
+static void multiply_accumulate(float *restrict const acc, float const *restrict const x, float const *restrict const h) {
+  // bin 0 packs two real values, DC and Nyquist
+  float const dc = acc[0] + x[0] * h[0];
+  float const nyquist = acc[bins] + x[bins] * h[bins];
+  for (size_t i = 0; i < bins; i += 4) {
+    __m128 const xr = _mm_load_ps(x + i);
+    __m128 const xi = _mm_load_ps(x + bins + i);
+    __m128 const hr = _mm_load_ps(h + i);
+    __m128 const hi = _mm_load_ps(h + bins + i);
+    __m128 const ar = _mm_load_ps(acc + i);
+    __m128 const ai = _mm_load_ps(acc + bins + i);
+    _mm_store_ps(acc + i, _mm_add_ps(ar, _mm_sub_ps(_mm_mul_ps(xr, hr), _mm_mul_ps(xi, hi))));
+    _mm_store_ps(acc + bins + i, _mm_add_ps(ai, _mm_add_ps(_mm_mul_ps(xr, hi), _mm_mul_ps(xi, hr))));
+  }
+  acc[0] = dc;
+  acc[bins] = nyquist;
+}
+
+// Convolves partitions [first, last) for the output of the block.
+static void convolve(struct convreverb const *const r,
+                     size_t const block,
+                     size_t const ch,
+                     size_t const first,
+                     size_t const last,
+                     float *restrict const acc,
+                     float *restrict const time) {
+  memset(acc, 0, spectrum_size * sizeof(float));
+  for (size_t k = first; k < last; ++k) {
+    // blocks before the first one wrap around to slots that are still cleared
+    multiply_accumulate(acc, fdl_at(r, block - k, ch), ir_at(r->ir, ch, k));
+  }
+  fft_inverse(r->fft, acc, acc + bins, time);
+}
+
+static int worker_main(void *userdata) {
+  struct worker *const w = userdata;
+  struct convreverb const *const r = w->r;
+  for (;;) {
+    mtx_lock(&w->mtx);
+    while (!w->quit && atomic_load_explicit(&w->done, memory_order_relaxed) == w->target) {
+      cnd_wait(&w->cnd, &w->mtx);
+    }
+    bool const quit = w->quit;
+    size_t const block = atomic_load_explicit(&w->done, memory_order_relaxed);
+    mtx_unlock(&w->mtx);
+    if (quit) {
+      break;
+    }
+    float *const tail = w->tail + (block % r->tail_slots) * r->channels * block_size;
+    for (size_t ch = 0; ch < r->channels; ++ch) {
+      convolve(r, block, ch, w->first, w->last, w->acc, w->time);
+      memcpy(tail + ch * block_size, w->time + block_size, block_size * sizeof(float));
+    }
+    mtx_lock(&w->mtx);
+    atomic_store_explicit(&w->done, block + 1, memory_order_release);
+    cnd_broadcast(&w->cnd);
+    mtx_unlock(&w->mtx);
+  }
+  return 0;
+}
+
+static void worker_request(struct worker *const w, size_t const target) {
+  mtx_lock(&w->mtx);
+  w->target = target;
+  cnd_broadcast(&w->cnd);
+  mtx_unlock(&w->mtx);
+}
+
+static void worker_wait(struct worker *const w, size_t const block) {
+  if (atomic_load_explicit(&w->done, memory_order_acquire) > block) {
+    return;
+  }
+  mtx_lock(&w->mtx);
+  while (atomic_load_explicit(&w->done, memory_order_relaxed) <= block) {
+    cnd_wait(&w->cnd, &w->mtx);
+  }
+  mtx_unlock(&w->mtx);
+}
+
+// Waits for the requested work and rewinds the worker to the state right after a clear.
+static void worker_reset(struct worker *const w, size_t const head) {
+  mtx_lock(&w->mtx);
+  while (atomic_load_explicit(&w->done, memory_order_relaxed) != w->target) {
+    cnd_wait(&w->cnd, &w->mtx);
+  }
+  // tails of the blocks before head only involve blocks before the first one
+  w->target = head;
+  atomic_store_explicit(&w->done, head, memory_order_relaxed);
+  mtx_unlock(&w->mtx);
+}
+
+static void stop_workers(struct convreverb *const r) {
+  for (size_t i = 0; i < r->num_workers; ++i) {
+    struct worker *const w = r->workers + i;
+    if (w->started) {
+      mtx_lock(&w->mtx);
+      w->quit = true;
+      cnd_broadcast(&w->cnd);
+      mtx_unlock(&w->mtx);
+      thrd_join(w->thread, NULL);
+      cnd_destroy(&w->cnd);
+      mtx_destroy(&w->mtx);
+    }
+  }
+  if (r->workers) {
+    ereport(mem_free(&r->workers));
+  }
+  r->num_workers = 0;
+}
+
+static void release_buffers(struct convreverb *const r) {
+  stop_workers(r);
+  if (r->arena) {
+    ereport(mem_aligned_free(&r->arena));
+  }
+  r->frames = NULL;
+  r->out = NULL;
+  r->fdl = NULL;
+}
+
+NODISCARD static error start_workers(struct convreverb *const r, size_t const num_workers, float *buf) {
+  error err = mem(&r->workers, num_workers, sizeof(struct worker));
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  size_t const tail = r->ir->partitions - r->head;
+  r->num_workers = num_workers;
+  for (size_t i = 0; i < num_workers; ++i) {
+    struct worker *const w = r->workers + i;
+    *w = (struct worker){
+        .r = r,
+        .first = r->head + tail * i / num_workers,
+        .last = r->head + tail * (i + 1) / num_workers,
+        .target = r->head,
+        .acc = buf,
+        .time = buf + spectrum_size,
+        .tail = buf + spectrum_size + fft_size,
+    };
+    atomic_init(&w->done, r->head);
+    buf += spectrum_size + fft_size + r->tail_slots * r->channels * block_size;
+  }
+  for (size_t i = 0; i < num_workers; ++i) {
+    struct worker *const w = r->workers + i;
+    if (mtx_init(&w->mtx, mtx_plain) != thrd_success) {
+      err = errg(err_fail);
+      return err;
+    }
+    if (cnd_init(&w->cnd) != thrd_success) {
+      mtx_destroy(&w->mtx);
+      err = errg(err_fail);
+      return err;
+    }
+    if (thrd_create(&w->thread, worker_main, w) != thrd_success) {
+      cnd_destroy(&w->cnd);
+      mtx_destroy(&w->mtx);
+      err = errg(err_fail);
+      return err;
+    }
+    w->started = true;
+  }
+  return eok();
+}
+
+NODISCARD static error allocate(struct convreverb *const r) {
+  release_buffers(r);
+  if (!r->ir || r->channels == 0) {
+    return eok();
+  }
+  size_t const partitions = r->ir->partitions;
+  size_t const head = (r->max_samples + block_size - 1) / block_size + 1;
+  r->head = head < partitions ? head : partitions;
+  r->tail_slots = r->head + 2;
+  size_t slots = 1;
+  while (slots <= partitions) {
+    slots *= 2;
+  }
+  r->fdl_mask = slots - 1;
+  size_t const tail = partitions - r->head;
+  size_t num_workers = (tail + worker_partitions - 1) / worker_partitions;
+  if (num_workers > max_workers) {
+    num_workers = max_workers;
+  }
+  size_t const worker_len = spectrum_size + fft_size + r->tail_slots * r->channels * block_size;
+  size_t const len = r->channels * (fft_size + block_size) + slots * r->channels * spectrum_size + spectrum_size +
+                     fft_size + num_workers * worker_len;
+  error err = mem_aligned_alloc(&r->arena, len, sizeof(float), 16);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  memset(r->arena, 0, len * sizeof(float));
+  r->frames = r->arena;
+  r->out = r->frames + r->channels * fft_size;
+  r->fdl = r->out + r->channels * block_size;
+  r->acc = r->fdl + slots * r->channels * spectrum_size;
+  r->time = r->acc + spectrum_size;
+  r->fill = 0;
+  r->block = 0;
+  if (num_workers) {
+    err = start_workers(r, num_workers, r->time + fft_size);
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
+  }
+cleanup:
+  if (efailed(err)) {
+    release_buffers(r);
+  }
+  return err;
+}
+
+NODISCARD error convreverb_create(struct convreverb **const rp) {
+  if (!rp || *rp) {
+    return errg(err_invalid_arugment);
+  }
+  error err = mem(rp, 1, sizeof(struct convreverb));
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  struct convreverb *const r = *rp;
+  *r = (struct convreverb){
+      .wet = 1.f,
+      .channels = 2,
+      .need_parameter_update = true,
+  };
+  err = fft_create(&r->fft, fft_size);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+cleanup:
+  if (efailed(err)) {
+    if (*rp) {
+      ereport(convreverb_destroy(rp));
+    }
+  }
+  return err;
+}
+
+NODISCARD error convreverb_destroy(struct convreverb **const rp) {
+  if (!rp || !*rp) {
+    return errg(err_invalid_arugment);
+  }
+  struct convreverb *const r = *rp;
+  release_buffers(r);
+  if (r->next_ir) {
+    ereport(convreverb_ir_release(&r->next_ir));
+  }
+  if (r->ir) {
+    ereport(convreverb_ir_release(&r->ir));
+  }
+  if (r->fft) {
+    ereport(fft_destroy(&r->fft));
+  }
+  ereport(mem_free(rp));
+  return eok();
+}
+
+void convreverb_set_format(struct convreverb *const r, size_t const channels, size_t const max_samples) {
+  if (r->channels == channels && r->max_samples == max_samples) {
+    return;
+  }
+  r->channels = channels;
+  r->max_samples = max_samples;
+  r->need_parameter_update = true;
+}
+
+void convreverb_set_ir(struct convreverb *const r, struct convreverb_ir **const irp) {
+  if (r->next_ir) {
+    ereport(convreverb_ir_release(&r->next_ir));
+  }
+  if (irp) {
+    r->next_ir = *irp;
+    *irp = NULL;
+  }
+  r->next_ir_set = true;
+  r->need_parameter_update = true;
+}
+
+void convreverb_set_wet(struct convreverb *const r, float const v) { r->wet = v; }
+
+NODISCARD error convreverb_update_internal_parameter(struct convreverb *const r, bool *const updated) {
+  if (!r->need_parameter_update) {
+    if (updated) {
+      *updated = false;
+    }
+    return eok();
+  }
+  if (r->next_ir_set) {
+    release_buffers(r);
+    if (r->ir) {
+      ereport(convreverb_ir_release(&r->ir));
+    }
+    r->ir = r->next_ir;
+    r->next_ir = NULL;
+    r->next_ir_set = false;
+  }
+  error err = allocate(r);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  r->silent = false;
+  r->need_parameter_update = false;
+  if (updated) {
+    *updated = true;
+  }
+  return eok();
+}
+
+float convreverb_get_tail_duration(struct convreverb const *const r) {
+  if (!r->ir) {
+    return 0.f;
+  }
+  return (float)(r->ir->length + block_size) / r->ir->sample_rate;
+}
+
+static void process_block(struct convreverb *const r) {
+  size_t const block = r->block;
+  size_t const channels = r->channels;
+  for (size_t ch = 0; ch < channels; ++ch) {
+    float *const frame = r->frames + ch * fft_size;
+    float *const x = fdl_at(r, block, ch);
+    fft_forward(r->fft, frame, x, x + bins);
+    memcpy(frame, frame + block_size, block_size * sizeof(float));
+  }
+  // the tail of block + head only needs the spectra up to this block
+  for (size_t i = 0; i < r->num_workers; ++i) {
+    worker_request(r->workers + i, block + r->head + 1);
+  }
+  for (size_t ch = 0; ch < channels; ++ch) {
+    convolve(r, block, ch, 0, r->head, r->acc, r->time);
+    memcpy(r->out + ch * block_size, r->time + block_size, block_size * sizeof(float));
+  }
+  for (size_t i = 0; i < r->num_workers; ++i) {
+    struct worker *const w = r->workers + i;
+    worker_wait(w, block);
+    float const *const tail = w->tail + (block % r->tail_slots) * channels * block_size;
+    for (size_t ch = 0; ch < channels; ++ch) {
+      float *restrict const o = r->out + ch * block_size;
+      float const *restrict const t = tail + ch * block_size;
+      for (size_t j = 0; j < block_size; ++j) {
+        o[j] += t[j];
+      }
+    }
+  }
+  r->block = block + 1;
+}
+
+void convreverb_process(struct convreverb *const r,
+                        float const *restrict const *const inputs,
+                        float *restrict const *const outputs,
+                        size_t const samples) {
+  r->silent = false;
+  if (!r->arena) {
+    clear(outputs, r->channels, samples);
+    return;
+  }
+  float const wet = r->wet;
+  size_t pos = 0;
+  while (pos < samples) {
+    size_t const n = block_size - r->fill < samples - pos ? block_size - r->fill : samples - pos;
+    for (size_t ch = 0; ch < r->channels; ++ch) {
+      memcpy(r->frames + ch * fft_size + block_size + r->fill, inputs[ch] + pos, n * sizeof(float));
+      float const *restrict const o = r->out + ch * block_size + r->fill;
+      float *restrict const dest = outputs[ch] + pos;
+      for (size_t i = 0; i < n; ++i) {
+        dest[i] = o[i] * wet;
+      }
+    }
+    r->fill += n;
+    pos += n;
+    if (r->fill == block_size) {
+      process_block(r);
+      r->fill = 0;
+    }
+  }
+}
+
+void convreverb_clear(struct convreverb *const r) {
+  if (!r->arena) {
+    return;
+  }
+  for (size_t i = 0; i < r->num_workers; ++i) {
+    worker_reset(r->workers + i, r->head);
+  }
+  memset(r->frames, 0, r->channels * (fft_size + block_size) * sizeof(float));
+  memset(r->fdl, 0, (r->fdl_mask + 1) * r->channels * spectrum_size * sizeof(float));
+  for (size_t i = 0; i < r->num_workers; ++i) {
+    memset(r->workers[i].tail, 0, r->tail_slots * r->channels * block_size * sizeof(float));
+  }
+  r->fill = 0;
+  r->block = 0;
+}
+
+void convreverb_silence(struct convreverb *const r, size_t const samples) {
+  (void)samples;
+  if (!r->silent) {
+    convreverb_clear(r);
+    r->silent = true;
+  }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "ovbase.h"
+
+enum {
+  convreverb_partition_size = 256, // also the output latency in samples
+};
+
+struct convreverb_ir;
+
+// Impulse response split into frequency-domain partitions ready for the convolution.
+// Responses loaded from files are cached per file and sample rate, buses using the same file share one copy,
+// and returning to a rate that was used before does not decode and transform the file again.
+NODISCARD error convreverb_ir_load(struct convreverb_ir **const irp,
+                                   NATIVE_CHAR const *const path,
+                                   float const sample_rate);
+// Builds an uncached response from planar samples, resampling from source_rate to sample_rate.
+NODISCARD error convreverb_ir_create(struct convreverb_ir **const irp,
+                                     float const *const *const samples,
+                                     size_t const channels,
+                                     size_t const length,
+                                     float const source_rate,
+                                     float const sample_rate);
+NODISCARD error convreverb_ir_release(struct convreverb_ir **const irp);
+// Frees cached responses that are no longer used by any reverb.
+void convreverb_ir_cache_trim(void);
+
+struct convreverb;
+
+// Uniformly partitioned overlap-save convolution with a frequency-domain delay line.
+// The partitions needed by the next max_samples are convolved on the calling thread,
+// the rest of the tail is convolved ahead of time on worker threads.
+NODISCARD error convreverb_create(struct convreverb **const rp);
+NODISCARD error convreverb_destroy(struct convreverb **const rp);
+
+void convreverb_set_format(struct convreverb *const r, size_t const channels, size_t const max_samples);
+// Takes the ownership of *irp, NULL removes the response. It is swapped in on the next parameter update.
+void convreverb_set_ir(struct convreverb *const r, struct convreverb_ir **const irp);
+void convreverb_set_wet(struct convreverb *const r, float const v);
+
+NODISCARD error convreverb_update_internal_parameter(struct convreverb *const r, bool *const updated);
+
+// Seconds the output continues after the input became silent, including the latency.
+float convreverb_get_tail_duration(struct convreverb const *const r);
+
+void convreverb_process(struct convreverb *const r,
+                        float const *restrict const *const inputs,
+                        float *restrict const *const outputs,
+                        size_t const samples);
+void convreverb_clear(struct convreverb *const r);
+// Equivalent to processing samples of silence after the tail has died out, the state is cleared on the first call.
+void convreverb_silence(struct convreverb *const r, size_t const samples);
@@ -0,0 +1,206 @@
+#include "convreverb.c"
+
+#include "ovtest.h"
+
+enum {
+  test_samples = 48000 * 2,
+  test_ir_samples = 48000 * 3,
+  test_max_samples = 1600,
+};
+
+static float g_input[2][test_samples];
+static float g_output[2][test_samples];
+static float g_reference[2][test_samples];
+static float g_ir[2][test_ir_samples];
+
+static void generate_noise(float *const p, size_t const n, uint32_t t) {
+  static float const divider = 1.f / (float)(UINT32_MAX);
+  for (size_t i = 0; i < n; ++i) {
+    p[i] = (float)(ov_splitmix32(t)) * divider * 2.f - 1.f;
+    t = ov_splitmix32_next(t);
+  }
+}
+
+// decaying noise, like a real room
+static void generate_ir(size_t const len) {
+  for (size_t ch = 0; ch < 2; ++ch) {
+    generate_noise(g_ir[ch], len, (uint32_t)(get_global_hint() + ch));
+    for (size_t i = 0; i < len; ++i) {
+      g_ir[ch][i] *= expf(-4.f * (float)i / (float)len);
+    }
+  }
+}
+
+static struct convreverb *create(size_t const ir_len, size_t const max_samples) {
+  struct convreverb *r = NULL;
+  struct convreverb_ir *ir = NULL;
+  float const *irs[2] = {g_ir[0], g_ir[1]};
+  TEST_SUCCEEDED_F(convreverb_create(&r));
+  TEST_SUCCEEDED_F(convreverb_ir_create(&ir, irs, 2, ir_len, 48000.f, 48000.f));
+  convreverb_set_format(r, 2, max_samples);
+  convreverb_set_ir(r, &ir);
+  TEST_SUCCEEDED_F(convreverb_update_internal_parameter(r, NULL));
+  return r;
+}
+
+static void process(struct convreverb *const r, float *const *const outputs, size_t const block) {
+  for (size_t pos = 0; pos < test_samples; pos += block) {
+    size_t const n = test_samples - pos < block ? test_samples - pos : block;
+    float const *in[2] = {g_input[0] + pos, g_input[1] + pos};
+    float *out[2] = {outputs[0] + pos, outputs[1] + pos};
+    convreverb_process(r, (float const *restrict const *)in, (float *restrict const *)out, n);
+  }
+}
+
+// An impulse must reproduce the whole response after the latency, including the partitions on the workers.
+static void test_impulse(void) {
+  generate_ir(test_ir_samples);
+  struct convreverb *r = create(test_ir_samples, test_max_samples);
+  TEST_CHECK(r->num_workers > 1);
+  memset(g_input, 0, sizeof(g_input));
+  g_input[0][0] = 1.f;
+  g_input[1][0] = 1.f;
+  float *out[2] = {g_output[0], g_output[1]};
+  process(r, out, test_max_samples);
+  float max_diff = 0.f;
+  for (size_t ch = 0; ch < 2; ++ch) {
+    for (size_t i = 0; i < test_samples; ++i) {
+      float const expected = i < block_size ? 0.f : g_ir[ch][i - block_size];
+      max_diff = fmaxf(max_diff, fabsf(g_output[ch][i] - expected));
+    }
+  }
+  TEST_CHECK(max_diff < 1e-5f);
+  TEST_MSG("max diff %g", (double)max_diff);
+  TEST_SUCCEEDED_F(convreverb_destroy(&r));
+}
+
+static void test_match_direct(void) {
+  enum { ir_len = 6000, check_len = 24000 };
+  generate_ir(ir_len);
+  generate_noise(g_input[0], test_samples, 1);
+  generate_noise(g_input[1], test_samples, 2);
+  struct convreverb *r = create(ir_len, 1024);
+  float *out[2] = {g_output[0], g_output[1]};
+  process(r, out, 1000);
+  float max_diff = 0.f;
+  for (size_t ch = 0; ch < 2; ++ch) {
+    for (size_t i = block_size; i < check_len; ++i) {
+      double sum = 0.0;
+      size_t const t = i - block_size;
+      for (size_t j = 0; j < ir_len && j <= t; ++j) {
+        sum += (double)g_ir[ch][j] * (double)g_input[ch][t - j];
+      }
+      max_diff = fmaxf(max_diff, fabsf(g_output[ch][i] - (float)sum));
+    }
+  }
+  TEST_CHECK(max_diff < 1e-3f);
+  TEST_MSG("max diff %g", (double)max_diff);
+  TEST_SUCCEEDED_F(convreverb_destroy(&r));
+}
+
+static void test_block_sizes(void) {
+  static size_t const blocks[] = {1, 255, 256, 257, 1600};
+  generate_ir(test_ir_samples);
+  generate_noise(g_input[0], test_samples, 3);
+  generate_noise(g_input[1], test_samples, 4);
+  struct convreverb *r = create(test_ir_samples, test_max_samples);
+  float *ref[2] = {g_reference[0], g_reference[1]};
+  float *out[2] = {g_output[0], g_output[1]};
+  process(r, ref, test_max_samples);
+  for (size_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); ++b) {
+    convreverb_clear(r);
+    process(r, out, blocks[b]);
+    TEST_CHECK(memcmp(g_output, g_reference, sizeof(g_output)) == 0);
+    TEST_MSG("block size %zu", blocks[b]);
+  }
+  convreverb_silence(r, test_max_samples);
+  memset(g_input, 0, sizeof(g_input));
+  process(r, out, test_max_samples);
+  float const *o[2] = {g_output[0], g_output[1]};
+  TEST_CHECK(find_peak(o, 2, test_samples) <= 0.f);
+  TEST_SUCCEEDED_F(convreverb_destroy(&r));
+}
+
+// The response must keep its level and length when it is converted to another rate.
+static void test_resample(void) {
+  enum { len = 4410 };
+  for (size_t i = 0; i < len; ++i) {
+    g_ir[0][i] = 1.f;
+  }
+  struct convreverb_ir *ir = NULL;
+  float const *irs[1] = {g_ir[0]};
+  TEST_SUCCEEDED_F(convreverb_ir_create(&ir, irs, 1, len, 44100.f, 48000.f));
+  TEST_CHECK(ir->length == 4800);
+  struct convreverb *r = NULL;
+  TEST_SUCCEEDED_F(convreverb_create(&r));
+  convreverb_set_format(r, 1, test_max_samples);
+  convreverb_set_ir(r, &ir);
+  TEST_SUCCEEDED_F(convreverb_update_internal_parameter(r, NULL));
+  TEST_CHECK(fcmp(convreverb_get_tail_duration(r), ==, (4800.f + 256.f) / 48000.f, 1e-6f));
+  memset(g_input, 0, sizeof(g_input));
+  g_input[0][0] = 1.f;
+  float *out[1] = {g_output[0]};
+  for (size_t pos = 0; pos < 8000; pos += 1000) {
+    float const *in[1] = {g_input[0] + pos};
+    float *o[1] = {out[0] + pos};
+    convreverb_process(r, (float const *restrict const *)in, (float *restrict const *)o, 1000);
+  }
+  for (size_t i = block_size + 100; i < block_size + 4700; ++i) {
+    TEST_CHECK(fabsf(g_output[0][i] - 1.f) < 1e-2f);
+  }
+  TEST_CHECK(fabsf(g_output[0][block_size + 4900]) < 1e-3f);
+  TEST_SUCCEEDED_F(convreverb_destroy(&r));
+}
+
+// The tabulated kernel must match the windowed sinc it was computed from.
+static void test_resample_kernel(void) {
+  static double const pi = 3.14159265358979323846264338327950288;
+  static double const ratios[] = {44100.0 / 48000.0, 48000.0 / 44100.0, 96000.0 / 44100.0, 0.5};
+  enum { len = 2000 };
+  generate_noise(g_ir[0], len, 7);
+  for (size_t r = 0; r < sizeof(ratios) / sizeof(ratios[0]); ++r) {
+    double const ratio = ratios[r];
+    struct resample_kernel k = {0};
+    TEST_SUCCEEDED_F(resample_kernel_init(&k, ratio));
+    size_t const out_len = (size_t)ceil((double)len / ratio);
+    resample(&k, g_ir[0], len, g_output[0], out_len);
+    double const cutoff = ratio > 1.0 ? 1.0 / ratio : 1.0;
+    double const half = ceil(16.0 / cutoff);
+    float maxdiff = 0.f;
+    for (size_t i = 0; i < out_len; ++i) {
+      double const t = (double)i * ratio;
+      double const first = ceil(t - half);
+      size_t const end = (size_t)floor(t + half) + 1;
+      double sum = 0.0;
+      for (size_t j = first < 0.0 ? 0 : (size_t)first; j < end && j < len; ++j) {
+        double const x = t - (double)j;
+        double const w = 0.42 + 0.5 * cos(pi * x / half) + 0.08 * cos(2.0 * pi * x / half);
+        sum += (double)g_ir[0][j] * cutoff * sinc(cutoff * x) * w;
+      }
+      maxdiff = fmaxf(maxdiff, fabsf(g_output[0][i] - (float)sum));
+    }
+    TEST_CHECK(maxdiff < 1e-4f);
+    TEST_MSG("ratio %g: max deviation %g", ratio, (double)maxdiff);
+    resample_kernel_exit(&k);
+  }
+}
+
+static void bench_process(void) {
+  generate_ir(test_ir_samples);
+  generate_noise(g_input[0], test_samples, 5);
+  generate_noise(g_input[1], test_samples, 6);
+  struct convreverb *r = create(test_ir_samples, test_max_samples);
+  float *out[2] = {g_output[0], g_output[1]};
+  process(r, out, test_max_samples);
+  TEST_SUCCEEDED_F(convreverb_destroy(&r));
+}
+
+TEST_LIST = {
+    {"test_impulse", test_impulse},
+    {"test_match_direct", test_match_direct},
+    {"test_block_sizes", test_block_sizes},
+    {"test_resample", test_resample},
+    {"test_resample_kernel", test_resample_kernel},
+    {"bench_process", bench_process},
+    {NULL, NULL},
+};
@@ -9,6 +9,7 @@ NODISCARD error dither_create(struct dither *const d, size_t const channels) {
     err = ethru(err);
     return err;
   }
+  d->len = channels;
   dither_reset(d);
   return eok();
 }
@@ -29,5 +30,24 @@ void dither_reset(struct dither *const d) {
   if (!d) {
     return;
   }
-  memset(d->ptr, 0, sizeof(struct dither_state) * d->len);
+  // xorshift never leaves zero, so every lane gets its own non-zero seed
+  uint32_t seed = 0x2545f491;
+  for (size_t ch = 0; ch < d->len; ++ch) {
+    struct dither_state *const ds = d->ptr + ch;
+    for (size_t lane = 0; lane < dither_lanes; ++lane) {
+      ds->rng[lane] = ov_splitmix32(seed) | 1;
+      seed = ov_splitmix32_next(seed);
+    }
+    ds->err[0] = ds->err[1] = 0.f;
+  }
+}
+
+void dither_set_shaping(struct dither *const d, int const shaping) {
+  if (!d) {
+    return;
+  }
+  d->shaping = shaping;
+  for (size_t ch = 0; ch < d->len; ++ch) {
+    d->ptr[ch].err[0] = d->ptr[ch].err[1] = 0.f;
+  }
 }
@@ -4,34 +4,156 @@
 
 #include <math.h>
 
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+#if defined(__AVX2__) || defined(__AVX512F__)
+#  include <immintrin.h>
+#endif
+
+enum {
+  dither_lanes = 4,
+};
+
+enum dither_shaping {
+  dither_shaping_none,
+  dither_shaping_second_order, // error feedback through (1 - z^-1)^2, moves the noise toward Nyquist
+};
+
+// Each channel has one generator per SIMD lane, sample i of a span always draws from lane i % dither_lanes,
+// so the vector and scalar paths produce the same noise.
 struct dither_state {
-  float sample;
+  uint32_t rng[dither_lanes];
+  float err[2]; // last two quantization errors, only used by the noise shaping
 };
 
 struct dither {
   struct dither_state *ptr;
   size_t len;
   size_t cap;
-  uint32_t seed;
+  int shaping;
 };
 
 NODISCARD error dither_create(struct dither *const d, size_t const channels);
 NODISCARD error dither_destroy(struct dither *const d);
 
 void dither_reset(struct dither *const d);
+void dither_set_shaping(struct dither *const d, int const shaping);
+
+// Samples at or below -144 dB are digital silence and stay silent.
+static float const dither_threshold = 0.000000063095734f;
+
+static inline uint32_t dither_xorshift32(uint32_t x) {
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+// The difference of the two 16-bit halves is triangular in (-1, 1) LSB.
+static inline float dither_tpdf(uint32_t const r) {
+  static float const m = 1.f / 65536.f;
+  return (float)((int32_t)(r & 0xffff) - (int32_t)(r >> 16)) * m;
+}
+
+// Quantizes x, already clipped to [-1, 1], to a dithered int16 with the generator of the given lane.
+static inline int16_t dither_quantize(float const x, struct dither_state *const ds, size_t const lane) {
+  uint32_t const r = dither_xorshift32(ds->rng[lane]);
+  ds->rng[lane] = r;
+  float y = x * 32767.f;
+  if (fabsf(x) > dither_threshold) {
+    y += dither_tpdf(r);
+  }
+  return (int16_t)lrintf(fminf(fmaxf(y, -32768.f), 32767.f));
+}
 
-static inline float dither_process(float x, struct dither *const d, size_t const channel, float const scale) {
-  uint32_t const seed = d->seed;
-  float const thr = 0.000000063095734f; // -144db
-  if (fabsf(x) > thr) {
-    struct dither_state *const ds = d->ptr + channel;
-    static float const divider = 1.f / (float)(UINT32_MAX);
-    float v = (float)(ov_splitmix32(seed))*divider - 0.5f;
-    x = x * (scale - 1.f) + (v - ds->sample);
-    ds->sample = v;
-  } else {
-    x = x * scale;
+// The same with the error feedback of dither_shaping_second_order, lane 0 of each channel drives it.
+static inline int16_t dither_quantize_shaped(float const x, struct dither_state *const ds) {
+  uint32_t const r = dither_xorshift32(ds->rng[0]);
+  ds->rng[0] = r;
+  if (fabsf(x) <= dither_threshold) {
+    ds->err[0] = ds->err[1] = 0.f;
+    return 0;
   }
-  d->seed = ov_splitmix32_next(seed);
+  float const v = x * 32767.f - (2.f * ds->err[0] - ds->err[1]);
+  float const q = fminf(fmaxf(rintf(v + dither_tpdf(r)), -32768.f), 32767.f);
+  ds->err[1] = ds->err[0];
+  ds->err[0] = q - v;
+  return (int16_t)q;
+}
+
+#ifdef __SSE2__
+static inline __m128i dither_xorshift32_sse2(__m128i x) {
+  x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+  x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+  x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
   return x;
 }
+
+static inline __m128 dither_tpdf_sse2(__m128i const r) {
+  __m128i const d = _mm_sub_epi32(_mm_and_si128(r, _mm_set1_epi32(0xffff)), _mm_srli_epi32(r, 16));
+  return _mm_mul_ps(_mm_cvtepi32_ps(d), _mm_set1_ps(1.f / 65536.f));
+}
+
+// Four consecutive samples of one channel, clipped to [-1, 1], to dithered int32 with round to nearest.
+// Out of range results are left for the saturating pack.
+static inline __m128i dither_quantize_sse2(__m128 const x, __m128i *const rng) {
+  *rng = dither_xorshift32_sse2(*rng);
+  __m128 const mag = _mm_andnot_ps(_mm_set1_ps(-0.f), x);
+  __m128 const noise = _mm_and_ps(dither_tpdf_sse2(*rng), _mm_cmpgt_ps(mag, _mm_set1_ps(dither_threshold)));
+  return _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(32767.f)), noise));
+}
+
+// One frame of up to four channels in the lanes with the error feedback of dither_shaping_second_order.
+static inline __m128i
+dither_quantize_shaped_sse2(__m128 const x, __m128i *const rng, __m128 *const e0, __m128 *const e1) {
+  *rng = dither_xorshift32_sse2(*rng);
+  __m128 const mag = _mm_andnot_ps(_mm_set1_ps(-0.f), x);
+  __m128 const active = _mm_cmpgt_ps(mag, _mm_set1_ps(dither_threshold));
+  __m128 const v = _mm_sub_ps(_mm_mul_ps(x, _mm_set1_ps(32767.f)), _mm_sub_ps(_mm_add_ps(*e0, *e0), *e1));
+  __m128 const q = _mm_and_ps(
+      _mm_min_ps(_mm_max_ps(_mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_add_ps(v, dither_tpdf_sse2(*rng)))),
+                            _mm_set1_ps(-32768.f)),
+                 _mm_set1_ps(32767.f)),
+      active);
+  *e1 = _mm_and_ps(*e0, active);
+  *e0 = _mm_and_ps(_mm_sub_ps(q, v), active);
+  return _mm_cvtps_epi32(q);
+}
+#endif
+
+#ifdef __AVX2__
+// Eight consecutive samples of one channel, the same noise as two calls of dither_quantize_sse2:
+// the lanes of the generator are stepped twice and the low half takes the first draw.
+static inline __m256i dither_quantize_avx2(__m256 const x, __m128i *const rng) {
+  __m128i const r0 = dither_xorshift32_sse2(*rng);
+  __m128i const r1 = dither_xorshift32_sse2(r0);
+  *rng = r1;
+  __m256i const r = _mm256_inserti128_si256(_mm256_castsi128_si256(r0), r1, 1);
+  __m256i const d = _mm256_sub_epi32(_mm256_and_si256(r, _mm256_set1_epi32(0xffff)), _mm256_srli_epi32(r, 16));
+  __m256 const tpdf = _mm256_mul_ps(_mm256_cvtepi32_ps(d), _mm256_set1_ps(1.f / 65536.f));
+  __m256 const mag = _mm256_andnot_ps(_mm256_set1_ps(-0.f), x);
+  __m256 const noise = _mm256_and_ps(tpdf, _mm256_cmp_ps(mag, _mm256_set1_ps(dither_threshold), _CMP_GT_OQ));
+  return _mm256_cvtps_epi32(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(32767.f)), noise));
+}
+#endif
+
+#ifdef __AVX512F__
+// Sixteen consecutive samples of one channel, the same noise as four calls of dither_quantize_sse2.
+static inline __m512i dither_quantize_avx512(__m512 const x, __m128i *const rng) {
+  __m128i const r0 = dither_xorshift32_sse2(*rng);
+  __m128i const r1 = dither_xorshift32_sse2(r0);
+  __m128i const r2 = dither_xorshift32_sse2(r1);
+  __m128i const r3 = dither_xorshift32_sse2(r2);
+  *rng = r3;
+  __m512i r = _mm512_castsi128_si512(r0);
+  r = _mm512_inserti32x4(r, r1, 1);
+  r = _mm512_inserti32x4(r, r2, 2);
+  r = _mm512_inserti32x4(r, r3, 3);
+  __m512i const d = _mm512_sub_epi32(_mm512_and_si512(r, _mm512_set1_epi32(0xffff)), _mm512_srli_epi32(r, 16));
+  __m512 const tpdf = _mm512_mul_ps(_mm512_cvtepi32_ps(d), _mm512_set1_ps(1.f / 65536.f));
+  __mmask16 const active = _mm512_cmp_ps_mask(_mm512_abs_ps(x), _mm512_set1_ps(dither_threshold), _CMP_GT_OQ);
+  __m512 const noise = _mm512_maskz_mov_ps(active, tpdf);
+  return _mm512_cvtps_epi32(_mm512_add_ps(_mm512_mul_ps(x, _mm512_set1_ps(32767.f)), noise));
+}
+#endif
@@ -28,8 +28,23 @@
 
 #include <math.h>
 
+#include "chspec.h"
+#include "coefcache.h"
 #include "inlines.h"
 
+struct rms_window {
+  float *ptr;
+  size_t len;
+  size_t cap;
+  size_t cur;
+  double sum;     // double so that loud values leaving the window do not swamp quiet ones in it
+  double lap_sum; // sum of the values pushed since cur was last 0
+  float scale;
+};
+
+// dynamics_set_format reserves the RMS window for this duration, so changing the window never allocates.
+static float const rms_window_max_duration = 0.5f;
+
 struct dynamics {
   float thresh;
   float ratio;
@@ -41,23 +56,40 @@ struct dynamics {
   float gate_attack;
   float gate_decay;
   float fx_mix;
+  float rms_window_duration;
+  int detector;
 
   float thr, rat, env, env2, att, rel, trim, lthr, xthr, xrat, dry;
   float genv, gatt, irel;
+  struct rms_window rms;
+
+  size_t control_interval;
+  float ctl_att, ctl_rel, ctl_gatt, ctl_xrat;
+  float vca;
+  bool vca_valid;
 
   float sample_rate;
   size_t channels;
+  size_t channel_kernel; // index into channel_kernels, chosen by dynamics_set_format
   bool use_gate_limiter;
   bool need_parameter_update;
 };
 
-void dynamics_set_format(struct dynamics *const d, float const sample_rate, size_t const channels) {
+NODISCARD error dynamics_set_format(struct dynamics *const d, float const sample_rate, size_t const channels) {
+  float const max_samples = ceilf(rms_window_max_duration * sample_rate);
+  error err = agrow(&d->rms, max_samples < 1.f ? 1 : (size_t)max_samples);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
   if (fcmp(d->sample_rate, ==, sample_rate, 1e-12f) && d->channels == channels) {
-    return;
+    return eok();
   }
   d->need_parameter_update = true;
   d->sample_rate = sample_rate;
   d->channels = channels;
+  d->channel_kernel = chspec_index(channels);
+  return eok();
 }
 
 void dynamics_set_thresh(struct dynamics *const d, float const v) {
@@ -142,7 +174,169 @@ void dynamics_set_fx_mix(struct dynamics *const d, float const v) {
   d->fx_mix = v;
 }
 
+void dynamics_set_detector(struct dynamics *const d, int const v) {
+  if (d->detector == v) {
+    return;
+  }
+  d->need_parameter_update = true;
+  d->detector = v;
+}
+
+void dynamics_set_rms_window(struct dynamics *const d, float const v) {
+  if (fcmp(d->rms_window_duration, ==, v, 1e-12f)) {
+    return;
+  }
+  d->need_parameter_update = true;
+  d->rms_window_duration = v;
+}
+
+void dynamics_set_control_interval(struct dynamics *const d, size_t const samples) {
+  size_t const v = samples >= 8 ? 8 : samples >= 4 ? 4 : 1;
+  if (d->control_interval == v) {
+    return;
+  }
+  d->need_parameter_update = true;
+  d->control_interval = v;
+  d->vca_valid = false;
+}
+
+static void rms_window_clear(struct rms_window *const w) {
+  if (w->ptr) {
+    memset(w->ptr, 0, w->len * sizeof(float));
+  }
+  w->cur = 0;
+  w->sum = 0.0;
+  w->lap_sum = 0.0;
+}
+
+// Pushes a mean square value into the window and returns the RMS of the window.
+// The sum is maintained incrementally, so the cost does not depend on the window length.
+static inline float rms_window_push(struct rms_window *const w, float const sq) {
+  float *restrict const ptr = w->ptr;
+  size_t cur = w->cur;
+  double sum = w->sum + (double)sq - (double)ptr[cur];
+  double lap_sum = w->lap_sum + (double)sq;
+  ptr[cur] = sq;
+  if (++cur == w->len) {
+    // after a full lap the window holds exactly the values pushed during it,
+    // taking their plain sum cancels the rounding errors accumulated in the running sum.
+    cur = 0;
+    sum = lap_sum;
+    lap_sum = 0.0;
+  }
+  w->cur = cur;
+  w->sum = sum;
+  w->lap_sum = lap_sum;
+  return sqrtf(fmaxf((float)sum, 0.f) * w->scale);
+}
+
+// The window is only kept while the RMS detector is selected, switching to it always starts from an empty window
+// so that history from before the peak detector ran is not replayed.
+static void update_rms_window(struct dynamics *const d) {
+  size_t len = 0;
+  if (d->detector == dynamics_detector_rms) {
+    float const samples = roundf(d->rms_window_duration * d->sample_rate);
+    len = samples < 1.f ? 1 : (size_t)samples;
+    if (len > d->rms.cap) {
+      len = d->rms.cap;
+    }
+  }
+  if (d->rms.len == len) {
+    return;
+  }
+  d->rms.len = len;
+  d->rms.scale = len ? 1.f / (float)len : 0.f;
+  rms_window_clear(&d->rms);
+}
+
+struct cache_key {
+  float thresh;
+  float ratio;
+  float output;
+  float attack;
+  float release;
+  float limiter;
+  float gate_thresh;
+  float gate_attack;
+  float gate_decay;
+  float fx_mix;
+  float sample_rate;
+  uint32_t control_interval;
+};
+
+struct cache_value {
+  float thr, rat, att, rel, trim, lthr, xthr, xrat, dry, gatt, irel;
+  float ctl_att, ctl_rel, ctl_gatt, ctl_xrat;
+  uint32_t use_gate_limiter;
+};
+
+static struct coefcache g_cache = COEFCACHE_INIT;
+
+static bool load_cached_parameter(struct dynamics *const d, struct cache_key const *const key) {
+  struct cache_value v;
+  if (!coefcache_get(&g_cache, key, sizeof(*key), &v, sizeof(v))) {
+    return false;
+  }
+  d->thr = v.thr;
+  d->rat = v.rat;
+  d->att = v.att;
+  d->rel = v.rel;
+  d->trim = v.trim;
+  d->lthr = v.lthr;
+  d->xthr = v.xthr;
+  d->xrat = v.xrat;
+  d->dry = v.dry;
+  d->gatt = v.gatt;
+  d->irel = v.irel;
+  d->ctl_att = v.ctl_att;
+  d->ctl_rel = v.ctl_rel;
+  d->ctl_gatt = v.ctl_gatt;
+  d->ctl_xrat = v.ctl_xrat;
+  d->use_gate_limiter = v.use_gate_limiter != 0;
+  return true;
+}
+
+static void store_cached_parameter(struct dynamics const *const d, struct cache_key const *const key) {
+  struct cache_value const v = {
+      .thr = d->thr,
+      .rat = d->rat,
+      .att = d->att,
+      .rel = d->rel,
+      .trim = d->trim,
+      .lthr = d->lthr,
+      .xthr = d->xthr,
+      .xrat = d->xrat,
+      .dry = d->dry,
+      .gatt = d->gatt,
+      .irel = d->irel,
+      .ctl_att = d->ctl_att,
+      .ctl_rel = d->ctl_rel,
+      .ctl_gatt = d->ctl_gatt,
+      .ctl_xrat = d->ctl_xrat,
+      .use_gate_limiter = d->use_gate_limiter ? 1 : 0,
+  };
+  coefcache_put(&g_cache, key, sizeof(*key), &v, sizeof(v));
+}
+
 static void update_internal_parameter(struct dynamics *const d) {
+  update_rms_window(d);
+  struct cache_key const key = {
+      .thresh = d->thresh,
+      .ratio = d->ratio,
+      .output = d->output,
+      .attack = d->attack,
+      .release = d->release,
+      .limiter = d->limiter,
+      .gate_thresh = d->gate_thresh,
+      .gate_attack = d->gate_attack,
+      .gate_decay = d->gate_decay,
+      .fx_mix = d->fx_mix,
+      .sample_rate = d->sample_rate,
+      .control_interval = (uint32_t)d->control_interval,
+  };
+  if (load_cached_parameter(d, &key)) {
+    return;
+  }
   d->use_gate_limiter = false;
   d->thr = powf(10.f, 2.f * d->thresh - 2.f);
   d->rat = 2.5f * d->ratio - 0.5f;
@@ -181,6 +375,14 @@ static void update_internal_parameter(struct dynamics *const d) {
 
   d->dry = 1.0f - d->fx_mix;
   d->trim *= d->fx_mix; // fx mix
+
+  // coefficients that advance the envelopes by control_interval samples at once
+  float const n = (float)d->control_interval;
+  d->ctl_att = 1.f - powf(1.f - d->att, n);
+  d->ctl_rel = powf(1.f - d->rel, n);
+  d->ctl_gatt = 1.f - powf(1.f - d->gatt, n);
+  d->ctl_xrat = powf(d->xrat, n);
+  store_cached_parameter(d, &key);
 }
 
 void dynamics_update_internal_parameter(struct dynamics *const d, bool *const updated) {
@@ -293,6 +495,10 @@ void dynamics_get_threshold_str(struct dynamics const *const d, NATIVE_CHAR dest
   write_str(dest, ov_itoa(v, tmp));
 }
 
+void dynamics_get_detector_str(struct dynamics const *const d, NATIVE_CHAR dest[16]) {
+  write_str(dest, d->detector == dynamics_detector_rms ? NSTR("RMS") : NSTR("Peak"));
+}
+
 NODISCARD error dynamics_create(struct dynamics **const dp) {
   if (!dp || *dp) {
     return errg(err_invalid_arugment);
@@ -313,13 +519,23 @@ NODISCARD error dynamics_create(struct dynamics **const dp) {
       .gate_attack = 0.10f,
       .gate_decay = 0.50f,
       .fx_mix = 1.00f,
+      .rms_window_duration = 0.05f,
+      .detector = dynamics_detector_peak,
       .env = 0.f,
       .env2 = 0.f,
       .genv = 0.f,
       .sample_rate = 48000.f,
       .channels = 2,
+      .channel_kernel = chspec_index(2),
+      .control_interval = 1,
       .need_parameter_update = true,
   };
+  err = dynamics_set_format(*dp, 48000.f, 2);
+  if (efailed(err)) {
+    err = ethru(err);
+    ereport(dynamics_destroy(dp));
+    return err;
+  }
   return eok();
 }
 
@@ -327,6 +543,7 @@ NODISCARD error dynamics_destroy(struct dynamics **const dp) {
   if (!dp || !*dp) {
     return errg(err_invalid_arugment);
   }
+  ereport(afree(&(*dp)->rms));
   ereport(mem_free(dp));
   return eok();
 }
@@ -335,183 +552,309 @@ void dynamics_clear(struct dynamics *const d) {
   d->env = 0;
   d->env2 = 0;
   d->genv = 0;
-}
-
-static void process_mono(struct dynamics *const d,
-                         float const *restrict const *const inputs,
-                         float *restrict const *const outputs,
-                         size_t const samples) {
-  float const ra = d->rat, xra = d->xrat, re = (1.f - d->rel), at = d->att, ga = d->gatt;
+  d->vca_valid = false;
+  rms_window_clear(&d->rms);
+}
+
+// Runs the envelope and gain computer once per interval samples on the peak of the block,
+// and ramps the gain linearly across the block in the VCA loop.
+// interval is 4 or 8, a constant like the flags so that whole blocks are read and written as SSE vectors,
+// a block cut short by the end of samples goes through the same computer one sample at a time.
+// When gains is not NULL the ramped gain is written there instead of being applied to outputs.
+static inline __attribute__((always_inline)) void process_decimated_impl(struct dynamics *const d,
+                                                                         float const *restrict const *const inputs,
+                                                                         float *restrict const *const outputs,
+                                                                         float *restrict const gains,
+                                                                         size_t const samples,
+                                                                         size_t const chs,
+                                                                         size_t const interval,
+                                                                         bool const use_gate_limiter) {
+  float const ra = d->rat, xra = d->ctl_xrat, re = d->ctl_rel, at = d->ctl_att, ga = d->ctl_gatt;
   float const tr = d->trim, th = d->thr, lth = d->use_gate_limiter && d->lthr == 0.f ? 1000.f : d->lthr, xth = d->xthr,
               y = d->dry;
-  float const *restrict in1 = inputs[0];
-  float *restrict out1 = outputs[0];
-  float a, i, g, e = d->env, e2 = d->env2, ge = d->genv;
-
-  if (d->use_gate_limiter) { // comp/gate/lim
-    for (size_t pos = 0; pos < samples; ++pos) {
-      a = in1[pos];
-      i = fabsf(a);
-
-      e = (i > e) ? e + at * (i - e) : e * re;
-      e2 = (i > e) ? i : e2 * re; // ir;
-
-      g = (e > th) ? tr / (1.f + ra * ((e / th) - 1.f)) : tr;
+  float i, g, e = d->env, e2 = d->env2, ge = d->genv, vca = d->vca;
+  bool const rms = d->detector == dynamics_detector_rms;
+  float const chscale = 1.f / (float)chs;
+  struct rms_window w = d->rms;
+  __m128 const abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 const ramp = _mm_set_ps(4.f, 3.f, 2.f, 1.f);
+
+  if (!d->vca_valid) {
+    vca = (e > th) ? tr / (1.f + ra * ((e / th) - 1.f)) + y : tr + y;
+  }
+  for (size_t pos = 0; pos < samples; pos += interval) {
+    size_t const n = samples - pos < interval ? samples - pos : interval;
+    i = 0.f; // get detector level of the block
+    if (rms) {
+      for (size_t k = pos; k < pos + n; ++k) {
+        float v = 0.f;
+        for (size_t ch = 0; ch < chs; ++ch) {
+          v += inputs[ch][k] * inputs[ch][k];
+        }
+        i = fmaxf(i, rms_window_push(&w, v * chscale));
+      }
+    } else if (n == interval) {
+      __m128 m = _mm_setzero_ps();
+      for (size_t ch = 0; ch < chs; ++ch) {
+        for (size_t k = 0; k < interval; k += 4) {
+          m = _mm_max_ps(m, _mm_and_ps(_mm_loadu_ps(inputs[ch] + pos + k), abs_mask));
+        }
+      }
+      m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+      m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+      i = _mm_cvtss_f32(m);
+    } else {
+      for (size_t k = pos; k < pos + n; ++k) {
+        for (size_t ch = 0; ch < chs; ++ch) {
+          i = fmaxf(i, fabsf(inputs[ch][k]));
+        }
+      }
+    }
 
+    e = (i > e) ? e + at * (i - e) : e * re;
+    g = (e > th) ? tr / (1.f + ra * ((e / th) - 1.f)) : tr;
+    if (use_gate_limiter) {
+      e2 = (i > e) ? i : e2 * re;
       if (g < 0.f) {
         g = 0.f;
       }
       if (g * e2 > lth) {
         g = lth / e2; // limit
       }
-
       ge = (e > xth) ? ge + ga - ga * ge : ge * xra; // gate
-
-      out1[pos] = a * (g * ge + y);
+      g = g * ge + y;
+    } else {
+      g = g + y;
     }
-  } else { // compressor only
-    for (size_t pos = 0; pos < samples; ++pos) {
-      a = in1[pos];
-      i = fabsf(a);
 
-      e = (i > e) ? e + at * (i - e) : e * re;                // envelope
-      g = (e > th) ? tr / (1.f + ra * ((e / th) - 1.f)) : tr; // gain
-
-      out1[pos] = a * (g + y); // vca
+    if (n == interval) {
+      __m128 const base = _mm_set1_ps(vca);
+      __m128 const step = _mm_set1_ps((g - vca) * (1.f / (float)interval));
+      for (size_t k = 0; k < interval; k += 4) {
+        __m128 const v = _mm_add_ps(base, _mm_mul_ps(step, _mm_add_ps(ramp, _mm_set1_ps((float)k)))); // vca
+        if (gains) {
+          _mm_storeu_ps(gains + pos + k, v);
+        } else {
+          for (size_t ch = 0; ch < chs; ++ch) {
+            _mm_storeu_ps(outputs[ch] + pos + k, _mm_mul_ps(_mm_loadu_ps(inputs[ch] + pos + k), v));
+          }
+        }
+      }
+    } else {
+      float const step = (g - vca) / (float)n;
+      for (size_t k = 0; k < n; ++k) {
+        float const v = vca + step * (float)(k + 1); // vca
+        if (gains) {
+          gains[pos + k] = v;
+        } else {
+          for (size_t ch = 0; ch < chs; ++ch) {
+            outputs[ch][pos + k] = inputs[ch][pos + k] * v;
+          }
+        }
+      }
     }
+    vca = g;
   }
+  d->rms.cur = w.cur;
+  d->rms.sum = w.sum;
+  d->vca = vca;
+  d->vca_valid = true;
   d->env = (e < 1.e-10f) ? 0.f : e;
   d->env2 = (e2 < 1.e-10f) ? 0.f : e2;
   d->genv = (ge < 1.e-10f) ? 0.f : ge;
 }
 
-static void process_stereo(struct dynamics *const d,
-                           float const *restrict const *const inputs,
-                           float *restrict const *const outputs,
-                           size_t const samples) {
+// Runs the envelope and gain computer on every sample.
+// chs is a constant in the channel_kernels instances so that the loops over the channels are unrolled,
+// use_gate_limiter and whether gains is NULL are constants too so that each mode gets its own loop.
+// When gains is not NULL the gain is written there instead of being applied to outputs.
+static inline __attribute__((always_inline)) void process_impl(struct dynamics *const d,
+                                                               float const *restrict const *const inputs,
+                                                               float *restrict const *const outputs,
+                                                               float *restrict const gains,
+                                                               size_t const samples,
+                                                               size_t const chs,
+                                                               bool const use_gate_limiter) {
   float const ra = d->rat, xra = d->xrat, re = (1.f - d->rel), at = d->att, ga = d->gatt;
   float const tr = d->trim, th = d->thr, lth = d->use_gate_limiter && d->lthr == 0.f ? 1000.f : d->lthr, xth = d->xthr,
               y = d->dry;
-  float const *restrict in1 = inputs[0];
-  float const *restrict in2 = inputs[1];
-  float *restrict out1 = outputs[0];
-  float *restrict out2 = outputs[1];
-  float a, b, i, g, e = d->env, e2 = d->env2, ge = d->genv;
-
-  if (d->use_gate_limiter) { // comp/gate/lim
-    for (size_t pos = 0; pos < samples; ++pos) {
-      a = in1[pos];
-      b = in2[pos];
-      i = fmaxf(fabsf(a), fabsf(b));
-
-      e = (i > e) ? e + at * (i - e) : e * re;
-      e2 = (i > e) ? i : e2 * re; // ir;
-
-      g = (e > th) ? tr / (1.f + ra * ((e / th) - 1.f)) : tr;
+  float i, g, e = d->env, e2 = d->env2, ge = d->genv;
+  bool const rms = d->detector == dynamics_detector_rms;
+  float const chscale = 1.f / (float)chs;
+  struct rms_window w = d->rms;
+
+  for (size_t pos = 0; pos < samples; ++pos) {
+    i = 0.f; // get detector level
+    if (rms) {
+      for (size_t ch = 0; ch < chs; ++ch) {
+        i += inputs[ch][pos] * inputs[ch][pos];
+      }
+      i = rms_window_push(&w, i * chscale);
+    } else {
+      for (size_t ch = 0; ch < chs; ++ch) {
+        i = fmaxf(i, fabsf(inputs[ch][pos]));
+      }
+    }
 
+    e = (i > e) ? e + at * (i - e) : e * re;                // envelope
+    g = (e > th) ? tr / (1.f + ra * ((e / th) - 1.f)) : tr; // gain
+    if (use_gate_limiter) { // comp/gate/lim
+      e2 = (i > e) ? i : e2 * re;
       if (g < 0.f) {
         g = 0.f;
       }
       if (g * e2 > lth) {
         g = lth / e2; // limit
       }
-
       ge = (e > xth) ? ge + ga - ga * ge : ge * xra; // gate
-
-      i = g * ge + y;
-      out1[pos] = a * i;
-      out2[pos] = b * i;
+      g = g * ge + y;
+    } else { // compressor only
+      g = g + y;
     }
-  } else { // compressor only
-    for (size_t pos = 0; pos < samples; ++pos) {
-      a = in1[pos];
-      b = in2[pos];
-      i = fmaxf(fabsf(a), fabsf(b));
-
-      e = (i > e) ? e + at * (i - e) : e * re;                // envelope
-      g = (e > th) ? tr / (1.f + ra * ((e / th) - 1.f)) : tr; // gain
-
-      i = g + y; // vca
-      out1[pos] = a * i;
-      out2[pos] = b * i;
+
+    if (gains) {
+      gains[pos] = g;
+    } else {
+      for (size_t ch = 0; ch < chs; ++ch) {
+        outputs[ch][pos] = inputs[ch][pos] * g; // vca
+      }
     }
   }
+  d->rms.cur = w.cur;
+  d->rms.sum = w.sum;
   d->env = (e < 1.e-10f) ? 0.f : e;
   d->env2 = (e2 < 1.e-10f) ? 0.f : e2;
   d->genv = (ge < 1.e-10f) ? 0.f : ge;
 }
 
-static void process_generic(struct dynamics *const d,
-                            float const *restrict const *const inputs,
-                            float *restrict const *const outputs,
-                            size_t const samples) {
-  size_t ch;
-  size_t const chs = d->channels;
-  float const ra = d->rat, xra = d->xrat, re = (1.f - d->rel), at = d->att, ga = d->gatt;
-  float const tr = d->trim, th = d->thr, lth = d->use_gate_limiter && d->lthr == 0.f ? 1000.f : d->lthr, xth = d->xthr,
-              y = d->dry;
-  float i, g, e = d->env, e2 = d->env2, ge = d->genv;
-
-  if (d->use_gate_limiter) { // comp/gate/lim
-    for (size_t pos = 0; pos < samples; ++pos) {
-      i = 0.f; // get peak level
-      for (ch = 0; ch < chs; ++ch) {
-        i = fmaxf(i, fabsf(inputs[ch][pos]));
-      }
-
-      e = (i > e) ? e + at * (i - e) : e * re;
-      e2 = (i > e) ? i : e2 * re; // ir;
+typedef void (*channel_kernel_func)(struct dynamics *const d,
+                                    float const *restrict const *const inputs,
+                                    float *restrict const *const outputs,
+                                    float *restrict const gains,
+                                    size_t const samples);
+
+// Picks the instance for the flags, so that neither whether gains is NULL nor use_gate_limiter is tested per sample.
+static inline __attribute__((always_inline)) void process_interval(struct dynamics *const d,
+                                                                   float const *restrict const *const inputs,
+                                                                   float *restrict const *const outputs,
+                                                                   float *restrict const gains,
+                                                                   size_t const samples,
+                                                                   size_t const chs,
+                                                                   size_t const interval) {
+  if (interval == 1) {
+    if (gains && d->use_gate_limiter) {
+      process_impl(d, inputs, NULL, gains, samples, chs, true);
+    } else if (gains) {
+      process_impl(d, inputs, NULL, gains, samples, chs, false);
+    } else if (d->use_gate_limiter) {
+      process_impl(d, inputs, outputs, NULL, samples, chs, true);
+    } else {
+      process_impl(d, inputs, outputs, NULL, samples, chs, false);
+    }
+  } else {
+    if (gains && d->use_gate_limiter) {
+      process_decimated_impl(d, inputs, NULL, gains, samples, chs, interval, true);
+    } else if (gains) {
+      process_decimated_impl(d, inputs, NULL, gains, samples, chs, interval, false);
+    } else if (d->use_gate_limiter) {
+      process_decimated_impl(d, inputs, outputs, NULL, samples, chs, interval, true);
+    } else {
+      process_decimated_impl(d, inputs, outputs, NULL, samples, chs, interval, false);
+    }
+  }
+}
 
-      g = (e > th) ? tr / (1.f + ra * ((e / th) - 1.f)) : tr;
+#define DEFINE_CHANNEL_KERNEL(name, chs)                                                                               \
+  static void name(struct dynamics *const d,                                                                           \
+                   float const *restrict const *const inputs,                                                          \
+                   float *restrict const *const outputs,                                                               \
+                   float *restrict const gains,                                                                        \
+                   size_t const samples) {                                                                             \
+    switch (d->control_interval) {                                                                                     \
+    case 8:                                                                                                            \
+      process_interval(d, inputs, outputs, gains, samples, chs, 8);                                                    \
+      break;                                                                                                           \
+    case 4:                                                                                                            \
+      process_interval(d, inputs, outputs, gains, samples, chs, 4);                                                    \
+      break;                                                                                                           \
+    default:                                                                                                           \
+      process_interval(d, inputs, outputs, gains, samples, chs, 1);                                                    \
+      break;                                                                                                           \
+    }                                                                                                                  \
+  }
+#define X(n) DEFINE_CHANNEL_KERNEL(process_##n, n)
+CHSPEC_EACH(X)
+#undef X
+DEFINE_CHANNEL_KERNEL(process_generic, d->channels)
+#undef DEFINE_CHANNEL_KERNEL
 
-      if (g < 0.f) {
-        g = 0.f;
-      }
-      if (g * e2 > lth) {
-        g = lth / e2; // limit
-      }
+#define X(n) process_##n,
+static channel_kernel_func const channel_kernels[chspec_max_channels + 1] = {process_generic, CHSPEC_EACH(X)};
+#undef X
 
-      ge = (e > xth) ? ge + ga - ga * ge : ge * xra; // gate
+void dynamics_process_gain(struct dynamics *const d,
+                           float const *restrict const *const inputs,
+                           float *restrict const gains,
+                           size_t const samples) {
+  channel_kernels[d->channel_kernel](d, inputs, NULL, gains, samples);
+}
 
-      i = g * ge + y;
-      for (ch = 0; ch < chs; ++ch) {
-        outputs[ch][pos] = inputs[ch][pos] * i;
-      }
+bool dynamics_bypass(struct dynamics *const d, float const peak, size_t const samples) {
+  // the RMS window and the gate would need the samples themselves
+  if (d->need_parameter_update || d->detector != dynamics_detector_peak || d->xthr > 0.f) {
+    return false;
+  }
+  float const tr = d->trim, th = d->thr, lth = d->use_gate_limiter && d->lthr == 0.f ? 1000.f : d->lthr, y = d->dry;
+  float e = d->env, e2 = d->env2, ge = d->genv;
+  // the envelope cannot climb above the larger of its current value and the peak,
+  // so when both are under the threshold the compressor stays at tr for the whole span.
+  if (e > th || peak > th) {
+    return false;
+  }
+  // silence stays silent whatever the gain is
+  if (peak > 0.f) {
+    static float const tolerance = 1e-6f;
+    float const g = d->use_gate_limiter ? tr * ge + y : tr + y;
+    if (fabsf(g - 1.f) > tolerance) {
+      return false;
     }
-  } else { // compressor only
-    for (size_t pos = 0; pos < samples; ++pos) {
-      i = 0.f; // get peak level
-      for (ch = 0; ch < chs; ++ch) {
-        i = fmaxf(i, fabsf(inputs[ch][pos]));
-      }
-
-      e = (i > e) ? e + at * (i - e) : e * re;                // envelope
-      g = (e > th) ? tr / (1.f + ra * ((e / th) - 1.f)) : tr; // gain
-
-      i = g + y; // vca
-      for (ch = 0; ch < chs; ++ch) {
-        outputs[ch][pos] = inputs[ch][pos] * i;
-      }
+    if (d->use_gate_limiter && (tr < 0.f || tr * fmaxf(e2, peak) > lth)) {
+      return false;
+    }
+    if (d->vca_valid && fabsf(d->vca - 1.f) > tolerance) {
+      return false;
     }
   }
+  // Which sample held the peak is unknown, the envelopes take the highest value they could have reached
+  // so that the next processed span never reacts later than it would have.
+  float const n = (float)samples;
+  float const re = powf(1.f - d->rel, n);
+  bool const open = e > 0.f || peak > 0.f;
+  e = fmaxf(e * re, peak);
+  e2 = fmaxf(e2 * re, peak);
+  ge = open ? 1.f - (1.f - ge) * powf(1.f - d->gatt, n) : ge * powf(d->xrat, n);
   d->env = (e < 1.e-10f) ? 0.f : e;
   d->env2 = (e2 < 1.e-10f) ? 0.f : e2;
   d->genv = (ge < 1.e-10f) ? 0.f : ge;
+  // where the decimated VCA would have ended up, e is still under the threshold
+  float g = tr;
+  if (d->use_gate_limiter) {
+    g = fmaxf(g, 0.f);
+    if (g * d->env2 > lth) {
+      g = lth / d->env2; // limit
+    }
+    g = g * d->genv + y;
+  } else {
+    g = g + y;
+  }
+  d->vca = g;
+  d->vca_valid = true;
+  return true;
 }
 
 void dynamics_process(struct dynamics *const d,
                       float const *restrict const *const inputs,
                       float *restrict const *const outputs,
                       size_t const samples) {
-  switch (d->channels) {
-  case 1:
-    process_mono(d, inputs, outputs, samples);
-    break;
-  case 2:
-    process_stereo(d, inputs, outputs, samples);
-    break;
-  default:
-    process_generic(d, inputs, outputs, samples);
-    break;
-  }
+  channel_kernels[d->channel_kernel](d, inputs, outputs, NULL, samples);
 }
@@ -27,10 +27,16 @@
 
 struct dynamics;
 
+enum dynamics_detector {
+  dynamics_detector_peak,
+  dynamics_detector_rms,
+};
+
 NODISCARD error dynamics_create(struct dynamics **const dp);
 NODISCARD error dynamics_destroy(struct dynamics **const dp);
 
-void dynamics_set_format(struct dynamics *const d, float const sample_rate, size_t const channels);
+// Also reserves the RMS window for the longest duration dynamics_set_rms_window accepts at this sample rate.
+NODISCARD error dynamics_set_format(struct dynamics *const d, float const sample_rate, size_t const channels);
 void dynamics_set_thresh(struct dynamics *const d, float const v);
 float dynamics_get_ratio(struct dynamics const *const d);
 void dynamics_set_ratio(struct dynamics *const d, float const v);
@@ -42,6 +48,11 @@ void dynamics_set_gate_thresh(struct dynamics *const d, float const v);
 void dynamics_set_gate_attack(struct dynamics *const d, float const v);
 void dynamics_set_gate_decay(struct dynamics *const d, float const v);
 void dynamics_set_fx_mix(struct dynamics *const d, float const v);
+void dynamics_set_detector(struct dynamics *const d, int const v);
+void dynamics_set_rms_window(struct dynamics *const d, float const v); // by seconds, up to 0.5
+// 1 computes the gain on every sample, 4 and 8 compute it once per that many samples from the block peak
+// and ramp between them. Other values are rounded down to one of these.
+void dynamics_set_control_interval(struct dynamics *const d, size_t const samples);
 
 void dynamics_update_internal_parameter(struct dynamics *const d, bool *const updated);
 
@@ -58,9 +69,20 @@ void dynamics_get_limiter_str(struct dynamics const *const d, NATIVE_CHAR dest[1
 void dynamics_get_ratio_str(struct dynamics const *const d, NATIVE_CHAR dest[16]);
 void dynamics_get_release_str(struct dynamics const *const d, NATIVE_CHAR dest[16]);
 void dynamics_get_threshold_str(struct dynamics const *const d, NATIVE_CHAR dest[16]);
+void dynamics_get_detector_str(struct dynamics const *const d, NATIVE_CHAR dest[16]);
 
 void dynamics_process(struct dynamics *const d,
                       float const *restrict const *const inputs,
                       float *restrict const *const outputs,
                       size_t const samples);
+// Runs the same detector and gain computer as dynamics_process and writes the gain of each sample to gains
+// instead of applying it, for callers that fuse the VCA into a later pass.
+void dynamics_process_gain(struct dynamics *const d,
+                           float const *restrict const *const inputs,
+                           float *restrict const gains,
+                           size_t const samples);
+// Tells whether dynamics_process would pass samples whose absolute peak is at most peak through unchanged.
+// When it would, the envelopes are advanced over them without looking at the samples and true is returned,
+// the caller must then not process them at all.
+bool dynamics_bypass(struct dynamics *const d, float const peak, size_t const samples);
 void dynamics_clear(struct dynamics *const d);
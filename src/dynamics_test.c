@@ -0,0 +1,373 @@
+#include "dynamics.c"
+
+#include "ovtest.h"
+
+enum {
+  test_channels = 2,
+  test_samples = 48000,
+  test_frame = 1601,
+};
+
+static float g_input[test_channels][test_samples];
+static float g_output[test_channels][test_samples];
+static float g_reference[test_channels][test_samples];
+
+static void f(float v) { (void)v; }
+
+static void generate_input(void) {
+  // noise bursts with a slowly moving envelope, which exercises both attack and release
+  uint32_t t = (uint32_t)get_global_hint();
+  static float const divider = 1.f / (float)(UINT32_MAX);
+  for (size_t i = 0; i < test_samples; ++i) {
+    float const env = (i / 4800) % 2 ? 0.9f : 0.05f;
+    for (size_t ch = 0; ch < test_channels; ++ch) {
+      g_input[ch][i] = ((float)(ov_splitmix32(t)) * divider * 2.f - 1.f) * env;
+      t = ov_splitmix32_next(t);
+    }
+  }
+}
+
+static void setup_strip(struct dynamics *const d) {
+  TEST_SUCCEEDED_F(dynamics_set_format(d, 48000.f, test_channels));
+  dynamics_set_output(d, 0.f);
+  dynamics_set_thresh(d, 0.4f);
+  dynamics_set_ratio(d, 0.6f);
+  dynamics_set_attack(d, 0.18f);
+  dynamics_set_release(d, 0.55f);
+}
+
+static void setup_limiter(struct dynamics *const d) {
+  TEST_SUCCEEDED_F(dynamics_set_format(d, 48000.f, test_channels));
+  dynamics_set_thresh(d, 1.f);
+  dynamics_set_ratio(d, 0.6f);
+  dynamics_set_attack(d, 0.f);
+  dynamics_set_release(d, 0.8f);
+  dynamics_set_output(d, 0.f);
+  dynamics_set_limiter(d, 0.7f);
+}
+
+static void process_all(struct dynamics *const d, float (*const output)[test_samples]) {
+  for (size_t pos = 0; pos < test_samples; pos += test_frame) {
+    size_t const n = test_samples - pos < test_frame ? test_samples - pos : test_frame;
+    float const *in[test_channels];
+    float *out[test_channels];
+    for (size_t ch = 0; ch < test_channels; ++ch) {
+      in[ch] = g_input[ch] + pos;
+      out[ch] = output[ch] + pos;
+    }
+    dynamics_process(d, (float const *restrict const *)in, (float *restrict const *)out, n);
+  }
+}
+
+static float max_deviation(void) {
+  float r = 0.f;
+  for (size_t ch = 0; ch < test_channels; ++ch) {
+    for (size_t i = 0; i < test_samples; ++i) {
+      r = fmaxf(r, fabsf(g_output[ch][i] - g_reference[ch][i]));
+    }
+  }
+  return r;
+}
+
+static float rms_deviation(void) {
+  double r = 0.;
+  for (size_t ch = 0; ch < test_channels; ++ch) {
+    for (size_t i = 0; i < test_samples; ++i) {
+      double const v = (double)(g_output[ch][i] - g_reference[ch][i]);
+      r += v * v;
+    }
+  }
+  return (float)sqrt(r / (double)(test_channels * test_samples));
+}
+
+// The largest deviations sit on the onsets of the bursts, where the per-sample path reacts within a couple of samples
+// and the decimated one within a block, so they depend on where an onset falls in its block.
+// The RMS deviation covers everything else and is what the bounds are measured on.
+static void test_decimated(void (*setup)(struct dynamics *const), float const max_tolerance, float const rms_tolerance) {
+  struct dynamics *d = NULL;
+  generate_input();
+  TEST_SUCCEEDED_F(dynamics_create(&d));
+  setup(d);
+  dynamics_update_internal_parameter(d, NULL);
+  process_all(d, g_reference);
+
+  static size_t const intervals[] = {4, 8};
+  for (size_t i = 0; i < sizeof(intervals) / sizeof(intervals[0]); ++i) {
+    dynamics_clear(d);
+    dynamics_set_control_interval(d, intervals[i]);
+    dynamics_update_internal_parameter(d, NULL);
+    process_all(d, g_output);
+    float const dev = max_deviation();
+    float const rdev = rms_deviation();
+    TEST_CHECK(dev < max_tolerance);
+    TEST_CHECK(rdev < rms_tolerance);
+    TEST_MSG("interval %zu: max deviation %f (%f dB), rms deviation %g (%f dB)",
+             intervals[i],
+             (double)dev,
+             (double)(20.f * log10f(dev)),
+             (double)rdev,
+             (double)(20.f * log10f(rdev)));
+  }
+  TEST_SUCCEEDED_F(dynamics_destroy(&d));
+}
+
+// measured up to 0.14 and 6.7e-4 (-63 dB) over several seeds
+static void test_decimated_strip(void) { test_decimated(setup_strip, 0.2f, 1e-3f); }
+// measured up to 0.022 and 7.5e-5 (-82 dB) over several seeds
+static void test_decimated_limiter(void) { test_decimated(setup_limiter, 0.03f, 1.5e-4f); }
+
+// dynamics_process_gain has to yield exactly the gain that dynamics_process applies.
+static void test_process_gain(void) {
+  static void (*const setups[])(struct dynamics *const) = {setup_strip, setup_limiter};
+  static float gains[test_frame];
+  generate_input();
+  for (size_t s = 0; s < sizeof(setups) / sizeof(setups[0]); ++s) {
+    for (size_t channels = 1; channels <= test_channels; ++channels) {
+      for (size_t interval = 1; interval <= 4; interval += 3) {
+        struct dynamics *d = NULL;
+        TEST_SUCCEEDED_F(dynamics_create(&d));
+        setups[s](d);
+        TEST_SUCCEEDED_F(dynamics_set_format(d, 48000.f, channels));
+        dynamics_set_control_interval(d, interval);
+        dynamics_update_internal_parameter(d, NULL);
+        process_all(d, g_reference);
+        dynamics_clear(d);
+        float dev = 0.f;
+        for (size_t pos = 0; pos < test_samples; pos += test_frame) {
+          size_t const n = test_samples - pos < test_frame ? test_samples - pos : test_frame;
+          float const *in[test_channels] = {g_input[0] + pos, g_input[1] + pos};
+          dynamics_process_gain(d, (float const *restrict const *)in, gains, n);
+          for (size_t ch = 0; ch < channels; ++ch) {
+            for (size_t i = 0; i < n; ++i) {
+              dev = fmaxf(dev, fabsf(in[ch][i] * gains[i] - g_reference[ch][pos + i]));
+            }
+          }
+        }
+        TEST_CHECK(dev < 1e-6f);
+        TEST_MSG("setup %zu, channels %zu, interval %zu: max deviation %g", s, channels, interval, (double)dev);
+        TEST_SUCCEEDED_F(dynamics_destroy(&d));
+      }
+    }
+  }
+}
+
+// Spans that dynamics_bypass lets through must come out unchanged from dynamics_process,
+// and skipping them must not change how the next loud span is limited.
+static void test_bypass(void) {
+  enum {
+    quiet_frames = 20,
+  };
+  generate_input();
+  for (size_t i = 0; i < test_samples; ++i) {
+    float const scale = i < test_frame * quiet_frames ? 0.5f / 0.9f : 2.f;
+    for (size_t ch = 0; ch < test_channels; ++ch) {
+      g_input[ch][i] *= scale;
+    }
+  }
+  for (size_t interval = 1; interval <= 4; interval += 3) {
+    struct dynamics *d = NULL;
+    TEST_SUCCEEDED_F(dynamics_create(&d));
+    setup_limiter(d);
+    dynamics_set_control_interval(d, interval);
+    dynamics_update_internal_parameter(d, NULL);
+    process_all(d, g_reference);
+    dynamics_clear(d);
+
+    TEST_CHECK(dynamics_bypass(d, 0.f, test_frame)); // silence passes even before the gate opens
+    dynamics_clear(d);
+    size_t bypassed = 0;
+    float dev = 0.f;
+    for (size_t pos = 0; pos < test_samples; pos += test_frame) {
+      size_t const n = test_samples - pos < test_frame ? test_samples - pos : test_frame;
+      float const *in[test_channels] = {g_input[0] + pos, g_input[1] + pos};
+      float *out[test_channels] = {g_output[0] + pos, g_output[1] + pos};
+      if (dynamics_bypass(d, find_peak(in, test_channels, n), n)) {
+        ++bypassed;
+        for (size_t ch = 0; ch < test_channels; ++ch) {
+          memcpy(out[ch], in[ch], n * sizeof(float));
+        }
+      } else {
+        dynamics_process(d, (float const *restrict const *)in, (float *restrict const *)out, n);
+      }
+    }
+    dev = max_deviation();
+    // the first quiet frame opens the gate and everything from the loud one on has to be limited
+    TEST_CHECK(bypassed == quiet_frames - 1);
+    TEST_CHECK(dev < 1e-5f);
+    TEST_MSG("interval %zu: bypassed %zu, max deviation %g", interval, bypassed, (double)dev);
+    TEST_SUCCEEDED_F(dynamics_destroy(&d));
+  }
+
+  struct dynamics *d = NULL;
+  TEST_SUCCEEDED_F(dynamics_create(&d));
+  setup_strip(d);
+  dynamics_update_internal_parameter(d, NULL);
+  TEST_CHECK(!dynamics_bypass(d, 0.5f, test_frame)); // over the threshold of the strip compressor
+  TEST_SUCCEEDED_F(dynamics_destroy(&d));
+}
+
+// Changing the window must not reallocate, and switching back to the RMS detector must start from an empty window.
+static void test_rms_window(void) {
+  struct dynamics *d = NULL;
+  generate_input();
+  TEST_SUCCEEDED_F(dynamics_create(&d));
+  setup_strip(d);
+  dynamics_set_detector(d, dynamics_detector_rms);
+  dynamics_update_internal_parameter(d, NULL);
+  float const *const ptr = d->rms.ptr;
+  TEST_CHECK(d->rms.cap >= 24000);
+  TEST_CHECK(d->rms.len == 2400);
+
+  dynamics_set_rms_window(d, 0.3f);
+  dynamics_update_internal_parameter(d, NULL);
+  TEST_CHECK(d->rms.ptr == ptr);
+  TEST_CHECK(d->rms.len == 14400);
+  dynamics_set_rms_window(d, 10.f);
+  dynamics_update_internal_parameter(d, NULL);
+  TEST_CHECK(d->rms.ptr == ptr);
+  TEST_CHECK(d->rms.len == d->rms.cap);
+
+  dynamics_set_rms_window(d, 0.05f);
+  dynamics_update_internal_parameter(d, NULL);
+  process_all(d, g_output);
+  TEST_CHECK(d->rms.sum > 0.0);
+  dynamics_set_detector(d, dynamics_detector_peak);
+  dynamics_update_internal_parameter(d, NULL);
+  process_all(d, g_output);
+  dynamics_set_detector(d, dynamics_detector_rms);
+  dynamics_update_internal_parameter(d, NULL);
+  TEST_CHECK(d->rms.ptr == ptr);
+  TEST_CHECK(d->rms.len == 2400);
+  TEST_CHECK(d->rms.cur == 0);
+  float stale = 0.f;
+  for (size_t i = 0; i < d->rms.len; ++i) {
+    stale = fmaxf(stale, d->rms.ptr[i]);
+  }
+  TEST_CHECK(stale <= 0.f && d->rms.sum <= 0.0);
+  TEST_MSG("stale %g, sum %g", (double)stale, d->rms.sum);
+  TEST_SUCCEEDED_F(dynamics_destroy(&d));
+}
+
+// The running sum must follow the window over many laps without drifting.
+static void test_rms_window_sum(void) {
+  enum { len = 100, laps = 1000 };
+  float buf[len] = {0};
+  struct rms_window w = {.ptr = buf, .len = len, .cap = len, .scale = 1.f / (float)len};
+  generate_input();
+  float maxdiff = 0.f;
+  for (size_t i = 0; i < len * laps; ++i) {
+    float const x = g_input[0][i % test_samples] * (i & 1024 ? 1.f : 1e-3f);
+    float const rms = rms_window_push(&w, x * x);
+    double sum = 0.0;
+    for (size_t j = 0; j < len; ++j) {
+      sum += (double)buf[j];
+    }
+    float const expected = (float)sqrt(sum / len);
+    maxdiff = fmaxf(maxdiff, fabsf(rms - expected) / fmaxf(expected, 1e-6f));
+  }
+  TEST_CHECK(maxdiff < 1e-3f);
+  TEST_MSG("max relative deviation %g", (double)maxdiff);
+}
+
+// Every specialized instance has to match the generic one that reads the channel count at run time.
+static void test_channel_kernels(void) {
+  enum {
+    max_channels = chspec_max_channels + 1,
+  };
+  static float in[max_channels][test_frame];
+  static float out[max_channels][test_frame];
+  static float ref[max_channels][test_frame];
+  static void (*const setups[])(struct dynamics *const) = {setup_strip, setup_limiter};
+  float const *inputs[max_channels];
+  float *outputs[max_channels];
+  float *references[max_channels];
+  uint32_t t = (uint32_t)get_global_hint();
+  static float const divider = 1.f / (float)(UINT32_MAX);
+  for (size_t ch = 0; ch < max_channels; ++ch) {
+    for (size_t i = 0; i < test_frame; ++i) {
+      in[ch][i] = ((float)(ov_splitmix32(t)) * divider * 2.f - 1.f) * (i < test_frame / 2 ? 0.9f : 0.05f);
+      t = ov_splitmix32_next(t);
+    }
+    inputs[ch] = in[ch];
+    outputs[ch] = out[ch];
+    references[ch] = ref[ch];
+  }
+  for (size_t s = 0; s < sizeof(setups) / sizeof(setups[0]); ++s) {
+    for (int detector = dynamics_detector_peak; detector <= dynamics_detector_rms; ++detector) {
+      for (size_t interval = 1; interval <= 4; interval += 3) {
+        for (size_t channels = 1; channels <= max_channels; ++channels) {
+          struct dynamics *d = NULL;
+          struct dynamics *generic = NULL;
+          TEST_SUCCEEDED_F(dynamics_create(&d));
+          TEST_SUCCEEDED_F(dynamics_create(&generic));
+          struct dynamics *const ds[2] = {d, generic};
+          for (size_t i = 0; i < 2; ++i) {
+            setups[s](ds[i]);
+            TEST_SUCCEEDED_F(dynamics_set_format(ds[i], 48000.f, channels));
+            dynamics_set_detector(ds[i], detector);
+            dynamics_set_control_interval(ds[i], interval);
+            dynamics_update_internal_parameter(ds[i], NULL);
+          }
+          float dev = 0.f;
+          for (size_t frame = 0; frame < 4; ++frame) {
+            dynamics_process(d, (float const *restrict const *)inputs, (float *restrict const *)outputs, test_frame);
+            process_generic(
+                generic, (float const *restrict const *)inputs, (float *restrict const *)references, NULL, test_frame);
+            for (size_t ch = 0; ch < channels; ++ch) {
+              for (size_t i = 0; i < test_frame; ++i) {
+                dev = fmaxf(dev, fabsf(out[ch][i] - ref[ch][i]));
+              }
+            }
+          }
+          TEST_CHECK(dev < 1e-6f);
+          TEST_MSG("setup %zu, detector %d, interval %zu, channels %zu: max deviation %g",
+                   s,
+                   detector,
+                   interval,
+                   channels,
+                   (double)dev);
+          TEST_SUCCEEDED_F(dynamics_destroy(&generic));
+          TEST_SUCCEEDED_F(dynamics_destroy(&d));
+        }
+      }
+    }
+  }
+}
+
+static void bench(void (*setup)(struct dynamics *const), size_t const interval) {
+  struct dynamics *d = NULL;
+  generate_input();
+  TEST_SUCCEEDED_F(dynamics_create(&d));
+  setup(d);
+  dynamics_set_control_interval(d, interval);
+  dynamics_update_internal_parameter(d, NULL);
+  for (int i = 0; i < 100; ++i) {
+    process_all(d, g_output);
+  }
+  f(g_output[0][0]);
+  TEST_SUCCEEDED_F(dynamics_destroy(&d));
+}
+
+static void bench_strip_per_sample(void) { bench(setup_strip, 1); }
+static void bench_strip_interval_4(void) { bench(setup_strip, 4); }
+static void bench_strip_interval_8(void) { bench(setup_strip, 8); }
+static void bench_limiter_per_sample(void) { bench(setup_limiter, 1); }
+static void bench_limiter_interval_4(void) { bench(setup_limiter, 4); }
+static void bench_limiter_interval_8(void) { bench(setup_limiter, 8); }
+
+TEST_LIST = {
+    {"test_decimated_strip", test_decimated_strip},
+    {"test_decimated_limiter", test_decimated_limiter},
+    {"test_process_gain", test_process_gain},
+    {"test_bypass", test_bypass},
+    {"test_rms_window", test_rms_window},
+    {"test_rms_window_sum", test_rms_window_sum},
+    {"test_channel_kernels", test_channel_kernels},
+    {"bench_strip_per_sample", bench_strip_per_sample},
+    {"bench_strip_interval_4", bench_strip_interval_4},
+    {"bench_strip_interval_8", bench_strip_interval_8},
+    {"bench_limiter_per_sample", bench_limiter_per_sample},
+    {"bench_limiter_interval_4", bench_limiter_interval_4},
+    {"bench_limiter_interval_8", bench_limiter_interval_8},
+    {NULL, NULL},
+};
@@ -60,6 +60,8 @@ static NODISCARD error get_axr_message(int const type, int const code, struct NA
   case err_axr_wav_size_limit_exceeded:
     return to_wstr(&str_unmanaged_const(gettext("Processing cannot continue because the wave file size is too large.")),
                    dest);
+  case err_axr_unsupported_wave_format:
+    return to_wstr(&str_unmanaged_const(gettext("The format of the wave file is not supported.")), dest);
   }
   return to_wstr(&str_unmanaged_const(gettext("Unknown error code.")), dest);
 }
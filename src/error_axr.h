@@ -16,6 +16,7 @@ enum err_axr {
   err_axr_project_has_not_yet_been_saved = 108,
 
   err_axr_wav_size_limit_exceeded = 201,
+  err_axr_unsupported_wave_format = 202,
 };
 
 NODISCARD error axr_error_message(int const type, int const code, struct NATIVE_STR *const dest);
@@ -0,0 +1,248 @@
+#pragma once
+
+#include "ovbase.h"
+
+#include <immintrin.h>
+
+#include "simd.h"
+
+// The tank of fdnreverb: the input diffuser, the damping and feedback matrix and the output mix of one sub-block.
+// Only included by simd_kernels.h, the 8-wide paths are built into the tables of the levels that have AVX.
+// The damping is the only recursion and runs with one line per lane, everything else runs along time,
+// where the Hadamard matrix is nothing but adds across the eight arrays.
+
+static inline void fdn_butterfly4(__m128 *const a, __m128 *const b) {
+  __m128 const x = *a;
+  *a = _mm_add_ps(x, *b);
+  *b = _mm_sub_ps(x, *b);
+}
+
+// Unnormalized 8x8 Hadamard transform across the eight vectors of v.
+static inline void fdn_hadamard4(__m128 *const v) {
+  fdn_butterfly4(v + 0, v + 1);
+  fdn_butterfly4(v + 2, v + 3);
+  fdn_butterfly4(v + 4, v + 5);
+  fdn_butterfly4(v + 6, v + 7);
+  fdn_butterfly4(v + 0, v + 2);
+  fdn_butterfly4(v + 1, v + 3);
+  fdn_butterfly4(v + 4, v + 6);
+  fdn_butterfly4(v + 5, v + 7);
+  fdn_butterfly4(v + 0, v + 4);
+  fdn_butterfly4(v + 1, v + 5);
+  fdn_butterfly4(v + 2, v + 6);
+  fdn_butterfly4(v + 3, v + 7);
+}
+
+// Runs m (up to 4) samples of damping starting at i, lines 0-3 in a and 4-7 in b.
+// Called with a constant m for full groups so the unrolled loop keeps everything in registers.
+static inline __attribute__((always_inline)) void fdn_damp4(struct simd_fdn_block *const s,
+                                                             size_t const i,
+                                                             size_t const m,
+                                                             __m128 *const lpa,
+                                                             __m128 *const lpb,
+                                                             __m128 const dpi,
+                                                             __m128 const dpv) {
+  __m128 a[4], b[4];
+  for (size_t k = 0; k < 4; ++k) {
+    a[k] = _mm_load_ps(s->rd[k] + i);
+    b[k] = _mm_load_ps(s->rd[k + 4] + i);
+  }
+  _MM_TRANSPOSE4_PS(a[0], a[1], a[2], a[3]);
+  _MM_TRANSPOSE4_PS(b[0], b[1], b[2], b[3]);
+  for (size_t k = 0; k < m; ++k) {
+    *lpa = _mm_add_ps(_mm_mul_ps(dpi, a[k]), _mm_mul_ps(dpv, *lpa));
+    *lpb = _mm_add_ps(_mm_mul_ps(dpi, b[k]), _mm_mul_ps(dpv, *lpb));
+    a[k] = *lpa;
+    b[k] = *lpb;
+  }
+  _MM_TRANSPOSE4_PS(a[0], a[1], a[2], a[3]);
+  _MM_TRANSPOSE4_PS(b[0], b[1], b[2], b[3]);
+  for (size_t k = 0; k < 4; ++k) {
+    _mm_store_ps(s->rd[k] + i, a[k]);
+    _mm_store_ps(s->rd[k + 4] + i, b[k]);
+  }
+}
+
+#ifdef __AVX__
+static inline void fdn_butterfly8(__m256 *const a, __m256 *const b) {
+  __m256 const x = *a;
+  *a = _mm256_add_ps(x, *b);
+  *b = _mm256_sub_ps(x, *b);
+}
+
+static inline void fdn_hadamard8(__m256 *const v) {
+  fdn_butterfly8(v + 0, v + 1);
+  fdn_butterfly8(v + 2, v + 3);
+  fdn_butterfly8(v + 4, v + 5);
+  fdn_butterfly8(v + 6, v + 7);
+  fdn_butterfly8(v + 0, v + 2);
+  fdn_butterfly8(v + 1, v + 3);
+  fdn_butterfly8(v + 4, v + 6);
+  fdn_butterfly8(v + 5, v + 7);
+  fdn_butterfly8(v + 0, v + 4);
+  fdn_butterfly8(v + 1, v + 5);
+  fdn_butterfly8(v + 2, v + 6);
+  fdn_butterfly8(v + 3, v + 7);
+}
+
+static inline __attribute__((always_inline)) void fdn_transpose8(__m256 *const r) {
+  __m256 const t0 = _mm256_unpacklo_ps(r[0], r[1]), t1 = _mm256_unpackhi_ps(r[0], r[1]);
+  __m256 const t2 = _mm256_unpacklo_ps(r[2], r[3]), t3 = _mm256_unpackhi_ps(r[2], r[3]);
+  __m256 const t4 = _mm256_unpacklo_ps(r[4], r[5]), t5 = _mm256_unpackhi_ps(r[4], r[5]);
+  __m256 const t6 = _mm256_unpacklo_ps(r[6], r[7]), t7 = _mm256_unpackhi_ps(r[6], r[7]);
+  __m256 const u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 const u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 const u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 const u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 const u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 const u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 const u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 const u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+  r[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+  r[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+  r[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+  r[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+  r[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+  r[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+  r[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+  r[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+}
+
+// Runs m (up to 8) samples of damping starting at i with all eight lines in one register.
+// With FMA the recursion is a single fused operation per sample.
+static inline __attribute__((always_inline)) void fdn_damp8(struct simd_fdn_block *const s,
+                                                             size_t const i,
+                                                             size_t const m,
+                                                             __m256 *const lp,
+                                                             __m256 const dpi,
+                                                             __m256 const dpv) {
+  __m256 a[8];
+  for (size_t k = 0; k < 8; ++k) {
+    a[k] = _mm256_load_ps(s->rd[k] + i);
+  }
+  fdn_transpose8(a);
+  for (size_t k = 0; k < m; ++k) {
+#  ifdef __FMA__
+    *lp = _mm256_fmadd_ps(dpv, *lp, _mm256_mul_ps(dpi, a[k]));
+#  else
+    *lp = _mm256_add_ps(_mm256_mul_ps(dpi, a[k]), _mm256_mul_ps(dpv, *lp));
+#  endif
+    a[k] = *lp;
+  }
+  fdn_transpose8(a);
+  for (size_t k = 0; k < 8; ++k) {
+    _mm256_store_ps(s->rd[k] + i, a[k]);
+  }
+}
+#endif
+
+// Input diffuser: eight taps of one line mixed through the Hadamard matrix.
+static inline void fdn_diffuse(struct simd_fdn const *const f, struct simd_fdn_block *const s, size_t const n) {
+  float const wet = f->diffuse * 0.35355339059327376220f; // 1 / sqrt(8)
+  float const dry = 1.f - f->diffuse;
+#ifdef __AVX__
+  __m256 const wet8 = _mm256_set1_ps(wet), dry8 = _mm256_set1_ps(dry);
+  for (size_t i = 0; i < n; i += 8) {
+    __m256 v[simd_fdn_lines];
+    for (size_t k = 0; k < simd_fdn_lines; ++k) {
+      v[k] = _mm256_load_ps(s->inject[k] + i);
+    }
+    fdn_hadamard8(v);
+    __m256 const x = _mm256_mul_ps(dry8, _mm256_load_ps(s->x + i));
+    for (size_t k = 0; k < simd_fdn_lines; ++k) {
+      _mm256_store_ps(s->inject[k] + i, _mm256_add_ps(x, _mm256_mul_ps(wet8, v[k])));
+    }
+  }
+#else
+  __m128 const wet4 = _mm_set1_ps(wet), dry4 = _mm_set1_ps(dry);
+  for (size_t i = 0; i < n; i += 4) {
+    __m128 v[simd_fdn_lines];
+    for (size_t k = 0; k < simd_fdn_lines; ++k) {
+      v[k] = _mm_load_ps(s->inject[k] + i);
+    }
+    fdn_hadamard4(v);
+    __m128 const x = _mm_mul_ps(dry4, _mm_load_ps(s->x + i));
+    for (size_t k = 0; k < simd_fdn_lines; ++k) {
+      _mm_store_ps(s->inject[k] + i, _mm_add_ps(x, _mm_mul_ps(wet4, v[k])));
+    }
+  }
+#endif
+}
+
+// Damping, the sub-block is transposed a group of samples at a time.
+static inline void fdn_damp(struct simd_fdn *const f, struct simd_fdn_block *const s, size_t const n) {
+  size_t i = 0;
+#ifdef __AVX__
+  __m256 const dpv = _mm256_set1_ps(f->damping), dpi = _mm256_set1_ps(1.f - f->damping);
+  __m256 lp = _mm256_loadu_ps(f->lp);
+  for (; i + 8 <= n; i += 8) {
+    fdn_damp8(s, i, 8, &lp, dpi, dpv);
+  }
+  if (i < n) {
+    fdn_damp8(s, i, n - i, &lp, dpi, dpv);
+  }
+  _mm256_storeu_ps(f->lp, lp);
+#else
+  __m128 const dpv = _mm_set1_ps(f->damping), dpi = _mm_set1_ps(1.f - f->damping);
+  __m128 lpa = _mm_loadu_ps(f->lp), lpb = _mm_loadu_ps(f->lp + 4);
+  for (; i + 4 <= n; i += 4) {
+    fdn_damp4(s, i, 4, &lpa, &lpb, dpi, dpv);
+  }
+  if (i < n) {
+    fdn_damp4(s, i, n - i, &lpa, &lpb, dpi, dpv);
+  }
+  _mm_storeu_ps(f->lp, lpa);
+  _mm_storeu_ps(f->lp + 4, lpb);
+#endif
+}
+
+// The feedback matrix over the damped lines plus the diffused input,
+// and the outputs as two orthogonal sign patterns over the same lines.
+static inline void fdn_mix(struct simd_fdn const *const f, struct simd_fdn_block *const s, size_t const n) {
+#ifdef __AVX__
+  __m256 g[simd_fdn_lines];
+  for (size_t k = 0; k < simd_fdn_lines; ++k) {
+    g[k] = _mm256_set1_ps(f->gains[k]);
+  }
+  for (size_t i = 0; i < n; i += 8) {
+    __m256 v[simd_fdn_lines];
+    for (size_t k = 0; k < simd_fdn_lines; ++k) {
+      v[k] = _mm256_load_ps(s->rd[k] + i);
+    }
+    _mm256_store_ps(s->lo + i,
+                    _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(v[0], v[1]), _mm256_add_ps(v[4], v[5])),
+                                  _mm256_add_ps(_mm256_add_ps(v[2], v[3]), _mm256_add_ps(v[6], v[7]))));
+    _mm256_store_ps(s->ro + i,
+                    _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(v[0], v[2]), _mm256_add_ps(v[5], v[7])),
+                                  _mm256_add_ps(_mm256_add_ps(v[1], v[3]), _mm256_add_ps(v[4], v[6]))));
+    fdn_hadamard8(v);
+    for (size_t k = 0; k < simd_fdn_lines; ++k) {
+      _mm256_store_ps(s->fb[k] + i, _mm256_add_ps(_mm256_mul_ps(g[k], v[k]), _mm256_load_ps(s->inject[k] + i)));
+    }
+  }
+#else
+  for (size_t i = 0; i < n; i += 4) {
+    __m128 v[simd_fdn_lines];
+    for (size_t k = 0; k < simd_fdn_lines; ++k) {
+      v[k] = _mm_load_ps(s->rd[k] + i);
+    }
+    _mm_store_ps(s->lo + i,
+                 _mm_sub_ps(_mm_add_ps(_mm_add_ps(v[0], v[1]), _mm_add_ps(v[4], v[5])),
+                            _mm_add_ps(_mm_add_ps(v[2], v[3]), _mm_add_ps(v[6], v[7]))));
+    _mm_store_ps(s->ro + i,
+                 _mm_sub_ps(_mm_add_ps(_mm_add_ps(v[0], v[2]), _mm_add_ps(v[5], v[7])),
+                            _mm_add_ps(_mm_add_ps(v[1], v[3]), _mm_add_ps(v[4], v[6]))));
+    fdn_hadamard4(v);
+    for (size_t k = 0; k < simd_fdn_lines; ++k) {
+      __m128 const g = _mm_set1_ps(f->gains[k]);
+      _mm_store_ps(s->fb[k] + i, _mm_add_ps(_mm_mul_ps(g, v[k]), _mm_load_ps(s->inject[k] + i)));
+    }
+  }
+#endif
+}
+
+static inline void fdn_process(struct simd_fdn *const f, struct simd_fdn_block *const s, size_t const n) {
+  fdn_diffuse(f, s, n);
+  fdn_damp(f, s, n);
+  fdn_mix(f, s, n);
+}
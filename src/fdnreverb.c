@@ -0,0 +1,518 @@
+#include "fdnreverb.h"
+
+#include <emmintrin.h>
+#include <math.h>
+
+#include "inlines.h"
+#include "simd.h"
+
+enum {
+  num_lines = simd_fdn_lines,
+  line_diffuser = num_lines,
+  line_pre_delay = num_lines + 1,
+  num_delays = num_lines + 2,
+  sub_block_max = simd_fdn_block_max,
+  max_excursion = 64, // excursion parameter is at most 32, the LFO doubles it
+};
+
+// Same layout as uxfdreverb: one arena, power-of-two capacities and a single position counter.
+struct delay {
+  float *ptr;
+  size_t mask;
+  size_t len;
+  size_t readofs; // -(len - 1), wraps around by design
+};
+
+struct fdnreverb {
+  float pre_delay;  // 0 - 1 (0s - 0.25s)
+  float band_width; // 0 - 1
+  float diffuse;    // 0 - 1
+  float decay;      // 0 - 1
+  float damping;    // 0 - 1
+  float excursion;  // 0 - 32
+  float wet;        // 0 - 1
+  float dry;        // 0 - 1
+
+  struct delay delays[num_delays];
+  size_t diffuser_taps[num_lines];
+  struct simd_fdn tank;
+  float *arena;
+  size_t arena_len;
+  size_t pos;
+  size_t sub_block;
+  float lp_in, curtime;
+  float sample_rate;
+  size_t channels;
+  bool sample_rate_changed : 1;
+  bool need_parameter_update : 1;
+  bool silent : 1;
+};
+
+// Mutually prime-ish lengths in seconds, so the modes of the lines do not line up.
+static float const line_lengths[num_lines] = {
+    0.0297f,
+    0.0371f,
+    0.0411f,
+    0.0437f,
+    0.0533f,
+    0.0599f,
+    0.0677f,
+    0.0731f,
+};
+
+static float const diffuser_tap_lengths[num_lines] = {
+    0.f,
+    0.0017f,
+    0.0031f,
+    0.0043f,
+    0.0059f,
+    0.0071f,
+    0.0083f,
+    0.0097f,
+};
+
+// The decay parameter is the gain applied over this many seconds of delay,
+// which roughly matches one trip around a half of the uxfdreverb tank.
+static float const decay_reference_length = 0.25f;
+
+static float const pi = 3.14159265358979323846264338327950288f;
+
+NODISCARD error fdnreverb_create(struct fdnreverb **const rp) {
+  if (!rp || *rp) {
+    return errg(err_invalid_arugment);
+  }
+  error err = mem(rp, 1, sizeof(struct fdnreverb));
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  **rp = (struct fdnreverb){
+      .pre_delay = 0.f,
+      .band_width = 0.9999f,
+      .diffuse = 1.f,
+      .decay = 0.5f,
+      .damping = 0.005f,
+      .excursion = 16.f,
+      .wet = 0.3f,
+      .dry = 0.6f,
+      .sample_rate = 48000.f,
+      .channels = 2,
+      .sample_rate_changed = true,
+      .need_parameter_update = true,
+  };
+  return eok();
+}
+
+NODISCARD error fdnreverb_destroy(struct fdnreverb **const rp) {
+  if (!rp || !*rp) {
+    return errg(err_invalid_arugment);
+  }
+  struct fdnreverb *const r = *rp;
+  if (r->arena) {
+    ereport(mem_aligned_free(&r->arena));
+  }
+  ereport(mem_free(rp));
+  return eok();
+}
+
+void fdnreverb_set_format(struct fdnreverb *const r, float const sample_rate, size_t const channels) {
+  bool sample_rate_is_same = fcmp(r->sample_rate, ==, sample_rate, 1e-12f);
+  if (sample_rate_is_same && r->channels == channels) {
+    return;
+  }
+  r->sample_rate = sample_rate;
+  r->channels = channels;
+  r->sample_rate_changed = !sample_rate_is_same;
+  r->need_parameter_update = true;
+}
+
+void fdnreverb_set_pre_delay(struct fdnreverb *const r, float const v) {
+  if (fcmp(r->pre_delay, ==, v, 1e-12f)) {
+    return;
+  }
+  r->need_parameter_update = true;
+  r->pre_delay = v;
+}
+
+void fdnreverb_set_band_width(struct fdnreverb *const r, float const v) {
+  if (fcmp(r->band_width, ==, v, 1e-12f)) {
+    return;
+  }
+  r->need_parameter_update = true;
+  r->band_width = v;
+}
+
+void fdnreverb_set_diffuse(struct fdnreverb *const r, float const v) {
+  if (fcmp(r->diffuse, ==, v, 1e-12f)) {
+    return;
+  }
+  r->need_parameter_update = true;
+  r->diffuse = v;
+}
+
+void fdnreverb_set_decay(struct fdnreverb *const r, float const v) {
+  if (fcmp(r->decay, ==, v, 1e-12f)) {
+    return;
+  }
+  r->need_parameter_update = true;
+  r->decay = v;
+}
+
+void fdnreverb_set_damping(struct fdnreverb *const r, float const v) {
+  if (fcmp(r->damping, ==, v, 1e-12f)) {
+    return;
+  }
+  r->need_parameter_update = true;
+  r->damping = v;
+}
+
+void fdnreverb_set_excursion(struct fdnreverb *const r, float const v) {
+  if (fcmp(r->excursion, ==, v, 1e-12f)) {
+    return;
+  }
+  r->need_parameter_update = true;
+  r->excursion = v;
+}
+
+void fdnreverb_set_wet(struct fdnreverb *const r, float const v) {
+  if (fcmp(r->wet, ==, v, 1e-12f)) {
+    return;
+  }
+  r->need_parameter_update = true;
+  r->wet = v;
+}
+
+void fdnreverb_set_dry(struct fdnreverb *const r, float const v) {
+  if (fcmp(r->dry, ==, v, 1e-12f)) {
+    return;
+  }
+  r->need_parameter_update = true;
+  r->dry = v;
+}
+
+static size_t next_power_of_two(size_t const v) {
+  size_t r = 1;
+  while (r < v) {
+    r <<= 1;
+  }
+  return r;
+}
+
+NODISCARD static error recreate_delays(struct fdnreverb *const r) {
+  float const sample_rate = r->sample_rate;
+  size_t lens[num_delays] = {0};
+  size_t caps[num_delays] = {0};
+  size_t total = 0;
+  for (size_t i = 0; i < num_lines; ++i) {
+    lens[i] = (size_t)(roundf(line_lengths[i] * sample_rate));
+    if (lens[i] == 0) {
+      lens[i] = 1;
+    }
+  }
+  // the diffuser and the pre-delay are tapped lines, written before they are read in each sub-block
+  lens[line_diffuser] = (size_t)(roundf(diffuser_tap_lengths[num_lines - 1] * sample_rate)) + sub_block_max + 1;
+  lens[line_pre_delay] = (size_t)(sample_rate) / 4 + sub_block_max + 1;
+  for (size_t i = 0; i < num_delays; ++i) {
+    caps[i] = next_power_of_two(lens[i]);
+    total += caps[i];
+  }
+  float *arena = NULL;
+  error err = mem_aligned_alloc(&arena, total, sizeof(float), 16);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  if (r->arena) {
+    ereport(mem_aligned_free(&r->arena));
+  }
+  r->arena = arena;
+  r->arena_len = total;
+  for (size_t i = 0, offset = 0; i < num_delays; ++i) {
+    r->delays[i] = (struct delay){
+        .ptr = arena + offset,
+        .mask = caps[i] - 1,
+        .len = lens[i],
+        .readofs = (size_t)0 - (lens[i] - 1),
+    };
+    offset += caps[i];
+  }
+  for (size_t i = 0; i < num_lines; ++i) {
+    r->diffuser_taps[i] = (size_t)0 - (size_t)(roundf(diffuser_tap_lengths[i] * sample_rate));
+  }
+  // A sub-block must not reach its own writes through the modulated reads of the feedback lines.
+  size_t sub_block = sub_block_max;
+  for (size_t i = 0; i < num_lines; ++i) {
+    size_t const limit = lens[i] > max_excursion + 2 ? lens[i] - (max_excursion + 2) : 1;
+    if (sub_block > limit) {
+      sub_block = limit;
+    }
+  }
+  r->sub_block = sub_block;
+  return eok();
+}
+
+static inline float clamp(float x, float const mn, float const mx) {
+  if (x < mn) {
+    x = mn;
+  }
+  if (x > mx) {
+    x = mx;
+  }
+  return x;
+}
+
+NODISCARD static error update_internal_parameter(struct fdnreverb *const r) {
+  error err = eok();
+  if (r->sample_rate_changed) {
+    err = recreate_delays(r);
+    if (efailed(err)) {
+      err = ethru(err);
+      goto cleanup;
+    }
+    fdnreverb_clear(r);
+  }
+  r->pre_delay = clamp(r->pre_delay, 0.f, 1.f);
+  r->band_width = clamp(r->band_width, 0.f, 1.f);
+  r->diffuse = clamp(r->diffuse, 0.f, 1.f);
+  r->decay = clamp(r->decay, 0.f, 1.f);
+  r->damping = clamp(r->damping, 0.f, 1.f);
+  r->excursion = clamp(r->excursion, 0.f, 32.f);
+  r->wet = clamp(r->wet, 0.f, 1.f);
+  r->dry = clamp(r->dry, 0.f, 1.f);
+  {
+    float const norm = 0.35355339059327376220f; // 1 / sqrt(8)
+    float const ref = decay_reference_length * r->sample_rate;
+    for (size_t i = 0; i < num_lines; ++i) {
+      r->tank.gains[i] = norm * powf(r->decay, (float)(r->delays[i].len) / ref);
+    }
+  }
+  r->tank.damping = r->damping;
+  r->tank.diffuse = r->diffuse;
+cleanup:
+  return err;
+}
+
+NODISCARD error fdnreverb_update_internal_parameter(struct fdnreverb *const r, bool *const updated) {
+  if (!r->need_parameter_update) {
+    if (updated) {
+      *updated = false;
+    }
+    return eok();
+  }
+  error err = update_internal_parameter(r);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  r->sample_rate_changed = false;
+  r->need_parameter_update = false;
+  if (updated) {
+    *updated = true;
+  }
+  return eok();
+}
+
+float fdnreverb_get_decay_per_second(struct fdnreverb const *const r) {
+  // Every line applies decay once per decay_reference_length seconds of delay and the matrix is orthogonal.
+  return powf(r->decay, 1.f / decay_reference_length);
+}
+
+static inline void
+read_ring(struct delay const *restrict const d, size_t const start, float *restrict const dst, size_t const n) {
+  size_t const cur = start & d->mask;
+  size_t const sz = d->mask + 1 - cur;
+  if (sz >= n) {
+    memcpy(dst, d->ptr + cur, n * sizeof(float));
+  } else {
+    memcpy(dst, d->ptr + cur, sz * sizeof(float));
+    memcpy(dst + sz, d->ptr, (n - sz) * sizeof(float));
+  }
+}
+
+static inline void
+write_ring(struct delay const *restrict const d, size_t const start, float const *restrict const src, size_t const n) {
+  size_t const cur = start & d->mask;
+  size_t const sz = d->mask + 1 - cur;
+  if (sz >= n) {
+    memcpy(d->ptr + cur, src, n * sizeof(float));
+  } else {
+    memcpy(d->ptr + cur, src, sz * sizeof(float));
+    memcpy(d->ptr, src + sz, (n - sz) * sizeof(float));
+  }
+}
+
+// Reads n samples whose offset from the regular read position moves linearly from o0 to o0 + step * n.
+// The offset moves slowly, so one contiguous span covers every interpolated tap of the sub-block,
+// and the integer part of the offset changes only a few times; each run with a fixed integer part is
+// a plain linear interpolation between two unaligned loads.
+static inline void read_modulated(struct delay const *restrict const d,
+                                  size_t const pos,
+                                  float const o0,
+                                  float const step,
+                                  float *restrict const span,
+                                  float *restrict const dst,
+                                  size_t const n) {
+  float const o1 = o0 + step * (float)n;
+  size_t const base = (size_t)(o0 < o1 ? o0 : o1);
+  size_t const extent = (size_t)(o0 < o1 ? o1 : o0) - base + 2;
+  read_ring(d, pos + d->readofs + base, span, n + extent);
+  float const start = o0 - (float)base;
+  size_t i = 0;
+  while (i < n) {
+    float const idx = start + step * (float)i;
+    size_t const c = (size_t)idx;
+    // first sample whose integer part differs, rounding only moves the boundary by a sample
+    size_t end = n;
+    if (step > 0.f) {
+      end = (size_t)(((float)(c + 1) - start) / step) + 1;
+    } else if (step < 0.f) {
+      end = (size_t)(((float)c - start) / step) + 1;
+    }
+    if (end <= i) {
+      end = i + 1;
+    } else if (end > n) {
+      end = n;
+    }
+    float const f0 = start - (float)c;
+    float const *restrict const x = span + c;
+    __m128 const stepv = _mm_set1_ps(step * 4.f);
+    __m128 frac = _mm_add_ps(_mm_set1_ps(f0), _mm_mul_ps(_mm_set1_ps(step), _mm_set_ps(3.f, 2.f, 1.f, 0.f)));
+    frac = _mm_add_ps(frac, _mm_mul_ps(_mm_set1_ps(step), _mm_set1_ps((float)i)));
+    for (; i + 4 <= end; i += 4) {
+      __m128 const a = _mm_loadu_ps(x + i), b = _mm_loadu_ps(x + i + 1);
+      _mm_storeu_ps(dst + i, _mm_add_ps(a, _mm_mul_ps(frac, _mm_sub_ps(b, a))));
+      frac = _mm_add_ps(frac, stepv);
+    }
+    for (; i < end; ++i) {
+      float const fr = f0 + step * (float)i;
+      dst[i] = x[i] + fr * (x[i + 1] - x[i]);
+    }
+  }
+}
+
+// Scratch for one sub-block, the tank itself runs in the fdn kernel of simd.h.
+struct scratch {
+  struct simd_fdn_block b;
+  _Alignas(16) float span[sub_block_max + max_excursion + 4];
+};
+
+void fdnreverb_process(struct fdnreverb *const r,
+                       float const *restrict const *const inputs,
+                       float *restrict const *const outputs,
+                       size_t const samples) {
+  r->silent = false;
+  size_t const pd = (size_t)(r->pre_delay * r->sample_rate * 0.25f);
+  float const bw = r->band_width;
+  float const ex = r->excursion;
+  float const we = r->wet * 0.6f / 2.f; // each output sums four lines
+  float const dr = r->dry;
+  float const timestep = 1.f / r->sample_rate;
+  size_t const sub_block = r->sub_block;
+
+  struct delay const *const d = r->delays;
+  struct simd_kernels const *const kernels = simd();
+  float lp_in = r->lp_in;
+  float curtime = r->curtime;
+  size_t pos = r->pos;
+
+  // 1Hz LFO as a quadrature oscillator stepped once per sub-block, restarted from the exact phase on every call.
+  // Only the even lines are modulated, line k is shifted by k/8 of a period.
+  // The matrix spreads their movement over every line on each trip, so the others are plain reads.
+  static float const phase_c[num_lines / 2] = {1.f, 0.f, -1.f, 0.f};
+  static float const phase_s[num_lines / 2] = {0.f, 1.f, 0.f, -1.f};
+  float const rot_c = cosf(2.f * pi * timestep * (float)sub_block);
+  float const rot_s = sinf(2.f * pi * timestep * (float)sub_block);
+  float lfo_c = cosf(2.f * pi * curtime), lfo_s = sinf(2.f * pi * curtime);
+
+  float const *restrict const i0 = inputs[0];
+  float const *restrict const i1 = inputs[1];
+  float *restrict const o0 = outputs[0];
+  float *restrict const o1 = outputs[1];
+
+  struct scratch s = {0};
+  size_t n, i, j, k;
+  for (j = 0; j < samples; j += n, pos += n) {
+    n = samples - j < sub_block ? samples - j : sub_block;
+
+    // pre-delay and input bandwidth
+    for (i = 0; i < n; ++i) {
+      s.b.x[i] = (i0[j + i] + i1[j + i]) * 0.5f;
+    }
+    write_ring(d + line_pre_delay, pos, s.b.x, n);
+    read_ring(d + line_pre_delay, pos - pd, s.b.x, n);
+    for (i = 0; i < n; ++i) {
+      lp_in = s.b.x[i] * bw + (1 - bw) * lp_in;
+      s.b.x[i] = lp_in;
+    }
+
+    // the eight taps of the input diffuser
+    write_ring(d + line_diffuser, pos, s.b.x, n);
+    for (k = 0; k < num_lines; ++k) {
+      read_ring(d + line_diffuser, pos + r->diffuser_taps[k], s.b.inject[k], n);
+    }
+
+    // reads of the feedback lines
+    {
+      float rc = rot_c, rs = rot_s;
+      if (n != sub_block) {
+        rc = cosf(2.f * pi * timestep * (float)n);
+        rs = sinf(2.f * pi * timestep * (float)n);
+      }
+      float const next_c = lfo_c * rc - lfo_s * rs;
+      float const next_s = lfo_s * rc + lfo_c * rs;
+      for (k = 0; k < num_lines; ++k) {
+        if (k & 1) {
+          read_ring(d + k, pos + d[k].readofs, s.b.rd[k], n);
+          continue;
+        }
+        float const e0 = ex * (1.f + lfo_c * phase_c[k / 2] - lfo_s * phase_s[k / 2]);
+        float const e1 = ex * (1.f + next_c * phase_c[k / 2] - next_s * phase_s[k / 2]);
+        read_modulated(d + k, pos, e0, (e1 - e0) / (float)n, s.span, s.b.rd[k], n);
+      }
+      lfo_c = next_c;
+      lfo_s = next_s;
+    }
+
+    // diffuser, damping, feedback matrix and output mix
+    kernels->fdn(&r->tank, &s.b, n);
+    for (k = 0; k < num_lines; ++k) {
+      write_ring(d + k, pos, s.b.fb[k], n);
+    }
+
+    // write
+    for (i = 0; i < n; ++i) {
+      o0[j + i] = i0[j + i] * dr + s.b.lo[i] * we;
+      o1[j + i] = i1[j + i] * dr + s.b.ro[i] * we;
+    }
+  }
+  // flush denormals in the recursions, the lines themselves are refilled by the feedback anyway
+  for (k = 0; k < num_lines; ++k) {
+    if (fabsf(r->tank.lp[k]) < 1e-15f) {
+      r->tank.lp[k] = 0.f;
+    }
+  }
+  r->lp_in = fabsf(lp_in) < 1e-15f ? 0.f : lp_in;
+  curtime += (float)(samples)*timestep;
+  r->curtime = curtime - floorf(curtime); // one period of the LFO
+  r->pos = pos;
+}
+
+void fdnreverb_clear(struct fdnreverb *const r) {
+  memset(r->tank.lp, 0, sizeof(r->tank.lp));
+  r->lp_in = 0.f;
+  r->curtime = 0.f;
+  r->pos = 0;
+  if (r->arena) {
+    memset(r->arena, 0, r->arena_len * sizeof(float));
+  }
+}
+
+void fdnreverb_silence(struct fdnreverb *const r, size_t const samples) {
+  float curtime = r->curtime;
+  if (!r->silent) {
+    fdnreverb_clear(r);
+    r->silent = true;
+  }
+  curtime += (float)(samples) / r->sample_rate;
+  r->curtime = curtime - floorf(curtime); // one period of the LFO
+}
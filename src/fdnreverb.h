@@ -0,0 +1,34 @@
+#pragma once
+
+#include "ovbase.h"
+
+// Feedback delay network reverb, an alternative to uxfdreverb with the same parameters.
+// Eight delay lines are mixed through a Hadamard matrix, which maps onto SIMD butterflies.
+struct fdnreverb;
+
+NODISCARD error fdnreverb_create(struct fdnreverb **const rp);
+NODISCARD error fdnreverb_destroy(struct fdnreverb **const rp);
+
+void fdnreverb_set_format(struct fdnreverb *const r, float const sample_rate, size_t const channels);
+void fdnreverb_set_pre_delay(struct fdnreverb *const r, float const v);
+void fdnreverb_set_band_width(struct fdnreverb *const r, float const v);
+void fdnreverb_set_diffuse(struct fdnreverb *const r, float const v);
+void fdnreverb_set_decay(struct fdnreverb *const r, float const v);
+void fdnreverb_set_damping(struct fdnreverb *const r, float const v);
+void fdnreverb_set_excursion(struct fdnreverb *const r, float const v);
+void fdnreverb_set_wet(struct fdnreverb *const r, float const v);
+void fdnreverb_set_dry(struct fdnreverb *const r, float const v);
+
+NODISCARD error fdnreverb_update_internal_parameter(struct fdnreverb *const r, bool *const updated);
+
+// Upper bound of the amplitude gain of the tail over one second of silent input.
+float fdnreverb_get_decay_per_second(struct fdnreverb const *const r);
+
+void fdnreverb_process(struct fdnreverb *const r,
+                       float const *restrict const *const inputs,
+                       float *restrict const *const outputs,
+                       size_t const samples);
+void fdnreverb_clear(struct fdnreverb *const r);
+// Equivalent to processing samples of silence after the tail has died out.
+// The state is cleared on the first call, later calls only advance the LFO, and fdnreverb_process resumes from there.
+void fdnreverb_silence(struct fdnreverb *const r, size_t const samples);
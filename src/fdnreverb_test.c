@@ -0,0 +1,196 @@
+#include "fdnreverb.c"
+
+#include "ovtest.h"
+
+#include "uxfdreverb.h"
+
+enum {
+  test_samples = 48000 * 3,
+};
+
+static float g_input[2][test_samples];
+static float g_output[2][test_samples];
+static float g_reference[2][test_samples];
+
+static void f(float v) { (void)v; }
+
+static void generate_input(void) {
+  uint32_t t = (uint32_t)get_global_hint();
+  static float const divider = 1.f / (float)(UINT32_MAX);
+  for (size_t ch = 0; ch < 2; ++ch) {
+    for (size_t i = 0; i < test_samples; ++i) {
+      g_input[ch][i] = (float)(ov_splitmix32(t)) * divider * 2.f - 1.f;
+      t = ov_splitmix32_next(t);
+    }
+  }
+}
+
+static void process(struct fdnreverb *const r, float *const *const outputs, size_t const block) {
+  for (size_t pos = 0; pos < test_samples; pos += block) {
+    size_t const n = test_samples - pos < block ? test_samples - pos : block;
+    float const *in[2] = {g_input[0] + pos, g_input[1] + pos};
+    float *out[2] = {outputs[0] + pos, outputs[1] + pos};
+    fdnreverb_process(r, (float const *restrict const *)in, (float *restrict const *)out, n);
+  }
+}
+
+static float energy(float const *const p, size_t const n) {
+  float e = 0.f;
+  for (size_t i = 0; i < n; ++i) {
+    e += p[i] * p[i];
+  }
+  return e;
+}
+
+// The tail of an impulse must decay at the rate set by the decay parameter.
+static void test_decay(void) {
+  struct fdnreverb *r = NULL;
+  TEST_SUCCEEDED_F(fdnreverb_create(&r));
+  fdnreverb_set_dry(r, 0.f);
+  fdnreverb_set_decay(r, 0.5f);
+  TEST_SUCCEEDED_F(fdnreverb_update_internal_parameter(r, NULL));
+  memset(g_input, 0, sizeof(g_input));
+  g_input[0][0] = 1.f;
+  g_input[1][0] = 1.f;
+  float *out[2] = {g_output[0], g_output[1]};
+  process(r, out, 1600);
+  for (size_t i = 0; i < test_samples; ++i) {
+    TEST_CHECK(fabsf(g_output[0][i]) < 4.f && fabsf(g_output[1][i]) < 4.f);
+  }
+  // halves in amplitude every 0.25s, so 0.5s later the energy is 1/16 minus the damping loss
+  float const e1 = energy(g_output[0] + 24000, 24000) + energy(g_output[1] + 24000, 24000);
+  float const e2 = energy(g_output[0] + 48000, 24000) + energy(g_output[1] + 48000, 24000);
+  float const ratio = e2 / e1;
+  TEST_CHECK(e1 > 0.f);
+  TEST_CHECK(ratio > 1.f / 32.f && ratio < 1.f / 12.f);
+  TEST_MSG("energy ratio %g", (double)ratio);
+  TEST_SUCCEEDED_F(fdnreverb_destroy(&r));
+}
+
+// The decay reported to the auto-sleep of aux buses must be an upper bound of the actual tail,
+// and a silenced reverb must restart from a clean state.
+static void test_silence(void) {
+  struct fdnreverb *r = NULL;
+  TEST_SUCCEEDED_F(fdnreverb_create(&r));
+  fdnreverb_set_dry(r, 0.f);
+  fdnreverb_set_decay(r, 0.9f);
+  TEST_SUCCEEDED_F(fdnreverb_update_internal_parameter(r, NULL));
+  memset(g_input, 0, sizeof(g_input));
+  g_input[0][0] = 1.f;
+  g_input[1][0] = 1.f;
+  float *out[2] = {g_output[0], g_output[1]};
+  process(r, out, 1600);
+  float const dps = fdnreverb_get_decay_per_second(r);
+  for (size_t i = 48000 / 2; i < test_samples; i += 4800) {
+    float const *o[2] = {g_output[0] + i, g_output[1] + i};
+    float const peak = find_peak(o, 2, 4800);
+    float const bound = 16.f * powf(dps, (float)(i) / 48000.f - 0.3f);
+    TEST_CHECK(peak < bound);
+    TEST_MSG("at %zu peak %g bound %g", i, (double)peak, (double)bound);
+  }
+  fdnreverb_silence(r, 4800);
+  memset(g_input[0], 0, sizeof(g_input[0]));
+  memset(g_input[1], 0, sizeof(g_input[1]));
+  process(r, out, 1600);
+  float const *o[2] = {g_output[0], g_output[1]};
+  TEST_CHECK(find_peak(o, 2, test_samples) <= 0.f);
+  TEST_SUCCEEDED_F(fdnreverb_destroy(&r));
+}
+
+// Without modulation the result must not depend on how the host splits the stream.
+static void test_block_sizes(void) {
+  static size_t const blocks[] = {1, 3, 63, 64, 65, 1601};
+  struct fdnreverb *r = NULL;
+  TEST_SUCCEEDED_F(fdnreverb_create(&r));
+  fdnreverb_set_excursion(r, 0.f);
+  TEST_SUCCEEDED_F(fdnreverb_update_internal_parameter(r, NULL));
+  generate_input();
+  float *ref[2] = {g_reference[0], g_reference[1]};
+  float *out[2] = {g_output[0], g_output[1]};
+  process(r, ref, test_samples);
+  for (size_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); ++b) {
+    fdnreverb_clear(r);
+    process(r, out, blocks[b]);
+    float dev = 0.f;
+    for (size_t ch = 0; ch < 2; ++ch) {
+      for (size_t i = 0; i < test_samples; ++i) {
+        dev = fmaxf(dev, fabsf(g_output[ch][i] - g_reference[ch][i]));
+      }
+    }
+    TEST_CHECK(dev < 1e-4f);
+    TEST_MSG("block %zu: max deviation %g", blocks[b], (double)dev);
+  }
+  TEST_SUCCEEDED_F(fdnreverb_destroy(&r));
+}
+
+// Every level runs the same tank, only FMA changes the rounding of the damping.
+static void test_levels(void) {
+  struct fdnreverb *r = NULL;
+  TEST_SUCCEEDED_F(fdnreverb_create(&r));
+  TEST_SUCCEEDED_F(fdnreverb_update_internal_parameter(r, NULL));
+  generate_input();
+  float *ref[2] = {g_reference[0], g_reference[1]};
+  float *out[2] = {g_output[0], g_output[1]};
+  process(r, ref, 1601);
+  for (int level = simd_level_avx2; level <= (int)simd_detect(); ++level) {
+    TEST_SUCCEEDED_F(simd_set_level((enum simd_level)level));
+    fdnreverb_clear(r);
+    process(r, out, 1601);
+    float dev = 0.f;
+    for (size_t ch = 0; ch < 2; ++ch) {
+      for (size_t i = 0; i < test_samples; ++i) {
+        dev = fmaxf(dev, fabsf(g_output[ch][i] - g_reference[ch][i]));
+      }
+    }
+    TEST_CHECK(dev < 1e-4f);
+    TEST_MSG("level %d: max deviation %g", level, (double)dev);
+  }
+  TEST_SUCCEEDED_F(simd_set_level(simd_level_sse2));
+  TEST_SUCCEEDED_F(fdnreverb_destroy(&r));
+}
+
+static void bench(enum simd_level const level) {
+  struct fdnreverb *r = NULL;
+  generate_input();
+  TEST_SUCCEEDED_F(fdnreverb_create(&r));
+  if (level > simd_detect()) {
+    TEST_MSG("level %d is not supported here", (int)level);
+    goto cleanup;
+  }
+  TEST_SUCCEEDED_F(simd_set_level(level));
+  TEST_SUCCEEDED_F(fdnreverb_update_internal_parameter(r, NULL));
+  float *out[2] = {g_output[0], g_output[1]};
+  process(r, out, 1600);
+  f(g_output[0][0]);
+  TEST_SUCCEEDED_F(simd_set_level(simd_level_sse2));
+cleanup:
+  TEST_SUCCEEDED_F(fdnreverb_destroy(&r));
+}
+
+static void bench_process(void) { bench(simd_level_sse2); }
+static void bench_process_avx2(void) { bench(simd_level_avx2); }
+
+static void bench_process_uxfdreverb(void) {
+  struct uxfdreverb *r = NULL;
+  generate_input();
+  TEST_SUCCEEDED_F(uxfdreverb_create(&r));
+  TEST_SUCCEEDED_F(uxfdreverb_update_internal_parameter(r, NULL));
+  for (size_t pos = 0; pos < test_samples; pos += 1600) {
+    float const *in[2] = {g_input[0] + pos, g_input[1] + pos};
+    float *out[2] = {g_output[0] + pos, g_output[1] + pos};
+    uxfdreverb_process(r, (float const *restrict const *)in, (float *restrict const *)out, 1600);
+  }
+  f(g_output[0][0]);
+  TEST_SUCCEEDED_F(uxfdreverb_destroy(&r));
+}
+
+TEST_LIST = {
+    {"test_decay", test_decay},
+    {"test_block_sizes", test_block_sizes},
+    {"test_silence", test_silence},
+    {"test_levels", test_levels},
+    {"bench_process", bench_process},
+    {"bench_process_avx2", bench_process_avx2},
+    {"bench_process_uxfdreverb", bench_process_uxfdreverb},
+    {NULL, NULL},
+};
@@ -0,0 +1,211 @@
+#include "fft.h"
+
+#include <math.h>
+#include <xmmintrin.h>
+
+struct fft {
+  size_t size;
+  size_t half;  // length of the complex transform
+  float *tw_re; // twiddles of the stage with span h at [h, 2h), only used for h >= 4
+  float *tw_im;
+  float *rt_re; // exp(-2 pi i k / size) for k in [0, half / 2], splits the complex result into the real spectrum
+  float *rt_im;
+  uint32_t *swaps; // pairs of indices exchanged by the bit-reversal permutation
+  size_t num_swaps;
+};
+
+NODISCARD error fft_destroy(struct fft **const fp) {
+  if (!fp || !*fp) {
+    return errg(err_invalid_arugment);
+  }
+  struct fft *const f = *fp;
+  if (f->tw_re) {
+    ereport(mem_aligned_free(&f->tw_re));
+  }
+  if (f->swaps) {
+    ereport(mem_free(&f->swaps));
+  }
+  ereport(mem_free(fp));
+  return eok();
+}
+
+NODISCARD error fft_create(struct fft **const fp, size_t const size) {
+  if (!fp || *fp || size < 8 || (size & (size - 1)) != 0 || size > UINT32_MAX) {
+    return errg(err_invalid_arugment);
+  }
+  error err = mem(fp, 1, sizeof(struct fft));
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  struct fft *const f = *fp;
+  *f = (struct fft){
+      .size = size,
+      .half = size / 2,
+  };
+  size_t const n = f->half;
+  size_t const rt_len = (n / 2 + 4) & ~(size_t)3;
+  err = mem_aligned_alloc(&f->tw_re, n * 2 + rt_len * 2, sizeof(float), 16);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  f->tw_im = f->tw_re + n;
+  f->rt_re = f->tw_im + n;
+  f->rt_im = f->rt_re + rt_len;
+  static double const pi = 3.14159265358979323846264338327950288;
+  for (size_t h = 1; h < n; h *= 2) {
+    for (size_t j = 0; j < h; ++j) {
+      f->tw_re[h + j] = (float)cos(-pi * (double)j / (double)h);
+      f->tw_im[h + j] = (float)sin(-pi * (double)j / (double)h);
+    }
+  }
+  f->tw_re[0] = 1.f;
+  f->tw_im[0] = 0.f;
+  for (size_t k = 0; k <= n / 2; ++k) {
+    f->rt_re[k] = (float)cos(-2.0 * pi * (double)k / (double)size);
+    f->rt_im[k] = (float)sin(-2.0 * pi * (double)k / (double)size);
+  }
+
+  size_t bits = 0;
+  while (((size_t)1 << bits) < n) {
+    ++bits;
+  }
+  err = mem(&f->swaps, n, sizeof(uint32_t));
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    size_t r = 0;
+    for (size_t b = 0; b < bits; ++b) {
+      r |= ((i >> b) & 1) << (bits - 1 - b);
+    }
+    if (i < r) {
+      f->swaps[f->num_swaps++] = (uint32_t)i;
+      f->swaps[f->num_swaps++] = (uint32_t)r;
+    }
+  }
+
+cleanup:
+  if (efailed(err)) {
+    if (*fp) {
+      ereport(fft_destroy(fp));
+    }
+  }
+  return err;
+}
+
+size_t fft_get_size(struct fft const *const f) { return f->size; }
+
+static void permute(struct fft const *const f, float *restrict const re, float *restrict const im) {
+  uint32_t const *const s = f->swaps;
+  for (size_t i = 0; i < f->num_swaps; i += 2) {
+    size_t const a = s[i], b = s[i + 1];
+    float const tr = re[a], ti = im[a];
+    re[a] = re[b];
+    im[a] = im[b];
+    re[b] = tr;
+    im[b] = ti;
+  }
+}
+
+// In-place radix-2 decimation-in-time complex FFT on bit-reversed input.
+static void transform(struct fft const *const f, float *restrict const re, float *restrict const im) {
+  size_t const n = f->half;
+  for (size_t i = 0; i < n; i += 4) {
+    // the first two stages only need the twiddles 1 and -i
+    float const r0 = re[i] + re[i + 1], i0 = im[i] + im[i + 1];
+    float const r1 = re[i] - re[i + 1], i1 = im[i] - im[i + 1];
+    float const r2 = re[i + 2] + re[i + 3], i2 = im[i + 2] + im[i + 3];
+    float const r3 = re[i + 2] - re[i + 3], i3 = im[i + 2] - im[i + 3];
+    re[i] = r0 + r2;
+    im[i] = i0 + i2;
+    re[i + 2] = r0 - r2;
+    im[i + 2] = i0 - i2;
+    re[i + 1] = r1 + i3;
+    im[i + 1] = i1 - r3;
+    re[i + 3] = r1 - i3;
+    im[i + 3] = i1 + r3;
+  }
+  for (size_t h = 4; h < n; h *= 2) {
+    float const *const wr = f->tw_re + h;
+    float const *const wi = f->tw_im + h;
+    for (size_t i = 0; i < n; i += h * 2) {
+      float *restrict const ar = re + i;
+      float *restrict const ai = im + i;
+      float *restrict const br = re + i + h;
+      float *restrict const bi = im + i + h;
+      for (size_t j = 0; j < h; j += 4) {
+        __m128 const twr = _mm_load_ps(wr + j);
+        __m128 const twi = _mm_load_ps(wi + j);
+        __m128 const xr = _mm_loadu_ps(br + j);
+        __m128 const xi = _mm_loadu_ps(bi + j);
+        __m128 const tr = _mm_sub_ps(_mm_mul_ps(xr, twr), _mm_mul_ps(xi, twi));
+        __m128 const ti = _mm_add_ps(_mm_mul_ps(xr, twi), _mm_mul_ps(xi, twr));
+        __m128 const yr = _mm_loadu_ps(ar + j);
+        __m128 const yi = _mm_loadu_ps(ai + j);
+        _mm_storeu_ps(ar + j, _mm_add_ps(yr, tr));
+        _mm_storeu_ps(ai + j, _mm_add_ps(yi, ti));
+        _mm_storeu_ps(br + j, _mm_sub_ps(yr, tr));
+        _mm_storeu_ps(bi + j, _mm_sub_ps(yi, ti));
+      }
+    }
+  }
+}
+
+void fft_forward(struct fft const *const f,
+                 float const *restrict const input,
+                 float *restrict const re,
+                 float *restrict const im) {
+  size_t const n = f->half;
+  // pack even and odd samples into one complex sequence of half the length
+  for (size_t i = 0; i < n; ++i) {
+    re[i] = input[i * 2];
+    im[i] = input[i * 2 + 1];
+  }
+  permute(f, re, im);
+  transform(f, re, im);
+  float const z0r = re[0], z0i = im[0];
+  re[0] = z0r + z0i;
+  im[0] = z0r - z0i;
+  for (size_t k = 1, nk = n - 1; k <= nk; ++k, --nk) {
+    // X[k] = E + W^k O and X[n-k] = conj(E - W^k O),
+    // where E and O are the spectra of the even and odd samples recovered from Z[k] and conj(Z[n-k])
+    float const er = (re[k] + re[nk]) * 0.5f, ei = (im[k] - im[nk]) * 0.5f;
+    float const odr = (im[k] + im[nk]) * 0.5f, odi = (re[nk] - re[k]) * 0.5f;
+    float const wr = f->rt_re[k], wi = f->rt_im[k];
+    float const tr = wr * odr - wi * odi, ti = wr * odi + wi * odr;
+    re[k] = er + tr;
+    im[k] = ei + ti;
+    re[nk] = er - tr;
+    im[nk] = ti - ei;
+  }
+}
+
+void fft_inverse(struct fft const *const f,
+                 float *restrict const re,
+                 float *restrict const im,
+                 float *restrict const output) {
+  size_t const n = f->half;
+  float const x0 = re[0], xn = im[0];
+  re[0] = (x0 + xn) * 0.5f;
+  im[0] = (xn - x0) * 0.5f; // conjugated for the inverse through the forward transform
+  for (size_t k = 1, nk = n - 1; k <= nk; ++k, --nk) {
+    float const er = (re[k] + re[nk]) * 0.5f, ei = (im[k] - im[nk]) * 0.5f;
+    float const dr = (re[k] - re[nk]) * 0.5f, di = (im[k] + im[nk]) * 0.5f;
+    float const wr = f->rt_re[k], wi = f->rt_im[k];
+    float const odr = wr * dr + wi * di, odi = wr * di - wi * dr;
+    // Z[k] = E + iO and Z[n-k] = conj(E - iO), both stored conjugated
+    re[k] = er - odi;
+    im[k] = -(ei + odr);
+    re[nk] = er + odi;
+    im[nk] = ei - odr;
+  }
+  permute(f, re, im);
+  transform(f, re, im);
+  for (size_t i = 0; i < n; ++i) {
+    output[i * 2] = re[i];
+    output[i * 2 + 1] = -im[i];
+  }
+}
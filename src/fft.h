@@ -0,0 +1,24 @@
+#pragma once
+
+#include "ovbase.h"
+
+struct fft;
+
+// Real-input FFT of a power-of-two size.
+// Spectra are stored in split form as size / 2 bins of re and im,
+// bin 0 is packed: re[0] holds the DC and im[0] holds the Nyquist component, both real.
+// The tables are read only after creation, so one instance can be shared between threads.
+NODISCARD error fft_create(struct fft **const fp, size_t const size);
+NODISCARD error fft_destroy(struct fft **const fp);
+
+size_t fft_get_size(struct fft const *const f);
+
+void fft_forward(struct fft const *const f,
+                 float const *restrict const input,
+                 float *restrict const re,
+                 float *restrict const im);
+// The output is scaled by size / 2. re and im are used as work area and destroyed.
+void fft_inverse(struct fft const *const f,
+                 float *restrict const re,
+                 float *restrict const im,
+                 float *restrict const output);
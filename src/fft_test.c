@@ -0,0 +1,82 @@
+#include "fft.c"
+
+#include "ovtest.h"
+
+enum {
+  max_size = 4096,
+};
+
+static float g_input[max_size];
+static float g_output[max_size];
+static float g_re[max_size / 2];
+static float g_im[max_size / 2];
+
+static void generate_noise(size_t const size) {
+  uint32_t t = (uint32_t)get_global_hint();
+  static float const divider = 1.f / (float)(UINT32_MAX);
+  for (size_t i = 0; i < size; ++i) {
+    g_input[i] = (float)(ov_splitmix32(t)) * divider * 2.f - 1.f;
+    t = ov_splitmix32_next(t);
+  }
+}
+
+static void test_forward(void) {
+  static double const pi = 3.14159265358979323846264338327950288;
+  for (size_t size = 8; size <= max_size; size *= 2) {
+    struct fft *f = NULL;
+    TEST_SUCCEEDED_F(fft_create(&f, size));
+    generate_noise(size);
+    fft_forward(f, g_input, g_re, g_im);
+    double max_diff = 0;
+    for (size_t k = 0; k <= size / 2; ++k) {
+      double re = 0, im = 0;
+      for (size_t i = 0; i < size; ++i) {
+        double const a = -2.0 * pi * (double)((k * i) % size) / (double)size;
+        re += (double)g_input[i] * cos(a);
+        im += (double)g_input[i] * sin(a);
+      }
+      double const gre = k == size / 2 ? (double)g_im[0] : (double)g_re[k];
+      double const gim = k == 0 || k == size / 2 ? 0.0 : (double)g_im[k];
+      max_diff = fmax(max_diff, fmax(fabs(gre - re), fabs(gim - im)));
+    }
+    TEST_CHECK(max_diff < 1e-4 * sqrt((double)size));
+    TEST_MSG("size %zu max diff %g", size, max_diff);
+    TEST_SUCCEEDED_F(fft_destroy(&f));
+  }
+}
+
+static void test_round_trip(void) {
+  for (size_t size = 8; size <= max_size; size *= 2) {
+    struct fft *f = NULL;
+    TEST_SUCCEEDED_F(fft_create(&f, size));
+    generate_noise(size);
+    fft_forward(f, g_input, g_re, g_im);
+    fft_inverse(f, g_re, g_im, g_output);
+    float const scale = 2.f / (float)size;
+    float max_diff = 0;
+    for (size_t i = 0; i < size; ++i) {
+      max_diff = fmaxf(max_diff, fabsf(g_output[i] * scale - g_input[i]));
+    }
+    TEST_CHECK(max_diff < 1e-5f);
+    TEST_MSG("size %zu max diff %g", size, (double)max_diff);
+    TEST_SUCCEEDED_F(fft_destroy(&f));
+  }
+}
+
+static void bench_round_trip(void) {
+  struct fft *f = NULL;
+  TEST_SUCCEEDED_F(fft_create(&f, 512));
+  generate_noise(512);
+  for (size_t i = 0; i < 20000; ++i) {
+    fft_forward(f, g_input, g_re, g_im);
+    fft_inverse(f, g_re, g_im, g_output);
+  }
+  TEST_SUCCEEDED_F(fft_destroy(&f));
+}
+
+TEST_LIST = {
+    {"test_forward", test_forward},
+    {"test_round_trip", test_round_trip},
+    {"bench_round_trip", bench_round_trip},
+    {NULL, NULL},
+};
@@ -0,0 +1,166 @@
+#include "halfband.h"
+
+#include <xmmintrin.h>
+
+enum {
+  num_taps = 16,     // taps of the odd phase, the even phase only has the center tap
+  center_delay = 7,  // delay of the center tap in half-rate samples
+  chunk_size = 64,   // must be a multiple of 4
+  history = num_taps - 1,
+};
+
+// 31-tap Kaiser-windowed (beta = 7) half-band lowpass, every other tap except the center is zero.
+// Flat to 0.18 fs and more than 56 dB down above 0.32 fs.
+static float const coefficients[num_taps] = {
+    -0.000125861305f, 0.00106450368f, -0.00377247227f, 0.00980408201f, -0.0215919023f, 0.0439889791f,
+    -0.0930905437f,   0.313737466f,   0.313737466f,    -0.0930905437f, 0.0439889791f,  -0.0215919023f,
+    0.00980408201f,   -0.00377247227f, 0.00106450368f, -0.000125861305f,
+};
+
+struct state {
+  float odd[history + chunk_size + 4];     // odd phase input history for the decimator
+  float even[center_delay + chunk_size];   // even phase input delayed to the center tap
+  float up[history + chunk_size + 4];      // half-rate input history for the interpolator
+  float pending;                           // input sample waiting for its pair
+  float carry;                             // output sample that did not fit into the previous block
+};
+
+struct states {
+  struct state *ptr;
+  size_t len;
+  size_t cap;
+};
+
+struct halfband {
+  struct states states;
+  bool pending;
+  bool carried;
+};
+
+NODISCARD error halfband_create(struct halfband **const hp) {
+  if (!hp || *hp) {
+    return errg(err_invalid_arugment);
+  }
+  error err = mem(hp, 1, sizeof(struct halfband));
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  **hp = (struct halfband){0};
+  return eok();
+}
+
+NODISCARD error halfband_destroy(struct halfband **const hp) {
+  if (!hp || !*hp) {
+    return errg(err_invalid_arugment);
+  }
+  ereport(afree(&(*hp)->states));
+  ereport(mem_free(hp));
+  return eok();
+}
+
+NODISCARD error halfband_set_format(struct halfband *const h, size_t const channels) {
+  if (h->states.len == channels) {
+    return eok();
+  }
+  error err = agrow(&h->states, channels);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  h->states.len = channels;
+  halfband_clear(h);
+  return eok();
+}
+
+// y[k] = sum(coefficients[i] * x[k + i]) for k < n, four outputs at a time.
+// y must have room for n rounded up to a multiple of 4.
+static inline void fir(float const *restrict const x, float *restrict const y, size_t const n) {
+  for (size_t k = 0; k < n; k += 4) {
+    __m128 acc = _mm_setzero_ps();
+    for (size_t i = 0; i < num_taps; ++i) {
+      acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(coefficients[i]), _mm_loadu_ps(x + k + i)));
+    }
+    _mm_storeu_ps(y + k, acc);
+  }
+}
+
+size_t halfband_decimate(struct halfband *const h,
+                         float const *restrict const *const inputs,
+                         float *restrict const *const outputs,
+                         size_t const samples) {
+  size_t const p = h->pending ? 1 : 0;
+  size_t const total = p + samples;
+  size_t const n = total / 2;
+  float tmp[chunk_size];
+  for (size_t ch = 0; ch < h->states.len; ++ch) {
+    struct state *const st = h->states.ptr + ch;
+    float const *restrict const x = inputs[ch];
+    float *restrict const y = outputs[ch];
+    float *restrict const odd = st->odd + history;
+    float *restrict const even = st->even + center_delay;
+    for (size_t m0 = 0; m0 < n; m0 += chunk_size) {
+      size_t const cn = n - m0 < chunk_size ? n - m0 : chunk_size;
+      for (size_t k = 0; k < cn; ++k) {
+        size_t const s = (m0 + k) * 2;
+        even[k] = p && s == 0 ? st->pending : x[s - p];
+        odd[k] = x[s + 1 - p];
+      }
+      fir(st->odd, tmp, cn);
+      for (size_t k = 0; k < cn; ++k) {
+        y[m0 + k] = tmp[k] + 0.5f * st->even[k];
+      }
+      memmove(st->odd, st->odd + cn, history * sizeof(float));
+      memmove(st->even, st->even + cn, center_delay * sizeof(float));
+    }
+    if (total & 1) {
+      st->pending = x[samples - 1];
+    }
+  }
+  h->pending = total & 1;
+  return n;
+}
+
+void halfband_interpolate(struct halfband *const h,
+                          float const *restrict const *const inputs,
+                          size_t const half_samples,
+                          float *restrict const *const outputs,
+                          size_t const samples) {
+  bool carried = false;
+  float tmp[chunk_size];
+  for (size_t ch = 0; ch < h->states.len; ++ch) {
+    struct state *const st = h->states.ptr + ch;
+    float const *restrict const x = inputs[ch];
+    float *restrict const y = outputs[ch];
+    size_t o = 0;
+    carried = false;
+    if (h->carried && samples) {
+      y[o++] = st->carry;
+    }
+    for (size_t m0 = 0; m0 < half_samples; m0 += chunk_size) {
+      size_t const cn = half_samples - m0 < chunk_size ? half_samples - m0 : chunk_size;
+      memcpy(st->up + history, x + m0, cn * sizeof(float));
+      fir(st->up, tmp, cn);
+      for (size_t k = 0; k < cn && o < samples; ++k) {
+        // the even output sums the odd taps, the odd output is the center tap alone
+        y[o++] = 2.f * tmp[k];
+        float const center = st->up[k + history - center_delay];
+        if (o < samples) {
+          y[o++] = center;
+        } else {
+          st->carry = center;
+          carried = true;
+        }
+      }
+      memmove(st->up, st->up + cn, history * sizeof(float));
+    }
+  }
+  h->carried = carried;
+}
+
+void halfband_clear(struct halfband *const h) {
+  memset(h->states.ptr, 0, sizeof(struct state) * h->states.len);
+  // Starts one output sample ahead so that the first block with an odd length still fills its output.
+  h->pending = false;
+  h->carried = true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "ovbase.h"
+
+struct halfband;
+
+// Half-band resampler pair for running a processor at half the sample rate.
+// halfband_decimate turns a full-rate block into half-rate samples and halfband_interpolate turns them back.
+// Odd-sized blocks are handled by carrying one sample over to the next call,
+// so the round trip always produces exactly as many samples as were passed in.
+NODISCARD error halfband_create(struct halfband **const hp);
+NODISCARD error halfband_destroy(struct halfband **const hp);
+
+NODISCARD error halfband_set_format(struct halfband *const h, size_t const channels);
+
+// Returns the number of half-rate samples written to outputs, at most (samples + 1) / 2.
+size_t halfband_decimate(struct halfband *const h,
+                         float const *restrict const *const inputs,
+                         float *restrict const *const outputs,
+                         size_t const samples);
+// inputs must be the half_samples produced by the halfband_decimate call for the same block of samples.
+void halfband_interpolate(struct halfband *const h,
+                          float const *restrict const *const inputs,
+                          size_t const half_samples,
+                          float *restrict const *const outputs,
+                          size_t const samples);
+void halfband_clear(struct halfband *const h);
@@ -0,0 +1,133 @@
+#include "halfband.c"
+
+#include "ovtest.h"
+
+#include <math.h>
+
+enum {
+  test_channels = 2,
+  test_samples = 4800,
+  test_half_samples = test_samples / 2 + 1,
+};
+
+static float g_input[test_channels][test_samples];
+static float g_half[test_channels][test_half_samples];
+static float g_output[test_channels][test_samples];
+static float g_reference[test_channels][test_samples];
+
+static float const *const g_inputs[test_channels] = {g_input[0], g_input[1]};
+static float *const g_halves[test_channels] = {g_half[0], g_half[1]};
+static float *const g_outputs[test_channels] = {g_output[0], g_output[1]};
+static float *const g_references[test_channels] = {g_reference[0], g_reference[1]};
+
+static void f(float v) { (void)v; }
+
+static void generate_sine(float const frequency) {
+  static float const pi = 3.14159265358979323846264338327950288f;
+  for (size_t ch = 0; ch < test_channels; ++ch) {
+    for (size_t i = 0; i < test_samples; ++i) {
+      g_input[ch][i] = 0.5f * sinf(2.f * pi * frequency * (float)i / 48000.f + (float)ch);
+    }
+  }
+}
+
+static void generate_noise(void) {
+  uint32_t t = (uint32_t)get_global_hint();
+  static float const divider = 1.f / (float)(UINT32_MAX);
+  for (size_t ch = 0; ch < test_channels; ++ch) {
+    for (size_t i = 0; i < test_samples; ++i) {
+      g_input[ch][i] = (float)(ov_splitmix32(t)) * divider * 2.f - 1.f;
+      t = ov_splitmix32_next(t);
+    }
+  }
+}
+
+static void round_trip(struct halfband *const h, float *const *const outputs, size_t const block) {
+  for (size_t pos = 0; pos < test_samples; pos += block) {
+    size_t const n = test_samples - pos < block ? test_samples - pos : block;
+    float const *in[test_channels] = {g_input[0] + pos, g_input[1] + pos};
+    float *out[test_channels] = {outputs[0] + pos, outputs[1] + pos};
+    size_t const hn = halfband_decimate(h, (float const *restrict const *)in, g_halves, n);
+    TEST_CHECK(hn <= (n + 1) / 2);
+    halfband_interpolate(h, (float const *restrict const *)g_halves, hn, out, n);
+  }
+}
+
+// Low frequencies pass through unchanged apart from the latency of both filters.
+static void test_round_trip(void) {
+  static size_t const latency = 30;
+  static size_t const settle = 64;
+  struct halfband *h = NULL;
+  TEST_SUCCEEDED_F(halfband_create(&h));
+  TEST_SUCCEEDED_F(halfband_set_format(h, test_channels));
+  generate_sine(1000.f);
+  round_trip(h, g_outputs, test_samples);
+  float dev = 0.f;
+  for (size_t ch = 0; ch < test_channels; ++ch) {
+    for (size_t i = latency + settle; i < test_samples; ++i) {
+      dev = fmaxf(dev, fabsf(g_output[ch][i] - g_input[ch][i - latency]));
+    }
+  }
+  TEST_CHECK(dev < 1e-3f);
+  TEST_MSG("max deviation %g", (double)dev);
+  TEST_SUCCEEDED_F(halfband_destroy(&h));
+}
+
+// Odd and uneven block sizes must give the same result as a single block.
+static void test_block_sizes(void) {
+  static size_t const blocks[] = {1, 2, 3, 63, 64, 65, 127, 801};
+  struct halfband *h = NULL;
+  TEST_SUCCEEDED_F(halfband_create(&h));
+  TEST_SUCCEEDED_F(halfband_set_format(h, test_channels));
+  generate_noise();
+  round_trip(h, g_references, test_samples);
+  for (size_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); ++b) {
+    halfband_clear(h);
+    round_trip(h, g_outputs, blocks[b]);
+    float dev = 0.f;
+    for (size_t ch = 0; ch < test_channels; ++ch) {
+      for (size_t i = 0; i < test_samples; ++i) {
+        dev = fmaxf(dev, fabsf(g_output[ch][i] - g_reference[ch][i]));
+      }
+    }
+    TEST_CHECK(dev < 1e-6f);
+    TEST_MSG("block %zu: max deviation %g", blocks[b], (double)dev);
+  }
+  TEST_SUCCEEDED_F(halfband_destroy(&h));
+}
+
+// Content above a quarter of the sample rate must not fold back into the half-rate signal.
+static void test_alias_rejection(void) {
+  struct halfband *h = NULL;
+  TEST_SUCCEEDED_F(halfband_create(&h));
+  TEST_SUCCEEDED_F(halfband_set_format(h, test_channels));
+  generate_sine(17000.f);
+  size_t const hn = halfband_decimate(h, (float const *restrict const *)g_inputs, g_halves, test_samples);
+  float peak = 0.f;
+  for (size_t i = 64; i < hn; ++i) {
+    peak = fmaxf(peak, fabsf(g_half[0][i]));
+  }
+  TEST_CHECK(peak < 0.5f * 0.002f); // -54dB
+  TEST_MSG("peak %g", (double)peak);
+  TEST_SUCCEEDED_F(halfband_destroy(&h));
+}
+
+static void bench_round_trip(void) {
+  struct halfband *h = NULL;
+  TEST_SUCCEEDED_F(halfband_create(&h));
+  TEST_SUCCEEDED_F(halfband_set_format(h, test_channels));
+  generate_noise();
+  for (int n = 0; n < 1000; ++n) {
+    round_trip(h, g_outputs, 1601);
+  }
+  f(g_output[0][0]);
+  TEST_SUCCEEDED_F(halfband_destroy(&h));
+}
+
+TEST_LIST = {
+    {"test_round_trip", test_round_trip},
+    {"test_block_sizes", test_block_sizes},
+    {"test_alias_rejection", test_alias_rejection},
+    {"bench_round_trip", bench_round_trip},
+    {NULL, NULL},
+};
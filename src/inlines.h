@@ -4,6 +4,11 @@
 
 #include "ovbase.h"
 
+#if defined(__SSE2__) || defined(__AVX__) || defined(__AVX512F__)
+#  include <immintrin.h>
+#endif
+
+#include "chspec.h"
 #include "dither.h"
 
 static inline int maxi(int const a, int const b) { return a > b ? a : b; }
@@ -31,6 +36,17 @@ static inline void clear(float *restrict const *const outputs, size_t const chan
   }
 }
 
+static inline float find_peak(float const *restrict const *const inputs, size_t const channels, size_t const samples) {
+  float r = 0.f;
+  for (size_t ch = 0; ch < channels; ++ch) {
+    float const *restrict const i = inputs[ch];
+    for (size_t pos = 0; pos < samples; ++pos) {
+      r = fmaxf(r, fabsf(i[pos]));
+    }
+  }
+  return r;
+}
+
 static inline void mix(float *restrict const *const outputs,
                        float const *restrict const *const inputs,
                        size_t const channels,
@@ -38,22 +54,60 @@ static inline void mix(float *restrict const *const outputs,
   for (size_t ch = 0; ch < channels; ++ch) {
     float const *restrict const i = inputs[ch];
     float *restrict const o = outputs[ch];
-    for (size_t pos = 0; pos < samples; ++pos) {
+    size_t pos = 0;
+#ifdef __AVX512F__
+    for (; pos + 16 <= samples; pos += 16) {
+      _mm512_storeu_ps(o + pos, _mm512_add_ps(_mm512_loadu_ps(o + pos), _mm512_loadu_ps(i + pos)));
+    }
+#endif
+#ifdef __AVX__
+    for (; pos + 8 <= samples; pos += 8) {
+      _mm256_storeu_ps(o + pos, _mm256_add_ps(_mm256_loadu_ps(o + pos), _mm256_loadu_ps(i + pos)));
+    }
+#endif
+#ifdef __SSE2__
+    for (; pos + 4 <= samples; pos += 4) {
+      _mm_storeu_ps(o + pos, _mm_add_ps(_mm_loadu_ps(o + pos), _mm_loadu_ps(i + pos)));
+    }
+#endif
+    for (; pos < samples; ++pos) {
       o[pos] += i[pos];
     }
   }
 }
 
-static inline void mix_with_gain(float *restrict const *const outputs,
-                                 float const *restrict const *const inputs,
-                                 float const gain_db,
-                                 size_t const channels,
-                                 size_t const samples) {
-  float const m = db_to_amp(gain_db);
+static inline void mix_with_amp(float *restrict const *const outputs,
+                                float const *restrict const *const inputs,
+                                float const m,
+                                size_t const channels,
+                                size_t const samples) {
   for (size_t ch = 0; ch < channels; ++ch) {
     float const *restrict const i = inputs[ch];
     float *restrict const o = outputs[ch];
-    for (size_t pos = 0; pos < samples; ++pos) {
+    size_t pos = 0;
+#ifdef __AVX512F__
+    __m512 const m16 = _mm512_set1_ps(m);
+    for (; pos + 16 <= samples; pos += 16) {
+      _mm512_storeu_ps(o + pos, _mm512_fmadd_ps(_mm512_loadu_ps(i + pos), m16, _mm512_loadu_ps(o + pos)));
+    }
+#endif
+#ifdef __AVX__
+    __m256 const m8 = _mm256_set1_ps(m);
+    for (; pos + 8 <= samples; pos += 8) {
+#  ifdef __FMA__
+      _mm256_storeu_ps(o + pos, _mm256_fmadd_ps(_mm256_loadu_ps(i + pos), m8, _mm256_loadu_ps(o + pos)));
+#  else
+      _mm256_storeu_ps(o + pos, _mm256_add_ps(_mm256_loadu_ps(o + pos), _mm256_mul_ps(_mm256_loadu_ps(i + pos), m8)));
+#  endif
+    }
+#endif
+#ifdef __SSE2__
+    __m128 const m4 = _mm_set1_ps(m);
+    for (; pos + 4 <= samples; pos += 4) {
+      _mm_storeu_ps(o + pos, _mm_add_ps(_mm_loadu_ps(o + pos), _mm_mul_ps(_mm_loadu_ps(i + pos), m4)));
+    }
+#endif
+    for (; pos < samples; ++pos) {
       o[pos] += i[pos] * m;
     }
   }
@@ -68,7 +122,26 @@ static inline void gain(float *restrict const *const outputs,
   for (size_t ch = 0; ch < channels; ++ch) {
     float const *restrict const i = inputs[ch];
     float *restrict const o = outputs[ch];
-    for (size_t pos = 0; pos < samples; ++pos) {
+    size_t pos = 0;
+#ifdef __AVX512F__
+    __m512 const g16 = _mm512_set1_ps(g);
+    for (; pos + 16 <= samples; pos += 16) {
+      _mm512_storeu_ps(o + pos, _mm512_mul_ps(_mm512_loadu_ps(i + pos), g16));
+    }
+#endif
+#ifdef __AVX__
+    __m256 const g8 = _mm256_set1_ps(g);
+    for (; pos + 8 <= samples; pos += 8) {
+      _mm256_storeu_ps(o + pos, _mm256_mul_ps(_mm256_loadu_ps(i + pos), g8));
+    }
+#endif
+#ifdef __SSE2__
+    __m128 const g4 = _mm_set1_ps(g);
+    for (; pos + 4 <= samples; pos += 4) {
+      _mm_storeu_ps(o + pos, _mm_mul_ps(_mm_loadu_ps(i + pos), g4));
+    }
+#endif
+    for (; pos < samples; ++pos) {
       o[pos] = i[pos] * g;
     }
   }
@@ -96,20 +169,53 @@ static inline void stereo_pan_and_gain(float *restrict const *const outputs,
   float const rl = 1.f - ll;
   float const lr = 1.f - rr;
 
-  float s0, s1;
-  for (size_t pos = 0; pos < samples; ++pos) {
-    s0 = i0[pos];
-    s1 = i1[pos];
-    o0[pos] = (s0 * ll + s1 * rl) * l;
-    o1[pos] = (s0 * lr + s1 * rr) * r;
+  // o0 = (s0 * ll + s1 * rl) * l, o1 = (s0 * lr + s1 * rr) * r
+  float const a = ll * l;
+  float const b = rl * l;
+  float const c = lr * r;
+  float const d = rr * r;
+  size_t pos = 0;
+#ifdef __AVX512F__
+  __m512 const a16 = _mm512_set1_ps(a), b16 = _mm512_set1_ps(b), c16 = _mm512_set1_ps(c), d16 = _mm512_set1_ps(d);
+  for (; pos + 16 <= samples; pos += 16) {
+    __m512 const s0 = _mm512_loadu_ps(i0 + pos);
+    __m512 const s1 = _mm512_loadu_ps(i1 + pos);
+    _mm512_storeu_ps(o0 + pos, _mm512_fmadd_ps(s1, b16, _mm512_mul_ps(s0, a16)));
+    _mm512_storeu_ps(o1 + pos, _mm512_fmadd_ps(s1, d16, _mm512_mul_ps(s0, c16)));
+  }
+#endif
+#ifdef __AVX__
+  __m256 const a8 = _mm256_set1_ps(a), b8 = _mm256_set1_ps(b), c8 = _mm256_set1_ps(c), d8 = _mm256_set1_ps(d);
+  for (; pos + 8 <= samples; pos += 8) {
+    __m256 const s0 = _mm256_loadu_ps(i0 + pos);
+    __m256 const s1 = _mm256_loadu_ps(i1 + pos);
+    _mm256_storeu_ps(o0 + pos, _mm256_add_ps(_mm256_mul_ps(s0, a8), _mm256_mul_ps(s1, b8)));
+    _mm256_storeu_ps(o1 + pos, _mm256_add_ps(_mm256_mul_ps(s0, c8), _mm256_mul_ps(s1, d8)));
+  }
+#endif
+#ifdef __SSE2__
+  __m128 const a4 = _mm_set1_ps(a), b4 = _mm_set1_ps(b), c4 = _mm_set1_ps(c), d4 = _mm_set1_ps(d);
+  for (; pos + 4 <= samples; pos += 4) {
+    __m128 const s0 = _mm_loadu_ps(i0 + pos);
+    __m128 const s1 = _mm_loadu_ps(i1 + pos);
+    _mm_storeu_ps(o0 + pos, _mm_add_ps(_mm_mul_ps(s0, a4), _mm_mul_ps(s1, b4)));
+    _mm_storeu_ps(o1 + pos, _mm_add_ps(_mm_mul_ps(s0, c4), _mm_mul_ps(s1, d4)));
+  }
+#endif
+  for (; pos < samples; ++pos) {
+    float const s0 = i0[pos];
+    float const s1 = i1[pos];
+    o0[pos] = s0 * a + s1 * b;
+    o1[pos] = s0 * c + s1 * d;
   }
 }
 
-static inline void interleaved_int16_to_float_generic(float *restrict const *const dest,
-                                                      int16_t const *restrict const src,
-                                                      size_t const channels,
-                                                      size_t const samples) {
-  static float const m = 1.f / 32768.f;
+static inline __attribute__((always_inline)) void
+interleaved_int16_to_float_generic(float *restrict const *const dest,
+                                   int16_t const *restrict const src,
+                                   float const m,
+                                   size_t const channels,
+                                   size_t const samples) {
   for (size_t i = 0; i < samples; ++i) {
     for (size_t ch = 0; ch < channels; ++ch) {
       dest[ch][i] = (float)(src[i * channels + ch]) * m;
@@ -119,12 +225,38 @@ static inline void interleaved_int16_to_float_generic(float *restrict const *con
 
 static inline void interleaved_int16_to_float_stereo(float *restrict const *const dest,
                                                      int16_t const *restrict const src,
+                                                     float const m,
                                                      size_t const samples) {
   int16_t const *restrict sp = src;
   float *restrict const dp0 = dest[0];
   float *restrict const dp1 = dest[1];
-  static float const m = 1.f / 32768.f;
-  for (size_t i = 0; i < samples; ++i) {
+  size_t i = 0;
+  // each 32-bit lane holds one frame, the left sample in the low half
+#ifdef __AVX512F__
+  __m512 const m16 = _mm512_set1_ps(m);
+  for (; i + 16 <= samples; i += 16) {
+    __m512i const v = _mm512_loadu_si512((void const *)(sp + i * 2));
+    _mm512_storeu_ps(dp0 + i, _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_srai_epi32(_mm512_slli_epi32(v, 16), 16)), m16));
+    _mm512_storeu_ps(dp1 + i, _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_srai_epi32(v, 16)), m16));
+  }
+#endif
+#ifdef __AVX2__
+  __m256 const m8 = _mm256_set1_ps(m);
+  for (; i + 8 <= samples; i += 8) {
+    __m256i const v = _mm256_loadu_si256((void const *)(sp + i * 2));
+    _mm256_storeu_ps(dp0 + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16)), m8));
+    _mm256_storeu_ps(dp1 + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(v, 16)), m8));
+  }
+#endif
+#ifdef __SSE2__
+  __m128 const m4 = _mm_set1_ps(m);
+  for (; i + 4 <= samples; i += 4) {
+    __m128i const v = _mm_loadu_si128((void const *)(sp + i * 2));
+    _mm_storeu_ps(dp0 + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(v, 16), 16)), m4));
+    _mm_storeu_ps(dp1 + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(v, 16)), m4));
+  }
+#endif
+  for (; i < samples; ++i) {
     dp0[i] = (float)(sp[i * 2 + 0]) * m;
     dp1[i] = (float)(sp[i * 2 + 1]) * m;
   }
@@ -132,42 +264,106 @@ static inline void interleaved_int16_to_float_stereo(float *restrict const *cons
 
 static inline void interleaved_int16_to_float_mono(float *restrict const *const dest,
                                                    int16_t const *restrict const src,
+                                                   float const m,
                                                    size_t const samples) {
   int16_t const *restrict sp = src;
   float *restrict const dp0 = dest[0];
-  static float const m = 1.f / 32768.f;
-  for (size_t i = 0; i < samples; ++i) {
+  size_t i = 0;
+#ifdef __AVX512F__
+  __m512 const m16 = _mm512_set1_ps(m);
+  for (; i + 16 <= samples; i += 16) {
+    __m256i const v = _mm256_loadu_si256((void const *)(sp + i));
+    _mm512_storeu_ps(dp0 + i, _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(v)), m16));
+  }
+#endif
+#ifdef __AVX2__
+  __m256 const m8 = _mm256_set1_ps(m);
+  for (; i + 8 <= samples; i += 8) {
+    __m128i const v = _mm_loadu_si128((void const *)(sp + i));
+    _mm256_storeu_ps(dp0 + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v)), m8));
+  }
+#endif
+#ifdef __SSE2__
+  __m128 const m4 = _mm_set1_ps(m);
+  for (; i + 8 <= samples; i += 8) {
+    __m128i const v = _mm_loadu_si128((void const *)(sp + i));
+    // sign extension by placing each sample in the high half and shifting back
+    __m128i const lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    __m128i const hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    _mm_storeu_ps(dp0 + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), m4));
+    _mm_storeu_ps(dp0 + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), m4));
+  }
+#endif
+  for (; i < samples; ++i) {
     dp0[i] = (float)(sp[i]) * m;
   }
 }
 
-static inline void interleaved_int16_to_float(float *restrict const *const dest,
-                                              int16_t const *restrict const src,
-                                              size_t const channels,
-                                              size_t const samples) {
+// Same as interleaved_int16_to_float with every sample also multiplied by gain.
+static inline void interleaved_int16_to_float_with_gain(float *restrict const *const dest,
+                                                        int16_t const *restrict const src,
+                                                        float const gain,
+                                                        size_t const channels,
+                                                        size_t const samples) {
+  float const m = gain * (1.f / 32768.f);
   switch (channels) {
   case 1:
-    interleaved_int16_to_float_mono(dest, src, samples);
+    interleaved_int16_to_float_mono(dest, src, m, samples);
     break;
   case 2:
-    interleaved_int16_to_float_stereo(dest, src, samples);
+    interleaved_int16_to_float_stereo(dest, src, m, samples);
     break;
+#define X(n)                                                                                                           \
+  case n:                                                                                                              \
+    interleaved_int16_to_float_generic(dest, src, m, n, samples);                                                      \
+    break;
+    CHSPEC_EACH_MULTI(X)
+#undef X
   default:
-    interleaved_int16_to_float_generic(dest, src, channels, samples);
+    interleaved_int16_to_float_generic(dest, src, m, channels, samples);
     break;
   }
 }
 
+static inline void interleaved_int16_to_float(float *restrict const *const dest,
+                                              int16_t const *restrict const src,
+                                              size_t const channels,
+                                              size_t const samples) {
+  interleaved_int16_to_float_with_gain(dest, src, 1.f, channels, samples);
+}
+
+// The absolute peak of count interleaved samples on the scale of interleaved_int16_to_float.
+static inline float find_peak_int16(int16_t const *restrict const src, size_t const count) {
+  int hi = 0, lo = 0;
+  size_t i = 0;
+#ifdef __SSE2__
+  __m128i vhi = _mm_setzero_si128(), vlo = _mm_setzero_si128();
+  for (; i + 8 <= count; i += 8) {
+    __m128i const v = _mm_loadu_si128((void const *)(src + i));
+    vhi = _mm_max_epi16(vhi, v);
+    vlo = _mm_min_epi16(vlo, v);
+  }
+  int16_t h[8], l[8];
+  _mm_storeu_si128((void *)h, vhi);
+  _mm_storeu_si128((void *)l, vlo);
+  for (size_t k = 0; k < 8; ++k) {
+    hi = maxi(hi, h[k]);
+    lo = maxi(lo, -l[k]);
+  }
+#endif
+  for (; i < count; ++i) {
+    hi = maxi(hi, src[i]);
+    lo = maxi(lo, -src[i]);
+  }
+  return (float)maxi(hi, lo) * (1.f / 32768.f);
+}
+
 static inline float thru_dither(float x, struct dither *const ds, size_t const channel, float const scale) {
   (void)ds;
   (void)channel;
   return x * scale;
 }
 
-static inline float add_dither(float x, struct dither *const ds, size_t const channel, float const scale) {
-  return dither_process(x, ds, channel, scale);
-}
-
 static inline float clip_hard(float x) {
   if (x < -1.f) {
     x = -1.f;
@@ -189,80 +385,350 @@ static inline float clip_soft(float x) {
   return x - t * x * x * x;
 }
 
-static inline void float_to_interleaved_int16_generic(int16_t *restrict const dest,
-                                                      float const *restrict const *const src,
-                                                      struct dither *const ds,
-                                                      size_t const channels,
-                                                      size_t const samples) {
+#ifdef __SSE2__
+static inline __m128 clip_hard_sse2(__m128 const x) {
+  return _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.f)), _mm_set1_ps(1.f));
+}
+
+// clip_hard and the scaling of the scalar conversion, truncated toward zero like a cast
+static inline __m128i float_to_int32_sse2(__m128 const x) {
+  return _mm_cvttps_epi32(_mm_mul_ps(clip_hard_sse2(x), _mm_set1_ps(32767.f)));
+}
+#endif
+
+#ifdef __AVX2__
+static inline __m256 clip_hard_avx2(__m256 const x) {
+  return _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-1.f)), _mm256_set1_ps(1.f));
+}
+
+static inline __m256i float_to_int32_avx2(__m256 const x) {
+  return _mm256_cvttps_epi32(_mm256_mul_ps(clip_hard_avx2(x), _mm256_set1_ps(32767.f)));
+}
+#endif
+
+#ifdef __AVX512F__
+static inline __m512 clip_hard_avx512(__m512 const x) {
+  return _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(-1.f)), _mm512_set1_ps(1.f));
+}
+
+static inline __m512i float_to_int32_avx512(__m512 const x) {
+  return _mm512_cvttps_epi32(_mm512_mul_ps(clip_hard_avx512(x), _mm512_set1_ps(32767.f)));
+}
+#endif
+
+static inline float gained(float const *restrict const src, float const *restrict const gains, size_t const i) {
+  return gains ? src[i] * gains[i] : src[i];
+}
+
+#ifdef __SSE2__
+static inline __m128
+load_gained_sse2(float const *restrict const src, float const *restrict const gains, size_t const i) {
+  __m128 const x = _mm_loadu_ps(src + i);
+  return gains ? _mm_mul_ps(x, _mm_loadu_ps(gains + i)) : x;
+}
+#endif
+
+#ifdef __AVX__
+static inline __m256
+load_gained_avx(float const *restrict const src, float const *restrict const gains, size_t const i) {
+  __m256 const x = _mm256_loadu_ps(src + i);
+  return gains ? _mm256_mul_ps(x, _mm256_loadu_ps(gains + i)) : x;
+}
+#endif
+
+#ifdef __AVX512F__
+static inline __m512
+load_gained_avx512(float const *restrict const src, float const *restrict const gains, size_t const i) {
+  __m512 const x = _mm512_loadu_ps(src + i);
+  return gains ? _mm512_mul_ps(x, _mm512_loadu_ps(gains + i)) : x;
+}
+#endif
+
+// Noise shaping feeds every sample's error into the next one, so the channels share the vector instead of time.
+static inline __attribute__((always_inline)) void
+float_to_interleaved_int16_shaped(int16_t *restrict const dest,
+                                  float const *restrict const *const src,
+                                  float const *restrict const gains,
+                                  struct dither *const ds,
+                                  size_t const channels,
+                                  size_t const samples) {
+#ifdef __SSE2__
+  for (size_t base = 0; base < channels; base += 4) {
+    size_t const n = channels - base < 4 ? channels - base : 4;
+    uint32_t rng[4] = {1, 1, 1, 1};
+    float e0[4] = {0}, e1[4] = {0};
+    for (size_t c = 0; c < n; ++c) {
+      rng[c] = ds->ptr[base + c].rng[0];
+      e0[c] = ds->ptr[base + c].err[0];
+      e1[c] = ds->ptr[base + c].err[1];
+    }
+    __m128i r = _mm_loadu_si128((void const *)rng);
+    __m128 ve0 = _mm_loadu_ps(e0), ve1 = _mm_loadu_ps(e1);
+    for (size_t i = 0; i < samples; ++i) {
+      float x[4] = {0};
+      for (size_t c = 0; c < n; ++c) {
+        x[c] = gained(src[base + c], gains, i);
+      }
+      int32_t q[4];
+      _mm_storeu_si128((void *)q, dither_quantize_shaped_sse2(clip_hard_sse2(_mm_loadu_ps(x)), &r, &ve0, &ve1));
+      for (size_t c = 0; c < n; ++c) {
+        dest[i * channels + base + c] = (int16_t)q[c];
+      }
+    }
+    _mm_storeu_si128((void *)rng, r);
+    _mm_storeu_ps(e0, ve0);
+    _mm_storeu_ps(e1, ve1);
+    for (size_t c = 0; c < n; ++c) {
+      ds->ptr[base + c].rng[0] = rng[c];
+      ds->ptr[base + c].err[0] = e0[c];
+      ds->ptr[base + c].err[1] = e1[c];
+    }
+  }
+#else
+  for (size_t i = 0; i < samples; ++i) {
+    for (size_t ch = 0; ch < channels; ++ch) {
+      dest[i * channels + ch] = dither_quantize_shaped(clip_hard(gained(src[ch], gains, i)), ds->ptr + ch);
+    }
+  }
+#endif
+}
+
+static inline __attribute__((always_inline)) void
+float_to_interleaved_int16_generic(int16_t *restrict const dest,
+                                   float const *restrict const *const src,
+                                   float const *restrict const gains,
+                                   struct dither *const ds,
+                                   size_t const channels,
+                                   size_t const samples) {
   static float const m = 32767.f;
   if (ds) {
-    for (size_t i = 0; i < samples; ++i) {
-      for (size_t ch = 0; ch < channels; ++ch) {
-        dest[i * channels + ch] = (int16_t)(add_dither(clip_hard(src[ch][i]), ds, i, m));
+    for (size_t ch = 0; ch < channels; ++ch) {
+      struct dither_state *const st = ds->ptr + ch;
+      float const *restrict const sp = src[ch];
+      int16_t *restrict const dp = dest + ch;
+      size_t i = 0;
+#ifdef __SSE2__
+      __m128i rng = _mm_loadu_si128((void const *)st->rng);
+#  ifdef __AVX2__
+      for (; i + 8 <= samples; i += 8) {
+        __m256i const q = dither_quantize_avx2(clip_hard_avx2(load_gained_avx(sp, gains, i)), &rng);
+        int16_t v[16];
+        _mm256_storeu_si256((void *)v, _mm256_packs_epi32(q, q));
+        for (size_t j = 0; j < 4; ++j) {
+          dp[(i + j) * channels] = v[j];
+          dp[(i + j + 4) * channels] = v[j + 8];
+        }
+      }
+#  endif
+      for (; i + 4 <= samples; i += 4) {
+        __m128i const q = dither_quantize_sse2(clip_hard_sse2(load_gained_sse2(sp, gains, i)), &rng);
+        int16_t v[8];
+        _mm_storeu_si128((void *)v, _mm_packs_epi32(q, q));
+        for (size_t j = 0; j < 4; ++j) {
+          dp[(i + j) * channels] = v[j];
+        }
+      }
+      _mm_storeu_si128((void *)st->rng, rng);
+#endif
+      for (; i < samples; ++i) {
+        dp[i * channels] = dither_quantize(clip_hard(gained(sp, gains, i)), st, i % dither_lanes);
       }
     }
   } else {
     for (size_t i = 0; i < samples; ++i) {
       for (size_t ch = 0; ch < channels; ++ch) {
-        dest[i * channels + ch] = (int16_t)(thru_dither(clip_hard(src[ch][i]), ds, i, m));
+        dest[i * channels + ch] = (int16_t)(thru_dither(clip_hard(gained(src[ch], gains, i)), ds, ch, m));
       }
     }
   }
 }
 
-static inline void float_to_interleaved_int16_stereo(int16_t *restrict const dest,
-                                                     float const *restrict const *const src,
-                                                     struct dither *const ds,
-                                                     size_t const samples) {
+static inline __attribute__((always_inline)) void
+float_to_interleaved_int16_stereo(int16_t *restrict const dest,
+                                  float const *restrict const *const src,
+                                  float const *restrict const gains,
+                                  struct dither *const ds,
+                                  size_t const samples) {
   float const *restrict sp0 = src[0];
   float const *restrict sp1 = src[1];
   int16_t *restrict const dp = dest;
   static float const m = 32767.f;
+  size_t i = 0;
   if (ds) {
-    for (size_t i = 0; i < samples; ++i) {
-      dp[i * 2 + 0] = (int16_t)(add_dither(clip_hard(sp0[i]), ds, 0, m));
-      dp[i * 2 + 1] = (int16_t)(add_dither(clip_hard(sp1[i]), ds, 1, m));
+    struct dither_state *const st0 = ds->ptr + 0;
+    struct dither_state *const st1 = ds->ptr + 1;
+#ifdef __SSE2__
+    __m128i rng0 = _mm_loadu_si128((void const *)st0->rng);
+    __m128i rng1 = _mm_loadu_si128((void const *)st1->rng);
+#  ifdef __AVX512F__
+    for (; i + 16 <= samples; i += 16) {
+      __m512i const l32 = dither_quantize_avx512(clip_hard_avx512(load_gained_avx512(sp0, gains, i)), &rng0);
+      __m512i const r32 = dither_quantize_avx512(clip_hard_avx512(load_gained_avx512(sp1, gains, i)), &rng1);
+      __m256i const l = _mm512_cvtsepi32_epi16(l32);
+      __m256i const r = _mm512_cvtsepi32_epi16(r32);
+      __m256i const lo = _mm256_unpacklo_epi16(l, r);
+      __m256i const hi = _mm256_unpackhi_epi16(l, r);
+      _mm256_storeu_si256((void *)(dp + i * 2), _mm256_permute2x128_si256(lo, hi, 0x20));
+      _mm256_storeu_si256((void *)(dp + i * 2 + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
     }
-  } else {
-    for (size_t i = 0; i < samples; ++i) {
-      dp[i * 2 + 0] = (int16_t)(thru_dither(clip_hard(sp0[i]), ds, 0, m));
-      dp[i * 2 + 1] = (int16_t)(thru_dither(clip_hard(sp1[i]), ds, 1, m));
+#  endif
+#  ifdef __AVX2__
+    for (; i + 8 <= samples; i += 8) {
+      __m256i const l = dither_quantize_avx2(clip_hard_avx2(load_gained_avx(sp0, gains, i)), &rng0);
+      __m256i const r = dither_quantize_avx2(clip_hard_avx2(load_gained_avx(sp1, gains, i)), &rng1);
+      _mm256_storeu_si256((void *)(dp + i * 2),
+                          _mm256_packs_epi32(_mm256_unpacklo_epi32(l, r), _mm256_unpackhi_epi32(l, r)));
     }
+#  endif
+    for (; i + 4 <= samples; i += 4) {
+      __m128i const l = dither_quantize_sse2(clip_hard_sse2(load_gained_sse2(sp0, gains, i)), &rng0);
+      __m128i const r = dither_quantize_sse2(clip_hard_sse2(load_gained_sse2(sp1, gains, i)), &rng1);
+      _mm_storeu_si128((void *)(dp + i * 2), _mm_packs_epi32(_mm_unpacklo_epi32(l, r), _mm_unpackhi_epi32(l, r)));
+    }
+    _mm_storeu_si128((void *)st0->rng, rng0);
+    _mm_storeu_si128((void *)st1->rng, rng1);
+#endif
+    for (; i < samples; ++i) {
+      dp[i * 2 + 0] = dither_quantize(clip_hard(gained(sp0, gains, i)), st0, i % dither_lanes);
+      dp[i * 2 + 1] = dither_quantize(clip_hard(gained(sp1, gains, i)), st1, i % dither_lanes);
+    }
+    return;
+  }
+#ifdef __AVX512F__
+  for (; i + 16 <= samples; i += 16) {
+    __m256i const l = _mm512_cvtsepi32_epi16(float_to_int32_avx512(load_gained_avx512(sp0, gains, i)));
+    __m256i const r = _mm512_cvtsepi32_epi16(float_to_int32_avx512(load_gained_avx512(sp1, gains, i)));
+    // frames 0-3 and 8-11 in lo, 4-7 and 12-15 in hi
+    __m256i const lo = _mm256_unpacklo_epi16(l, r);
+    __m256i const hi = _mm256_unpackhi_epi16(l, r);
+    _mm256_storeu_si256((void *)(dp + i * 2), _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256((void *)(dp + i * 2 + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+  }
+#endif
+#ifdef __AVX2__
+  for (; i + 8 <= samples; i += 8) {
+    __m256i const l = float_to_int32_avx2(load_gained_avx(sp0, gains, i));
+    __m256i const r = float_to_int32_avx2(load_gained_avx(sp1, gains, i));
+    // unpack and pack stay inside 128-bit lanes, which keeps the frames in order here
+    __m256i const v = _mm256_packs_epi32(_mm256_unpacklo_epi32(l, r), _mm256_unpackhi_epi32(l, r));
+    _mm256_storeu_si256((void *)(dp + i * 2), v);
+  }
+#endif
+#ifdef __SSE2__
+  for (; i + 4 <= samples; i += 4) {
+    __m128i const l = float_to_int32_sse2(load_gained_sse2(sp0, gains, i));
+    __m128i const r = float_to_int32_sse2(load_gained_sse2(sp1, gains, i));
+    _mm_storeu_si128((void *)(dp + i * 2), _mm_packs_epi32(_mm_unpacklo_epi32(l, r), _mm_unpackhi_epi32(l, r)));
+  }
+#endif
+  for (; i < samples; ++i) {
+    dp[i * 2 + 0] = (int16_t)(thru_dither(clip_hard(gained(sp0, gains, i)), ds, 0, m));
+    dp[i * 2 + 1] = (int16_t)(thru_dither(clip_hard(gained(sp1, gains, i)), ds, 1, m));
   }
 }
 
-static inline void float_to_interleaved_int16_mono(int16_t *restrict const dest,
-                                                   float const *restrict const *const src,
-                                                   struct dither *const ds,
-                                                   size_t const samples) {
+static inline __attribute__((always_inline)) void
+float_to_interleaved_int16_mono(int16_t *restrict const dest,
+                                float const *restrict const *const src,
+                                float const *restrict const gains,
+                                struct dither *const ds,
+                                size_t const samples) {
   float const *restrict sp0 = src[0];
   int16_t *restrict const dp = dest;
   static float const m = 32767.f;
+  size_t i = 0;
   if (ds) {
-    for (size_t i = 0; i < samples; ++i) {
-      dp[i] = (int16_t)(add_dither(clip_hard(sp0[i]), ds, 0, m));
+    struct dither_state *const st = ds->ptr;
+#ifdef __SSE2__
+    __m128i rng = _mm_loadu_si128((void const *)st->rng);
+#  ifdef __AVX512F__
+    for (; i + 16 <= samples; i += 16) {
+      __m512i const v = dither_quantize_avx512(clip_hard_avx512(load_gained_avx512(sp0, gains, i)), &rng);
+      _mm256_storeu_si256((void *)(dp + i), _mm512_cvtsepi32_epi16(v));
     }
-  } else {
-    for (size_t i = 0; i < samples; ++i) {
-      dp[i] = (int16_t)(thru_dither(clip_hard(sp0[i]), ds, 0, m));
+#  endif
+#  ifdef __AVX2__
+    for (; i + 16 <= samples; i += 16) {
+      __m256i const a = dither_quantize_avx2(clip_hard_avx2(load_gained_avx(sp0, gains, i)), &rng);
+      __m256i const b = dither_quantize_avx2(clip_hard_avx2(load_gained_avx(sp0, gains, i + 8)), &rng);
+      __m256i const v = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+      _mm256_storeu_si256((void *)(dp + i), v);
+    }
+#  endif
+    for (; i + 8 <= samples; i += 8) {
+      __m128i const a = dither_quantize_sse2(clip_hard_sse2(load_gained_sse2(sp0, gains, i)), &rng);
+      __m128i const b = dither_quantize_sse2(clip_hard_sse2(load_gained_sse2(sp0, gains, i + 4)), &rng);
+      _mm_storeu_si128((void *)(dp + i), _mm_packs_epi32(a, b));
+    }
+    _mm_storeu_si128((void *)st->rng, rng);
+#endif
+    for (; i < samples; ++i) {
+      dp[i] = dither_quantize(clip_hard(gained(sp0, gains, i)), st, i % dither_lanes);
     }
+    return;
+  }
+#ifdef __AVX512F__
+  for (; i + 16 <= samples; i += 16) {
+    __m512i const v = float_to_int32_avx512(load_gained_avx512(sp0, gains, i));
+    _mm256_storeu_si256((void *)(dp + i), _mm512_cvtsepi32_epi16(v));
+  }
+#endif
+#ifdef __AVX2__
+  for (; i + 16 <= samples; i += 16) {
+    __m256i const a = float_to_int32_avx2(load_gained_avx(sp0, gains, i));
+    __m256i const b = float_to_int32_avx2(load_gained_avx(sp0, gains, i + 8));
+    // the pack interleaves 128-bit lanes as a0 b0 a1 b1, put them back in order
+    __m256i const v = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256((void *)(dp + i), v);
+  }
+#endif
+#ifdef __SSE2__
+  for (; i + 8 <= samples; i += 8) {
+    __m128i const a = float_to_int32_sse2(load_gained_sse2(sp0, gains, i));
+    __m128i const b = float_to_int32_sse2(load_gained_sse2(sp0, gains, i + 4));
+    _mm_storeu_si128((void *)(dp + i), _mm_packs_epi32(a, b));
+  }
+#endif
+  for (; i < samples; ++i) {
+    dp[i] = (int16_t)(thru_dither(clip_hard(gained(sp0, gains, i)), ds, 0, m));
   }
 }
 
-static inline void float_to_interleaved_int16(int16_t *restrict const dest,
-                                              float const *restrict const *const src,
-                                              struct dither *const ds,
-                                              size_t const channels,
-                                              size_t const samples) {
+// Applies a per-sample gain shared by all channels before the clip, dither and pack.
+static inline __attribute__((always_inline)) void
+float_to_interleaved_int16_with_gain(int16_t *restrict const dest,
+                                     float const *restrict const *const src,
+                                     float const *restrict const gains,
+                                     struct dither *const ds,
+                                     size_t const channels,
+                                     size_t const samples) {
+  if (ds && ds->shaping == dither_shaping_second_order) {
+    float_to_interleaved_int16_shaped(dest, src, gains, ds, channels, samples);
+    return;
+  }
   switch (channels) {
   case 1:
-    float_to_interleaved_int16_mono(dest, src, ds, samples);
+    float_to_interleaved_int16_mono(dest, src, gains, ds, samples);
     break;
   case 2:
-    float_to_interleaved_int16_stereo(dest, src, ds, samples);
+    float_to_interleaved_int16_stereo(dest, src, gains, ds, samples);
+    break;
+#define X(n)                                                                                                           \
+  case n:                                                                                                              \
+    float_to_interleaved_int16_generic(dest, src, gains, ds, n, samples);                                              \
     break;
+    CHSPEC_EACH_MULTI(X)
+#undef X
   default:
-    float_to_interleaved_int16_generic(dest, src, ds, channels, samples);
+    float_to_interleaved_int16_generic(dest, src, gains, ds, channels, samples);
     break;
   }
 }
+
+static inline void float_to_interleaved_int16(int16_t *restrict const dest,
+                                              float const *restrict const *const src,
+                                              struct dither *const ds,
+                                              size_t const channels,
+                                              size_t const samples) {
+  float_to_interleaved_int16_with_gain(dest, src, NULL, ds, channels, samples);
+}
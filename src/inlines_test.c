@@ -0,0 +1,332 @@
+#include "inlines.h"
+
+#include "ovtest.h"
+
+enum {
+  test_max_samples = 67,
+  test_max_offset = 3,
+  test_buffer_samples = test_max_samples + test_max_offset,
+  test_max_channels = chspec_max_channels + 1, // every specialized count and one generic
+};
+
+static float g_a[test_max_channels][test_buffer_samples];
+static float g_b[test_max_channels][test_buffer_samples];
+static float g_out[test_max_channels][test_buffer_samples];
+static float g_ref[test_max_channels][test_buffer_samples];
+static int16_t g_i16[test_buffer_samples * test_max_channels];
+static int16_t g_i16_out[test_buffer_samples * test_max_channels];
+static int16_t g_i16_ref[test_buffer_samples * test_max_channels];
+
+static void generate(void) {
+  uint32_t t = 1;
+  static float const divider = 1.f / (float)(UINT32_MAX);
+  for (size_t ch = 0; ch < test_max_channels; ++ch) {
+    for (size_t i = 0; i < test_buffer_samples; ++i) {
+      // reaches beyond full scale to exercise the clipping
+      g_a[ch][i] = ((float)(ov_splitmix32(t)) * divider * 2.f - 1.f) * 1.25f;
+      t = ov_splitmix32_next(t);
+      g_b[ch][i] = (float)(ov_splitmix32(t)) * divider * 2.f - 1.f;
+      t = ov_splitmix32_next(t);
+    }
+  }
+  for (size_t i = 0; i < test_buffer_samples * test_max_channels; ++i) {
+    g_i16[i] = (int16_t)(ov_splitmix32(t) & 0xffff);
+    t = ov_splitmix32_next(t);
+  }
+  g_i16[0] = INT16_MIN;
+  g_i16[1] = INT16_MAX;
+}
+
+static bool near(float const *const a, float const *const b, size_t const n) {
+  for (size_t i = 0; i < n; ++i) {
+    if (fabsf(a[i] - b[i]) > 1e-6f * fmaxf(1.f, fabsf(b[i]))) {
+      TEST_MSG("mismatch at %zu: %g != %g", i, (double)a[i], (double)b[i]);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Every kernel runs over every length up to a few vectors from every misaligned start
+// and is compared with the plain loop it replaces.
+#define FOR_EACH_SPAN(offset, n)                                                                                       \
+  for (size_t offset = 0; offset <= test_max_offset; ++offset)                                                       \
+    for (size_t n = 0; n <= test_max_samples; ++n)
+
+static void test_mix(void) {
+  generate();
+  bool ok = true;
+  FOR_EACH_SPAN(offset, n) {
+    float const *in[2] = {g_a[0] + offset, g_a[1] + offset};
+    float *out[2] = {g_out[0] + offset, g_out[1] + offset};
+    for (size_t ch = 0; ch < 2; ++ch) {
+      for (size_t i = 0; i < test_buffer_samples; ++i) {
+        g_out[ch][i] = g_ref[ch][i] = g_b[ch][i];
+      }
+      for (size_t i = offset; i < offset + n; ++i) {
+        g_ref[ch][i] += g_a[ch][i];
+      }
+    }
+    mix(out, in, 2, n);
+    ok = ok && near(g_out[0], g_ref[0], test_buffer_samples) && near(g_out[1], g_ref[1], test_buffer_samples);
+  }
+  TEST_CHECK(ok);
+}
+
+static void test_mix_with_amp(void) {
+  generate();
+  bool ok = true;
+  FOR_EACH_SPAN(offset, n) {
+    float const *in[2] = {g_a[0] + offset, g_a[1] + offset};
+    float *out[2] = {g_out[0] + offset, g_out[1] + offset};
+    for (size_t ch = 0; ch < 2; ++ch) {
+      for (size_t i = 0; i < test_buffer_samples; ++i) {
+        g_out[ch][i] = g_ref[ch][i] = g_b[ch][i];
+      }
+      for (size_t i = offset; i < offset + n; ++i) {
+        g_ref[ch][i] += g_a[ch][i] * 0.3f;
+      }
+    }
+    mix_with_amp(out, in, 0.3f, 2, n);
+    ok = ok && near(g_out[0], g_ref[0], test_buffer_samples) && near(g_out[1], g_ref[1], test_buffer_samples);
+  }
+  TEST_CHECK(ok);
+}
+
+static void test_gain(void) {
+  generate();
+  bool ok = true;
+  float const g = db_to_amp(-6.f);
+  FOR_EACH_SPAN(offset, n) {
+    float const *in[2] = {g_a[0] + offset, g_a[1] + offset};
+    float *out[2] = {g_out[0] + offset, g_out[1] + offset};
+    memset(g_out, 0, sizeof(g_out));
+    memset(g_ref, 0, sizeof(g_ref));
+    for (size_t ch = 0; ch < 2; ++ch) {
+      for (size_t i = offset; i < offset + n; ++i) {
+        g_ref[ch][i] = g_a[ch][i] * g;
+      }
+    }
+    gain(out, in, -6.f, 2, n);
+    ok = ok && near(g_out[0], g_ref[0], test_buffer_samples) && near(g_out[1], g_ref[1], test_buffer_samples);
+  }
+  TEST_CHECK(ok);
+}
+
+static void test_stereo_pan_and_gain(void) {
+  static float const pans[] = {-1.f, -0.3f, 0.f, 0.6f, 1.f};
+  generate();
+  bool ok = true;
+  for (size_t p = 0; p < sizeof(pans) / sizeof(pans[0]); ++p) {
+    float const pan = (pans[p] + 1.f) * 0.5f;
+    float const g = db_to_amp(-3.f);
+    float const l = cosf(0.5f * 3.14159265358979323846f * pan) * g;
+    float const r = sinf(0.5f * 3.14159265358979323846f * pan) * g;
+    float const ll = pan < 0.5f ? (0.5f + pan) : 1.f;
+    float const rr = pan > 0.5f ? (1.5f - pan) : 1.f;
+    FOR_EACH_SPAN(offset, n) {
+      float const *in[2] = {g_a[0] + offset, g_a[1] + offset};
+      float *out[2] = {g_out[0] + offset, g_out[1] + offset};
+      memset(g_out, 0, sizeof(g_out));
+      memset(g_ref, 0, sizeof(g_ref));
+      for (size_t i = offset; i < offset + n; ++i) {
+        g_ref[0][i] = (g_a[0][i] * ll + g_a[1][i] * (1.f - ll)) * l;
+        g_ref[1][i] = (g_a[0][i] * (1.f - rr) + g_a[1][i] * rr) * r;
+      }
+      stereo_pan_and_gain(out, in, pans[p], -3.f, n);
+      ok = ok && near(g_out[0], g_ref[0], test_buffer_samples) && near(g_out[1], g_ref[1], test_buffer_samples);
+    }
+  }
+  TEST_CHECK(ok);
+}
+
+static void test_interleaved_int16_to_float(void) {
+  generate();
+  bool ok = true;
+  for (size_t channels = 1; channels <= test_max_channels; ++channels) {
+    FOR_EACH_SPAN(offset, n) {
+      float *out[test_max_channels];
+      for (size_t ch = 0; ch < channels; ++ch) {
+        out[ch] = g_out[ch] + offset;
+      }
+      memset(g_out, 0, sizeof(g_out));
+      memset(g_ref, 0, sizeof(g_ref));
+      for (size_t i = 0; i < n; ++i) {
+        for (size_t ch = 0; ch < channels; ++ch) {
+          g_ref[ch][offset + i] = (float)(g_i16[(offset + i) * channels + ch]) / 32768.f;
+        }
+      }
+      interleaved_int16_to_float(out, g_i16 + offset * channels, channels, n);
+      ok = ok && memcmp(g_out, g_ref, sizeof(g_out)) == 0;
+    }
+    TEST_CHECK(ok);
+    TEST_MSG("channels %zu", channels);
+  }
+}
+
+static void test_find_peak_int16(void) {
+  generate();
+  bool ok = true;
+  FOR_EACH_SPAN(offset, n) {
+    int ref = 0;
+    for (size_t i = 0; i < n * 2; ++i) {
+      ref = maxi(ref, abs(g_i16[offset * 2 + i]));
+    }
+    ok = ok && fcmp(find_peak_int16(g_i16 + offset * 2, n * 2), ==, (float)ref / 32768.f, 1e-9f);
+  }
+  TEST_CHECK(ok);
+  TEST_CHECK(fcmp(find_peak_int16(g_i16, 2), ==, 1.f, 1e-9f)); // INT16_MIN
+}
+
+static void test_float_to_interleaved_int16(void) {
+  generate();
+  bool ok = true;
+  for (size_t channels = 1; channels <= test_max_channels; ++channels) {
+    FOR_EACH_SPAN(offset, n) {
+      float const *in[test_max_channels];
+      for (size_t ch = 0; ch < channels; ++ch) {
+        in[ch] = g_a[ch] + offset;
+      }
+      memset(g_i16_out, 0, sizeof(g_i16_out));
+      memset(g_i16_ref, 0, sizeof(g_i16_ref));
+      for (size_t i = 0; i < n; ++i) {
+        for (size_t ch = 0; ch < channels; ++ch) {
+          g_i16_ref[(offset + i) * channels + ch] = (int16_t)(clip_hard(g_a[ch][offset + i]) * 32767.f);
+        }
+      }
+      float_to_interleaved_int16(g_i16_out + offset * channels, in, NULL, channels, n);
+      ok = ok && memcmp(g_i16_out, g_i16_ref, sizeof(g_i16_out)) == 0;
+    }
+    TEST_CHECK(ok);
+    TEST_MSG("channels %zu", channels);
+  }
+}
+
+static void test_float_to_interleaved_int16_with_gain(void) {
+  generate();
+  bool ok = true;
+  for (size_t channels = 1; channels <= test_max_channels; ++channels) {
+    FOR_EACH_SPAN(offset, n) {
+      float const *in[test_max_channels];
+      for (size_t ch = 0; ch < channels; ++ch) {
+        in[ch] = g_a[ch] + offset;
+      }
+      float const *const gains = g_b[1] + offset;
+      memset(g_i16_out, 0, sizeof(g_i16_out));
+      memset(g_i16_ref, 0, sizeof(g_i16_ref));
+      for (size_t i = 0; i < n; ++i) {
+        for (size_t ch = 0; ch < channels; ++ch) {
+          float const x = g_a[ch][offset + i] * gains[i];
+          g_i16_ref[(offset + i) * channels + ch] = (int16_t)(clip_hard(x) * 32767.f);
+        }
+      }
+      float_to_interleaved_int16_with_gain(g_i16_out + offset * channels, in, gains, NULL, channels, n);
+      ok = ok && memcmp(g_i16_out, g_i16_ref, sizeof(g_i16_out)) == 0;
+    }
+    TEST_CHECK(ok);
+    TEST_MSG("channels %zu", channels);
+  }
+}
+
+// The vector paths draw sample i from lane i % dither_lanes of its own channel, so plain per-sample
+// dither_quantize calls over a copy of the state must leave the same state.
+// The output may still differ by one step where FMA contraction changes a rounding tie.
+static void test_float_to_interleaved_int16_dither(void) {
+  enum { max_channels = 3 };
+  static float a[max_channels][test_buffer_samples];
+  static int16_t out[test_buffer_samples * max_channels];
+  static int16_t ref[test_buffer_samples * max_channels];
+  generate();
+  for (size_t i = 0; i < test_buffer_samples; ++i) {
+    a[0][i] = g_a[0][i];
+    a[1][i] = g_a[1][i];
+    a[2][i] = g_b[0][i] * 0.001f;
+  }
+  a[0][5] = 0.f; // silence must not be dithered
+  bool ok = true;
+  for (size_t channels = 1; channels <= max_channels; ++channels) {
+    struct dither d = {0};
+    struct dither rd = {0};
+    TEST_SUCCEEDED_F(dither_create(&d, channels));
+    TEST_SUCCEEDED_F(dither_create(&rd, channels));
+    FOR_EACH_SPAN(offset, n) {
+      float const *in[max_channels] = {a[0] + offset, a[1] + offset, a[2] + offset};
+      for (size_t i = 0; i < n; ++i) {
+        for (size_t ch = 0; ch < channels; ++ch) {
+          ref[i * channels + ch] = dither_quantize(clip_hard(in[ch][i]), rd.ptr + ch, i % dither_lanes);
+        }
+      }
+      float_to_interleaved_int16(out, in, &d, channels, n);
+      ok = ok && memcmp(d.ptr, rd.ptr, channels * sizeof(struct dither_state)) == 0;
+      for (size_t i = 0; i < n; ++i) {
+        for (size_t ch = 0; ch < channels; ++ch) {
+          float const x = clip_hard(in[ch][i]) * 32767.f;
+          ok = ok && abs(out[i * channels + ch] - ref[i * channels + ch]) <= 1;
+          ok = ok && fabsf((float)out[i * channels + ch] - x) <= 1.5f;
+          if (ch == 0 && offset + i == 5) {
+            ok = ok && out[i * channels + ch] == 0;
+          }
+        }
+      }
+    }
+    TEST_CHECK(ok);
+    TEST_MSG("channels %zu", channels);
+    TEST_SUCCEEDED_F(dither_destroy(&rd));
+    TEST_SUCCEEDED_F(dither_destroy(&d));
+  }
+}
+
+// Returns the lag-1 autocorrelation of the total error, about 0 for white TPDF
+// and -2/3 for noise shaped by (1 - z^-1)^2.
+static float error_autocorrelation(int const shaping, size_t const channels) {
+  enum { n = 48000 };
+  static float buf[2][n];
+  static int16_t out[n * 2];
+  if (channels > 2) {
+    return 1.f;
+  }
+  float const *in[2] = {buf[0], buf[1]};
+  for (size_t i = 0; i < n; ++i) {
+    buf[0][i] = 0.3f * sinf((float)i * 0.01f);
+    buf[1][i] = 0.2f * sinf((float)i * 0.013f);
+  }
+  struct dither d = {0};
+  if (efailed(dither_create(&d, channels))) {
+    return 1.f;
+  }
+  dither_set_shaping(&d, shaping);
+  float_to_interleaved_int16(out, in, &d, channels, n);
+  ereport(dither_destroy(&d));
+  double r0 = 0, r1 = 0, prev = 0;
+  for (size_t i = 0; i < n; ++i) {
+    double const e = (double)out[i * channels + channels - 1] - (double)(buf[channels - 1][i] * 32767.f);
+    r0 += e * e;
+    r1 += e * prev;
+    prev = e;
+  }
+  return (float)(r1 / r0);
+}
+
+static void test_dither_noise_shaping(void) {
+  for (size_t channels = 1; channels <= 2; ++channels) {
+    float const flat = error_autocorrelation(dither_shaping_none, channels);
+    float const shaped = error_autocorrelation(dither_shaping_second_order, channels);
+    TEST_CHECK(fabsf(flat) < 0.05f);
+    TEST_CHECK(fcmp(shaped, ==, -2.f / 3.f, 0.05f));
+    TEST_MSG("channels %zu: flat %g, shaped %g", channels, (double)flat, (double)shaped);
+  }
+}
+
+TEST_LIST = {
+    {"test_mix", test_mix},
+    {"test_mix_with_amp", test_mix_with_amp},
+    {"test_gain", test_gain},
+    {"test_stereo_pan_and_gain", test_stereo_pan_and_gain},
+    {"test_interleaved_int16_to_float", test_interleaved_int16_to_float},
+    {"test_find_peak_int16", test_find_peak_int16},
+    {"test_float_to_interleaved_int16", test_float_to_interleaved_int16},
+    {"test_float_to_interleaved_int16_with_gain", test_float_to_interleaved_int16_with_gain},
+    {"test_float_to_interleaved_int16_dither", test_float_to_interleaved_int16_dither},
+    {"test_dither_noise_shaping", test_dither_noise_shaping},
+    {NULL, NULL},
+};
@@ -3,66 +3,183 @@
 #include "ovnum.h"
 #include "ovutil/str.h"
 
-#include "circbuffer.h"
 #include "inlines.h"
 
 #include <math.h>
 
+enum {
+  reserve_samples = 4096, // room for the input on top of the delay, grows when a longer block arrives
+};
+
+static float const fade_duration = 0.005f; // crossfade between the old and the new delay in seconds
+
+// The delay line is a planar ring with a power-of-two capacity.
+// The input is written once and the delayed signal is handed out as views into the ring.
+// Changing the delay moves the read position inside the ring and crossfades to it, the history is kept.
 struct lagger {
-  struct circbuffer *buf;
+  float *ring;               // channels * cap
+  float *fade_buf;           // channels * fade_len, the crossfaded part of the output
+  float const **view_inputs; // lagger_max_spans * channels, pointers handed out by lagger_process
+  float **view_outputs;      // lagger_max_spans * channels
+  size_t cap;
+  size_t pos;    // write position, the delayed signal starts at pos - samples
+  size_t filled; // samples before pos that hold the signal, older ones are undefined
+  size_t fade_len;
+  size_t fade_pos;  // fading while this is less than fade_len
+  size_t fade_from; // delay in samples the crossfade starts from
   float duration;
   float sample_rate;
   size_t samples;
   size_t channels;
   bool need_parameter_update;
+  bool format_changed;
 };
 
-NODISCARD error lagger_create(struct lagger **const lp) {
-  if (!lp || *lp) {
-    return errg(err_invalid_arugment);
+static size_t next_power_of_two(size_t const v) {
+  size_t r = 1;
+  while (r < v) {
+    r <<= 1;
+  }
+  return r;
+}
+
+static bool is_fading(struct lagger const *const l) { return l->fade_pos < l->fade_len; }
+
+static void release(struct lagger *const l) {
+  if (l->ring) {
+    ereport(mem_aligned_free(&l->ring));
   }
+  if (l->fade_buf) {
+    ereport(mem_aligned_free(&l->fade_buf));
+  }
+  if (l->view_inputs) {
+    ereport(mem_free(&l->view_inputs));
+  }
+  if (l->view_outputs) {
+    ereport(mem_free(&l->view_outputs));
+  }
+  l->cap = 0;
+  l->filled = 0;
+  l->fade_len = 0;
+  l->fade_pos = 0;
+}
+
+NODISCARD static error allocate(struct lagger *const l) {
+  size_t const channels = l->channels;
+  size_t const fade_len = (size_t)(fade_duration * l->sample_rate) + 1;
   struct lagger tmp = {0};
-  error err = circbuffer_create(&tmp.buf);
+  error err = mem_aligned_alloc(&tmp.fade_buf, channels * fade_len, sizeof(float), 16);
   if (efailed(err)) {
     err = ethru(err);
     goto cleanup;
   }
-  err = mem(lp, 1, sizeof(struct lagger));
+  err = mem(&tmp.view_inputs, lagger_max_spans * channels, sizeof(float const *));
   if (efailed(err)) {
     err = ethru(err);
     goto cleanup;
   }
+  err = mem(&tmp.view_outputs, lagger_max_spans * channels, sizeof(float *));
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  release(l);
+  l->fade_buf = tmp.fade_buf;
+  l->view_inputs = tmp.view_inputs;
+  l->view_outputs = tmp.view_outputs;
+  l->fade_len = fade_len;
+  l->fade_pos = fade_len;
+  tmp = (struct lagger){0};
+
+cleanup:
+  release(&tmp);
+  return err;
+}
+
+// Makes room for needed samples, growing the ring at least twofold and carrying the history over.
+NODISCARD static error reserve(struct lagger *const l, size_t const needed) {
+  if (needed <= l->cap) {
+    return eok();
+  }
+  size_t const cap = next_power_of_two(needed > l->cap * 2 ? needed : l->cap * 2);
+  float *ring = NULL;
+  error err = mem_aligned_alloc(&ring, l->channels * cap, sizeof(float), 16);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  if (l->ring) {
+    size_t const old_mask = l->cap - 1;
+    size_t const mask = cap - 1;
+    for (size_t ch = 0; ch < l->channels; ++ch) {
+      float const *const src = l->ring + ch * l->cap;
+      float *const dest = ring + ch * cap;
+      for (size_t i = l->pos - l->filled; i != l->pos; ++i) {
+        dest[i & mask] = src[i & old_mask];
+      }
+    }
+    ereport(mem_aligned_free(&l->ring));
+  }
+  l->ring = ring;
+  l->cap = cap;
+  return eok();
+}
+
+// Silences the part of the last delay samples that holds no signal yet.
+static void fill_history(struct lagger *const l, size_t const delay) {
+  if (delay <= l->filled) {
+    return;
+  }
+  size_t const mask = l->cap - 1;
+  for (size_t ch = 0; ch < l->channels; ++ch) {
+    float *const ring = l->ring + ch * l->cap;
+    for (size_t i = l->pos - delay; i != l->pos - l->filled; ++i) {
+      ring[i & mask] = 0.f;
+    }
+  }
+  l->filled = delay;
+}
+
+NODISCARD error lagger_create(struct lagger **const lp) {
+  if (!lp || *lp) {
+    return errg(err_invalid_arugment);
+  }
+  error err = mem(lp, 1, sizeof(struct lagger));
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
   **lp = (struct lagger){
-      .buf = tmp.buf,
       .sample_rate = 48000.f,
       .channels = 2,
       .need_parameter_update = true,
+      .format_changed = true,
   };
-  tmp.buf = NULL;
-
-cleanup:
-  if (tmp.buf) {
-    ereport(circbuffer_destroy(&tmp.buf));
-  }
-  return err;
+  return eok();
 }
 
 NODISCARD error lagger_destroy(struct lagger **const lp) {
   if (!lp || !*lp) {
     return errg(err_invalid_arugment);
   }
-  ereport(circbuffer_destroy(&(*lp)->buf));
+  release(*lp);
   ereport(mem_free(lp));
   return eok();
 }
 
 void lagger_clear(struct lagger *const l) {
-  circbuffer_clear(l->buf);
-  ereport(circbuffer_write_silence(l->buf, l->samples));
+  if (!l->ring) {
+    return;
+  }
+  l->filled = 0;
+  l->fade_pos = l->fade_len;
+  fill_history(l, l->samples);
 }
 
 float lagger_get_duration(struct lagger const *const l) { return l->duration; }
 
+bool lagger_is_active(struct lagger const *const l) { return l->samples > 0 || is_fading(l); }
+
 static void write_str(NATIVE_CHAR *dest, NATIVE_CHAR const *src) {
   for (; *src != NSTR('\0'); ++src, ++dest) {
     *dest = *src;
@@ -83,6 +200,7 @@ void lagger_set_format(struct lagger *const l, float const sample_rate, size_t c
   l->sample_rate = sample_rate;
   l->channels = channels;
   l->need_parameter_update = true;
+  l->format_changed = true;
 }
 
 void lagger_set_duration(struct lagger *const l, float const duration) {
@@ -100,17 +218,45 @@ NODISCARD error lagger_update_internal_parameter(struct lagger *const l, bool *c
     }
     return eok();
   }
-  l->samples = (size_t)(l->duration * l->sample_rate);
-  circbuffer_clear(l->buf);
-  error err = circbuffer_set_channels(l->buf, l->channels);
-  if (efailed(err)) {
-    err = ethru(err);
-    return err;
-  }
-  err = circbuffer_write_silence(l->buf, l->samples);
-  if (efailed(err)) {
-    err = ethru(err);
-    return err;
+  size_t const delay = (size_t)(l->duration * l->sample_rate);
+  error err = eok();
+  if (l->format_changed) {
+    err = allocate(l);
+    if (efailed(err)) {
+      err = ethru(err);
+      return err;
+    }
+    err = reserve(l, delay + reserve_samples);
+    if (efailed(err)) {
+      err = ethru(err);
+      return err;
+    }
+    l->samples = delay;
+    fill_history(l, delay);
+    l->format_changed = false;
+  } else if (delay != l->samples) {
+    if (is_fading(l)) {
+      // Restarting from the old delay would jump away from the blend that is playing,
+      // so the new delay waits until the running crossfade has reached its target.
+      if (updated) {
+        *updated = false;
+      }
+      return eok();
+    }
+    if (!lagger_is_active(l)) {
+      // lagger_process is not called without a delay, what is left in the ring is not the recent signal
+      l->filled = 0;
+    }
+    size_t const from = l->samples;
+    err = reserve(l, (from > delay ? from : delay) + reserve_samples);
+    if (efailed(err)) {
+      err = ethru(err);
+      return err;
+    }
+    fill_history(l, delay);
+    l->fade_from = from;
+    l->fade_pos = 0;
+    l->samples = delay;
   }
   l->need_parameter_update = false;
   if (updated) {
@@ -119,26 +265,99 @@ NODISCARD error lagger_update_internal_parameter(struct lagger *const l, bool *c
   return eok();
 }
 
+// Appends up to two spans of the delay line that start delay samples before the current block.
+static size_t add_ring_spans(struct lagger *const l,
+                             struct lagger_view *const view,
+                             size_t const delay,
+                             size_t const offset,
+                             float *restrict const *const outputs,
+                             size_t const samples) {
+  size_t const channels = l->channels;
+  size_t const cap = l->cap;
+  size_t pos = l->pos - delay + offset;
+  size_t n = view->spans;
+  for (size_t done = offset; done < samples; ++n) {
+    size_t const r = pos & (cap - 1);
+    size_t const len = cap - r < samples - done ? cap - r : samples - done;
+    float const **const in = l->view_inputs + n * channels;
+    float **const out = l->view_outputs + n * channels;
+    for (size_t ch = 0; ch < channels; ++ch) {
+      in[ch] = l->ring + ch * cap + r;
+      out[ch] = outputs[ch] + done;
+    }
+    view->inputs[n] = (float const *restrict const *)in;
+    view->outputs[n] = (float *restrict const *)out;
+    view->samples[n] = len;
+    done += len;
+    pos += len;
+  }
+  return n;
+}
+
 void lagger_process(struct lagger *const l,
                     float const *restrict const *const inputs,
                     float *restrict const *const outputs,
-                    size_t const samples) {
-  if (!l->samples) {
-    for (size_t ch = 0, chlen = l->channels; ch < chlen; ++ch) {
-      memcpy(outputs[ch], inputs[ch], samples * sizeof(float));
+                    size_t const samples,
+                    struct lagger_view *const view) {
+  size_t const channels = l->channels;
+  bool const fading = is_fading(l);
+  size_t const longest = fading && l->fade_from > l->samples ? l->fade_from : l->samples;
+  bool pass_through = !lagger_is_active(l) || !l->ring;
+  if (!pass_through && longest + samples > l->cap) {
+    error err = reserve(l, longest + samples);
+    if (efailed(err)) {
+      ereport(err);
+      pass_through = true;
     }
-    return;
   }
-  if (l->samples >= samples) {
-    size_t written = 0;
-    ereport(circbuffer_read(l->buf, outputs, samples, &written));
-    ereport(circbuffer_write(l->buf, inputs, written));
+  if (pass_through) {
+    *view = (struct lagger_view){
+        .spans = 1,
+        .inputs = {inputs},
+        .outputs = {outputs},
+        .samples = {samples},
+    };
     return;
   }
-  size_t written = 0;
-  ereport(circbuffer_read(l->buf, outputs, l->samples, &written));
-  for (size_t ch = 0, chlen = l->channels; ch < chlen; ++ch) {
-    memcpy(outputs[ch] + written, inputs[ch], (samples - written) * sizeof(float));
+  size_t const cap = l->cap;
+  size_t const mask = cap - 1;
+  size_t const w = l->pos & mask;
+  size_t const w1 = cap - w < samples ? cap - w : samples;
+  for (size_t ch = 0; ch < channels; ++ch) {
+    float *const ring = l->ring + ch * cap;
+    memcpy(ring + w, inputs[ch], w1 * sizeof(float));
+    memcpy(ring, inputs[ch] + w1, (samples - w1) * sizeof(float));
+  }
+
+  *view = (struct lagger_view){0};
+  size_t offset = 0;
+  if (fading) {
+    // the beginning of the block is mixed from both read positions
+    size_t const len = l->fade_len - l->fade_pos < samples ? l->fade_len - l->fade_pos : samples;
+    float const step = 1.f / (float)(l->fade_len);
+    float const **const in = l->view_inputs;
+    float **const out = l->view_outputs;
+    for (size_t ch = 0; ch < channels; ++ch) {
+      float const *const ring = l->ring + ch * cap;
+      float *const dest = l->fade_buf + ch * l->fade_len;
+      size_t const from = l->pos - l->fade_from;
+      size_t const to = l->pos - l->samples;
+      for (size_t i = 0; i < len; ++i) {
+        float const t = (float)(l->fade_pos + i + 1) * step;
+        float const a = ring[(from + i) & mask];
+        dest[i] = a + (ring[(to + i) & mask] - a) * t;
+      }
+      in[ch] = dest;
+      out[ch] = outputs[ch];
+    }
+    view->inputs[0] = (float const *restrict const *)in;
+    view->outputs[0] = (float *restrict const *)out;
+    view->samples[0] = len;
+    view->spans = 1;
+    l->fade_pos += len;
+    offset = len;
   }
-  ereport(circbuffer_write_offset(l->buf, inputs, written, samples - written));
+  view->spans = add_ring_spans(l, view, l->samples, offset, outputs, samples);
+  l->pos += samples;
+  l->filled = l->filled + samples < cap ? l->filled + samples : cap;
 }
@@ -10,13 +10,32 @@ NODISCARD error lagger_destroy(struct lagger **const lp);
 void lagger_clear(struct lagger *const l);
 
 float lagger_get_duration(struct lagger const *const l);
+bool lagger_is_active(struct lagger const *const l); // delaying or still fading out of a previous delay
 void lagger_get_duration_str(struct lagger const *const l, NATIVE_CHAR dest[16]); // by msecs
 
 void lagger_set_format(struct lagger *const l, float const sample_rate, size_t const channels);
 void lagger_set_duration(struct lagger *const l, float const duration);
 NODISCARD error lagger_update_internal_parameter(struct lagger *const l, bool *const updated);
 
+enum {
+  lagger_max_spans = 3,
+};
+
+// The delayed signal as at most three spans, a crossfaded head while the delay is changing
+// and up to two spans inside the delay line.
+// Each span is paired with the place in the caller's output buffer its processed result belongs to,
+// so the next stage reads the delay line directly and leaves a contiguous result in outputs.
+struct lagger_view {
+  size_t spans;
+  float const *restrict const *inputs[lagger_max_spans];
+  float *restrict const *outputs[lagger_max_spans];
+  size_t samples[lagger_max_spans];
+};
+
+// Writes inputs into the delay line and returns the delayed signal in view.
+// Nothing is written to outputs, the view is valid until the next call.
 void lagger_process(struct lagger *const l,
                     float const *restrict const *const inputs,
                     float *restrict const *const outputs,
-                    size_t const samples);
+                    size_t const samples,
+                    struct lagger_view *const view);
@@ -0,0 +1,227 @@
+#include "lagger.c"
+
+#include "ovtest.h"
+
+enum {
+  test_channels = 2,
+  test_samples = 48000,
+  test_max_block = 6000,
+};
+
+static float g_input[test_channels][test_samples];
+static float g_output[test_channels][test_samples];
+
+static void generate_input(void) {
+  for (size_t ch = 0; ch < test_channels; ++ch) {
+    for (size_t i = 0; i < test_samples; ++i) {
+      g_input[ch][i] = (float)(i + 1) * (ch ? -1.f : 1.f);
+    }
+  }
+}
+
+// Collects the view the way the channel strip does and checks it against a plain delay.
+static bool process_and_check(struct lagger *const l, size_t const delay, size_t const *const blocks, size_t const n) {
+  size_t pos = 0;
+  size_t two_spans = 0;
+  for (size_t b = 0; pos < test_samples; b = (b + 1) % n) {
+    size_t const len = test_samples - pos < blocks[b] ? test_samples - pos : blocks[b];
+    float const *in[test_channels] = {g_input[0] + pos, g_input[1] + pos};
+    float *out[test_channels] = {g_output[0] + pos, g_output[1] + pos};
+    struct lagger_view view = {0};
+    lagger_process(l, (float const *restrict const *)in, (float *restrict const *)out, len, &view);
+    size_t total = 0;
+    for (size_t i = 0; i < view.spans; ++i) {
+      for (size_t ch = 0; ch < test_channels; ++ch) {
+        memcpy(view.outputs[i][ch], view.inputs[i][ch], view.samples[i] * sizeof(float));
+      }
+      total += view.samples[i];
+    }
+    if (total != len) {
+      return false;
+    }
+    two_spans += view.spans == 2;
+    pos += len;
+  }
+  for (size_t ch = 0; ch < test_channels; ++ch) {
+    for (size_t i = 0; i < test_samples; ++i) {
+      float const expected = i < delay ? 0.f : g_input[ch][i - delay];
+      if (fcmp(g_output[ch][i], !=, expected, 1e-6f)) {
+        TEST_MSG("mismatch at ch %zu pos %zu", ch, i);
+        return false;
+      }
+    }
+  }
+  return two_spans > 0;
+}
+
+static void test_delay(void) {
+  static size_t const blocks[] = {1600, 1, 255, 4097, 800, test_max_block};
+  static float const durations[] = {0.001f, 0.01f, 0.05f, 0.2f};
+  generate_input();
+  for (size_t d = 0; d < sizeof(durations) / sizeof(durations[0]); ++d) {
+    struct lagger *l = NULL;
+    TEST_SUCCEEDED_F(lagger_create(&l));
+    lagger_set_format(l, 48000.f, test_channels);
+    lagger_set_duration(l, durations[d]);
+    TEST_SUCCEEDED_F(lagger_update_internal_parameter(l, NULL));
+    size_t const delay = (size_t)(durations[d] * 48000.f);
+    TEST_CHECK(process_and_check(l, delay, blocks, sizeof(blocks) / sizeof(blocks[0])));
+    TEST_MSG("duration %g", (double)durations[d]);
+
+    lagger_clear(l);
+    TEST_CHECK(process_and_check(l, delay, blocks + 2, 2));
+    TEST_MSG("duration %g after clear", (double)durations[d]);
+    TEST_SUCCEEDED_F(lagger_destroy(&l));
+  }
+}
+
+static void process_block(struct lagger *const l, size_t const pos, size_t const len) {
+  float const *in[test_channels] = {g_input[0] + pos, g_input[1] + pos};
+  float *out[test_channels] = {g_output[0] + pos, g_output[1] + pos};
+  struct lagger_view view = {0};
+  lagger_process(l, (float const *restrict const *)in, (float *restrict const *)out, len, &view);
+  for (size_t i = 0; i < view.spans; ++i) {
+    for (size_t ch = 0; ch < test_channels; ++ch) {
+      memcpy(view.outputs[i][ch], view.inputs[i][ch], view.samples[i] * sizeof(float));
+    }
+  }
+}
+
+// Changing the delay keeps the history and crossfades between both read positions.
+static void test_duration_change(void) {
+  enum { block = 480, change_at = 24000 };
+  static float const durations[][2] = {{0.01f, 0.05f}, {0.05f, 0.01f}, {0.01f, 0.15f}, {0.f, 0.02f}, {0.02f, 0.f}};
+  generate_input();
+  for (size_t d = 0; d < sizeof(durations) / sizeof(durations[0]); ++d) {
+    struct lagger *l = NULL;
+    TEST_SUCCEEDED_F(lagger_create(&l));
+    lagger_set_format(l, 48000.f, test_channels);
+    lagger_set_duration(l, durations[d][0]);
+    TEST_SUCCEEDED_F(lagger_update_internal_parameter(l, NULL));
+    size_t const from = (size_t)(durations[d][0] * 48000.f);
+    size_t const to = (size_t)(durations[d][1] * 48000.f);
+    memset(g_output, 0, sizeof(g_output));
+    size_t pos = 0;
+    for (; pos < change_at; pos += block) {
+      if (lagger_is_active(l)) {
+        process_block(l, pos, block);
+      } else {
+        memcpy(g_output[0] + pos, g_input[0] + pos, block * sizeof(float));
+        memcpy(g_output[1] + pos, g_input[1] + pos, block * sizeof(float));
+      }
+    }
+    float const *const ring = l->ring;
+    size_t const cap = l->cap;
+    lagger_set_duration(l, durations[d][1]);
+    TEST_SUCCEEDED_F(lagger_update_internal_parameter(l, NULL));
+    TEST_CHECK(lagger_is_active(l));
+    if (from + reserve_samples <= cap && to + reserve_samples <= cap) {
+      TEST_CHECK(l->ring == ring); // moved inside the reserved capacity
+    } else {
+      TEST_CHECK(l->cap >= cap * 2); // grown geometrically
+    }
+    size_t const fade_len = l->fade_len;
+    for (; pos < test_samples; pos += block) {
+      process_block(l, pos, block);
+    }
+    TEST_CHECK(lagger_is_active(l) == (to > 0));
+
+    bool ok = true;
+    for (size_t ch = 0; ch < test_channels && ok; ++ch) {
+      for (size_t i = 0; i < test_samples && ok; ++i) {
+        float const a = i < from ? 0.f : g_input[ch][i - from];
+        // nothing is recorded while the lagger is bypassed
+        float const b = i < to || (from == 0 && i - to < change_at) ? 0.f : g_input[ch][i - to];
+        float const v = g_output[ch][i];
+        if (i < change_at) {
+          ok = fcmp(v, ==, a, 1e-6f);
+        } else if (i < change_at + fade_len) {
+          float const tol = fabsf(a) * 1e-5f + 1e-3f;
+          ok = v >= fminf(a, b) - tol && v <= fmaxf(a, b) + tol; // between both taps
+        } else {
+          ok = fcmp(v, ==, b, 1e-6f); // the history at the new delay is intact
+        }
+        if (!ok) {
+          TEST_MSG("mismatch at ch %zu pos %zu", ch, i);
+        }
+      }
+    }
+    TEST_CHECK(ok);
+    TEST_MSG("duration %g -> %g", (double)durations[d][0], (double)durations[d][1]);
+    TEST_SUCCEEDED_F(lagger_destroy(&l));
+  }
+}
+
+static bool between(float const v, float const a, float const b) {
+  float const tol = fmaxf(fabsf(a), fabsf(b)) * 1e-5f + 1e-3f;
+  return v >= fminf(a, b) - tol && v <= fmaxf(a, b) + tol;
+}
+
+// A change that arrives during a crossfade is applied once that crossfade has finished,
+// so the output never jumps back to the tap the running fade is leaving.
+static void test_change_while_fading(void) {
+  enum { block = 96, change_at = 24000 };
+  generate_input();
+  struct lagger *l = NULL;
+  TEST_SUCCEEDED_F(lagger_create(&l));
+  lagger_set_format(l, 48000.f, test_channels);
+  lagger_set_duration(l, 0.01f);
+  TEST_SUCCEEDED_F(lagger_update_internal_parameter(l, NULL));
+  size_t const d0 = 480, d1 = 2400, d2 = 960;
+  size_t pos = 0;
+  for (; pos < change_at; pos += block) {
+    process_block(l, pos, block);
+  }
+  lagger_set_duration(l, 0.05f);
+  TEST_SUCCEEDED_F(lagger_update_internal_parameter(l, NULL));
+  size_t const fade_len = l->fade_len;
+  process_block(l, pos, block);
+  pos += block;
+
+  bool updated = true;
+  lagger_set_duration(l, 0.02f);
+  TEST_SUCCEEDED_F(lagger_update_internal_parameter(l, &updated));
+  TEST_CHECK(!updated);
+  size_t second_at = 0;
+  for (; pos < test_samples; pos += block) {
+    TEST_SUCCEEDED_F(lagger_update_internal_parameter(l, &updated));
+    if (updated) {
+      second_at = pos;
+    }
+    process_block(l, pos, block);
+  }
+  TEST_CHECK(second_at >= change_at + fade_len && second_at < change_at + fade_len + block);
+
+  bool ok = true;
+  for (size_t ch = 0; ch < test_channels && ok; ++ch) {
+    for (size_t i = 0; i < test_samples && ok; ++i) {
+      float const a = i < d0 ? 0.f : g_input[ch][i - d0];
+      float const b = g_input[ch][i - d1];
+      float const c = i < d2 ? 0.f : g_input[ch][i - d2];
+      float const v = g_output[ch][i];
+      if (i < change_at) {
+        ok = fcmp(v, ==, a, 1e-6f);
+      } else if (i < change_at + fade_len) {
+        ok = between(v, a, b);
+      } else if (i < second_at) {
+        ok = fcmp(v, ==, b, 1e-6f);
+      } else if (i < second_at + fade_len) {
+        ok = between(v, b, c);
+      } else {
+        ok = fcmp(v, ==, c, 1e-6f);
+      }
+      if (!ok) {
+        TEST_MSG("mismatch at ch %zu pos %zu", ch, i);
+      }
+    }
+  }
+  TEST_CHECK(ok);
+  TEST_SUCCEEDED_F(lagger_destroy(&l));
+}
+
+TEST_LIST = {
+    {"test_delay", test_delay},
+    {"test_duration_change", test_duration_change},
+    {"test_change_while_fading", test_change_while_fading},
+    {NULL, NULL},
+};
@@ -0,0 +1,400 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#  define _GNU_SOURCE // memfd_create
+#endif
+
+#include "mirrorbuf_i16.h"
+
+#ifdef _WIN32
+#  include "ovutil/win32.h"
+#elif defined(__linux__)
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
+#include "simd.h"
+
+enum {
+  growth_limit = 65536, // the largest step the buffer grows by at once in samples
+  map_retries = 8,      // another thread can take the address range between reserving and mapping it
+};
+
+// One half of the storage holds buffer_size samples, the other half aliases it.
+// Without the mapping both halves are separate memory and writes are copied to both.
+struct storage {
+  int16_t *ptr;
+  size_t bytes; // size of one half
+  bool mirrored;
+};
+
+struct mirrorbuf_i16 {
+  struct storage s;
+
+  size_t channels;
+  size_t buffer_size;
+  size_t remain;
+  size_t writecur;
+  size_t reserved;      // mirrorbuf_i16_shrink never goes below this
+  size_t peak;          // the highest remain since the last mirrorbuf_i16_shrink
+  bool mirror_disabled; // always use the copying fallback
+};
+
+static size_t get_granularity(void) {
+#ifdef _WIN32
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  return (size_t)si.dwAllocationGranularity;
+#elif defined(__linux__)
+  long const r = sysconf(_SC_PAGESIZE);
+  return r > 0 ? (size_t)r : 4096;
+#else
+  return 4096;
+#endif
+}
+
+static size_t gcd(size_t a, size_t b) {
+  while (b) {
+    size_t const t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+// The size of one half, a multiple of both the mapping granularity and the sample frame.
+static size_t storage_bytes(size_t const frame_bytes, size_t const samples) {
+  size_t const g = get_granularity();
+  size_t const unit = g / gcd(g, frame_bytes) * frame_bytes;
+  return (samples * frame_bytes + unit - 1) / unit * unit;
+}
+
+#ifdef _WIN32
+static bool map_mirrored(struct storage *const s, size_t const bytes) {
+  HANDLE const h = CreateFileMappingW(
+      INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)bytes >> 32), (DWORD)(bytes & 0xffffffff), NULL);
+  if (!h) {
+    return false;
+  }
+  bool ok = false;
+  for (int i = 0; i < map_retries && !ok; ++i) {
+    // find a free range for both views, then map them into it
+    char *const p = VirtualAlloc(NULL, bytes * 2, MEM_RESERVE, PAGE_NOACCESS);
+    if (!p) {
+      break;
+    }
+    VirtualFree(p, 0, MEM_RELEASE);
+    void *const a = MapViewOfFileEx(h, FILE_MAP_ALL_ACCESS, 0, 0, bytes, p);
+    void *const b = a ? MapViewOfFileEx(h, FILE_MAP_ALL_ACCESS, 0, 0, bytes, p + bytes) : NULL;
+    if (a && b) {
+      s->ptr = (int16_t *)a;
+      ok = true;
+      continue;
+    }
+    if (a) {
+      UnmapViewOfFile(a);
+    }
+  }
+  // the views keep the section alive
+  CloseHandle(h);
+  return ok;
+}
+
+static void unmap_mirrored(struct storage *const s) {
+  UnmapViewOfFile((char *)s->ptr + s->bytes);
+  UnmapViewOfFile(s->ptr);
+}
+#elif defined(__linux__)
+static bool map_mirrored(struct storage *const s, size_t const bytes) {
+  int const fd = memfd_create("mirrorbuf_i16", MFD_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  bool ok = false;
+  char *p = MAP_FAILED;
+  if (ftruncate(fd, (off_t)bytes) == -1) {
+    goto cleanup;
+  }
+  p = mmap(NULL, bytes * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    goto cleanup;
+  }
+  if (mmap(p, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+      mmap(p + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+    munmap(p, bytes * 2);
+    goto cleanup;
+  }
+  s->ptr = (int16_t *)(void *)p;
+  ok = true;
+cleanup:
+  // the mappings keep the memory alive
+  close(fd);
+  return ok;
+}
+
+static void unmap_mirrored(struct storage *const s) { munmap(s->ptr, s->bytes * 2); }
+#else
+static bool map_mirrored(struct storage *const s, size_t const bytes) {
+  (void)s;
+  (void)bytes;
+  return false;
+}
+
+static void unmap_mirrored(struct storage *const s) { (void)s; }
+#endif
+
+NODISCARD static error storage_allocate(struct storage *const s, size_t const bytes, bool const mirror) {
+  if (mirror && map_mirrored(s, bytes)) {
+    s->bytes = bytes;
+    s->mirrored = true;
+    return eok();
+  }
+  error err = mem_aligned_alloc(&s->ptr, bytes / sizeof(int16_t) * 2, sizeof(int16_t), 16);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  s->bytes = bytes;
+  s->mirrored = false;
+  return eok();
+}
+
+static void storage_release(struct storage *const s) {
+  if (!s->ptr) {
+    return;
+  }
+  if (s->mirrored) {
+    unmap_mirrored(s);
+    s->ptr = NULL;
+  } else {
+    ereport(mem_aligned_free(&s->ptr));
+  }
+  *s = (struct storage){0};
+}
+
+// Grows geometrically so that uneven writes settle after a few reallocations.
+static size_t grow_size(size_t const buffer_size, size_t const needed) {
+  size_t const grown = buffer_size + (buffer_size < growth_limit ? buffer_size : growth_limit);
+  return grown > needed ? grown : needed;
+}
+
+static size_t get_readcur(struct mirrorbuf_i16 const *const m) {
+  size_t const r = m->writecur + m->buffer_size - m->remain;
+  return r >= m->buffer_size ? r - m->buffer_size : r;
+}
+
+// Moves the remaining samples into new storage that holds at least buffer_size samples.
+NODISCARD static error resize(struct mirrorbuf_i16 *const m, size_t const buffer_size) {
+  size_t const frame_bytes = m->channels * sizeof(int16_t);
+  size_t const bytes = storage_bytes(frame_bytes, buffer_size);
+  if (bytes == m->s.bytes) {
+    return eok();
+  }
+  struct storage s = {0};
+  error err = storage_allocate(&s, bytes, !m->mirror_disabled);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  size_t const remain_bytes = m->remain * frame_bytes;
+  if (remain_bytes) {
+    char const *const src = (char const *)m->s.ptr + get_readcur(m) * frame_bytes;
+    memcpy(s.ptr, src, remain_bytes);
+    if (!s.mirrored) {
+      memcpy((char *)s.ptr + bytes, src, remain_bytes);
+    }
+  }
+  storage_release(&m->s);
+  m->s = s;
+  m->buffer_size = bytes / frame_bytes;
+  m->writecur = m->remain == m->buffer_size ? 0 : m->remain;
+  return eok();
+}
+
+NODISCARD static error ensure(struct mirrorbuf_i16 *const m, size_t const samples) {
+  size_t const needed = m->remain + samples;
+  if (m->s.ptr && needed <= m->buffer_size) {
+    return eok();
+  }
+  size_t const size = m->s.ptr ? grow_size(m->buffer_size, needed) : needed > m->reserved ? needed : m->reserved;
+  error err = resize(m, size);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  return eok();
+}
+
+NODISCARD error mirrorbuf_i16_create(struct mirrorbuf_i16 **const mp) {
+  if (!mp || *mp) {
+    return errg(err_invalid_arugment);
+  }
+  error err = mem(mp, 1, sizeof(struct mirrorbuf_i16));
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  **mp = (struct mirrorbuf_i16){0};
+  return eok();
+}
+
+NODISCARD error mirrorbuf_i16_destroy(struct mirrorbuf_i16 **const mp) {
+  if (!mp || !*mp) {
+    return errg(err_invalid_arugment);
+  }
+  storage_release(&(*mp)->s);
+  ereport(mem_free(mp));
+  return eok();
+}
+
+NODISCARD error mirrorbuf_i16_reserve(struct mirrorbuf_i16 *const m, size_t const buffer_size) {
+  if (!m || !buffer_size) {
+    return errg(err_invalid_arugment);
+  }
+  m->reserved = buffer_size;
+  if (!m->channels || (m->s.ptr && buffer_size <= m->buffer_size)) {
+    return eok();
+  }
+  error err = resize(m, buffer_size);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  return eok();
+}
+
+NODISCARD error mirrorbuf_i16_shrink(struct mirrorbuf_i16 *const m) {
+  if (!m) {
+    return errg(err_invalid_arugment);
+  }
+  size_t const peak = m->peak > m->remain ? m->peak : m->remain;
+  size_t const target = peak * 2 > m->reserved ? peak * 2 : m->reserved;
+  m->peak = m->remain;
+  if (!m->s.ptr || !target || target * 2 > m->buffer_size) {
+    return eok();
+  }
+  error err = resize(m, target);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  return eok();
+}
+
+void mirrorbuf_i16_clear(struct mirrorbuf_i16 *const m) {
+  m->remain = 0;
+  m->writecur = 0;
+}
+
+NODISCARD error mirrorbuf_i16_set_channels(struct mirrorbuf_i16 *const m, size_t const channels) {
+  if (!m || !channels) {
+    return errg(err_invalid_arugment);
+  }
+  if (m->channels == channels) {
+    return eok();
+  }
+  storage_release(&m->s);
+  m->channels = channels;
+  m->buffer_size = 0;
+  m->remain = 0;
+  m->writecur = 0;
+  return eok();
+}
+
+size_t mirrorbuf_i16_get_channels(struct mirrorbuf_i16 const *const m) { return m->channels; }
+
+size_t mirrorbuf_i16_get_remain(struct mirrorbuf_i16 const *const m) { return m->remain; }
+
+bool mirrorbuf_i16_is_mirrored(struct mirrorbuf_i16 const *const m) { return m->s.mirrored; }
+
+NODISCARD error mirrorbuf_i16_write(struct mirrorbuf_i16 *const m,
+                                    int16_t const *restrict const src,
+                                    size_t const samples) {
+  if (!m || !src) {
+    return errg(err_invalid_arugment);
+  }
+  if (!m->channels) {
+    return errg(err_unexpected);
+  }
+  if (!samples) {
+    return eok();
+  }
+  error err = ensure(m, samples);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  size_t const channels = m->channels;
+  size_t const buffer_size = m->buffer_size;
+  size_t const writecur = m->writecur;
+  int16_t *const ptr = m->s.ptr;
+  memcpy(ptr + writecur * channels, src, samples * channels * sizeof(int16_t));
+  if (!m->s.mirrored) {
+    // keep the other half in step, the span may cross into it
+    size_t const sz = buffer_size - writecur < samples ? buffer_size - writecur : samples;
+    memcpy(ptr + (writecur + buffer_size) * channels, src, sz * channels * sizeof(int16_t));
+    memcpy(ptr, src + sz * channels, (samples - sz) * channels * sizeof(int16_t));
+  }
+  size_t const cur = writecur + samples;
+  m->writecur = cur >= buffer_size ? cur - buffer_size : cur;
+  m->remain += samples;
+  if (m->remain > m->peak) {
+    m->peak = m->remain;
+  }
+  return eok();
+}
+
+NODISCARD error mirrorbuf_i16_read(struct mirrorbuf_i16 *const m,
+                                   int16_t *restrict const dest,
+                                   size_t const samples,
+                                   size_t *const written) {
+  if (!m) {
+    return errg(err_invalid_arugment);
+  }
+  if (!dest) {
+    return errg(err_null_pointer);
+  }
+  size_t const readsize = m->remain >= samples ? samples : m->remain;
+  if (readsize) {
+    memcpy(dest, m->s.ptr + get_readcur(m) * m->channels, readsize * m->channels * sizeof(int16_t));
+    m->remain -= readsize;
+  }
+  if (written) {
+    *written = readsize;
+  }
+  return eok();
+}
+
+NODISCARD error mirrorbuf_i16_read_as_float(struct mirrorbuf_i16 *const m,
+                                            float *restrict const *const dest,
+                                            size_t const samples,
+                                            float const mul,
+                                            size_t *const written) {
+  if (!m) {
+    return errg(err_invalid_arugment);
+  }
+  if (!dest) {
+    return errg(err_null_pointer);
+  }
+  size_t const readsize = m->remain >= samples ? samples : m->remain;
+  if (readsize) {
+    // the readable part is one contiguous span, the kernel scales by 1/32768 on its own
+    simd()->interleaved_int16_to_float_with_gain(
+        dest, m->s.ptr + get_readcur(m) * m->channels, mul * 32768.f, m->channels, readsize);
+    m->remain -= readsize;
+  }
+  if (written) {
+    *written = readsize;
+  }
+  return eok();
+}
+
+NODISCARD error mirrorbuf_i16_discard(struct mirrorbuf_i16 *const m, size_t const samples, size_t *const discarded) {
+  if (!m) {
+    return errg(err_invalid_arugment);
+  }
+  size_t const readsize = m->remain >= samples ? samples : m->remain;
+  m->remain -= readsize;
+  if (discarded) {
+    *discarded = readsize;
+  }
+  return eok();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "ovbase.h"
+
+// A circular buffer of interleaved int16 samples like circbuffer_i16.
+// The storage is mapped twice back to back so every read and write is a single contiguous span.
+// When the system refuses the mapping the buffer keeps a copy of the data in a second half instead.
+struct mirrorbuf_i16;
+
+NODISCARD error mirrorbuf_i16_create(struct mirrorbuf_i16 **const mp);
+NODISCARD error mirrorbuf_i16_destroy(struct mirrorbuf_i16 **const mp);
+
+// Makes room for at least buffer_size samples up front, writes grow the buffer geometrically beyond that.
+NODISCARD error mirrorbuf_i16_reserve(struct mirrorbuf_i16 *const m, size_t const buffer_size);
+// Gives back the capacity the writes since the last call did not need, intended to be called while idle.
+NODISCARD error mirrorbuf_i16_shrink(struct mirrorbuf_i16 *const m);
+
+void mirrorbuf_i16_clear(struct mirrorbuf_i16 *const m);
+
+NODISCARD error mirrorbuf_i16_set_channels(struct mirrorbuf_i16 *const m, size_t const channels);
+size_t mirrorbuf_i16_get_channels(struct mirrorbuf_i16 const *const m);
+size_t mirrorbuf_i16_get_remain(struct mirrorbuf_i16 const *const m);
+bool mirrorbuf_i16_is_mirrored(struct mirrorbuf_i16 const *const m);
+
+NODISCARD error mirrorbuf_i16_write(struct mirrorbuf_i16 *const m,
+                                    int16_t const *restrict const src,
+                                    size_t const samples);
+
+NODISCARD error mirrorbuf_i16_read(struct mirrorbuf_i16 *const m,
+                                   int16_t *restrict const dest,
+                                   size_t const samples,
+                                   size_t *const written);
+NODISCARD error mirrorbuf_i16_read_as_float(struct mirrorbuf_i16 *const m,
+                                            float *restrict const *const dest,
+                                            size_t const samples,
+                                            float const mul,
+                                            size_t *const written);
+NODISCARD error mirrorbuf_i16_discard(struct mirrorbuf_i16 *const m, size_t const samples, size_t *const discarded);
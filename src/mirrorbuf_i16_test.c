@@ -0,0 +1,176 @@
+#include "mirrorbuf_i16.c"
+
+#include "ovtest.h"
+
+#include "circbuffer_i16.h"
+
+enum {
+  test_channels = 2,
+  test_samples = 48000,
+};
+
+static int16_t g_input[test_samples * test_channels];
+static int16_t g_output[test_samples * test_channels];
+static float g_float[test_channels][test_samples];
+
+static void generate_input(void) {
+  for (size_t i = 0; i < test_samples * test_channels; ++i) {
+    g_input[i] = (int16_t)((i * 7919) & 0x7fff);
+  }
+}
+
+static void test_create_destroy(void) {
+  struct mirrorbuf_i16 *m = NULL;
+  TEST_SUCCEEDED_F(mirrorbuf_i16_create(&m));
+  TEST_CHECK(m != NULL);
+  TEST_SUCCEEDED_F(mirrorbuf_i16_destroy(&m));
+  TEST_CHECK(m == NULL);
+}
+
+// Streams through the buffer in uneven blocks so that reads and writes keep crossing the end of the ring.
+static bool stream(struct mirrorbuf_i16 *const m) {
+  static size_t const blocks[] = {1, 1471, 255, 4097, 800, 6000};
+  size_t wpos = 0;
+  size_t rpos = 0;
+  for (size_t b = 0; rpos < test_samples; b = (b + 1) % (sizeof(blocks) / sizeof(blocks[0]))) {
+    size_t const n = test_samples - wpos < blocks[b] ? test_samples - wpos : blocks[b];
+    if (efailed(mirrorbuf_i16_write(m, g_input + wpos * test_channels, n))) {
+      return false;
+    }
+    wpos += n;
+    size_t const want = blocks[(b + 2) % (sizeof(blocks) / sizeof(blocks[0]))];
+    size_t written = 0;
+    if (b & 1) {
+      if (efailed(mirrorbuf_i16_read(m, g_output + rpos * test_channels, want, &written))) {
+        return false;
+      }
+    } else {
+      float *out[test_channels] = {g_float[0] + rpos, g_float[1] + rpos};
+      if (efailed(mirrorbuf_i16_read_as_float(m, out, want, 1.f, &written))) {
+        return false;
+      }
+      for (size_t i = rpos; i < rpos + written; ++i) {
+        for (size_t ch = 0; ch < test_channels; ++ch) {
+          g_output[i * test_channels + ch] = (int16_t)g_float[ch][i];
+        }
+      }
+    }
+    rpos += written;
+  }
+  return memcmp(g_input, g_output, sizeof(g_input)) == 0;
+}
+
+static void test_stream(void) {
+  generate_input();
+  for (int disabled = 0; disabled < 2; ++disabled) {
+    struct mirrorbuf_i16 *m = NULL;
+    TEST_SUCCEEDED_F(mirrorbuf_i16_create(&m));
+    m->mirror_disabled = disabled;
+    TEST_SUCCEEDED_F(mirrorbuf_i16_set_channels(m, test_channels));
+    TEST_SUCCEEDED_F(mirrorbuf_i16_reserve(m, 1024));
+    TEST_CHECK(m->buffer_size >= 1024);
+#ifdef __linux__
+    TEST_CHECK(mirrorbuf_i16_is_mirrored(m) == !disabled);
+#endif
+    memset(g_output, 0, sizeof(g_output));
+    TEST_CHECK(stream(m));
+    TEST_MSG("mirrored %d", mirrorbuf_i16_is_mirrored(m));
+    TEST_SUCCEEDED_F(mirrorbuf_i16_destroy(&m));
+  }
+}
+
+// Both halves must show the same samples whichever way the storage was made.
+static void test_mirror(void) {
+  generate_input();
+  for (int disabled = 0; disabled < 2; ++disabled) {
+    struct mirrorbuf_i16 *m = NULL;
+    TEST_SUCCEEDED_F(mirrorbuf_i16_create(&m));
+    m->mirror_disabled = disabled;
+    TEST_SUCCEEDED_F(mirrorbuf_i16_set_channels(m, test_channels));
+    TEST_SUCCEEDED_F(mirrorbuf_i16_reserve(m, 16));
+    size_t const size = m->buffer_size;
+    TEST_SUCCEEDED_F(mirrorbuf_i16_write(m, g_input, size - 3));
+    TEST_SUCCEEDED_F(mirrorbuf_i16_discard(m, size - 3, NULL));
+    TEST_SUCCEEDED_F(mirrorbuf_i16_write(m, g_input, 10));
+    TEST_CHECK(m->buffer_size == size);
+    TEST_CHECK(m->writecur == 7);
+    size_t const n = size * test_channels;
+    TEST_CHECK(memcmp(m->s.ptr, m->s.ptr + n, n * sizeof(int16_t)) == 0);
+    TEST_CHECK(memcmp(m->s.ptr + n - 3 * test_channels, g_input, 10 * test_channels * sizeof(int16_t)) == 0);
+    TEST_SUCCEEDED_F(mirrorbuf_i16_destroy(&m));
+  }
+}
+
+static void test_grow_shrink(void) {
+  generate_input();
+  struct mirrorbuf_i16 *m = NULL;
+  TEST_SUCCEEDED_F(mirrorbuf_i16_create(&m));
+  TEST_SUCCEEDED_F(mirrorbuf_i16_set_channels(m, 3));
+  TEST_SUCCEEDED_F(mirrorbuf_i16_reserve(m, 16));
+  size_t const size = m->buffer_size;
+  TEST_CHECK((size * 3 * sizeof(int16_t)) % get_granularity() == 0);
+
+  // grow while the data crosses the end of the ring
+  TEST_SUCCEEDED_F(mirrorbuf_i16_write(m, g_input, size - 5));
+  TEST_SUCCEEDED_F(mirrorbuf_i16_discard(m, size - 10, NULL));
+  TEST_SUCCEEDED_F(mirrorbuf_i16_write(m, g_input + (size - 5) * 3, size));
+  TEST_CHECK(m->buffer_size >= size * 2);
+  size_t written = 0;
+  TEST_SUCCEEDED_F(mirrorbuf_i16_read(m, g_output, size + 5, &written));
+  TEST_CHECK(written == size + 5);
+  TEST_CHECK(memcmp(g_output, g_input + (size - 10) * 3, written * 3 * sizeof(int16_t)) == 0);
+
+  TEST_SUCCEEDED_F(mirrorbuf_i16_shrink(m));
+  TEST_SUCCEEDED_F(mirrorbuf_i16_write(m, g_input, 4));
+  TEST_SUCCEEDED_F(mirrorbuf_i16_shrink(m));
+  TEST_CHECK(m->buffer_size == size);
+  TEST_SUCCEEDED_F(mirrorbuf_i16_read(m, g_output, 16, &written));
+  TEST_CHECK(written == 4 && memcmp(g_output, g_input, 4 * 3 * sizeof(int16_t)) == 0);
+  TEST_SUCCEEDED_F(mirrorbuf_i16_destroy(&m));
+}
+
+enum {
+  bench_frame = 1471,
+  bench_frames = 100000,
+};
+
+// Frame-sized conversions over a buffer that keeps wrapping, compare with bench_circbuffer_read_as_float.
+static void bench_read_as_float(void) {
+  generate_input();
+  struct mirrorbuf_i16 *m = NULL;
+  TEST_SUCCEEDED_F(mirrorbuf_i16_create(&m));
+  TEST_SUCCEEDED_F(mirrorbuf_i16_set_channels(m, test_channels));
+  TEST_SUCCEEDED_F(mirrorbuf_i16_reserve(m, bench_frame * 2));
+  float *out[test_channels] = {g_float[0], g_float[1]};
+  size_t written = 0;
+  for (size_t i = 0; i < bench_frames; ++i) {
+    TEST_SUCCEEDED_F(mirrorbuf_i16_write(m, g_input, bench_frame));
+    TEST_SUCCEEDED_F(mirrorbuf_i16_read_as_float(m, out, bench_frame, 1.f, &written));
+  }
+  TEST_SUCCEEDED_F(mirrorbuf_i16_destroy(&m));
+}
+
+static void bench_circbuffer_read_as_float(void) {
+  generate_input();
+  struct circbuffer_i16 *c = NULL;
+  TEST_SUCCEEDED_F(circbuffer_i16_create(&c));
+  TEST_SUCCEEDED_F(circbuffer_i16_set_channels(c, test_channels));
+  TEST_SUCCEEDED_F(circbuffer_i16_reserve(c, bench_frame * 2));
+  float *out[test_channels] = {g_float[0], g_float[1]};
+  size_t written = 0;
+  for (size_t i = 0; i < bench_frames; ++i) {
+    TEST_SUCCEEDED_F(circbuffer_i16_write(c, g_input, bench_frame));
+    TEST_SUCCEEDED_F(circbuffer_i16_read_as_float(c, out, bench_frame, 1.f, &written));
+  }
+  TEST_SUCCEEDED_F(circbuffer_i16_destroy(&c));
+}
+
+TEST_LIST = {
+    {"test_create_destroy", test_create_destroy},
+    {"test_stream", test_stream},
+    {"test_mirror", test_mirror},
+    {"test_grow_shrink", test_grow_shrink},
+    {"bench_read_as_float", bench_read_as_float},
+    {"bench_circbuffer_read_as_float", bench_circbuffer_read_as_float},
+    {NULL, NULL},
+};
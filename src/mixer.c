@@ -3,6 +3,12 @@
 #include "array2d.h"
 #include "dynamics.h"
 #include "inlines.h"
+#include "simd.h"
+
+enum {
+  // the master limiter gain is computed into a stack buffer of this many samples at a time
+  master_block_size = 256,
+};
 
 struct mixer {
   struct channel_list *cl;
@@ -17,12 +23,14 @@ struct mixer {
   size_t frame_counter;
   uint64_t position;
   bool warming;
+  bool bypassed; // the last frame was left to passthrough
 
   struct dither dither;
   struct array2d mixbuf;
   struct array2d chbuf;
   struct array2d auxbuf;
   struct array2d subbuf;
+  float const **master_view; // mixbuf offset to the current master block
 };
 
 static void release_buffer(struct mixer *const m) {
@@ -30,6 +38,9 @@ static void release_buffer(struct mixer *const m) {
   array2d_release(&m->auxbuf);
   array2d_release(&m->chbuf);
   array2d_release(&m->mixbuf);
+  if (m->master_view) {
+    ereport(mem_free(&m->master_view));
+  }
   ereport(dither_destroy(&m->dither));
 }
 
@@ -59,6 +70,11 @@ NODISCARD static error allocate_buffer(struct mixer *const m, size_t const sampl
     err = ethru(err);
     goto cleanup;
   }
+  err = mem(&m->master_view, channels, sizeof(float const *));
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
 cleanup:
   if (efailed(err)) {
     release_buffer(m);
@@ -81,21 +97,6 @@ NODISCARD error mixer_destroy(struct mixer **const mp) {
   return eok();
 }
 
-NODISCARD static error write_to_send(void *const userdata,
-                                     int const send_id,
-                                     size_t const frame_counter,
-                                     float const *restrict const *const src,
-                                     size_t const samples,
-                                     float const gain_db) {
-  struct mixer *const m = userdata;
-  error err = aux_channel_list_add(m->acl, send_id, frame_counter, src, samples, gain_db);
-  if (efailed(err)) {
-    err = ethru(err);
-    return err;
-  }
-  return eok();
-}
-
 static void channel_notify(void *const userdata,
                            int const id,
                            float const *restrict const *const buf,
@@ -131,6 +132,7 @@ NODISCARD error mixer_create(struct mixer **const mp) {
   *m = (struct mixer){
       .frame_counter = 1,
   };
+  simd_init();
   err = dynamics_create(&m->limiter);
   if (efailed(err)) {
     err = ethru(err);
@@ -154,7 +156,6 @@ NODISCARD error mixer_create(struct mixer **const mp) {
     goto cleanup;
   }
   channel_list_set_userdata(m->cl, m);
-  channel_list_set_write_to_send_target_callback(m->cl, write_to_send);
   channel_list_set_notify_callback(m->cl, channel_notify);
   aux_channel_list_set_userdata(m->acl, m);
   aux_channel_list_set_notify_callback(m->acl, aux_channel_notify);
@@ -210,13 +211,18 @@ NODISCARD error mixer_set_format(struct mixer *const m,
     goto cleanup;
   }
 
-  dynamics_set_format(m->limiter, sample_rate, channels);
+  err = dynamics_set_format(m->limiter, sample_rate, channels);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
   dynamics_update_internal_parameter(m->limiter, NULL);
 
   m->subbuf = tmp.subbuf;
   m->auxbuf = tmp.auxbuf;
   m->chbuf = tmp.chbuf;
   m->mixbuf = tmp.mixbuf;
+  m->master_view = tmp.master_view;
   m->dither = tmp.dither;
   m->sample_rate = sample_rate;
   m->channels = channels;
@@ -260,7 +266,17 @@ NODISCARD error mixer_update_aux_channel(struct mixer *const m,
                                          int const aux_channel_id,
                                          struct aux_channel_effect_params const *e,
                                          bool *const updated) {
-  error err = aux_channel_list_channel_update(m->acl, aux_channel_id, m->frame_counter, e, updated);
+  error err = eok();
+  if (m->warming) {
+    // The warm-up is not realtime, wait for the construction so that the reverb tail is built up by it.
+    err = aux_channel_list_prewarm(m->acl, aux_channel_id, e);
+    if (efailed(err)) {
+      err = ethru(err);
+      return err;
+    }
+    aux_channel_list_wait(m->acl);
+  }
+  err = aux_channel_list_channel_update(m->acl, aux_channel_id, m->frame_counter, e, updated);
   if (efailed(err)) {
     err = ethru(err);
     return err;
@@ -268,28 +284,75 @@ NODISCARD error mixer_update_aux_channel(struct mixer *const m,
   return eok();
 }
 
-void mixer_mix(struct mixer *const m, int16_t *restrict const buffer, size_t const samples) {
+// Applies the master limiter, clips, dithers and interleaves in a single pass over mixbuf.
+// Only the limiter gain goes through memory, one value per sample in a block small enough to stay in cache.
+static void master_output(struct mixer *const m,
+                          struct simd_kernels const *const k,
+                          int16_t *restrict const buffer,
+                          float *restrict const *const mixbuf,
+                          size_t const samples) {
+  size_t const channels = m->channels;
+  float gains[master_block_size];
+  float const *restrict const *const view = (float const *restrict const *)m->master_view;
+  for (size_t pos = 0; pos < samples; pos += master_block_size) {
+    size_t const n = samples - pos < master_block_size ? samples - pos : master_block_size;
+    for (size_t ch = 0; ch < channels; ++ch) {
+      m->master_view[ch] = mixbuf[ch] + pos;
+    }
+    dynamics_process_gain(m->limiter, view, gains, n);
+    k->float_to_interleaved_int16_with_gain(buffer + pos * channels, view, gains, &m->dither, channels, n);
+  }
+}
+
+// Without any channel to mix the output is the input through the master limiter.
+// When the limiter would not change it either, buffer is left as it is
+// instead of making a round trip through float that only adds the dither.
+static bool passthrough(struct mixer *const m, int16_t const *restrict const buffer, size_t const samples) {
+  if (m->output_notify_func && !m->warming) {
+    return false; // the callback wants the float signal
+  }
+  size_t const frame_counter = m->frame_counter;
+  if (channel_list_is_active(m->cl, frame_counter) || aux_channel_list_is_active(m->acl, frame_counter)) {
+    return false;
+  }
+  return dynamics_bypass(m->limiter, find_peak_int16(buffer, samples * m->channels), samples);
+}
+
+static void mix_frame(struct mixer *const m, int16_t *restrict const buffer, size_t const samples) {
   size_t const channels = m->channels;
   size_t const frame_counter = m->frame_counter;
-  float *restrict const *mixbuf = m->mixbuf.ptr;
+  float *restrict const *const mixbuf = m->mixbuf.ptr;
   float *restrict const *chbuf = m->chbuf.ptr;
   float *restrict const *subbuf = m->subbuf.ptr;
+  struct simd_kernels const *const k = simd();
 
-  interleaved_int16_to_float(mixbuf, buffer, channels, samples);
+  k->interleaved_int16_to_float(mixbuf, buffer, channels, samples);
 
   if (m->output_notify_func && !m->warming) {
     m->output_notify_func(
         m->userdata, m, mixer_channel_type_other, 0, (float const *restrict const *const)mixbuf, channels, samples);
   }
 
-  channel_list_mix(m->cl, frame_counter, samples, mixbuf, chbuf, subbuf);
+  struct channel_send_route const *routes = NULL;
+  size_t const num_routes = aux_channel_list_get_send_routes(m->acl, frame_counter, &routes);
+  channel_list_mix(m->cl, frame_counter, samples, routes, num_routes, mixbuf, chbuf, subbuf);
   aux_channel_list_mix(m->acl, frame_counter, samples, mixbuf, subbuf);
 
-  dynamics_process(m->limiter, (float const *restrict const *const)mixbuf, subbuf, samples);
-  swap(&mixbuf, &subbuf);
-
-  float_to_interleaved_int16(buffer, (float const *restrict const *const)mixbuf, &m->dither, channels, samples);
+  master_output(m, k, buffer, mixbuf, samples);
+}
 
+void mixer_mix(struct mixer *const m, int16_t *restrict const buffer, size_t const samples) {
+  size_t const frame_counter = m->frame_counter;
+  if (passthrough(m, buffer, samples)) {
+    if (!m->bypassed) {
+      // the noise shaper's error terms belong to the signal before the skipped frames
+      dither_reset(&m->dither);
+      m->bypassed = true;
+    }
+  } else {
+    mix_frame(m, buffer, samples);
+    m->bypassed = false;
+  }
   if ((frame_counter & 0xff) == 0xff) {
     channel_list_gc(m->cl, frame_counter);
     aux_channel_list_gc(m->acl, frame_counter);
@@ -0,0 +1,271 @@
+#include "peq.h"
+
+#include <emmintrin.h>
+#include <math.h>
+
+#include "inlines.h"
+#include "rbjeq.h"
+
+// The bands are evaluated as a pipeline: band k lives in SIMD lane k and
+// on every step each lane passes its output to the next lane.
+// A sample therefore reaches the last band lanes - 1 steps after it entered the first one.
+// The pipeline is filled and drained within each call, so there is no added latency.
+
+// Transposed Direct Form II state of all bands of one channel.
+struct state {
+  float s1[peq_max_bands];
+  float s2[peq_max_bands];
+};
+
+struct states {
+  struct state *ptr;
+  size_t len;
+  size_t cap;
+};
+
+struct peq {
+  struct peq_band bands[peq_max_bands];
+  size_t num_bands;
+  size_t lanes; // 0, 4 or 8
+  float b0[peq_max_bands], b1[peq_max_bands], b2[peq_max_bands], a1[peq_max_bands], a2[peq_max_bands];
+  struct states states;
+  float sample_rate;
+  size_t channels;
+  bool need_parameter_update;
+};
+
+NODISCARD error peq_create(struct peq **const pp) {
+  if (!pp || *pp) {
+    return errg(err_invalid_arugment);
+  }
+  error err = mem(pp, 1, sizeof(struct peq));
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  **pp = (struct peq){
+      .sample_rate = 48000.f,
+      .channels = 2,
+      .need_parameter_update = true,
+  };
+  return eok();
+}
+
+NODISCARD error peq_destroy(struct peq **const pp) {
+  if (!pp || !*pp) {
+    return errg(err_invalid_arugment);
+  }
+  ereport(afree(&(*pp)->states));
+  ereport(mem_free(pp));
+  return eok();
+}
+
+void peq_set_format(struct peq *const p, float const sample_rate, size_t const channels) {
+  if (fcmp(p->sample_rate, ==, sample_rate, 1e-12f) && p->channels == channels) {
+    return;
+  }
+  p->sample_rate = sample_rate;
+  p->channels = channels;
+  p->need_parameter_update = true;
+}
+
+void peq_set_bands(struct peq *const p, struct peq_band const *const bands, size_t const n) {
+  size_t const num_bands = n < peq_max_bands ? n : peq_max_bands;
+  if (p->num_bands != num_bands) {
+    p->num_bands = num_bands;
+    p->need_parameter_update = true;
+  }
+  for (size_t i = 0; i < num_bands; ++i) {
+    struct peq_band *const b = p->bands + i;
+    if (b->type == bands[i].type && fcmp(b->frequency, ==, bands[i].frequency, 1e-12f) &&
+        fcmp(b->q, ==, bands[i].q, 1e-12f) && fcmp(b->gain, ==, bands[i].gain, 1e-12f)) {
+      continue;
+    }
+    *b = bands[i];
+    p->need_parameter_update = true;
+  }
+}
+
+size_t peq_get_bands(struct peq const *const p) { return p->num_bands; }
+
+NODISCARD static error update_internal_parameter(struct peq *const p) {
+  if (p->states.len != p->channels) {
+    error err = agrow(&p->states, p->channels);
+    if (efailed(err)) {
+      err = ethru(err);
+      return err;
+    }
+    p->states.len = p->channels;
+    peq_clear(p);
+  }
+  for (size_t i = 0; i < peq_max_bands; ++i) {
+    struct rbjeq_coefficients c = {.b0 = 1.f}; // unused lanes pass the signal through
+    if (i < p->num_bands) {
+      struct peq_band const *const b = p->bands + i;
+      error err = rbjeq_calculate_coefficients(b->type, p->sample_rate, b->frequency, b->q, b->gain, &c);
+      if (efailed(err)) {
+        err = ethru(err);
+        return err;
+      }
+    }
+    p->b0[i] = c.b0;
+    p->b1[i] = c.b1;
+    p->b2[i] = c.b2;
+    p->a1[i] = c.a1;
+    p->a2[i] = c.a2;
+  }
+  p->lanes = p->num_bands == 0 ? 0 : p->num_bands <= 4 ? 4 : 8;
+  return eok();
+}
+
+NODISCARD error peq_update_internal_parameter(struct peq *const p, bool *const updated) {
+  if (!p->need_parameter_update) {
+    if (updated) {
+      *updated = false;
+    }
+    return eok();
+  }
+  error err = update_internal_parameter(p);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  p->need_parameter_update = false;
+  if (updated) {
+    *updated = true;
+  }
+  return eok();
+}
+
+struct coef {
+  __m128 b0, b1, b2, a1, a2;
+};
+
+struct stage {
+  __m128 s1, s2, y;
+};
+
+static inline struct coef load_coef(struct peq const *const p, size_t const offset) {
+  return (struct coef){
+      .b0 = _mm_loadu_ps(p->b0 + offset),
+      .b1 = _mm_loadu_ps(p->b1 + offset),
+      .b2 = _mm_loadu_ps(p->b2 + offset),
+      .a1 = _mm_loadu_ps(p->a1 + offset),
+      .a2 = _mm_loadu_ps(p->a2 + offset),
+  };
+}
+
+// Shifts v by one lane toward the last band and puts the lowest lane of x into the first lane.
+static inline __m128 shift_in(__m128 const v, __m128 const x) {
+  return _mm_move_ss(_mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)), x);
+}
+
+static inline void step(struct stage *const st, struct coef const *const c, __m128 const x) {
+  st->y = _mm_add_ps(_mm_mul_ps(c->b0, x), st->s1);
+  st->s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(c->b1, x), _mm_mul_ps(c->a1, st->y)), st->s2);
+  st->s2 = _mm_sub_ps(_mm_mul_ps(c->b2, x), _mm_mul_ps(c->a2, st->y));
+}
+
+// Same as step but keeps the state of the lanes that have no valid sample while filling or draining.
+static inline void step_masked(struct stage *const st, struct coef const *const c, __m128 const x, __m128 const mask) {
+  __m128 const s1 = st->s1, s2 = st->s2;
+  step(st, c, x);
+  st->s1 = _mm_or_ps(_mm_and_ps(mask, st->s1), _mm_andnot_ps(mask, s1));
+  st->s2 = _mm_or_ps(_mm_and_ps(mask, st->s2), _mm_andnot_ps(mask, s2));
+}
+
+// Lane k holds sample t - k at step t, which is valid only while it is in [0, samples).
+static inline __m128 valid_lanes(size_t const t, size_t const samples, __m128i const lane_index) {
+  __m128i const d = _mm_sub_epi32(_mm_set1_epi32((int)t), lane_index);
+  return _mm_castsi128_ps(
+      _mm_and_si128(_mm_cmpgt_epi32(d, _mm_set1_epi32(-1)), _mm_cmplt_epi32(d, _mm_set1_epi32((int)samples))));
+}
+
+static inline __m128 flush_denormal(__m128 const v) {
+  __m128 const abs = _mm_andnot_ps(_mm_set1_ps(-0.f), v);
+  return _mm_and_ps(v, _mm_cmpge_ps(abs, _mm_set1_ps(1e-15f)));
+}
+
+static inline __attribute__((always_inline)) void process_impl(struct peq *const p,
+                                                               float const *restrict const *const inputs,
+                                                               float *restrict const *const outputs,
+                                                               size_t const samples,
+                                                               size_t const lanes) {
+  bool const wide = lanes == 8;
+  struct coef const ca = load_coef(p, 0);
+  struct coef const cb = wide ? load_coef(p, 4) : ca;
+  __m128i const lane_index_a = _mm_set_epi32(3, 2, 1, 0);
+  __m128i const lane_index_b = _mm_set_epi32(7, 6, 5, 4);
+  size_t const latency = lanes - 1;
+  size_t const steps = samples + latency;
+  size_t const body_end = samples > latency ? samples : latency;
+  for (size_t ch = 0, chlen = p->states.len; ch < chlen; ++ch) {
+    float const *restrict const in = inputs[ch];
+    float *restrict const out = outputs[ch];
+    struct state *const s = p->states.ptr + ch;
+    struct stage a = {_mm_loadu_ps(s->s1), _mm_loadu_ps(s->s2), _mm_setzero_ps()};
+    struct stage b = {_mm_loadu_ps(s->s1 + 4), _mm_loadu_ps(s->s2 + 4), _mm_setzero_ps()};
+    size_t t = 0;
+    for (; t < latency; ++t) { // fill
+      __m128 const x = _mm_set_ss(t < samples ? in[t] : 0.f);
+      if (wide) {
+        step_masked(&b, &cb, shift_in(b.y, _mm_shuffle_ps(a.y, a.y, 0xff)), valid_lanes(t, samples, lane_index_b));
+      }
+      step_masked(&a, &ca, shift_in(a.y, x), valid_lanes(t, samples, lane_index_a));
+    }
+    if (wide) {
+      for (; t < samples; ++t) {
+        step(&b, &cb, shift_in(b.y, _mm_shuffle_ps(a.y, a.y, 0xff)));
+        step(&a, &ca, shift_in(a.y, _mm_set_ss(in[t])));
+        out[t - latency] = _mm_cvtss_f32(_mm_shuffle_ps(b.y, b.y, 0xff));
+      }
+    } else {
+      for (; t < samples; ++t) {
+        step(&a, &ca, shift_in(a.y, _mm_set_ss(in[t])));
+        out[t - latency] = _mm_cvtss_f32(_mm_shuffle_ps(a.y, a.y, 0xff));
+      }
+    }
+    for (t = body_end; t < steps; ++t) { // drain
+      __m128 const x = _mm_set_ss(t < samples ? in[t] : 0.f);
+      if (wide) {
+        step_masked(&b, &cb, shift_in(b.y, _mm_shuffle_ps(a.y, a.y, 0xff)), valid_lanes(t, samples, lane_index_b));
+        out[t - latency] = _mm_cvtss_f32(_mm_shuffle_ps(b.y, b.y, 0xff));
+      }
+      step_masked(&a, &ca, shift_in(a.y, x), valid_lanes(t, samples, lane_index_a));
+      if (!wide) {
+        out[t - latency] = _mm_cvtss_f32(_mm_shuffle_ps(a.y, a.y, 0xff));
+      }
+    }
+    _mm_storeu_ps(s->s1, flush_denormal(a.s1));
+    _mm_storeu_ps(s->s2, flush_denormal(a.s2));
+    if (wide) {
+      _mm_storeu_ps(s->s1 + 4, flush_denormal(b.s1));
+      _mm_storeu_ps(s->s2 + 4, flush_denormal(b.s2));
+    }
+  }
+}
+
+void peq_process(struct peq *const p,
+                 float const *restrict const *const inputs,
+                 float *restrict const *const outputs,
+                 size_t const samples) {
+  switch (p->lanes) {
+  case 4:
+    process_impl(p, inputs, outputs, samples, 4);
+    break;
+  case 8:
+    process_impl(p, inputs, outputs, samples, 8);
+    break;
+  default:
+    for (size_t ch = 0, chlen = p->states.len; ch < chlen; ++ch) {
+      memcpy(outputs[ch], inputs[ch], samples * sizeof(float));
+    }
+    break;
+  }
+}
+
+void peq_clear(struct peq *const p) {
+  for (size_t ch = 0, chlen = p->states.len; ch < chlen; ++ch) {
+    p->states.ptr[ch] = (struct state){0};
+  }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "ovbase.h"
+
+enum {
+  peq_max_bands = 8,
+};
+
+struct peq_band {
+  int type; // enum rbjeq_type
+  float frequency;
+  float q;
+  float gain;
+};
+
+struct peq;
+
+NODISCARD error peq_create(struct peq **const pp);
+NODISCARD error peq_destroy(struct peq **const pp);
+
+void peq_set_format(struct peq *const p, float const sample_rate, size_t const channels);
+// Bands are applied in series from bands[0]. n is clamped to peq_max_bands.
+void peq_set_bands(struct peq *const p, struct peq_band const *const bands, size_t const n);
+size_t peq_get_bands(struct peq const *const p);
+
+NODISCARD error peq_update_internal_parameter(struct peq *const p, bool *const updated);
+
+void peq_process(struct peq *const p,
+                 float const *restrict const *const inputs,
+                 float *restrict const *const outputs,
+                 size_t const samples);
+void peq_clear(struct peq *const p);
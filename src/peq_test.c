@@ -0,0 +1,168 @@
+#include "peq.c"
+
+#include "ovtest.h"
+
+enum {
+  test_max_channels = 3,
+  test_samples = 4800,
+};
+
+static float g_input[test_max_channels][test_samples];
+static float g_output[test_max_channels][test_samples];
+static float g_reference[test_max_channels][test_samples];
+static float g_tmp[test_max_channels][test_samples];
+
+static struct peq_band const g_bands[peq_max_bands] = {
+    {rbjeq_type_high_pass, 30.f, 0.7071f, 0.f},
+    {rbjeq_type_low_shelf, 200.f, 0.7071f, 4.f},
+    {rbjeq_type_peaking, 500.f, 1.5f, -3.f},
+    {rbjeq_type_notch, 1000.f, 8.f, 0.f},
+    {rbjeq_type_peaking, 2500.f, 0.9f, 2.f},
+    {rbjeq_type_high_shelf, 6000.f, 0.7071f, -4.f},
+    {rbjeq_type_band_pass, 8000.f, 0.5f, 0.f},
+    {rbjeq_type_low_pass, 18000.f, 0.7071f, 0.f},
+};
+
+static void f(float v) { (void)v; }
+
+static void generate_input(void) {
+  uint32_t t = (uint32_t)get_global_hint();
+  static float const divider = 1.f / (float)(UINT32_MAX);
+  for (size_t ch = 0; ch < test_max_channels; ++ch) {
+    for (size_t i = 0; i < test_samples; ++i) {
+      g_input[ch][i] = (float)(ov_splitmix32(t)) * divider * 2.f - 1.f;
+      t = ov_splitmix32_next(t);
+    }
+  }
+}
+
+// Runs the bands one after another in double precision, so that the result is practically free of rounding errors.
+static void process_reference(size_t const bands, size_t const channels) {
+  static double buf[test_samples];
+  for (size_t ch = 0; ch < channels; ++ch) {
+    for (size_t i = 0; i < test_samples; ++i) {
+      buf[i] = (double)g_input[ch][i];
+    }
+    for (size_t b = 0; b < bands; ++b) {
+      struct rbjeq_coefficients c;
+      TEST_SUCCEEDED_F(rbjeq_calculate_coefficients(
+          g_bands[b].type, 48000.f, g_bands[b].frequency, g_bands[b].q, g_bands[b].gain, &c));
+      double s1 = 0., s2 = 0.;
+      for (size_t i = 0; i < test_samples; ++i) {
+        double const x = buf[i];
+        double const y = (double)c.b0 * x + s1;
+        s1 = (double)c.b1 * x - (double)c.a1 * y + s2;
+        s2 = (double)c.b2 * x - (double)c.a2 * y;
+        buf[i] = y;
+      }
+    }
+    for (size_t i = 0; i < test_samples; ++i) {
+      g_reference[ch][i] = (float)buf[i];
+    }
+  }
+}
+
+// Processes the whole input in uneven frames, including ones shorter than the pipeline.
+static void process_all(struct peq *const p, size_t const channels) {
+  static size_t const frames[] = {1, 3, 7, 64, 333, 1000};
+  size_t pos = 0, fi = 0;
+  while (pos < test_samples) {
+    size_t n = frames[fi++ % (sizeof(frames) / sizeof(frames[0]))];
+    if (n > test_samples - pos) {
+      n = test_samples - pos;
+    }
+    float const *in[test_max_channels];
+    float *out[test_max_channels];
+    for (size_t ch = 0; ch < channels; ++ch) {
+      in[ch] = g_input[ch] + pos;
+      out[ch] = g_output[ch] + pos;
+    }
+    peq_process(p, (float const *restrict const *)in, (float *restrict const *)out, n);
+    pos += n;
+  }
+}
+
+static void test_cascade(void) {
+  // The 30 Hz low cut has its poles at 0.997, so rounding errors in its state build up at low frequencies and
+  // any single precision cascade ends up 2e-4 to 5e-4 away from the double precision result (a cascade of rbjeq
+  // filters included). -ffast-math lets the compiler order the operations of the two differently, so their errors
+  // add up when they are compared with each other. Once the band-pass removes the low end the deviation is 3e-6.
+  static float const tolerance = 1e-3f;
+  struct peq *p = NULL;
+  generate_input();
+  TEST_SUCCEEDED_F(peq_create(&p));
+  for (size_t channels = 1; channels <= test_max_channels; ++channels) {
+    for (size_t bands = 0; bands <= peq_max_bands; ++bands) {
+      peq_set_format(p, 48000.f, channels);
+      peq_set_bands(p, g_bands, bands);
+      TEST_SUCCEEDED_F(peq_update_internal_parameter(p, NULL));
+      peq_clear(p);
+      process_all(p, channels);
+      process_reference(bands, channels);
+      float dev = 0.f;
+      for (size_t ch = 0; ch < channels; ++ch) {
+        for (size_t i = 0; i < test_samples; ++i) {
+          dev = fmaxf(dev, fabsf(g_output[ch][i] - g_reference[ch][i]));
+        }
+      }
+      TEST_CHECK(dev < tolerance);
+      TEST_MSG("%zu bands, %zu channels: max deviation %g", bands, channels, (double)dev);
+    }
+  }
+  TEST_SUCCEEDED_F(peq_destroy(&p));
+}
+
+static void bench_peq(size_t const bands) {
+  struct peq *p = NULL;
+  generate_input();
+  TEST_SUCCEEDED_F(peq_create(&p));
+  peq_set_format(p, 48000.f, 2);
+  peq_set_bands(p, g_bands, bands);
+  TEST_SUCCEEDED_F(peq_update_internal_parameter(p, NULL));
+  float const *in[2] = {g_input[0], g_input[1]};
+  float *out[2] = {g_output[0], g_output[1]};
+  for (int i = 0; i < 1000; ++i) {
+    peq_process(p, (float const *restrict const *)in, (float *restrict const *)out, test_samples);
+  }
+  f(g_output[0][0]);
+  TEST_SUCCEEDED_F(peq_destroy(&p));
+}
+
+static void bench_stereo_peq_2_bands(void) { bench_peq(2); }
+static void bench_stereo_peq_4_bands(void) { bench_peq(4); }
+static void bench_stereo_peq_8_bands(void) { bench_peq(8); }
+
+static void bench_stereo_rbjeq_2_filters(void) {
+  struct rbjeq *low = NULL;
+  struct rbjeq *high = NULL;
+  generate_input();
+  TEST_SUCCEEDED_F(rbjeq_create(&low));
+  TEST_SUCCEEDED_F(rbjeq_create(&high));
+  rbjeq_set_kernel(low, rbjeq_kernel_scalar);
+  rbjeq_set_kernel(high, rbjeq_kernel_scalar);
+  rbjeq_set_type(low, rbjeq_type_low_shelf);
+  rbjeq_set_gain(low, 4.f);
+  rbjeq_set_type(high, rbjeq_type_high_shelf);
+  rbjeq_set_gain(high, -4.f);
+  TEST_SUCCEEDED_F(rbjeq_update_internal_parameter(low, NULL));
+  TEST_SUCCEEDED_F(rbjeq_update_internal_parameter(high, NULL));
+  float const *in[2] = {g_input[0], g_input[1]};
+  float *tmp[2] = {g_tmp[0], g_tmp[1]};
+  float *out[2] = {g_output[0], g_output[1]};
+  for (int i = 0; i < 1000; ++i) {
+    rbjeq_process(low, (float const *restrict const *)in, (float *restrict const *)tmp, test_samples);
+    rbjeq_process(high, (float const *restrict const *)tmp, (float *restrict const *)out, test_samples);
+  }
+  f(g_output[0][0]);
+  TEST_SUCCEEDED_F(rbjeq_destroy(&high));
+  TEST_SUCCEEDED_F(rbjeq_destroy(&low));
+}
+
+TEST_LIST = {
+    {"test_cascade", test_cascade},
+    {"bench_stereo_rbjeq_2_filters", bench_stereo_rbjeq_2_filters},
+    {"bench_stereo_peq_2_bands", bench_stereo_peq_2_bands},
+    {"bench_stereo_peq_4_bands", bench_stereo_peq_4_bands},
+    {"bench_stereo_peq_8_bands", bench_stereo_peq_8_bands},
+    {NULL, NULL},
+};
@@ -5,7 +5,9 @@
 
 #include <math.h>
 
+#include "coefcache.h"
 #include "inlines.h"
+#include "simd.h"
 
 struct channel {
   float in0, in1, out0, out1;
@@ -17,11 +19,21 @@ struct channels {
   size_t cap;
 };
 
+// Transposed Direct Form II state for the kernels of biquad.h,
+// s1 of every channel followed by s2 of every channel, each padded to a multiple of 8 channels.
+struct states {
+  float *ptr;
+  size_t len;
+  size_t cap;
+};
+
 struct rbjeq {
   float b0a0, b1a0, b2a0, a1a0, a2a0;
   float sample_rate, frequency, q, gain;
   struct channels buffers;
+  struct states states;
   int filter_type;
+  int kernel;
   size_t channels;
   bool need_parameter_update;
 };
@@ -41,6 +53,7 @@ NODISCARD error rbjeq_create(struct rbjeq **const eqp) {
       .q = 1.f,
       .channels = 2,
       .filter_type = rbjeq_type_low_pass,
+      .kernel = rbjeq_kernel_simd,
       .need_parameter_update = true,
   };
   return eok();
@@ -51,6 +64,7 @@ NODISCARD error rbjeq_destroy(struct rbjeq **const eqp) {
     return errg(err_invalid_arugment);
   }
   ereport(afree(&(*eqp)->buffers));
+  ereport(afree(&(*eqp)->states));
   ereport(mem_free(eqp));
   return eok();
 }
@@ -72,6 +86,14 @@ void rbjeq_set_type(struct rbjeq *const eq, int const v) {
   eq->need_parameter_update = true;
 }
 
+void rbjeq_set_kernel(struct rbjeq *const eq, int const v) {
+  if (eq->kernel == v) {
+    return;
+  }
+  eq->kernel = v;
+  rbjeq_clear(eq); // state layouts are different between kernels
+}
+
 void rbjeq_set_frequency(struct rbjeq *const eq, float const v) {
   if (fcmp(eq->frequency, ==, v, 1e-12f)) {
     return;
@@ -115,29 +137,22 @@ void rbjeq_get_gain_str(struct rbjeq *const eq, NATIVE_CHAR dest[16]) {
   write_str(dest, ov_ftoa((double)eq->gain, 2, NSTR('.'), tmp));
 }
 
-NODISCARD static error update_internal_parameter(struct rbjeq *const eq) {
-  if (eq->buffers.len != eq->channels) {
-    error err = agrow(&eq->buffers, eq->channels);
-    if (efailed(err)) {
-      err = ethru(err);
-      return err;
-    }
-    eq->buffers.len = eq->channels;
-    rbjeq_clear(eq);
-  }
+NODISCARD static error calculate_coefficients(int const type,
+                                              float const sample_rate,
+                                              float const frequency,
+                                              float const q,
+                                              float const gain,
+                                              struct rbjeq_coefficients *const c) {
   static float const pi = 3.14159265358979323846264338327950288f;
-  float const sample_rate = eq->sample_rate;
-  float const freq = fmaxf(0.f, fminf(eq->frequency, sample_rate * 0.5f));
-  float const q = fmaxf(eq->q, 1e-12f);
-  float const gain = eq->gain;
-
+  float const freq = fmaxf(0.f, fminf(frequency, sample_rate * 0.5f));
+  float const qv = fmaxf(q, 1e-12f);
   float const A = powf(10.f, gain / 40.f);
   float const w0 = 2.f * pi * freq / sample_rate;
   float const tsin = sinf(w0), tcos = cosf(w0);
-  float const alpha = tsin / (2.f * q);
-  float const beta = sqrtf(A) / q;
+  float const alpha = tsin / (2.f * qv);
+  float const beta = sqrtf(A) / qv;
   float a0, a1, a2, b0, b1, b2;
-  switch (eq->filter_type) {
+  switch (type) {
   case rbjeq_type_low_pass:
     b0 = (1.f - tcos) / 2.f;
     b1 = 1.f - tcos;
@@ -205,11 +220,80 @@ NODISCARD static error update_internal_parameter(struct rbjeq *const eq) {
   default:
     return errg(err_unexpected);
   }
-  eq->b0a0 = b0 / a0;
-  eq->b1a0 = b1 / a0;
-  eq->b2a0 = b2 / a0;
-  eq->a1a0 = a1 / a0;
-  eq->a2a0 = a2 / a0;
+  c->b0 = b0 / a0;
+  c->b1 = b1 / a0;
+  c->b2 = b2 / a0;
+  c->a1 = a1 / a0;
+  c->a2 = a2 / a0;
+  return eok();
+}
+
+struct cache_key {
+  int32_t type;
+  float sample_rate;
+  float frequency;
+  float q;
+  float gain;
+};
+
+static struct coefcache g_cache = COEFCACHE_INIT;
+
+NODISCARD error rbjeq_calculate_coefficients(int const type,
+                                             float const sample_rate,
+                                             float const frequency,
+                                             float const q,
+                                             float const gain,
+                                             struct rbjeq_coefficients *const c) {
+  if (!c) {
+    return errg(err_invalid_arugment);
+  }
+  struct cache_key const key = {
+      .type = type,
+      .sample_rate = sample_rate,
+      .frequency = frequency,
+      .q = q,
+      .gain = gain,
+  };
+  if (coefcache_get(&g_cache, &key, sizeof(key), c, sizeof(*c))) {
+    return eok();
+  }
+  error err = calculate_coefficients(type, sample_rate, frequency, q, gain, c);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  coefcache_put(&g_cache, &key, sizeof(key), c, sizeof(*c));
+  return eok();
+}
+
+NODISCARD static error update_internal_parameter(struct rbjeq *const eq) {
+  if (eq->buffers.len != eq->channels) {
+    error err = agrow(&eq->buffers, eq->channels);
+    if (efailed(err)) {
+      err = ethru(err);
+      return err;
+    }
+    eq->buffers.len = eq->channels;
+    size_t const states = 2 * ((eq->channels + 7) & ~(size_t)7);
+    err = agrow(&eq->states, states);
+    if (efailed(err)) {
+      err = ethru(err);
+      return err;
+    }
+    eq->states.len = states;
+    rbjeq_clear(eq);
+  }
+  struct rbjeq_coefficients c;
+  error err = rbjeq_calculate_coefficients(eq->filter_type, eq->sample_rate, eq->frequency, eq->q, eq->gain, &c);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  eq->b0a0 = c.b0;
+  eq->b1a0 = c.b1;
+  eq->b2a0 = c.b2;
+  eq->a1a0 = c.a1;
+  eq->a2a0 = c.a2;
   return eok();
 }
 
@@ -239,10 +323,10 @@ float rbjeq_get_lookahead_duration(struct rbjeq *const eq) {
   return 2.f / eq->sample_rate;
 }
 
-void rbjeq_process(struct rbjeq *const eq,
-                   float const *restrict const *const inputs,
-                   float *restrict const *const outputs,
-                   size_t const samples) {
+static void process_scalar(struct rbjeq *const eq,
+                           float const *restrict const *const inputs,
+                           float *restrict const *const outputs,
+                           size_t const samples) {
   float const denom = 1e-24f;
   float const b0a0 = eq->b0a0;
   float const b1a0 = eq->b1a0;
@@ -278,8 +362,95 @@ void rbjeq_process(struct rbjeq *const eq,
   }
 }
 
+static void process_cascade_scalar(struct rbjeq *const eq1,
+                                   struct rbjeq *const eq2,
+                                   float const *restrict const *const inputs,
+                                   float *restrict const *const outputs,
+                                   size_t const samples) {
+  float const denom = 1e-24f;
+  float const b0a0 = eq1->b0a0, b1a0 = eq1->b1a0, b2a0 = eq1->b2a0, a1a0 = eq1->a1a0, a2a0 = eq1->a2a0;
+  float const c0a0 = eq2->b0a0, c1a0 = eq2->b1a0, c2a0 = eq2->b2a0, d1a0 = eq2->a1a0, d2a0 = eq2->a2a0;
+  float i0, i1, o0, o1, p0, p1, last, v;
+  for (size_t ch = 0, chlen = eq1->buffers.len; ch < chlen; ++ch) {
+    struct channel *const chbuf1 = eq1->buffers.ptr + ch;
+    struct channel *const chbuf2 = eq2->buffers.ptr + ch;
+    float const *const in = inputs[ch];
+    float *const out = outputs[ch];
+    i0 = chbuf1->in0;
+    i1 = chbuf1->in1;
+    o0 = chbuf1->out0;
+    o1 = chbuf1->out1;
+    p0 = chbuf2->out0;
+    p1 = chbuf2->out1;
+    for (size_t i = 0; i < samples; ++i) {
+      v = in[i];
+      last = b0a0 * v + b1a0 * i0 + b2a0 * i1 - a1a0 * o0 - a2a0 * o1 + denom;
+      last -= denom;
+      i1 = i0;
+      i0 = v;
+      // the input history of the second stage is the output history of the first stage
+      v = c0a0 * last + c1a0 * o0 + c2a0 * o1 - d1a0 * p0 - d2a0 * p1 + denom;
+      v -= denom;
+      o1 = o0;
+      o0 = last;
+      p1 = p0;
+      p0 = v;
+      out[i] = v;
+    }
+    chbuf1->in0 = i0;
+    chbuf1->in1 = i1;
+    chbuf1->out0 = o0;
+    chbuf1->out1 = o1;
+    chbuf2->in0 = o0;
+    chbuf2->in1 = o1;
+    chbuf2->out0 = p0;
+    chbuf2->out1 = p1;
+  }
+}
+
+static inline struct simd_biquad get_biquad(struct rbjeq const *const eq) {
+  return (struct simd_biquad){
+      .b0 = eq->b0a0,
+      .b1 = eq->b1a0,
+      .b2 = eq->b2a0,
+      .a1 = eq->a1a0,
+      .a2 = eq->a2a0,
+      .s1 = eq->states.ptr,
+      .s2 = eq->states.ptr + eq->states.len / 2,
+  };
+}
+
+void rbjeq_process(struct rbjeq *const eq,
+                   float const *restrict const *const inputs,
+                   float *restrict const *const outputs,
+                   size_t const samples) {
+  if (eq->kernel == rbjeq_kernel_simd) {
+    struct simd_biquad const b = get_biquad(eq);
+    simd()->biquad(&b, NULL, inputs, outputs, eq->buffers.len, samples);
+    return;
+  }
+  process_scalar(eq, inputs, outputs, samples);
+}
+
+void rbjeq_process_cascade(struct rbjeq *const eq1,
+                           struct rbjeq *const eq2,
+                           float const *restrict const *const inputs,
+                           float *restrict const *const outputs,
+                           size_t const samples) {
+  if (eq1->kernel == rbjeq_kernel_simd) {
+    struct simd_biquad const b1 = get_biquad(eq1);
+    struct simd_biquad const b2 = get_biquad(eq2);
+    simd()->biquad(&b1, &b2, inputs, outputs, eq1->buffers.len, samples);
+    return;
+  }
+  process_cascade_scalar(eq1, eq2, inputs, outputs, samples);
+}
+
 void rbjeq_clear(struct rbjeq *const eq) {
   for (size_t ch = 0, chlen = eq->buffers.len; ch < chlen; ++ch) {
     eq->buffers.ptr[ch] = (struct channel){0};
   }
+  for (size_t i = 0, len = eq->states.len; i < len; ++i) {
+    eq->states.ptr[i] = 0.f;
+  }
 }
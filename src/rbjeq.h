@@ -1,3 +1,4 @@
+#pragma once
 
 #include "ovbase.h"
 
@@ -14,11 +15,30 @@ enum rbjeq_type {
   rbjeq_type_all_pass,
 };
 
+enum rbjeq_kernel {
+  rbjeq_kernel_scalar, // Direct Form I, channel by channel
+  rbjeq_kernel_simd,   // Transposed Direct Form II, channels in SSE lanes
+};
+
+// Biquad coefficients normalized by a0.
+struct rbjeq_coefficients {
+  float b0, b1, b2, a1, a2;
+};
+
+// Results are cached process-wide, so identical parameter sets are computed only once.
+NODISCARD error rbjeq_calculate_coefficients(int const type,
+                                             float const sample_rate,
+                                             float const frequency,
+                                             float const q,
+                                             float const gain,
+                                             struct rbjeq_coefficients *const c);
+
 NODISCARD error rbjeq_create(struct rbjeq **const eqp);
 NODISCARD error rbjeq_destroy(struct rbjeq **const eqp);
 
 void rbjeq_set_format(struct rbjeq *const eq, float const sample_rate, size_t const channels);
 void rbjeq_set_type(struct rbjeq *const eq, int const v);
+void rbjeq_set_kernel(struct rbjeq *const eq, int const v);
 void rbjeq_set_frequency(struct rbjeq *const eq, float const v);
 void rbjeq_get_frequency_str(struct rbjeq *const eq, NATIVE_CHAR dest[16]);
 
@@ -35,4 +55,11 @@ void rbjeq_process(struct rbjeq *const eq,
                    float const *restrict const *const inputs,
                    float *restrict const *const outputs,
                    size_t const samples);
+// Processes eq1 and eq2 in series in a single pass.
+// Both must have the same format and kernel.
+void rbjeq_process_cascade(struct rbjeq *const eq1,
+                           struct rbjeq *const eq2,
+                           float const *restrict const *const inputs,
+                           float *restrict const *const outputs,
+                           size_t const samples);
 void rbjeq_clear(struct rbjeq *const eq);
@@ -0,0 +1,210 @@
+#include "rbjeq.c"
+
+#include "ovtest.h"
+
+enum {
+  test_max_channels = 9,
+  test_samples = 4800,
+};
+
+static float g_input[test_max_channels][test_samples];
+static float g_output[test_max_channels][test_samples];
+static float g_reference[test_max_channels][test_samples];
+static float g_tmp[test_max_channels][test_samples];
+
+static void f(float v) { (void)v; }
+
+static void generate_input(void) {
+  uint32_t t = (uint32_t)get_global_hint();
+  static float const divider = 1.f / (float)(UINT32_MAX);
+  for (size_t ch = 0; ch < test_max_channels; ++ch) {
+    for (size_t i = 0; i < test_samples; ++i) {
+      g_input[ch][i] = (float)(ov_splitmix32(t)) * divider * 2.f - 1.f;
+      t = ov_splitmix32_next(t);
+    }
+  }
+}
+
+static void setup(struct rbjeq *const eq, int const type, float const frequency, float const gain, size_t const channels) {
+  rbjeq_set_format(eq, 48000.f, channels);
+  rbjeq_set_type(eq, type);
+  rbjeq_set_frequency(eq, frequency);
+  rbjeq_set_q(eq, 1.f / 1.41421356237f);
+  rbjeq_set_gain(eq, gain);
+}
+
+// Processes the whole input in uneven frames so that both the 4-sample body and the tail are exercised.
+static void process_all(struct rbjeq *const eq1,
+                        struct rbjeq *const eq2,
+                        size_t const channels,
+                        float (*const output)[test_samples]) {
+  static size_t const frames[] = {1, 7, 64, 333, 1000};
+  size_t pos = 0, fi = 0;
+  while (pos < test_samples) {
+    size_t n = frames[fi++ % (sizeof(frames) / sizeof(frames[0]))];
+    if (n > test_samples - pos) {
+      n = test_samples - pos;
+    }
+    float const *in[test_max_channels];
+    float *out[test_max_channels];
+    for (size_t ch = 0; ch < channels; ++ch) {
+      in[ch] = g_input[ch] + pos;
+      out[ch] = output[ch] + pos;
+    }
+    if (eq2) {
+      rbjeq_process_cascade(eq1, eq2, (float const *restrict const *)in, (float *restrict const *)out, n);
+    } else {
+      rbjeq_process(eq1, (float const *restrict const *)in, (float *restrict const *)out, n);
+    }
+    pos += n;
+  }
+}
+
+static float max_deviation(size_t const channels) {
+  float r = 0.f;
+  for (size_t ch = 0; ch < channels; ++ch) {
+    for (size_t i = 0; i < test_samples; ++i) {
+      r = fmaxf(r, fabsf(g_output[ch][i] - g_reference[ch][i]));
+    }
+  }
+  return r;
+}
+
+// The simd kernel is checked at every level this machine supports,
+// AVX2 takes 5 to 8 channels in one vector and stereo cascades use their own pipeline.
+static void test_simd(void) {
+  static float const tolerance = 2e-4f;
+  struct rbjeq *eq = NULL;
+  generate_input();
+  TEST_SUCCEEDED_F(rbjeq_create(&eq));
+  for (int level = simd_level_sse2; level <= (int)simd_detect(); ++level) {
+    TEST_SUCCEEDED_F(simd_set_level((enum simd_level)level));
+    for (int type = rbjeq_type_low_pass; type <= rbjeq_type_all_pass; ++type) {
+      for (size_t channels = 1; channels <= test_max_channels; ++channels) {
+        setup(eq, type, 200.f, 6.f, channels);
+        TEST_SUCCEEDED_F(rbjeq_update_internal_parameter(eq, NULL));
+        rbjeq_set_kernel(eq, rbjeq_kernel_scalar);
+        rbjeq_clear(eq);
+        process_all(eq, NULL, channels, g_reference);
+        rbjeq_set_kernel(eq, rbjeq_kernel_simd);
+        rbjeq_clear(eq);
+        process_all(eq, NULL, channels, g_output);
+        float const dev = max_deviation(channels);
+        TEST_CHECK(dev < tolerance);
+        TEST_MSG("level %d, type %d, %zu channels: max deviation %g", level, type, channels, (double)dev);
+      }
+    }
+  }
+  TEST_SUCCEEDED_F(simd_set_level(simd_level_sse2));
+  TEST_SUCCEEDED_F(rbjeq_destroy(&eq));
+}
+
+static void test_cascade(void) {
+  static float const tolerance = 2e-4f;
+  static int const kernels[] = {rbjeq_kernel_scalar, rbjeq_kernel_simd};
+  struct rbjeq *low = NULL;
+  struct rbjeq *high = NULL;
+  generate_input();
+  TEST_SUCCEEDED_F(rbjeq_create(&low));
+  TEST_SUCCEEDED_F(rbjeq_create(&high));
+  for (size_t channels = 1; channels <= test_max_channels; ++channels) {
+    setup(low, rbjeq_type_low_shelf, 200.f, 6.f, channels);
+    setup(high, rbjeq_type_high_shelf, 3000.f, -6.f, channels);
+    TEST_SUCCEEDED_F(rbjeq_update_internal_parameter(low, NULL));
+    TEST_SUCCEEDED_F(rbjeq_update_internal_parameter(high, NULL));
+
+    // reference: scalar kernel, one filter after another
+    rbjeq_set_kernel(low, rbjeq_kernel_scalar);
+    rbjeq_set_kernel(high, rbjeq_kernel_scalar);
+    rbjeq_clear(low);
+    rbjeq_clear(high);
+    process_all(low, NULL, channels, g_tmp);
+    float const *in[test_max_channels];
+    float *out[test_max_channels];
+    for (size_t ch = 0; ch < channels; ++ch) {
+      in[ch] = g_tmp[ch];
+      out[ch] = g_reference[ch];
+    }
+    rbjeq_process(high, (float const *restrict const *)in, (float *restrict const *)out, test_samples);
+
+    for (int level = simd_level_sse2; level <= (int)simd_detect(); ++level) {
+      TEST_SUCCEEDED_F(simd_set_level((enum simd_level)level));
+      for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); ++i) {
+        rbjeq_set_kernel(low, kernels[i]);
+        rbjeq_set_kernel(high, kernels[i]);
+        rbjeq_clear(low);
+        rbjeq_clear(high);
+        process_all(low, high, channels, g_output);
+        float const dev = max_deviation(channels);
+        TEST_CHECK(dev < tolerance);
+        TEST_MSG("level %d, kernel %d, %zu channels: max deviation %g", level, kernels[i], channels, (double)dev);
+      }
+    }
+  }
+  TEST_SUCCEEDED_F(simd_set_level(simd_level_sse2));
+  TEST_SUCCEEDED_F(rbjeq_destroy(&high));
+  TEST_SUCCEEDED_F(rbjeq_destroy(&low));
+}
+
+static void bench(int const kernel, bool const cascade, size_t const channels, enum simd_level const level) {
+  struct rbjeq *low = NULL;
+  struct rbjeq *high = NULL;
+  generate_input();
+  TEST_SUCCEEDED_F(rbjeq_create(&low));
+  TEST_SUCCEEDED_F(rbjeq_create(&high));
+  if (level > simd_detect()) {
+    TEST_MSG("level %d is not supported here", (int)level);
+    goto cleanup;
+  }
+  TEST_SUCCEEDED_F(simd_set_level(level));
+  setup(low, rbjeq_type_low_shelf, 200.f, 6.f, channels);
+  setup(high, rbjeq_type_high_shelf, 3000.f, -6.f, channels);
+  TEST_SUCCEEDED_F(rbjeq_update_internal_parameter(low, NULL));
+  TEST_SUCCEEDED_F(rbjeq_update_internal_parameter(high, NULL));
+  rbjeq_set_kernel(low, kernel);
+  rbjeq_set_kernel(high, kernel);
+  float const *in[test_max_channels];
+  float *tmp[test_max_channels];
+  float *out[test_max_channels];
+  for (size_t ch = 0; ch < channels; ++ch) {
+    in[ch] = g_input[ch];
+    tmp[ch] = g_tmp[ch];
+    out[ch] = g_output[ch];
+  }
+  for (int i = 0; i < 1000; ++i) {
+    if (cascade) {
+      rbjeq_process_cascade(low, high, (float const *restrict const *)in, (float *restrict const *)out, test_samples);
+    } else {
+      rbjeq_process(low, (float const *restrict const *)in, (float *restrict const *)tmp, test_samples);
+      rbjeq_process(high, (float const *restrict const *)tmp, (float *restrict const *)out, test_samples);
+    }
+  }
+  f(g_output[0][0]);
+  TEST_SUCCEEDED_F(simd_set_level(simd_level_sse2));
+cleanup:
+  TEST_SUCCEEDED_F(rbjeq_destroy(&high));
+  TEST_SUCCEEDED_F(rbjeq_destroy(&low));
+}
+
+static void bench_stereo_scalar(void) { bench(rbjeq_kernel_scalar, false, 2, simd_level_sse2); }
+static void bench_stereo_scalar_cascade(void) { bench(rbjeq_kernel_scalar, true, 2, simd_level_sse2); }
+static void bench_stereo_simd(void) { bench(rbjeq_kernel_simd, false, 2, simd_level_sse2); }
+static void bench_stereo_simd_cascade(void) { bench(rbjeq_kernel_simd, true, 2, simd_level_sse2); }
+static void bench_stereo_avx2_cascade(void) { bench(rbjeq_kernel_simd, true, 2, simd_level_avx2); }
+static void bench_8ch_scalar_cascade(void) { bench(rbjeq_kernel_scalar, true, 8, simd_level_sse2); }
+static void bench_8ch_simd_cascade(void) { bench(rbjeq_kernel_simd, true, 8, simd_level_sse2); }
+static void bench_8ch_avx2_cascade(void) { bench(rbjeq_kernel_simd, true, 8, simd_level_avx2); }
+
+TEST_LIST = {
+    {"test_simd", test_simd},
+    {"test_cascade", test_cascade},
+    {"bench_stereo_scalar", bench_stereo_scalar},
+    {"bench_stereo_scalar_cascade", bench_stereo_scalar_cascade},
+    {"bench_stereo_simd", bench_stereo_simd},
+    {"bench_stereo_simd_cascade", bench_stereo_simd_cascade},
+    {"bench_stereo_avx2_cascade", bench_stereo_avx2_cascade},
+    {"bench_8ch_scalar_cascade", bench_8ch_scalar_cascade},
+    {"bench_8ch_simd_cascade", bench_8ch_simd_cascade},
+    {"bench_8ch_avx2_cascade", bench_8ch_avx2_cascade},
+    {NULL, NULL},
+};
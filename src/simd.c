@@ -0,0 +1,78 @@
+#include "simd.h"
+
+#include <cpuid.h>
+#include <immintrin.h>
+#include <stdlib.h>
+#include <string.h>
+
+static enum simd_level g_level = simd_level_sse2;
+static struct simd_kernels const *g_kernels = &simd_kernels_sse2;
+
+// The extended registers can only be used when the OS saves them on context switches,
+// only called after cpuid reported OSXSAVE.
+__attribute__((target("xsave"))) static uint64_t xgetbv0(void) { return (uint64_t)_xgetbv(0); }
+
+enum simd_level simd_detect(void) {
+  enum {
+    xcr0_avx = 0x06,    // XMM, YMM
+    xcr0_avx512 = 0xe0, // opmask, ZMM0-15 upper halves, ZMM16-31
+  };
+  unsigned int a, b, c, d;
+  if (!__get_cpuid(1, &a, &b, &c, &d)) {
+    return simd_level_sse2;
+  }
+  if (!(c & bit_OSXSAVE) || !(c & bit_AVX) || !(c & bit_FMA)) {
+    return simd_level_sse2;
+  }
+  uint64_t const xcr0 = xgetbv0();
+  if ((xcr0 & xcr0_avx) != xcr0_avx || __get_cpuid_max(0, NULL) < 7) {
+    return simd_level_sse2;
+  }
+  __cpuid_count(7, 0, a, b, c, d);
+  if (!(b & bit_AVX2)) {
+    return simd_level_sse2;
+  }
+  unsigned int const avx512 = bit_AVX512F | bit_AVX512BW | bit_AVX512VL;
+  if ((b & avx512) != avx512 || (xcr0 & xcr0_avx512) != xcr0_avx512) {
+    return simd_level_avx2;
+  }
+  return simd_level_avx512;
+}
+
+static void apply(enum simd_level const level) {
+  static struct simd_kernels const *const kernels[] = {
+      [simd_level_sse2] = &simd_kernels_sse2,
+      [simd_level_avx2] = &simd_kernels_avx2,
+      [simd_level_avx512] = &simd_kernels_avx512,
+  };
+  g_level = level;
+  g_kernels = kernels[level];
+}
+
+void simd_init(void) {
+  enum simd_level const detected = simd_detect();
+  enum simd_level level = detected;
+  char const *const env = getenv("AUDIOMIXER_SIMD");
+  if (env) {
+    if (strcmp(env, "sse2") == 0) {
+      level = simd_level_sse2;
+    } else if (strcmp(env, "avx2") == 0 && detected >= simd_level_avx2) {
+      level = simd_level_avx2;
+    } else if (strcmp(env, "avx512") == 0 && detected >= simd_level_avx512) {
+      level = simd_level_avx512;
+    }
+  }
+  apply(level);
+}
+
+NODISCARD error simd_set_level(enum simd_level const level) {
+  if (level > simd_detect()) {
+    return errg(err_invalid_arugment);
+  }
+  apply(level);
+  return eok();
+}
+
+enum simd_level simd_get_level(void) { return g_level; }
+
+struct simd_kernels const *simd(void) { return g_kernels; }
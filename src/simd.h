@@ -0,0 +1,116 @@
+#pragma once
+
+#include "ovbase.h"
+
+struct dither;
+
+enum simd_level {
+  simd_level_sse2,
+  simd_level_avx2,   // AVX2 and FMA
+  simd_level_avx512, // AVX-512 F/BW/VL on top of AVX2
+};
+
+// One biquad section in Transposed Direct Form II, normalized by a0.
+// s1 and s2 hold the state of each channel and are padded so that kernels may read and write them
+// up to the next multiple of 8 channels.
+struct simd_biquad {
+  float b0, b1, b2, a1, a2;
+  float *s1;
+  float *s2;
+};
+
+enum {
+  simd_fdn_lines = 8,
+  simd_fdn_block_max = 64,
+};
+
+// One sub-block of the feedback delay network of fdnreverb.
+// Every array is padded to simd_fdn_block_max samples so the kernels need no scalar tail,
+// the padding carries stale values that are never written back to the lines.
+struct simd_fdn_block {
+  _Alignas(32) float x[simd_fdn_block_max];                      // band-limited input of the diffuser
+  _Alignas(32) float inject[simd_fdn_lines][simd_fdn_block_max]; // diffuser taps in, line inputs out
+  _Alignas(32) float rd[simd_fdn_lines][simd_fdn_block_max];     // modulated reads in, damped lines out
+  _Alignas(32) float fb[simd_fdn_lines][simd_fdn_block_max];     // the next input of each line
+  _Alignas(32) float lo[simd_fdn_block_max];
+  _Alignas(32) float ro[simd_fdn_block_max];
+};
+
+// The part of the fdnreverb state that the kernel carries from one sub-block to the next.
+struct simd_fdn {
+  float gains[simd_fdn_lines]; // feedback gain of each line, including the Hadamard normalization
+  float lp[simd_fdn_lines];    // damping filters
+  float damping;
+  float diffuse;
+};
+
+// The mixing and conversion kernels of inlines.h, the biquad kernels of biquad.h and the fdnreverb tank of fdn.h,
+// each table is built from its own translation unit compiled with the target flags of its level.
+struct simd_kernels {
+  void (*mix)(float *restrict const *const outputs,
+              float const *restrict const *const inputs,
+              size_t const channels,
+              size_t const samples);
+  void (*mix_with_amp)(float *restrict const *const outputs,
+                       float const *restrict const *const inputs,
+                       float const m,
+                       size_t const channels,
+                       size_t const samples);
+  void (*gain)(float *restrict const *const outputs,
+               float const *restrict const *const inputs,
+               float const gain_db,
+               size_t const channels,
+               size_t const samples);
+  void (*stereo_pan_and_gain)(float *restrict const *const outputs,
+                              float const *restrict const *const inputs,
+                              float const pan,
+                              float const gain_db,
+                              size_t const samples);
+  void (*interleaved_int16_to_float)(float *restrict const *const dest,
+                                     int16_t const *restrict const src,
+                                     size_t const channels,
+                                     size_t const samples);
+  void (*interleaved_int16_to_float_with_gain)(float *restrict const *const dest,
+                                               int16_t const *restrict const src,
+                                               float const gain,
+                                               size_t const channels,
+                                               size_t const samples);
+  void (*float_to_interleaved_int16)(int16_t *restrict const dest,
+                                     float const *restrict const *const src,
+                                     struct dither *const ds,
+                                     size_t const channels,
+                                     size_t const samples);
+  void (*float_to_interleaved_int16_with_gain)(int16_t *restrict const dest,
+                                               float const *restrict const *const src,
+                                               float const *restrict const gains,
+                                               struct dither *const ds,
+                                               size_t const channels,
+                                               size_t const samples);
+  // Runs second after first when second is not NULL.
+  void (*biquad)(struct simd_biquad const *const first,
+                 struct simd_biquad const *const second,
+                 float const *restrict const *const inputs,
+                 float *restrict const *const outputs,
+                 size_t const channels,
+                 size_t const samples);
+  // Runs the input diffuser, the damping and feedback matrix and the output mix over n samples of the block.
+  void (*fdn)(struct simd_fdn *const f, struct simd_fdn_block *const b, size_t const n);
+};
+
+extern struct simd_kernels const simd_kernels_sse2;
+extern struct simd_kernels const simd_kernels_avx2;
+extern struct simd_kernels const simd_kernels_avx512;
+
+// Returns the highest level both the CPU and the OS support.
+enum simd_level simd_detect(void);
+
+// Selects the detected level, or the one named by the AUDIOMIXER_SIMD environment variable
+// ("sse2", "avx2" or "avx512") when it is set and supported, to compare the levels on one machine.
+void simd_init(void);
+
+// Fails with err_invalid_arugment if the level is not supported here.
+NODISCARD error simd_set_level(enum simd_level const level);
+enum simd_level simd_get_level(void);
+
+// The kernels of the selected level, SSE2 until simd_init or simd_set_level is called.
+struct simd_kernels const *simd(void);
@@ -0,0 +1,7 @@
+// Compiled with -mavx2 -mfma, see CMakeLists.txt.
+#if !defined(__AVX2__) || !defined(__FMA__)
+#  error "simd_avx2.c needs AVX2 and FMA enabled"
+#endif
+
+#define SIMD_KERNELS simd_kernels_avx2
+#include "simd_kernels.h"
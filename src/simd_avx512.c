@@ -0,0 +1,7 @@
+// Compiled with -mavx512f -mavx512bw -mavx512vl -mavx2 -mfma, see CMakeLists.txt.
+#if !defined(__AVX512F__) || !defined(__AVX512BW__) || !defined(__AVX512VL__)
+#  error "simd_avx512.c needs AVX-512 F/BW/VL enabled"
+#endif
+
+#define SIMD_KERNELS simd_kernels_avx512
+#include "simd_kernels.h"
@@ -0,0 +1,102 @@
+#pragma once
+
+// Builds the kernel table named SIMD_KERNELS from inlines.h, biquad.h and fdn.h.
+// Only included by the simd_*.c files, the kernels pick their vector paths from that file's target flags.
+
+#include "biquad.h"
+#include "fdn.h"
+#include "inlines.h"
+#include "simd.h"
+
+#ifndef SIMD_KERNELS
+#  error "SIMD_KERNELS must be defined"
+#endif
+
+static void kernel_mix(float *restrict const *const outputs,
+                       float const *restrict const *const inputs,
+                       size_t const channels,
+                       size_t const samples) {
+  mix(outputs, inputs, channels, samples);
+}
+
+static void kernel_mix_with_amp(float *restrict const *const outputs,
+                                float const *restrict const *const inputs,
+                                float const m,
+                                size_t const channels,
+                                size_t const samples) {
+  mix_with_amp(outputs, inputs, m, channels, samples);
+}
+
+static void kernel_gain(float *restrict const *const outputs,
+                        float const *restrict const *const inputs,
+                        float const gain_db,
+                        size_t const channels,
+                        size_t const samples) {
+  gain(outputs, inputs, gain_db, channels, samples);
+}
+
+static void kernel_stereo_pan_and_gain(float *restrict const *const outputs,
+                                       float const *restrict const *const inputs,
+                                       float const pan,
+                                       float const gain_db,
+                                       size_t const samples) {
+  stereo_pan_and_gain(outputs, inputs, pan, gain_db, samples);
+}
+
+static void kernel_interleaved_int16_to_float(float *restrict const *const dest,
+                                              int16_t const *restrict const src,
+                                              size_t const channels,
+                                              size_t const samples) {
+  interleaved_int16_to_float(dest, src, channels, samples);
+}
+
+static void kernel_interleaved_int16_to_float_with_gain(float *restrict const *const dest,
+                                                        int16_t const *restrict const src,
+                                                        float const gain,
+                                                        size_t const channels,
+                                                        size_t const samples) {
+  interleaved_int16_to_float_with_gain(dest, src, gain, channels, samples);
+}
+
+static void kernel_float_to_interleaved_int16(int16_t *restrict const dest,
+                                              float const *restrict const *const src,
+                                              struct dither *const ds,
+                                              size_t const channels,
+                                              size_t const samples) {
+  float_to_interleaved_int16(dest, src, ds, channels, samples);
+}
+
+static void kernel_float_to_interleaved_int16_with_gain(int16_t *restrict const dest,
+                                                        float const *restrict const *const src,
+                                                        float const *restrict const gains,
+                                                        struct dither *const ds,
+                                                        size_t const channels,
+                                                        size_t const samples) {
+  float_to_interleaved_int16_with_gain(dest, src, gains, ds, channels, samples);
+}
+
+static void kernel_biquad(struct simd_biquad const *const first,
+                          struct simd_biquad const *const second,
+                          float const *restrict const *const inputs,
+                          float *restrict const *const outputs,
+                          size_t const channels,
+                          size_t const samples) {
+  biquad_process(first, second, inputs, outputs, channels, samples);
+}
+
+static void kernel_fdn(struct simd_fdn *const f, struct simd_fdn_block *const b, size_t const n) {
+  fdn_process(f, b, n);
+}
+
+struct simd_kernels const SIMD_KERNELS = {
+    .mix = kernel_mix,
+    .mix_with_amp = kernel_mix_with_amp,
+    .gain = kernel_gain,
+    .stereo_pan_and_gain = kernel_stereo_pan_and_gain,
+    .interleaved_int16_to_float = kernel_interleaved_int16_to_float,
+    .interleaved_int16_to_float_with_gain = kernel_interleaved_int16_to_float_with_gain,
+    .float_to_interleaved_int16 = kernel_float_to_interleaved_int16,
+    .float_to_interleaved_int16_with_gain = kernel_float_to_interleaved_int16_with_gain,
+    .biquad = kernel_biquad,
+    .fdn = kernel_fdn,
+};
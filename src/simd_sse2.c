@@ -0,0 +1,2 @@
+#define SIMD_KERNELS simd_kernels_sse2
+#include "simd_kernels.h"
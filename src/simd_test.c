@@ -0,0 +1,154 @@
+#include "simd.c"
+
+#include "ovtest.h"
+
+#include "inlines.h"
+
+enum {
+  test_samples = 131,
+};
+
+static float g_a[2][test_samples];
+static float g_b[2][test_samples];
+static float g_out[2][test_samples];
+static float g_ref[2][test_samples];
+static int16_t g_i16[test_samples * 2];
+static int16_t g_i16_out[test_samples * 2];
+static int16_t g_i16_ref[test_samples * 2];
+
+static void generate(void) {
+  uint32_t t = 1;
+  static float const divider = 1.f / (float)(UINT32_MAX);
+  for (size_t ch = 0; ch < 2; ++ch) {
+    for (size_t i = 0; i < test_samples; ++i) {
+      g_a[ch][i] = ((float)(ov_splitmix32(t)) * divider * 2.f - 1.f) * 1.25f;
+      t = ov_splitmix32_next(t);
+      g_b[ch][i] = (float)(ov_splitmix32(t)) * divider * 2.f - 1.f;
+      t = ov_splitmix32_next(t);
+    }
+  }
+  for (size_t i = 0; i < test_samples * 2; ++i) {
+    g_i16[i] = (int16_t)(ov_splitmix32(t) & 0xffff);
+    t = ov_splitmix32_next(t);
+  }
+}
+
+static bool near(float const *const a, float const *const b, size_t const n) {
+  for (size_t i = 0; i < n; ++i) {
+    if (fabsf(a[i] - b[i]) > 1e-6f * fmaxf(1.f, fabsf(b[i]))) {
+      TEST_MSG("mismatch at %zu: %g != %g", i, (double)a[i], (double)b[i]);
+      return false;
+    }
+  }
+  return true;
+}
+
+static void test_select(void) {
+  enum simd_level const detected = simd_detect();
+  TEST_CHECK(simd_get_level() == simd_level_sse2);
+  TEST_CHECK(simd() == &simd_kernels_sse2);
+  simd_init();
+  TEST_CHECK(simd_get_level() <= detected);
+  TEST_MSG("detected %d, selected %d", (int)detected, (int)simd_get_level());
+  TEST_SUCCEEDED_F(simd_set_level(detected));
+  TEST_CHECK(simd_get_level() == detected);
+  if (detected < simd_level_avx512) {
+    error err = simd_set_level(simd_level_avx512);
+    TEST_CHECK(efailed(err));
+    efree(&err);
+    TEST_CHECK(simd_get_level() == detected);
+  }
+  TEST_SUCCEEDED_F(simd_set_level(simd_level_sse2));
+  TEST_CHECK(simd() == &simd_kernels_sse2);
+}
+
+// Every level has to produce what the SSE2 build does, up to the rounding that FMA changes.
+static void check_level(struct simd_kernels const *const k) {
+  struct simd_kernels const *const ref = &simd_kernels_sse2;
+  float const *in[2] = {g_a[0], g_a[1]};
+  float *out[2] = {g_out[0], g_out[1]};
+  float *rout[2] = {g_ref[0], g_ref[1]};
+  for (size_t n = 0; n <= test_samples; n += 13) {
+    memcpy(g_out, g_b, sizeof(g_b));
+    memcpy(g_ref, g_b, sizeof(g_b));
+    k->mix(out, in, 2, n);
+    ref->mix(rout, in, 2, n);
+    TEST_CHECK(near(g_out[0], g_ref[0], test_samples) && near(g_out[1], g_ref[1], test_samples));
+
+    k->mix_with_amp(out, in, 0.3f, 2, n);
+    ref->mix_with_amp(rout, in, 0.3f, 2, n);
+    TEST_CHECK(near(g_out[0], g_ref[0], test_samples) && near(g_out[1], g_ref[1], test_samples));
+
+    k->gain(out, in, -6.f, 2, n);
+    ref->gain(rout, in, -6.f, 2, n);
+    TEST_CHECK(near(g_out[0], g_ref[0], test_samples) && near(g_out[1], g_ref[1], test_samples));
+
+    k->stereo_pan_and_gain(out, in, 0.4f, -3.f, n);
+    ref->stereo_pan_and_gain(rout, in, 0.4f, -3.f, n);
+    TEST_CHECK(near(g_out[0], g_ref[0], test_samples) && near(g_out[1], g_ref[1], test_samples));
+
+    for (size_t channels = 1; channels <= 2; ++channels) {
+      memset(g_out, 0, sizeof(g_out));
+      memset(g_ref, 0, sizeof(g_ref));
+      k->interleaved_int16_to_float(out, g_i16, channels, n);
+      ref->interleaved_int16_to_float(rout, g_i16, channels, n);
+      TEST_CHECK(memcmp(g_out, g_ref, sizeof(g_out)) == 0);
+
+      k->interleaved_int16_to_float_with_gain(out, g_i16, 0.7f, channels, n);
+      ref->interleaved_int16_to_float_with_gain(rout, g_i16, 0.7f, channels, n);
+      TEST_CHECK(near(g_out[0], g_ref[0], test_samples) && near(g_out[1], g_ref[1], test_samples));
+
+      memset(g_i16_out, 0, sizeof(g_i16_out));
+      memset(g_i16_ref, 0, sizeof(g_i16_ref));
+      k->float_to_interleaved_int16(g_i16_out, in, NULL, channels, n);
+      ref->float_to_interleaved_int16(g_i16_ref, in, NULL, channels, n);
+      TEST_CHECK(memcmp(g_i16_out, g_i16_ref, sizeof(g_i16_out)) == 0);
+      TEST_MSG("channels %zu, samples %zu", channels, n);
+    }
+  }
+}
+
+// The wider dithered packs step the same generators, so they must leave the same state and,
+// up to a rounding tie that FMA contraction moves, the same samples.
+static void check_dither(struct simd_kernels const *const k) {
+  struct simd_kernels const *const ref = &simd_kernels_sse2;
+  static int16_t out[test_samples * 3];
+  static int16_t rout[test_samples * 3];
+  float const *in[3] = {g_a[0], g_a[1], g_b[0]};
+  for (size_t channels = 1; channels <= 3; ++channels) {
+    struct dither d = {0};
+    struct dither rd = {0};
+    TEST_SUCCEEDED_F(dither_create(&d, channels));
+    TEST_SUCCEEDED_F(dither_create(&rd, channels));
+    bool ok = true;
+    for (size_t n = 0; n <= test_samples; n += 13) {
+      k->float_to_interleaved_int16_with_gain(out, in, g_b[1], &d, channels, n);
+      ref->float_to_interleaved_int16_with_gain(rout, in, g_b[1], &rd, channels, n);
+      ok = ok && memcmp(d.ptr, rd.ptr, channels * sizeof(struct dither_state)) == 0;
+      for (size_t i = 0; i < n * channels; ++i) {
+        ok = ok && abs(out[i] - rout[i]) <= 1;
+      }
+    }
+    TEST_CHECK(ok);
+    TEST_MSG("channels %zu", channels);
+    TEST_SUCCEEDED_F(dither_destroy(&rd));
+    TEST_SUCCEEDED_F(dither_destroy(&d));
+  }
+}
+
+static void test_kernels(void) {
+  static struct simd_kernels const *const kernels[] = {&simd_kernels_sse2, &simd_kernels_avx2, &simd_kernels_avx512};
+  generate();
+  enum simd_level const detected = simd_detect();
+  for (int level = simd_level_sse2; level <= (int)detected; ++level) {
+    check_level(kernels[level]);
+    check_dither(kernels[level]);
+    TEST_MSG("level %d", level);
+  }
+}
+
+TEST_LIST = {
+    {"test_select", test_select},
+    {"test_kernels", test_kernels},
+    {NULL, NULL},
+};
@@ -0,0 +1,217 @@
+#include "spscring.h"
+
+#include <stdalign.h>
+#include <stdatomic.h>
+
+#include "inlines.h"
+
+enum {
+  cache_line = 64,
+};
+
+struct spscring {
+  // fixed while the ring is in use
+  float *buf; // channels * capacity, planar
+  size_t channels;
+  size_t capacity; // power of two
+
+  // owned by the producer, tail is only read when the cached value says the ring is full
+  alignas(cache_line) atomic_size_t head;
+  size_t cached_tail;
+  float **wptrs;
+
+  // owned by the consumer
+  alignas(cache_line) atomic_size_t tail;
+  size_t cached_head;
+  float **rptrs;
+};
+
+static size_t next_power_of_two(size_t const v) {
+  size_t r = 1;
+  while (r < v) {
+    r <<= 1;
+  }
+  return r;
+}
+
+static void release(struct spscring *const r) {
+  if (r->buf) {
+    ereport(mem_aligned_free(&r->buf));
+  }
+  if (r->wptrs) {
+    ereport(mem_free(&r->wptrs));
+  }
+  if (r->rptrs) {
+    ereport(mem_free(&r->rptrs));
+  }
+  r->channels = 0;
+  r->capacity = 0;
+}
+
+// Points ptrs at pos inside each channel and returns how many samples are contiguous from there.
+static size_t get_span(struct spscring const *const r, float **const ptrs, size_t const pos, size_t const samples) {
+  size_t const p = pos & (r->capacity - 1);
+  for (size_t ch = 0; ch < r->channels; ++ch) {
+    ptrs[ch] = r->buf + ch * r->capacity + p;
+  }
+  return r->capacity - p < samples ? r->capacity - p : samples;
+}
+
+NODISCARD error spscring_create(struct spscring **const rp) {
+  if (!rp || *rp) {
+    return errg(err_invalid_arugment);
+  }
+  // the indices must not share a cache line, so the ring itself needs the alignment
+  error err = mem_aligned_alloc(rp, 1, sizeof(struct spscring), cache_line);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  struct spscring *const r = *rp;
+  *r = (struct spscring){0};
+  atomic_init(&r->head, 0);
+  atomic_init(&r->tail, 0);
+  return eok();
+}
+
+NODISCARD error spscring_destroy(struct spscring **const rp) {
+  if (!rp || !*rp) {
+    return errg(err_invalid_arugment);
+  }
+  release(*rp);
+  ereport(mem_aligned_free(rp));
+  return eok();
+}
+
+NODISCARD error spscring_set_format(struct spscring *const r, size_t const channels, size_t const buffer_size) {
+  if (!r || !channels || !buffer_size) {
+    return errg(err_invalid_arugment);
+  }
+  size_t const capacity = next_power_of_two(buffer_size);
+  struct spscring tmp = {0};
+  error err = mem_aligned_alloc(&tmp.buf, channels * capacity, sizeof(float), 16);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  err = mem(&tmp.wptrs, channels, sizeof(float *));
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  err = mem(&tmp.rptrs, channels, sizeof(float *));
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  release(r);
+  r->buf = tmp.buf;
+  r->wptrs = tmp.wptrs;
+  r->rptrs = tmp.rptrs;
+  r->channels = channels;
+  r->capacity = capacity;
+  atomic_store_explicit(&r->head, 0, memory_order_relaxed);
+  atomic_store_explicit(&r->tail, 0, memory_order_relaxed);
+  r->cached_tail = 0;
+  r->cached_head = 0;
+  tmp = (struct spscring){0};
+
+cleanup:
+  release(&tmp);
+  return err;
+}
+
+size_t spscring_get_channels(struct spscring const *const r) { return r->channels; }
+
+size_t spscring_get_capacity(struct spscring const *const r) { return r->capacity; }
+
+size_t spscring_get_writable(struct spscring *const r) {
+  size_t const head = atomic_load_explicit(&r->head, memory_order_relaxed);
+  r->cached_tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+  return r->capacity - (head - r->cached_tail);
+}
+
+// Returns how much the producer can write without touching the consumer's cache line when it is not needed.
+static size_t writable(struct spscring *const r, size_t const head, size_t const samples) {
+  size_t n = r->capacity - (head - r->cached_tail);
+  if (n < samples) {
+    r->cached_tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    n = r->capacity - (head - r->cached_tail);
+  }
+  return n < samples ? n : samples;
+}
+
+size_t spscring_write(struct spscring *const r, float const *restrict const *const src, size_t const samples) {
+  size_t const head = atomic_load_explicit(&r->head, memory_order_relaxed);
+  size_t const n = writable(r, head, samples);
+  for (size_t done = 0; done < n;) {
+    size_t const len = get_span(r, r->wptrs, head + done, n - done);
+    for (size_t ch = 0; ch < r->channels; ++ch) {
+      memcpy(r->wptrs[ch], src[ch] + done, len * sizeof(float));
+    }
+    done += len;
+  }
+  atomic_store_explicit(&r->head, head + n, memory_order_release);
+  return n;
+}
+
+size_t spscring_write_i16(struct spscring *const r, int16_t const *restrict const src, size_t const samples) {
+  size_t const head = atomic_load_explicit(&r->head, memory_order_relaxed);
+  size_t const n = writable(r, head, samples);
+  for (size_t done = 0; done < n;) {
+    size_t const len = get_span(r, r->wptrs, head + done, n - done);
+    interleaved_int16_to_float((float *restrict const *)r->wptrs, src + done * r->channels, r->channels, len);
+    done += len;
+  }
+  atomic_store_explicit(&r->head, head + n, memory_order_release);
+  return n;
+}
+
+size_t spscring_get_readable(struct spscring *const r) {
+  size_t const tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+  r->cached_head = atomic_load_explicit(&r->head, memory_order_acquire);
+  return r->cached_head - tail;
+}
+
+static size_t readable(struct spscring *const r, size_t const tail, size_t const samples) {
+  size_t n = r->cached_head - tail;
+  if (n < samples) {
+    r->cached_head = atomic_load_explicit(&r->head, memory_order_acquire);
+    n = r->cached_head - tail;
+  }
+  return n < samples ? n : samples;
+}
+
+size_t spscring_read(struct spscring *const r, float *restrict const *const dest, size_t const samples) {
+  size_t const tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+  size_t const n = readable(r, tail, samples);
+  for (size_t done = 0; done < n;) {
+    size_t const len = get_span(r, r->rptrs, tail + done, n - done);
+    for (size_t ch = 0; ch < r->channels; ++ch) {
+      memcpy(dest[ch] + done, r->rptrs[ch], len * sizeof(float));
+    }
+    done += len;
+  }
+  atomic_store_explicit(&r->tail, tail + n, memory_order_release);
+  return n;
+}
+
+size_t spscring_read_i16(struct spscring *const r, int16_t *restrict const dest, size_t const samples) {
+  size_t const tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+  size_t const n = readable(r, tail, samples);
+  for (size_t done = 0; done < n;) {
+    size_t const len = get_span(r, r->rptrs, tail + done, n - done);
+    float_to_interleaved_int16(
+        dest + done * r->channels, (float const *restrict const *)r->rptrs, NULL, r->channels, len);
+    done += len;
+  }
+  atomic_store_explicit(&r->tail, tail + n, memory_order_release);
+  return n;
+}
+
+size_t spscring_discard(struct spscring *const r, size_t const samples) {
+  size_t const tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+  size_t const n = readable(r, tail, samples);
+  atomic_store_explicit(&r->tail, tail + n, memory_order_release);
+  return n;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ovbase.h"
+
+// A lock-free ring of planar float samples for one producer thread and one consumer thread.
+// spscring_write* may only be called from the producer and spscring_read* / spscring_discard only from the consumer.
+// The counts are in samples per channel, a call moves as much as fits and returns how much that was.
+struct spscring;
+
+NODISCARD error spscring_create(struct spscring **const rp);
+NODISCARD error spscring_destroy(struct spscring **const rp);
+
+// Allocates room for at least buffer_size samples and empties the ring.
+// Neither side may be using the ring during the call.
+NODISCARD error spscring_set_format(struct spscring *const r, size_t const channels, size_t const buffer_size);
+size_t spscring_get_channels(struct spscring const *const r);
+size_t spscring_get_capacity(struct spscring const *const r);
+
+size_t spscring_get_writable(struct spscring *const r);
+size_t spscring_write(struct spscring *const r, float const *restrict const *const src, size_t const samples);
+size_t spscring_write_i16(struct spscring *const r, int16_t const *restrict const src, size_t const samples);
+
+size_t spscring_get_readable(struct spscring *const r);
+size_t spscring_read(struct spscring *const r, float *restrict const *const dest, size_t const samples);
+size_t spscring_read_i16(struct spscring *const r, int16_t *restrict const dest, size_t const samples);
+size_t spscring_discard(struct spscring *const r, size_t const samples);
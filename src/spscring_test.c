@@ -0,0 +1,164 @@
+#include "spscring.c"
+
+#include "ovtest.h"
+
+#include "ovthreads.h"
+
+enum {
+  test_channels = 2,
+  test_max_block = 1000,
+};
+
+struct stream {
+  struct spscring *r;
+  size_t total;
+  bool use_i16;
+  bool ok;
+};
+
+static uint32_t next_block(uint32_t *const rng) {
+  *rng = *rng * 1664525u + 1013904223u;
+  return (*rng >> 8) % test_max_block + 1;
+}
+
+// A counting sequence that survives the int16 round trip, each channel has its own sign.
+static int16_t sample_value(size_t const pos, size_t const ch) {
+  int16_t const v = (int16_t)(pos % 30000);
+  return ch ? (int16_t)-v : v;
+}
+
+static int producer(void *userdata) {
+  struct stream *const s = userdata;
+  static float buf[test_channels][test_max_block];
+  static int16_t ibuf[test_max_block * test_channels];
+  float const *src[test_channels] = {buf[0], buf[1]};
+  uint32_t rng = 1;
+  for (size_t pos = 0; pos < s->total;) {
+    size_t n = next_block(&rng);
+    n = s->total - pos < n ? s->total - pos : n;
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t ch = 0; ch < test_channels; ++ch) {
+        buf[ch][i] = (float)sample_value(pos + i, ch) / 32768.f;
+        ibuf[i * test_channels + ch] = sample_value(pos + i, ch);
+      }
+    }
+    size_t done = 0;
+    while (done < n) {
+      if (s->use_i16) {
+        done += spscring_write_i16(s->r, ibuf + done * test_channels, n - done);
+      } else {
+        float const *p[test_channels] = {src[0] + done, src[1] + done};
+        done += spscring_write(s->r, (float const *restrict const *)p, n - done);
+      }
+      if (done < n) {
+        thrd_yield();
+      }
+    }
+    pos += n;
+  }
+  return 0;
+}
+
+static int consumer(void *userdata) {
+  struct stream *const s = userdata;
+  static float buf[test_channels][test_max_block];
+  static int16_t ibuf[test_max_block * test_channels];
+  float *dest[test_channels] = {buf[0], buf[1]};
+  uint32_t rng = 2;
+  s->ok = true;
+  for (size_t pos = 0; pos < s->total;) {
+    size_t const want = next_block(&rng);
+    size_t const n = s->use_i16 ? spscring_read_i16(s->r, ibuf, want)
+                                : spscring_read(s->r, (float *restrict const *)dest, want);
+    if (!n) {
+      thrd_yield();
+      continue;
+    }
+    for (size_t i = 0; i < n && s->ok; ++i) {
+      for (size_t ch = 0; ch < test_channels; ++ch) {
+        int16_t const expected = sample_value(pos + i, ch);
+        int16_t const got = s->use_i16 ? ibuf[i * test_channels + ch] : (int16_t)lrintf(buf[ch][i] * 32768.f);
+        if (abs(got - expected) > 1) {
+          s->ok = false;
+        }
+      }
+    }
+    pos += n;
+  }
+  return 0;
+}
+
+static bool run(struct spscring *const r, size_t const total, bool const use_i16) {
+  struct stream s = {.r = r, .total = total, .use_i16 = use_i16};
+  thrd_t p, c;
+  if (thrd_create(&p, producer, &s) != thrd_success) {
+    return false;
+  }
+  if (thrd_create(&c, consumer, &s) != thrd_success) {
+    thrd_join(p, NULL);
+    return false;
+  }
+  thrd_join(p, NULL);
+  thrd_join(c, NULL);
+  return s.ok && spscring_get_readable(r) == 0;
+}
+
+static void test_single_thread(void) {
+  static float const data[2][8] = {{1, 2, 3, 4, 5, 6, 7, 8}, {-1, -2, -3, -4, -5, -6, -7, -8}};
+  float const *src[2] = {data[0], data[1]};
+  float buf[2][8] = {{0}};
+  float *dest[2] = {buf[0], buf[1]};
+  struct spscring *r = NULL;
+  TEST_SUCCEEDED_F(spscring_create(&r));
+  TEST_CHECK(((uintptr_t)r % cache_line) == 0);
+  TEST_CHECK((uintptr_t)&r->tail - (uintptr_t)&r->head >= cache_line);
+  TEST_SUCCEEDED_F(spscring_set_format(r, 2, 6));
+  TEST_CHECK(spscring_get_capacity(r) == 8);
+  TEST_CHECK(spscring_get_writable(r) == 8);
+
+  TEST_CHECK(spscring_write(r, (float const *restrict const *)src, 5) == 5);
+  TEST_CHECK(spscring_discard(r, 3) == 3);
+  TEST_CHECK(spscring_write(r, (float const *restrict const *)src, 8) == 6); // crosses the end, stops when full
+  TEST_CHECK(spscring_get_writable(r) == 0);
+  TEST_CHECK(spscring_get_readable(r) == 8);
+  TEST_CHECK(spscring_read(r, (float *restrict const *)dest, 8) == 8);
+  static float const expected[8] = {4, 5, 1, 2, 3, 4, 5, 6};
+  for (size_t i = 0; i < 8; ++i) {
+    TEST_CHECK(fcmp(buf[0][i], ==, expected[i], 1e-6f) && fcmp(buf[1][i], ==, -expected[i], 1e-6f));
+  }
+  TEST_CHECK(spscring_read(r, (float *restrict const *)dest, 8) == 0);
+
+  static int16_t const idata[6] = {100, -100, 200, -200, 300, -300};
+  int16_t ibuf[6] = {0};
+  TEST_CHECK(spscring_write_i16(r, idata, 3) == 3);
+  TEST_CHECK(spscring_read_i16(r, ibuf, 8) == 3);
+  for (size_t i = 0; i < 6; ++i) {
+    TEST_CHECK(abs(ibuf[i] - idata[i]) <= 1);
+  }
+  TEST_SUCCEEDED_F(spscring_destroy(&r));
+}
+
+static void test_stress(void) {
+  struct spscring *r = NULL;
+  TEST_SUCCEEDED_F(spscring_create(&r));
+  // smaller than the blocks so both sides keep running into each other
+  TEST_SUCCEEDED_F(spscring_set_format(r, test_channels, 700));
+  TEST_CHECK(run(r, 2000000, false));
+  TEST_CHECK(run(r, 2000000, true));
+  TEST_SUCCEEDED_F(spscring_destroy(&r));
+}
+
+static void bench_throughput(void) {
+  struct spscring *r = NULL;
+  TEST_SUCCEEDED_F(spscring_create(&r));
+  TEST_SUCCEEDED_F(spscring_set_format(r, test_channels, 48000));
+  TEST_CHECK(run(r, 48000 * 600, false));
+  TEST_SUCCEEDED_F(spscring_destroy(&r));
+}
+
+TEST_LIST = {
+    {"test_single_thread", test_single_thread},
+    {"test_stress", test_stress},
+    {"bench_throughput", bench_throughput},
+    {NULL, NULL},
+};
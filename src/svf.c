@@ -0,0 +1,338 @@
+#include "svf.h"
+
+#include <math.h>
+
+#include "chspec.h"
+#include "inlines.h"
+#include "rbjeq.h"
+
+// Based on Andrew Simper's "Linear Trapezoidal Integrated SVF" notes.
+// The interpolated quantities are g (the prewarped cutoff), k (damping) and sqrt(A) (shelf/peak amplitude),
+// so ramping only needs a few multiplications and one division per sample instead of tanf/powf.
+
+struct channel {
+  float ic1eq, ic2eq;
+};
+
+struct channels {
+  struct channel *ptr;
+  size_t len;
+  size_t cap;
+};
+
+struct shape {
+  float g, k, sa;
+};
+
+struct svf {
+  float sample_rate, frequency, q, gain, ramp_duration;
+  int filter_type;
+  size_t channels;
+  size_t channel_kernel; // index into channel_kernels, chosen by svf_set_format
+  struct channels buffers;
+
+  struct shape current;
+  struct shape target;
+  struct shape step;
+  size_t ramp_remain;
+  bool initialized;
+  bool need_parameter_update;
+};
+
+NODISCARD error svf_create(struct svf **const sp) {
+  if (!sp || *sp) {
+    return errg(err_invalid_arugment);
+  }
+  error err = mem(sp, 1, sizeof(struct svf));
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  **sp = (struct svf){
+      .sample_rate = 48000.f,
+      .frequency = 1000.f,
+      .q = 1.f,
+      .ramp_duration = 0.02f,
+      .channels = 2,
+      .channel_kernel = chspec_index(2),
+      .filter_type = rbjeq_type_low_pass,
+      .need_parameter_update = true,
+  };
+  return eok();
+}
+
+NODISCARD error svf_destroy(struct svf **const sp) {
+  if (!sp || !*sp) {
+    return errg(err_invalid_arugment);
+  }
+  ereport(afree(&(*sp)->buffers));
+  ereport(mem_free(sp));
+  return eok();
+}
+
+void svf_set_format(struct svf *const s, float const sample_rate, size_t const channels) {
+  if (fcmp(s->sample_rate, ==, sample_rate, 1e-12f) && s->channels == channels) {
+    return;
+  }
+  s->sample_rate = sample_rate;
+  s->channels = channels;
+  s->channel_kernel = chspec_index(channels);
+  s->initialized = false; // g depends on the sample rate, do not ramp from the old one
+  s->need_parameter_update = true;
+}
+
+void svf_set_type(struct svf *const s, int const v) {
+  if (s->filter_type == v) {
+    return;
+  }
+  s->filter_type = v;
+  s->initialized = false;
+  s->need_parameter_update = true;
+}
+
+void svf_set_frequency(struct svf *const s, float const v) {
+  if (fcmp(s->frequency, ==, v, 1e-12f)) {
+    return;
+  }
+  s->frequency = v;
+  s->need_parameter_update = true;
+}
+
+void svf_set_q(struct svf *const s, float const v) {
+  if (fcmp(s->q, ==, v, 1e-12f)) {
+    return;
+  }
+  s->q = v;
+  s->need_parameter_update = true;
+}
+
+float svf_get_gain(struct svf const *const s) { return s->gain; }
+void svf_set_gain(struct svf *const s, float const v) {
+  if (fcmp(s->gain, ==, v, 1e-12f)) {
+    return;
+  }
+  s->gain = v;
+  s->need_parameter_update = true;
+}
+
+void svf_set_ramp_duration(struct svf *const s, float const v) {
+  if (fcmp(s->ramp_duration, ==, v, 1e-12f)) {
+    return;
+  }
+  s->ramp_duration = v;
+  s->need_parameter_update = true;
+}
+
+static struct shape calc_shape(struct svf const *const s) {
+  static float const pi = 3.14159265358979323846264338327950288f;
+  float const freq = fmaxf(1.f, fminf(s->frequency, s->sample_rate * 0.499f));
+  float const q = fmaxf(s->q, 1e-12f);
+  float const sa = powf(10.f, s->gain / 80.f); // sqrt(A)
+  float g = tanf(pi * freq / s->sample_rate);
+  float k = 1.f / q;
+  switch (s->filter_type) {
+  case rbjeq_type_low_shelf:
+    g /= sa;
+    break;
+  case rbjeq_type_high_shelf:
+    g *= sa;
+    break;
+  case rbjeq_type_peaking:
+    k /= sa * sa;
+    break;
+  }
+  return (struct shape){.g = g, .k = k, .sa = sa};
+}
+
+NODISCARD static error update_internal_parameter(struct svf *const s) {
+  if (s->buffers.len != s->channels) {
+    error err = agrow(&s->buffers, s->channels);
+    if (efailed(err)) {
+      err = ethru(err);
+      return err;
+    }
+    s->buffers.len = s->channels;
+    svf_clear(s);
+  }
+  switch (s->filter_type) {
+  case rbjeq_type_low_pass:
+  case rbjeq_type_high_pass:
+  case rbjeq_type_band_pass:
+  case rbjeq_type_notch:
+  case rbjeq_type_low_shelf:
+  case rbjeq_type_high_shelf:
+  case rbjeq_type_peaking:
+  case rbjeq_type_all_pass:
+    break;
+  default:
+    return errg(err_unexpected);
+  }
+  s->target = calc_shape(s);
+  size_t const ramp = (size_t)(s->ramp_duration * s->sample_rate);
+  if (!s->initialized || ramp == 0) {
+    s->current = s->target;
+    s->ramp_remain = 0;
+    s->initialized = true;
+    return eok();
+  }
+  float const inv = 1.f / (float)ramp;
+  s->step = (struct shape){
+      .g = (s->target.g - s->current.g) * inv,
+      .k = (s->target.k - s->current.k) * inv,
+      .sa = (s->target.sa - s->current.sa) * inv,
+  };
+  s->ramp_remain = ramp;
+  return eok();
+}
+
+NODISCARD error svf_update_internal_parameter(struct svf *const s, bool *const updated) {
+  if (!s->need_parameter_update) {
+    if (updated) {
+      *updated = false;
+    }
+    return eok();
+  }
+  error err = update_internal_parameter(s);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  s->need_parameter_update = false;
+  if (updated) {
+    *updated = true;
+  }
+  return eok();
+}
+
+bool svf_is_active(struct svf const *const s) {
+  switch (s->filter_type) {
+  case rbjeq_type_low_shelf:
+  case rbjeq_type_high_shelf:
+  case rbjeq_type_peaking:
+    return s->ramp_remain > 0 || fcmp(s->current.sa, !=, 1.f, 1e-7f);
+  }
+  return true;
+}
+
+struct coef {
+  float a1, a2, a3, m0, m1, m2;
+};
+
+static inline struct coef calc_coef(int const type, struct shape const *const sh) {
+  float const g = sh->g, k = sh->k, sa = sh->sa, A = sa * sa;
+  float const a1 = 1.f / (1.f + g * (g + k));
+  float const a2 = g * a1;
+  float const a3 = g * a2;
+  switch (type) {
+  case rbjeq_type_low_pass:
+    return (struct coef){a1, a2, a3, 0.f, 0.f, 1.f};
+  case rbjeq_type_high_pass:
+    return (struct coef){a1, a2, a3, 1.f, -k, -1.f};
+  case rbjeq_type_band_pass:
+    return (struct coef){a1, a2, a3, 0.f, k, 0.f};
+  case rbjeq_type_notch:
+    return (struct coef){a1, a2, a3, 1.f, -k, 0.f};
+  case rbjeq_type_all_pass:
+    return (struct coef){a1, a2, a3, 1.f, -2.f * k, 0.f};
+  case rbjeq_type_low_shelf:
+    return (struct coef){a1, a2, a3, 1.f, k * (A - 1.f), A * A - 1.f};
+  case rbjeq_type_high_shelf:
+    return (struct coef){a1, a2, a3, A * A, k * (1.f - A) * A, 1.f - A * A};
+  case rbjeq_type_peaking:
+    return (struct coef){a1, a2, a3, 1.f, k * (A * A - 1.f), 0.f};
+  }
+  return (struct coef){a1, a2, a3, 1.f, 0.f, 0.f};
+}
+
+static inline float tick(struct coef const *const c, struct channel *const ch, float const v0) {
+  float const v3 = v0 - ch->ic2eq;
+  float const v1 = c->a1 * ch->ic1eq + c->a2 * v3;
+  float const v2 = ch->ic2eq + c->a2 * ch->ic1eq + c->a3 * v3;
+  ch->ic1eq = 2.f * v1 - ch->ic1eq;
+  ch->ic2eq = 2.f * v2 - ch->ic2eq;
+  return c->m0 * v0 + c->m1 * v1 + c->m2 * v2;
+}
+
+// chs is a constant in the channel_kernels instances so that the loop over the channels in the ramp is unrolled.
+static inline __attribute__((always_inline)) void process_impl(struct svf *const s,
+                                                               float const *restrict const *const inputs,
+                                                               float *restrict const *const outputs,
+                                                               size_t const samples,
+                                                               size_t const chs) {
+  struct channel *const chbufs = s->buffers.ptr;
+  size_t pos = 0;
+
+  // while ramping the coefficients are shared by all channels, so iterate over samples first
+  for (; pos < samples && s->ramp_remain > 0; ++pos) {
+    s->current.g += s->step.g;
+    s->current.k += s->step.k;
+    s->current.sa += s->step.sa;
+    if (--s->ramp_remain == 0) {
+      s->current = s->target;
+    }
+    struct coef const c = calc_coef(s->filter_type, &s->current);
+    for (size_t ch = 0; ch < chs; ++ch) {
+      outputs[ch][pos] = tick(&c, chbufs + ch, inputs[ch][pos]);
+    }
+  }
+  if (pos == samples) {
+    return;
+  }
+
+  struct coef const c = calc_coef(s->filter_type, &s->current);
+  for (size_t ch = 0; ch < chs; ++ch) {
+    struct channel st = chbufs[ch];
+    float const *restrict const in = inputs[ch];
+    float *restrict const out = outputs[ch];
+    for (size_t i = pos; i < samples; ++i) {
+      out[i] = tick(&c, &st, in[i]);
+    }
+    // keep the integrators out of the denormal range
+    if (fabsf(st.ic1eq) < 1e-15f) {
+      st.ic1eq = 0.f;
+    }
+    if (fabsf(st.ic2eq) < 1e-15f) {
+      st.ic2eq = 0.f;
+    }
+    chbufs[ch] = st;
+  }
+}
+
+typedef void (*channel_kernel_func)(struct svf *const s,
+                                    float const *restrict const *const inputs,
+                                    float *restrict const *const outputs,
+                                    size_t const samples);
+
+#define DEFINE_CHANNEL_KERNEL(name, chs)                                                                               \
+  static void name(struct svf *const s,                                                                                \
+                   float const *restrict const *const inputs,                                                          \
+                   float *restrict const *const outputs,                                                               \
+                   size_t const samples) {                                                                             \
+    process_impl(s, inputs, outputs, samples, chs);                                                                    \
+  }
+#define X(n) DEFINE_CHANNEL_KERNEL(process_##n, n)
+CHSPEC_EACH(X)
+#undef X
+DEFINE_CHANNEL_KERNEL(process_generic, s->buffers.len)
+#undef DEFINE_CHANNEL_KERNEL
+
+#define X(n) process_##n,
+static channel_kernel_func const channel_kernels[chspec_max_channels + 1] = {process_generic, CHSPEC_EACH(X)};
+#undef X
+
+void svf_process(struct svf *const s,
+                 float const *restrict const *const inputs,
+                 float *restrict const *const outputs,
+                 size_t const samples) {
+  channel_kernels[s->channel_kernel](s, inputs, outputs, samples);
+}
+
+void svf_clear(struct svf *const s) {
+  for (size_t ch = 0, chlen = s->buffers.len; ch < chlen; ++ch) {
+    s->buffers.ptr[ch] = (struct channel){0};
+  }
+  // with no history left there is nothing to glide from, the next parameter update jumps to its target
+  s->current = s->target;
+  s->ramp_remain = 0;
+  s->initialized = false;
+}
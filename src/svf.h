@@ -0,0 +1,30 @@
+#pragma once
+
+#include "ovbase.h"
+
+// Zero-delay-feedback (topology-preserving transform) state variable filter.
+// Filter types are shared with rbjeq (enum rbjeq_type).
+// Frequency and gain changes are ramped per sample, so automation does not zipper.
+struct svf;
+
+NODISCARD error svf_create(struct svf **const sp);
+NODISCARD error svf_destroy(struct svf **const sp);
+
+void svf_set_format(struct svf *const s, float const sample_rate, size_t const channels);
+void svf_set_type(struct svf *const s, int const v);
+void svf_set_frequency(struct svf *const s, float const v);
+void svf_set_q(struct svf *const s, float const v);
+float svf_get_gain(struct svf const *const s);
+void svf_set_gain(struct svf *const s, float const v);
+void svf_set_ramp_duration(struct svf *const s, float const v); // by seconds
+
+NODISCARD error svf_update_internal_parameter(struct svf *const s, bool *const updated);
+
+// Returns true while the filter changes the signal, including while it is ramping toward 0 dB.
+bool svf_is_active(struct svf const *const s);
+
+void svf_process(struct svf *const s,
+                 float const *restrict const *const inputs,
+                 float *restrict const *const outputs,
+                 size_t const samples);
+void svf_clear(struct svf *const s);
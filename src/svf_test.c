@@ -0,0 +1,189 @@
+#include "svf.c"
+
+#include "ovtest.h"
+
+enum {
+  test_channels = 2,
+  test_samples = 4800,
+};
+
+static float g_input[test_channels][test_samples];
+static float g_output[test_channels][test_samples];
+static float g_reference[test_channels][test_samples];
+
+static void f(float v) { (void)v; }
+
+static void generate_input(void) {
+  uint32_t t = (uint32_t)get_global_hint();
+  static float const divider = 1.f / (float)(UINT32_MAX);
+  for (size_t ch = 0; ch < test_channels; ++ch) {
+    for (size_t i = 0; i < test_samples; ++i) {
+      g_input[ch][i] = (float)(ov_splitmix32(t)) * divider * 2.f - 1.f;
+      t = ov_splitmix32_next(t);
+    }
+  }
+}
+
+static float const *const g_inputs[test_channels] = {g_input[0], g_input[1]};
+static float *const g_outputs[test_channels] = {g_output[0], g_output[1]};
+static float *const g_references[test_channels] = {g_reference[0], g_reference[1]};
+
+// Without modulation the trapezoidal SVF is the same bilinear-transformed filter as the RBJ biquad.
+static void test_match_rbjeq(void) {
+  static float const tolerance = 1e-4f;
+  struct svf *s = NULL;
+  struct rbjeq *eq = NULL;
+  generate_input();
+  TEST_SUCCEEDED_F(svf_create(&s));
+  TEST_SUCCEEDED_F(rbjeq_create(&eq));
+  for (int type = rbjeq_type_low_pass; type <= rbjeq_type_all_pass; ++type) {
+    svf_set_type(s, type);
+    svf_set_frequency(s, 800.f);
+    svf_set_q(s, 0.9f);
+    svf_set_gain(s, 6.f);
+    TEST_SUCCEEDED_F(svf_update_internal_parameter(s, NULL));
+    svf_clear(s);
+    rbjeq_set_type(eq, type);
+    rbjeq_set_frequency(eq, 800.f);
+    rbjeq_set_q(eq, 0.9f);
+    rbjeq_set_gain(eq, 6.f);
+    TEST_SUCCEEDED_F(rbjeq_update_internal_parameter(eq, NULL));
+    rbjeq_clear(eq);
+    svf_process(s, (float const *restrict const *)g_inputs, g_outputs, test_samples);
+    rbjeq_process(eq, (float const *restrict const *)g_inputs, g_references, test_samples);
+    float dev = 0.f;
+    for (size_t ch = 0; ch < test_channels; ++ch) {
+      for (size_t i = 0; i < test_samples; ++i) {
+        dev = fmaxf(dev, fabsf(g_output[ch][i] - g_reference[ch][i]));
+      }
+    }
+    TEST_CHECK(dev < tolerance);
+    TEST_MSG("type %d: max deviation %g", type, (double)dev);
+  }
+  TEST_SUCCEEDED_F(rbjeq_destroy(&eq));
+  TEST_SUCCEEDED_F(svf_destroy(&s));
+}
+
+static void test_ramp(void) {
+  struct svf *s = NULL;
+  TEST_SUCCEEDED_F(svf_create(&s));
+  svf_set_type(s, rbjeq_type_peaking);
+  svf_set_frequency(s, 1000.f);
+  svf_set_gain(s, 0.f);
+  svf_set_ramp_duration(s, 0.01f);
+  TEST_SUCCEEDED_F(svf_update_internal_parameter(s, NULL));
+  TEST_CHECK(!svf_is_active(s));
+
+  svf_set_gain(s, 12.f);
+  TEST_SUCCEEDED_F(svf_update_internal_parameter(s, NULL));
+  TEST_CHECK(svf_is_active(s));
+  TEST_CHECK(s->ramp_remain == 480);
+
+  svf_set_gain(s, 0.f);
+  TEST_SUCCEEDED_F(svf_update_internal_parameter(s, NULL));
+  generate_input();
+  svf_process(s, (float const *restrict const *)g_inputs, g_outputs, 479);
+  TEST_CHECK(svf_is_active(s));
+  svf_process(s, (float const *restrict const *)g_inputs, g_outputs, 1);
+  TEST_CHECK(!svf_is_active(s));
+  TEST_SUCCEEDED_F(svf_destroy(&s));
+}
+
+// Every specialized instance has to match the generic one that reads the channel count at run time,
+// both while ramping and after it.
+static void test_channel_kernels(void) {
+  enum {
+    max_channels = chspec_max_channels + 1,
+    block = 600,
+  };
+  static float out[max_channels][test_samples];
+  static float ref[max_channels][test_samples];
+  generate_input();
+  for (size_t channels = 1; channels <= max_channels; ++channels) {
+    struct svf *s = NULL;
+    struct svf *generic = NULL;
+    TEST_SUCCEEDED_F(svf_create(&s));
+    TEST_SUCCEEDED_F(svf_create(&generic));
+    struct svf *const ss[2] = {s, generic};
+    for (size_t i = 0; i < 2; ++i) {
+      svf_set_format(ss[i], 48000.f, channels);
+      svf_set_type(ss[i], rbjeq_type_peaking);
+      svf_set_gain(ss[i], 0.f);
+      TEST_SUCCEEDED_F(svf_update_internal_parameter(ss[i], NULL));
+      svf_set_gain(ss[i], 12.f); // ramps over the first 960 samples
+      TEST_SUCCEEDED_F(svf_update_internal_parameter(ss[i], NULL));
+    }
+    for (size_t pos = 0; pos < test_samples; pos += block) {
+      float const *in[max_channels];
+      float *o[max_channels];
+      float *r[max_channels];
+      for (size_t ch = 0; ch < channels; ++ch) {
+        in[ch] = g_input[ch % test_channels] + pos;
+        o[ch] = out[ch] + pos;
+        r[ch] = ref[ch] + pos;
+      }
+      svf_process(s, (float const *restrict const *)in, (float *restrict const *)o, block);
+      process_generic(generic, (float const *restrict const *)in, (float *restrict const *)r, block);
+    }
+    float dev = 0.f;
+    for (size_t ch = 0; ch < channels; ++ch) {
+      for (size_t i = 0; i < test_samples; ++i) {
+        dev = fmaxf(dev, fabsf(out[ch][i] - ref[ch][i]));
+      }
+    }
+    TEST_CHECK(dev < 1e-6f);
+    TEST_MSG("channels %zu: max deviation %g", channels, (double)dev);
+    TEST_SUCCEEDED_F(svf_destroy(&generic));
+    TEST_SUCCEEDED_F(svf_destroy(&s));
+  }
+}
+
+// Sweeps the frequency on every 32 samples, which is what automation would do in the worst case.
+static void bench_sweep_svf(void) {
+  struct svf *s = NULL;
+  generate_input();
+  TEST_SUCCEEDED_F(svf_create(&s));
+  svf_set_type(s, rbjeq_type_peaking);
+  svf_set_gain(s, 6.f);
+  svf_set_ramp_duration(s, 32.f / 48000.f);
+  for (int n = 0; n < 100; ++n) {
+    for (size_t pos = 0; pos < test_samples; pos += 32) {
+      svf_set_frequency(s, 200.f + (float)(pos + (size_t)n));
+      TEST_SUCCEEDED_F(svf_update_internal_parameter(s, NULL));
+      float const *in[test_channels] = {g_input[0] + pos, g_input[1] + pos};
+      float *out[test_channels] = {g_output[0] + pos, g_output[1] + pos};
+      svf_process(s, (float const *restrict const *)in, out, 32);
+    }
+  }
+  f(g_output[0][0]);
+  TEST_SUCCEEDED_F(svf_destroy(&s));
+}
+
+// Recomputes RBJ coefficients on every sample, the alternative to ramping.
+static void bench_sweep_rbjeq_per_sample(void) {
+  struct rbjeq *eq = NULL;
+  generate_input();
+  TEST_SUCCEEDED_F(rbjeq_create(&eq));
+  rbjeq_set_type(eq, rbjeq_type_peaking);
+  rbjeq_set_gain(eq, 6.f);
+  for (int n = 0; n < 100; ++n) {
+    for (size_t pos = 0; pos < test_samples; ++pos) {
+      rbjeq_set_frequency(eq, 200.f + (float)n * 0.25f + (float)pos * 0.001f);
+      TEST_SUCCEEDED_F(rbjeq_update_internal_parameter(eq, NULL));
+      float const *in[test_channels] = {g_input[0] + pos, g_input[1] + pos};
+      float *out[test_channels] = {g_output[0] + pos, g_output[1] + pos};
+      rbjeq_process(eq, (float const *restrict const *)in, out, 1);
+    }
+  }
+  f(g_output[0][0]);
+  TEST_SUCCEEDED_F(rbjeq_destroy(&eq));
+}
+
+TEST_LIST = {
+    {"test_match_rbjeq", test_match_rbjeq},
+    {"test_ramp", test_ramp},
+    {"test_channel_kernels", test_channel_kernels},
+    {"bench_sweep_svf", bench_sweep_svf},
+    {"bench_sweep_rbjeq_per_sample", bench_sweep_rbjeq_per_sample},
+    {NULL, NULL},
+};
@@ -10,19 +10,24 @@
 #include "uxfdreverb.h"
 
 #include <math.h>
+#include <xmmintrin.h>
 
 #include "inlines.h"
 
 enum {
   num_delays = 12,
   num_taps = 14,
+  sub_block_max = 64, // must be a multiple of 4
+  max_excursion = 64, // excursion parameter is at most 32, the LFO doubles it
 };
 
+// All delay lines live in one arena with power-of-two capacities and share a single position counter.
+// A line of len samples is written at pos and read at pos - (len - 1), both wrapped with the mask.
 struct delay {
   float *ptr;
+  size_t mask;
   size_t len;
-  size_t writecur;
-  size_t readcur;
+  size_t readofs; // -(len - 1), wraps around by design
 };
 
 struct uxfdreverb {
@@ -36,15 +41,20 @@ struct uxfdreverb {
   float dry;        // 0 - 1
 
   struct delay delays[num_delays];
-  size_t taps[num_taps];
+  size_t tapofs[num_taps];
+  float *arena;
+  size_t arena_len;
+  size_t pos;
+  size_t sub_block;
   float *pre_delay_ptr;
-  size_t pre_delay_len;
+  size_t pre_delay_len; // power of two
   size_t pre_delay_writecur;
   float lp1, lp2, lp3, curtime;
   float sample_rate;
   size_t channels;
   bool sample_rate_changed : 1;
   bool need_parameter_update : 1;
+  bool silent : 1;
 };
 
 static size_t pre_delay_max(struct uxfdreverb const *const r) { return (size_t)(r->sample_rate) / 4; }
@@ -80,10 +90,8 @@ NODISCARD error uxfdreverb_destroy(struct uxfdreverb **const rp) {
     return errg(err_invalid_arugment);
   }
   struct uxfdreverb *const r = *rp;
-  for (size_t i = 0; i < num_delays; ++i) {
-    if (r->delays[i].ptr) {
-      ereport(mem_aligned_free(&r->delays[i].ptr));
-    }
+  if (r->arena) {
+    ereport(mem_aligned_free(&r->arena));
   }
   if (r->pre_delay_ptr) {
     ereport(mem_aligned_free(&r->pre_delay_ptr));
@@ -167,6 +175,14 @@ void uxfdreverb_set_dry(struct uxfdreverb *const r, float const v) {
   r->dry = v;
 }
 
+static size_t next_power_of_two(size_t const v) {
+  size_t r = 1;
+  while (r < v) {
+    r <<= 1;
+  }
+  return r;
+}
+
 NODISCARD static error recreate_delays(struct uxfdreverb *const r) {
   static float const delay_lengths[num_delays] = {
       0.004771345f,
@@ -183,35 +199,48 @@ NODISCARD static error recreate_delays(struct uxfdreverb *const r) {
       0.106280031f,
   };
   float const sample_rate = r->sample_rate;
-  float *ptrs[num_delays] = {0};
   size_t lens[num_delays] = {0};
-  error err = eok();
+  size_t caps[num_delays] = {0};
+  size_t total = 0;
   for (size_t i = 0; i < num_delays; ++i) {
     lens[i] = (size_t)(roundf(delay_lengths[i] * sample_rate));
-    err = mem_aligned_alloc(&ptrs[i], lens[i], sizeof(float), 16);
-    if (efailed(err)) {
-      err = ethru(err);
-      goto cleanup;
+    if (lens[i] == 0) {
+      lens[i] = 1;
     }
+    caps[i] = next_power_of_two(lens[i]);
+    total += caps[i];
   }
-  for (size_t i = 0; i < num_delays; ++i) {
-    if (r->delays[i].ptr) {
-      ereport(mem_aligned_free(&r->delays[i].ptr));
-    }
+  float *arena = NULL;
+  error err = mem_aligned_alloc(&arena, total, sizeof(float), 16);
+  if (efailed(err)) {
+    err = ethru(err);
+    return err;
+  }
+  if (r->arena) {
+    ereport(mem_aligned_free(&r->arena));
+  }
+  r->arena = arena;
+  r->arena_len = total;
+  for (size_t i = 0, offset = 0; i < num_delays; ++i) {
     r->delays[i] = (struct delay){
-        .ptr = ptrs[i],
+        .ptr = arena + offset,
+        .mask = caps[i] - 1,
         .len = lens[i],
+        .readofs = (size_t)0 - (lens[i] - 1),
     };
+    offset += caps[i];
   }
-cleanup:
-  if (efailed(err)) {
-    for (size_t i = 0; i < num_delays; ++i) {
-      if (ptrs[i]) {
-        ereport(mem_aligned_free(&ptrs[i]));
-      }
+  // A sub-block must not reach its own writes, including the interpolated reads of the modulated lines.
+  size_t sub_block = sub_block_max;
+  for (size_t i = 0; i < num_delays; ++i) {
+    size_t const margin = i == 4 || i == 8 ? max_excursion + 2 : 1;
+    size_t const limit = lens[i] > margin ? lens[i] - margin : 1;
+    if (sub_block > limit) {
+      sub_block = limit;
     }
   }
-  return err;
+  r->sub_block = sub_block;
+  return eok();
 }
 
 static void update_taps(struct uxfdreverb *const r) {
@@ -231,14 +260,16 @@ static void update_taps(struct uxfdreverb *const r) {
       0.011256342f,
       0.004065724f,
   };
+  // the delay line each tap reads from, see uxfdreverb_process
+  static size_t const tap_delays[num_taps] = {9, 9, 10, 11, 5, 6, 7, 5, 5, 6, 7, 9, 10, 11};
   float const sample_rate = r->sample_rate;
   for (size_t i = 0; i < num_taps; ++i) {
-    r->taps[i] = (size_t)(roundf(taps[i] * sample_rate));
+    r->tapofs[i] = r->delays[tap_delays[i]].readofs + (size_t)(roundf(taps[i] * sample_rate));
   }
 }
 
 NODISCARD static error recreate_pre_delay(struct uxfdreverb *const r) {
-  size_t const pre_delay_len = pre_delay_max(r) * 2;
+  size_t const pre_delay_len = next_power_of_two(pre_delay_max(r) * 2);
   float *pre_delay_ptr = NULL;
   error err = mem_aligned_alloc(&pre_delay_ptr, pre_delay_len, sizeof(float), 16);
   if (efailed(err)) {
@@ -313,6 +344,12 @@ NODISCARD error uxfdreverb_update_internal_parameter(struct uxfdreverb *const r,
   return eok();
 }
 
+float uxfdreverb_get_decay_per_second(struct uxfdreverb const *const r) {
+  // Every trip around one half of the tank goes through the damper and the cross-feed, both multiply by decay.
+  // The longer half takes 0.368s including its allpasses, damping only makes the tail shorter.
+  return powf(r->decay, 2.f / 0.368f);
+}
+
 static inline void
 to_mono(float *restrict const o, float const *restrict const i0, float const *restrict const i1, size_t const samples) {
   for (size_t i = 0; i < samples; ++i) {
@@ -335,72 +372,118 @@ static inline void write_pre_delay(float *restrict const o,
   }
 }
 
-static inline void advance_all_cursor(struct delay *restrict const d) {
-#if 0
-  for (size_t i = 0; i < num_delays; ++i) {
-    d[i].readcur = (d[i].readcur + 1) % d[i].len;
-    d[i].writecur = (d[i].writecur + 1) % d[i].len;
-  }
-#else
-  _Alignas(16) size_t cur[num_delays * 2];
-  _Alignas(16) size_t len[num_delays * 2];
-  for (size_t i = 0; i < num_delays; ++i) {
-    cur[i] = d[i].readcur;
-    len[i] = d[i].len;
-    cur[i + num_delays] = d[i].writecur;
-    len[i + num_delays] = d[i].len;
-  }
-  for (size_t i = 0; i < num_delays * 2; ++i) {
-    ++cur[i];
-    if (cur[i] == len[i]) {
-      cur[i] = 0;
-    }
+static inline void read_ring(
+    float const *restrict const ptr, size_t const mask, size_t const start, float *restrict const dst, size_t const n) {
+  size_t const cur = start & mask;
+  size_t const sz = mask + 1 - cur;
+  if (sz >= n) {
+    memcpy(dst, ptr + cur, n * sizeof(float));
+  } else {
+    memcpy(dst, ptr + cur, sz * sizeof(float));
+    memcpy(dst + sz, ptr, (n - sz) * sizeof(float));
   }
-  for (size_t i = 0; i < num_delays; ++i) {
-    d[i].readcur = cur[i];
-    d[i].writecur = cur[i + num_delays];
+}
+
+static inline void write_ring(
+    float *restrict const ptr, size_t const mask, size_t const start, float const *restrict const src, size_t const n) {
+  size_t const cur = start & mask;
+  size_t const sz = mask + 1 - cur;
+  if (sz >= n) {
+    memcpy(ptr + cur, src, n * sizeof(float));
+  } else {
+    memcpy(ptr + cur, src, sz * sizeof(float));
+    memcpy(ptr, src + sz, (n - sz) * sizeof(float));
   }
-#endif
 }
 
-static inline void write_delay(struct delay *restrict const d, float const v) { d->ptr[d->writecur] = v; }
+// Scratch for one sub-block. Every array is padded to a multiple of 4 so the SSE loops need no scalar tail;
+// the padding lanes carry stale values that are never written back.
+struct scratch {
+  _Alignas(16) float x[sub_block_max];
+  _Alignas(16) float l[sub_block_max];
+  _Alignas(16) float r[sub_block_max];
+  _Alignas(16) float excursion[sub_block_max];
+  _Alignas(16) float rd[sub_block_max];
+  _Alignas(16) float rd2[sub_block_max];
+  _Alignas(16) float w[sub_block_max];
+  _Alignas(16) float w2[sub_block_max];
+  _Alignas(16) float lo[sub_block_max];
+  _Alignas(16) float ro[sub_block_max];
+};
 
-static inline float read_delay(struct delay const *restrict const d) { return d->ptr[d->readcur]; }
+// Runs an allpass stage over n samples: w = in - g * delayed goes into the line, io becomes g * w + delayed.
+// Valid because n never exceeds the line length, so none of the reads see this sub-block's writes.
+static inline void allpass(struct delay const *restrict const d,
+                           size_t const pos,
+                           float *restrict const io,
+                           float *restrict const rd,
+                           float *restrict const w,
+                           size_t const n,
+                           float const g) {
+  read_ring(d->ptr, d->mask, pos + d->readofs, rd, n);
+  __m128 const gv = _mm_set1_ps(g);
+  for (size_t i = 0; i < n; i += 4) {
+    __m128 const dv = _mm_load_ps(rd + i);
+    __m128 const wv = _mm_sub_ps(_mm_load_ps(io + i), _mm_mul_ps(gv, dv));
+    _mm_store_ps(w + i, wv);
+    _mm_store_ps(io + i, _mm_add_ps(_mm_mul_ps(gv, wv), dv));
+  }
+  write_ring(d->ptr, d->mask, pos, w, n);
+}
 
-static inline float read_delay_at(struct delay const *restrict const d, size_t const idx) {
-  size_t const len = d->len;
-  size_t cur = d->readcur + idx;
-  if (cur >= len) {
-    cur -= len;
+// Interpolated read for the tank diffusers, the excursion moves the tap towards the write position.
+static inline void modulated_read(struct delay const *restrict const d,
+                                  size_t const pos,
+                                  float const *restrict const excursion,
+                                  float *restrict const rd,
+                                  size_t const n) {
+  float const *restrict const ptr = d->ptr;
+  size_t const mask = d->mask;
+  size_t const start = pos + d->readofs;
+  for (size_t i = 0; i < n; ++i) {
+    size_t const iidx = (size_t)excursion[i];
+    float const frac = excursion[i] - (float)iidx;
+    size_t const cur = start + i + iidx;
+    float const x = ptr[cur & mask];
+    float const y = ptr[(cur + 1) & mask];
+    rd[i] = x + frac * (y - x);
   }
-  return d->ptr[cur];
 }
 
-static float read_delay_at_approx(struct delay const *restrict const d, float const idx) {
-  size_t const iidx = (size_t)idx;
-  float const frac = idx - (float)iidx;
-  float const *const ptr = d->ptr;
-  size_t const len = d->len;
-  size_t readcur = d->readcur + iidx;
-  if (readcur >= len) {
-    readcur -= len;
-  }
-  size_t next_readcur = readcur + 1;
-  if (next_readcur >= len) {
-    next_readcur -= len;
-  }
-  float const x = ptr[readcur];
-  float const y = ptr[next_readcur];
-  return x + frac * (y - x);
+static inline void tap(struct delay const *restrict const d,
+                       size_t const pos,
+                       size_t const tapofs,
+                       float *restrict const acc,
+                       float *restrict const tmp,
+                       size_t const n,
+                       bool const subtract) {
+  read_ring(d->ptr, d->mask, pos + tapofs, tmp, n);
+  if (subtract) {
+    for (size_t i = 0; i < n; i += 4) {
+      _mm_store_ps(acc + i, _mm_sub_ps(_mm_load_ps(acc + i), _mm_load_ps(tmp + i)));
+    }
+  } else {
+    for (size_t i = 0; i < n; i += 4) {
+      _mm_store_ps(acc + i, _mm_add_ps(_mm_load_ps(acc + i), _mm_load_ps(tmp + i)));
+    }
+  }
 }
 
-static inline float read_pre_delay(struct delay const *restrict const d) { return d->ptr[d->writecur]; }
+// out = a + g * b
+static inline void
+mul_add(float *restrict const out, float const *restrict const a, float const *restrict const b, float const g, size_t const n) {
+  __m128 const gv = _mm_set1_ps(g);
+  for (size_t i = 0; i < n; i += 4) {
+    _mm_store_ps(out + i, _mm_add_ps(_mm_load_ps(a + i), _mm_mul_ps(gv, _mm_load_ps(b + i))));
+  }
+}
 
 void uxfdreverb_process(struct uxfdreverb *const r,
                         float const *restrict const *const inputs,
                         float *restrict const *const outputs,
                         size_t const samples) {
   static float const pi = 3.14159265358979323846264338327950288f;
+  r->silent = false;
   size_t const pd = (size_t)(r->pre_delay * r->sample_rate * 0.25f);
   float const bw = r->band_width;
   float const fi = r->diffuse * 0.75f;
@@ -417,86 +500,130 @@ void uxfdreverb_process(struct uxfdreverb *const r,
 
   float *restrict const pre_delay_ptr = r->pre_delay_ptr;
   size_t const pre_delay_len = r->pre_delay_len;
+  size_t const pre_delay_mask = pre_delay_len - 1;
   size_t const block_size = pre_delay_max(r);
+  size_t const sub_block = r->sub_block;
 
-  struct delay *const delays = r->delays;
-  size_t const *const taps = r->taps;
+  struct delay const *const d = r->delays;
+  size_t const *const tapofs = r->tapofs;
 
   float lp1 = r->lp1;
   float lp2 = r->lp2;
   float lp3 = r->lp3;
   float curtime = r->curtime;
+  size_t pos = r->pos;
   size_t pre_delay_writecur = r->pre_delay_writecur;
-  size_t pre_delay_readcur = r->pre_delay_writecur + pre_delay_len - pd;
-  if (pre_delay_readcur >= pre_delay_len) {
-    pre_delay_readcur -= pre_delay_len;
-  }
+  size_t pre_delay_readcur = r->pre_delay_writecur - pd;
+
+  // 1Hz LFO (footnote 14, pp. 665) as a recursive quadrature oscillator.
+  // It restarts from the exact phase on every call, so the rounding error cannot accumulate.
+  float const rot_c = cosf(2.f * pi * timestep), rot_s = sinf(2.f * pi * timestep);
+  float lfo_c = cosf(2.f * pi * curtime), lfo_s = sinf(2.f * pi * curtime), tmp;
 
   float const *restrict i0 = inputs[0];
   float const *restrict i1 = inputs[1];
   float *restrict o0 = outputs[0];
   float *restrict o1 = outputs[1];
 
-  float lo, ro, split, excursion;
-  size_t remain = samples, block, i;
+  struct scratch s = {0};
+  size_t remain = samples, block, n, i, j;
   while (remain) {
     block = remain < block_size ? remain : block_size;
     write_pre_delay(pre_delay_ptr, pre_delay_len, pre_delay_writecur, i0, i1, block);
-    for (i = 0; i < block; ++i) {
-      lo = 0.f;
-      ro = 0.f;
-      lp1 = pre_delay_ptr[pre_delay_readcur] * bw + (1 - bw) * lp1;
-
-      // Please note: The groupings and formatting below does not bear any useful information about
-      //              the topology of the network. I just want orderly looking text.
+    // Every stage runs over the whole sub-block before the next one starts.
+    // sub_block is shorter than any line (minus the excursion range for the modulated ones),
+    // so reads never depend on writes made in the same sub-block and the result matches per-sample processing.
+    for (j = 0; j < block; j += n, pos += n, pre_delay_readcur += n) {
+      n = block - j < sub_block ? block - j : sub_block;
+
+      read_ring(pre_delay_ptr, pre_delay_mask, pre_delay_readcur, s.x, n);
+      for (i = 0; i < n; ++i) {
+        lp1 = s.x[i] * bw + (1 - bw) * lp1;
+        s.x[i] = lp1;
+      }
 
       // pre
-      write_delay(delays + 0, lp1 - fi * read_delay(delays + 0));
-      write_delay(delays + 1, fi * (read_pre_delay(delays + 0) - read_delay(delays + 1)) + read_delay(delays + 0));
-      write_delay(delays + 2, fi * read_pre_delay(delays + 1) + read_delay(delays + 1) - si * read_delay(delays + 2));
-      write_delay(delays + 3, si * (read_pre_delay(delays + 2) - read_delay(delays + 3)) + read_delay(delays + 2));
-
-      split = si * read_pre_delay(delays + 3) + read_delay(delays + 3);
-
-      // 1Hz (footnote 14, pp. 665)
-      excursion = ex * (1.f + cosf((curtime + (timestep * (float)i)) * pi * 2.f));
-
-      // left
-      write_delay(delays + 4,
-                  split + dc * read_delay(delays + 11) +
-                      ft * read_delay_at_approx(delays + 4, excursion)); // tank diffuse 1
-      write_delay(delays + 5,
-                  read_delay_at_approx(delays + 4, excursion) - ft * read_pre_delay(delays + 4)); // long delay 1
-      lp2 = (1 - dp) * read_delay(delays + 5) + dp * lp2;                                         // damp 1
-      write_delay(delays + 6, dc * lp2 - st * read_delay(delays + 6));                            // tank diffuse 2
-      write_delay(delays + 7, read_delay(delays + 6) + st * read_pre_delay(delays + 6));          // long delay 2
-
-      // right
-      write_delay(delays + 8,
-                  split + dc * read_delay(delays + 7) +
-                      ft * read_delay_at_approx(delays + 8, excursion)); // tank diffuse 3
-      write_delay(delays + 9,
-                  read_delay_at_approx(delays + 8, excursion) - ft * read_pre_delay(delays + 8)); // long delay 3
-      lp3 = (1 - dp) * read_delay(delays + 9) + dp * lp3;                                         // damper 2
-      write_delay(delays + 10, dc * lp3 - st * read_delay(delays + 10));                          // tank diffuse 4
-      write_delay(delays + 11, read_delay(delays + 10) + st * read_pre_delay(delays + 10));       // long delay 4
-
-      lo = read_delay_at(delays + 9, taps[0]) + read_delay_at(delays + 9, taps[1]) -
-           read_delay_at(delays + 10, taps[2]) + read_delay_at(delays + 11, taps[3]) -
-           read_delay_at(delays + 5, taps[4]) - read_delay_at(delays + 6, taps[5]) - read_delay_at(delays + 7, taps[6]);
-
-      ro = read_delay_at(delays + 5, taps[7]) + read_delay_at(delays + 5, taps[8]) -
-           read_delay_at(delays + 6, taps[9]) + read_delay_at(delays + 7, taps[10]) -
-           read_delay_at(delays + 9, taps[11]) - read_delay_at(delays + 10, taps[12]) -
-           read_delay_at(delays + 11, taps[13]);
+      allpass(d + 0, pos, s.x, s.rd, s.w, n, fi);
+      allpass(d + 1, pos, s.x, s.rd, s.w, n, fi);
+      allpass(d + 2, pos, s.x, s.rd, s.w, n, si);
+      allpass(d + 3, pos, s.x, s.rd, s.w, n, si);
+
+      for (i = 0; i < n; ++i) {
+        s.excursion[i] = ex * (1.f + lfo_c);
+        tmp = lfo_c * rot_c - lfo_s * rot_s;
+        lfo_s = lfo_s * rot_c + lfo_c * rot_s;
+        lfo_c = tmp;
+      }
 
-      // write
-      o0[i] = i0[i] * dr + lo * we;
-      o1[i] = i1[i] * dr + ro * we;
+      // tank inputs, both cross-feeds read from before this sub-block
+      read_ring(d[11].ptr, d[11].mask, pos + d[11].readofs, s.rd, n);
+      mul_add(s.l, s.x, s.rd, dc, n);
+      read_ring(d[7].ptr, d[7].mask, pos + d[7].readofs, s.rd, n);
+      mul_add(s.r, s.x, s.rd, dc, n);
+
+      // tank diffuse 1 and 3, allpasses with modulated taps and negated gain
+      modulated_read(d + 4, pos, s.excursion, s.rd, n);
+      modulated_read(d + 8, pos, s.excursion, s.rd2, n);
+      {
+        __m128 const ftv = _mm_set1_ps(ft);
+        for (i = 0; i < n; i += 4) {
+          __m128 const delayed_l = _mm_load_ps(s.rd + i), delayed_r = _mm_load_ps(s.rd2 + i);
+          __m128 const wl = _mm_add_ps(_mm_load_ps(s.l + i), _mm_mul_ps(ftv, delayed_l));
+          __m128 const wr = _mm_add_ps(_mm_load_ps(s.r + i), _mm_mul_ps(ftv, delayed_r));
+          _mm_store_ps(s.w + i, wl);
+          _mm_store_ps(s.w2 + i, wr);
+          _mm_store_ps(s.l + i, _mm_sub_ps(delayed_l, _mm_mul_ps(ftv, wl)));
+          _mm_store_ps(s.r + i, _mm_sub_ps(delayed_r, _mm_mul_ps(ftv, wr)));
+        }
+      }
+      write_ring(d[4].ptr, d[4].mask, pos, s.w, n);
+      write_ring(d[8].ptr, d[8].mask, pos, s.w2, n);
+
+      // long delay 1 and 3
+      write_ring(d[5].ptr, d[5].mask, pos, s.l, n);
+      write_ring(d[9].ptr, d[9].mask, pos, s.r, n);
+
+      // damper 1 and 2, the two recursions run side by side
+      read_ring(d[5].ptr, d[5].mask, pos + d[5].readofs, s.l, n);
+      read_ring(d[9].ptr, d[9].mask, pos + d[9].readofs, s.r, n);
+      for (i = 0; i < n; ++i) {
+        lp2 = (1 - dp) * s.l[i] + dp * lp2;
+        lp3 = (1 - dp) * s.r[i] + dp * lp3;
+        s.l[i] = dc * lp2;
+        s.r[i] = dc * lp3;
+      }
+
+      // tank diffuse 2 and 4
+      allpass(d + 6, pos, s.l, s.rd, s.w, n, st);
+      allpass(d + 10, pos, s.r, s.rd, s.w, n, st);
+
+      // long delay 2 and 4
+      write_ring(d[7].ptr, d[7].mask, pos, s.l, n);
+      write_ring(d[11].ptr, d[11].mask, pos, s.r, n);
+
+      // output taps, read after the whole tank has been written
+      memset(s.lo, 0, sizeof(s.lo));
+      memset(s.ro, 0, sizeof(s.ro));
+      tap(d + 9, pos, tapofs[0], s.lo, s.rd, n, false);
+      tap(d + 9, pos, tapofs[1], s.lo, s.rd, n, false);
+      tap(d + 10, pos, tapofs[2], s.lo, s.rd, n, true);
+      tap(d + 11, pos, tapofs[3], s.lo, s.rd, n, false);
+      tap(d + 5, pos, tapofs[4], s.lo, s.rd, n, true);
+      tap(d + 6, pos, tapofs[5], s.lo, s.rd, n, true);
+      tap(d + 7, pos, tapofs[6], s.lo, s.rd, n, true);
+
+      tap(d + 5, pos, tapofs[7], s.ro, s.rd, n, false);
+      tap(d + 5, pos, tapofs[8], s.ro, s.rd, n, false);
+      tap(d + 6, pos, tapofs[9], s.ro, s.rd, n, true);
+      tap(d + 7, pos, tapofs[10], s.ro, s.rd, n, false);
+      tap(d + 9, pos, tapofs[11], s.ro, s.rd, n, true);
+      tap(d + 10, pos, tapofs[12], s.ro, s.rd, n, true);
+      tap(d + 11, pos, tapofs[13], s.ro, s.rd, n, true);
 
-      advance_all_cursor(delays);
-      if (++pre_delay_readcur == pre_delay_len) {
-        pre_delay_readcur = 0;
+      // write
+      for (i = 0; i < n; ++i) {
+        o0[j + i] = i0[j + i] * dr + s.lo[i] * we;
+        o1[j + i] = i1[j + i] * dr + s.ro[i] * we;
       }
     }
     i0 += block;
@@ -504,16 +631,17 @@ void uxfdreverb_process(struct uxfdreverb *const r,
     o0 += block;
     o1 += block;
     curtime += (float)(block)*timestep;
-    pre_delay_writecur += block;
-    if (pre_delay_writecur >= pre_delay_len) {
-      pre_delay_writecur -= pre_delay_len;
+    if (curtime >= 1.f) {
+      curtime -= 1.f; // one period of the LFO
     }
+    pre_delay_writecur = (pre_delay_writecur + block) & pre_delay_mask;
     remain -= block;
   }
   r->lp1 = lp1;
   r->lp2 = lp2;
   r->lp3 = lp3;
   r->curtime = curtime;
+  r->pos = pos;
   r->pre_delay_writecur = pre_delay_writecur;
 }
 
@@ -522,12 +650,18 @@ void uxfdreverb_clear(struct uxfdreverb *const r) {
   r->lp2 = 0.f;
   r->lp3 = 0.f;
   r->curtime = 0.f;
-  struct delay *restrict const d = r->delays;
-  for (size_t i = 0; i < num_delays; ++i) {
-    memset(d[i].ptr, 0, d[i].len * sizeof(float));
-    d[i].writecur = d[i].len - 1;
-    d[i].readcur = 0;
-  }
+  r->pos = 0;
+  memset(r->arena, 0, r->arena_len * sizeof(float));
   memset(r->pre_delay_ptr, 0, r->pre_delay_len * sizeof(float));
   r->pre_delay_writecur = 0;
 }
+
+void uxfdreverb_silence(struct uxfdreverb *const r, size_t const samples) {
+  float curtime = r->curtime;
+  if (!r->silent) {
+    uxfdreverb_clear(r);
+    r->silent = true;
+  }
+  curtime += (float)(samples) / r->sample_rate;
+  r->curtime = curtime - floorf(curtime); // one period of the LFO
+}
@@ -28,8 +28,14 @@ void uxfdreverb_set_dry(struct uxfdreverb *const r, float const v);
 
 NODISCARD error uxfdreverb_update_internal_parameter(struct uxfdreverb *const r, bool *const updated);
 
+// Upper bound of the amplitude gain of the tail over one second of silent input.
+float uxfdreverb_get_decay_per_second(struct uxfdreverb const *const r);
+
 void uxfdreverb_process(struct uxfdreverb *const r,
                         float const *restrict const *const inputs,
                         float *restrict const *const outputs,
                         size_t const samples);
 void uxfdreverb_clear(struct uxfdreverb *const r);
+// Equivalent to processing samples of silence after the tail has died out.
+// The state is cleared on the first call, later calls only advance the LFO, and uxfdreverb_process resumes from there.
+void uxfdreverb_silence(struct uxfdreverb *const r, size_t const samples);
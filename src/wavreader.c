@@ -0,0 +1,183 @@
+#include "wavreader.h"
+
+#include "ovutil/win32.h"
+
+#include "error_axr.h"
+
+enum wave_format {
+  wave_format_pcm = 1,
+  wave_format_ieee_float = 3,
+  wave_format_extensible = 0xfffe,
+};
+
+struct wavreader {
+  HANDLE file;
+  HANDLE mapping;
+  uint8_t const *view;
+  uint8_t const *data;
+  size_t channels;
+  size_t samples;
+  size_t block_align;
+  size_t bytes; // bytes per sample
+  float sample_rate;
+  bool is_float;
+};
+
+static uint16_t read16(uint8_t const *const p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t read32(uint8_t const *const p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+static uint32_t fourcc(char const *const s) {
+  return (uint32_t)s[0] | ((uint32_t)s[1] << 8) | ((uint32_t)s[2] << 16) | ((uint32_t)s[3] << 24);
+}
+
+NODISCARD static error parse(struct wavreader *const w, size_t const size) {
+  uint8_t const *const p = w->view;
+  if (size < 12 || read32(p) != fourcc("RIFF") || read32(p + 8) != fourcc("WAVE")) {
+    return err(err_type_axr, err_axr_unsupported_wave_format);
+  }
+  bool has_format = false;
+  size_t pos = 12;
+  while (pos + 8 <= size) {
+    uint32_t const id = read32(p + pos);
+    size_t const chunk_size = read32(p + pos + 4);
+    size_t const body = pos + 8;
+    if (chunk_size > size - body) {
+      // some writers leave the size of the last chunk unset, use what is there
+      if (id != fourcc("data")) {
+        break;
+      }
+    }
+    size_t const avail = chunk_size > size - body ? size - body : chunk_size;
+    if (id == fourcc("fmt ") && avail >= 16) {
+      uint16_t tag = read16(p + body);
+      if (tag == wave_format_extensible && avail >= 26) {
+        tag = read16(p + body + 24); // the first two bytes of the sub format GUID
+      }
+      size_t const bits = read16(p + body + 14);
+      w->channels = read16(p + body + 2);
+      w->sample_rate = (float)read32(p + body + 4);
+      w->block_align = read16(p + body + 12);
+      w->bytes = bits / 8;
+      w->is_float = tag == wave_format_ieee_float;
+      if ((tag != wave_format_pcm && tag != wave_format_ieee_float) || (w->is_float && bits != 32) ||
+          (!w->is_float && bits != 16 && bits != 24 && bits != 32) || w->channels == 0 ||
+          w->block_align < w->channels * w->bytes || w->sample_rate <= 0.f) {
+        return err(err_type_axr, err_axr_unsupported_wave_format);
+      }
+      has_format = true;
+    } else if (id == fourcc("data") && has_format) {
+      w->data = p + body;
+      w->samples = avail / w->block_align;
+      return eok();
+    }
+    pos = body + chunk_size + (chunk_size & 1);
+  }
+  return err(err_type_axr, err_axr_unsupported_wave_format);
+}
+
+NODISCARD error wavreader_close(struct wavreader **const wp) {
+  if (!wp || !*wp) {
+    return errg(err_invalid_arugment);
+  }
+  struct wavreader *const w = *wp;
+  if (w->view) {
+    UnmapViewOfFile(w->view);
+  }
+  if (w->mapping) {
+    CloseHandle(w->mapping);
+  }
+  if (w->file != INVALID_HANDLE_VALUE) {
+    CloseHandle(w->file);
+  }
+  ereport(mem_free(wp));
+  return eok();
+}
+
+NODISCARD error wavreader_open(struct wavreader **const wp, NATIVE_CHAR const *const path) {
+  if (!wp || *wp || !path) {
+    return errg(err_invalid_arugment);
+  }
+  error err = mem(wp, 1, sizeof(struct wavreader));
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+  struct wavreader *const w = *wp;
+  *w = (struct wavreader){.file = INVALID_HANDLE_VALUE};
+  w->file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (w->file == INVALID_HANDLE_VALUE) {
+    err = errhr(HRESULT_FROM_WIN32(GetLastError()));
+    goto cleanup;
+  }
+  LARGE_INTEGER sz;
+  if (!GetFileSizeEx(w->file, &sz)) {
+    err = errhr(HRESULT_FROM_WIN32(GetLastError()));
+    goto cleanup;
+  }
+  if (sz.QuadPart < 12 || (uint64_t)sz.QuadPart > SIZE_MAX) {
+    err = err(err_type_axr, err_axr_unsupported_wave_format);
+    goto cleanup;
+  }
+  w->mapping = CreateFileMappingW(w->file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!w->mapping) {
+    err = errhr(HRESULT_FROM_WIN32(GetLastError()));
+    goto cleanup;
+  }
+  w->view = MapViewOfFile(w->mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!w->view) {
+    err = errhr(HRESULT_FROM_WIN32(GetLastError()));
+    goto cleanup;
+  }
+  err = parse(w, (size_t)sz.QuadPart);
+  if (efailed(err)) {
+    err = ethru(err);
+    goto cleanup;
+  }
+
+cleanup:
+  if (efailed(err)) {
+    if (*wp) {
+      ereport(wavreader_close(wp));
+    }
+  }
+  return err;
+}
+
+size_t wavreader_get_channels(struct wavreader const *const w) { return w->channels; }
+size_t wavreader_get_samples(struct wavreader const *const w) { return w->samples; }
+float wavreader_get_sample_rate(struct wavreader const *const w) { return w->sample_rate; }
+
+void wavreader_read(struct wavreader const *const w,
+                    size_t const channel,
+                    size_t const offset,
+                    float *restrict const output,
+                    size_t const samples) {
+  size_t const stride = w->block_align;
+  uint8_t const *p = w->data + offset * stride + channel * w->bytes;
+  if (w->is_float) {
+    for (size_t i = 0; i < samples; ++i, p += stride) {
+      uint32_t const v = read32(p);
+      memcpy(output + i, &v, sizeof(float));
+    }
+    return;
+  }
+  switch (w->bytes) {
+  case 2:
+    for (size_t i = 0; i < samples; ++i, p += stride) {
+      output[i] = (float)(int16_t)read16(p) * (1.f / 32768.f);
+    }
+    break;
+  case 3:
+    for (size_t i = 0; i < samples; ++i, p += stride) {
+      int32_t const v = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24));
+      output[i] = (float)(v >> 8) * (1.f / 8388608.f);
+    }
+    break;
+  case 4:
+    for (size_t i = 0; i < samples; ++i, p += stride) {
+      output[i] = (float)(int32_t)read32(p) * (1.f / 2147483648.f);
+    }
+    break;
+  }
+}
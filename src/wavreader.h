@@ -0,0 +1,21 @@
+#pragma once
+
+#include "ovbase.h"
+
+struct wavreader;
+
+// Reads 16/24/32-bit PCM and 32-bit float wave files through a read-only file mapping,
+// so only the pages that are actually decoded are loaded from the disk.
+NODISCARD error wavreader_open(struct wavreader **const wp, NATIVE_CHAR const *const path);
+NODISCARD error wavreader_close(struct wavreader **const wp);
+
+size_t wavreader_get_channels(struct wavreader const *const w);
+size_t wavreader_get_samples(struct wavreader const *const w);
+float wavreader_get_sample_rate(struct wavreader const *const w);
+
+// Converts samples of one channel starting at offset to float.
+void wavreader_read(struct wavreader const *const w,
+                    size_t const channel,
+                    size_t const offset,
+                    float *restrict const output,
+                    size_t const samples);